@@ -0,0 +1,248 @@
+/*****************************************************************************************
+ * File: AlphaMask.h
+ * Desc: Packed 1-bit alpha mask of a surface, for pixel perfect collisions
+ *****************************************************************************************/
+
+/*********************************** The zlib License ************************************
+ *
+ * Copyright (c) 2013 Indielib-crossplatform Development Team
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software
+ * in a product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ *
+ *****************************************************************************************/
+
+
+
+#ifndef _ALPHAMASK_H_
+#define _ALPHAMASK_H_
+
+#include "Defines.h"
+#include <math.h>
+#include <vector>
+
+/** @cond DOCUMENT_PRIVATEAPI */
+
+typedef unsigned long long MASK_WORD;
+
+#define ALPHAMASK_WORD_BITS 64
+
+// --------------------------------------------------------------------------------
+//									 AlphaMask
+// --------------------------------------------------------------------------------
+
+// One bit per pixel, set when the alpha of the pixel reaches the threshold. Rows are stored from
+// the upper one, and each row is packed in words, the lowest bit of the first word being the
+// leftmost pixel. So two masks are checked 64 pixels at a time with an AND.
+class AlphaMask {
+public:
+
+	// ----- Init/End -----
+
+	AlphaMask() : _width(0), _height(0), _wordsPerRow(0) {}
+
+	// ----- Public methods -----
+
+	// Builds the mask from the pixels of a 32 bits image (alpha is the last byte of each pixel)
+	bool build(const unsigned char *pPixels, int pWidth, int pHeight, int pThreshold) {
+		if (!pPixels || pWidth <= 0 || pHeight <= 0) return 0;
+
+		_width = pWidth;
+		_height = pHeight;
+		_wordsPerRow = (_width + ALPHAMASK_WORD_BITS - 1) / ALPHAMASK_WORD_BITS;
+		_bits.assign(_wordsPerRow * _height, 0);
+
+		// Image rows start from the lower one
+		for (int y = 0; y < _height; y++) {
+			const unsigned char *mAlpha = pPixels + (_height - 1 - y) * _width * 4 + 3;
+			MASK_WORD *mRow = &_bits[y * _wordsPerRow];
+			for (int x = 0; x < _width; x++, mAlpha += 4) {
+				if (*mAlpha >= pThreshold) {
+					mRow[x / ALPHAMASK_WORD_BITS] |= static_cast<MASK_WORD>(1) << (x % ALPHAMASK_WORD_BITS);
+				}
+			}
+		}
+
+		return 1;
+	}
+
+	bool isSolid(int pX, int pY) const {
+		if (pX < 0 || pY < 0 || pX >= _width || pY >= _height) return 0;
+		return (_bits[pY * _wordsPerRow + pX / ALPHAMASK_WORD_BITS] >> (pX % ALPHAMASK_WORD_BITS)) & 1;
+	}
+
+	// 64 pixels of a row, from column pX. Pixels out of the mask are 0
+	MASK_WORD getBits(int pX, int pY) const {
+		if (pY < 0 || pY >= _height || pX >= _width || pX <= -ALPHAMASK_WORD_BITS) return 0;
+		if (pX < 0) return getBits(0, pY) << (-pX);
+
+		const MASK_WORD *mRow = &_bits[pY * _wordsPerRow];
+		int mWord = pX / ALPHAMASK_WORD_BITS;
+		int mShift = pX % ALPHAMASK_WORD_BITS;
+
+		MASK_WORD mBits = mRow[mWord] >> mShift;
+		if (mShift && mWord + 1 < _wordsPerRow) {
+			mBits |= mRow[mWord + 1] << (ALPHAMASK_WORD_BITS - mShift);
+		}
+		return mBits;
+	}
+
+	int getWidth() const {
+		return _width;
+	}
+	int getHeight() const {
+		return _height;
+	}
+
+private:
+
+	// ----- Private -----
+
+	int _width;
+	int _height;
+	int _wordsPerRow;
+	std::vector<MASK_WORD> _bits;
+};
+
+// --------------------------------------------------------------------------------
+//								 AlphaMaskPlacement
+// --------------------------------------------------------------------------------
+
+// A mask (or a region of it) placed in the world by the matrix of an entity. World pixels are
+// sampled at their centers. When the entity is only moved by whole pixels, the rows of the mask
+// are read directly; otherwise (scaling, mirroring, rotation) each pixel is sampled
+class AlphaMaskPlacement {
+public:
+
+	// ----- Init/End -----
+
+	AlphaMaskPlacement() : _x1(0), _y1(0), _x2(0), _y2(0), _mask(NULL), _offX(0), _offY(0), _width(0), _height(0),
+		_isUnit(0), _unitX(0), _unitY(0), _tx(0), _ty(0), _invA(0), _invB(0), _invC(0), _invD(0) {}
+
+	// ----- Public methods -----
+
+	// Places the region (pOffX, pOffY, pWidth, pHeight) of the mask. Returns false if nothing is visible
+	bool place(const AlphaMask *pMask, const IND_Matrix &pMat, int pOffX, int pOffY, int pWidth, int pHeight) {
+		if (!pMask || pWidth <= 0 || pHeight <= 0) return 0;
+
+		_mask = pMask;
+		_offX = pOffX;
+		_offY = pOffY;
+		_width = pWidth;
+		_height = pHeight;
+
+		// World = matrix * local (columns of the matrix are the axis, translation is the last one)
+		float mA = pMat._11, mB = pMat._12, mC = pMat._21, mD = pMat._22;
+		_tx = pMat._14;
+		_ty = pMat._24;
+
+		float mDet = mA * mD - mB * mC;
+		if (fabs(mDet) < 0.000001f) return 0;
+		_invA = mD / mDet;
+		_invB = -mB / mDet;
+		_invC = -mC / mDet;
+		_invD = mA / mDet;
+
+		_isUnit = (mA == 1.0f && mD == 1.0f && mB == 0.0f && mC == 0.0f &&
+		           _tx == floorf(_tx) && _ty == floorf(_ty));
+		_unitX = static_cast<int>(_tx);
+		_unitY = static_cast<int>(_ty);
+
+		// Box in world pixels
+		float mW = static_cast<float>(pWidth);
+		float mH = static_cast<float>(pHeight);
+		float mCornersX [4] = {0.0f, mA * mW, mB * mH, mA * mW + mB * mH};
+		float mCornersY [4] = {0.0f, mC * mW, mD * mH, mC * mW + mD * mH};
+		float mMinX = mCornersX[0], mMaxX = mCornersX[0], mMinY = mCornersY[0], mMaxY = mCornersY[0];
+		for (int i = 1; i < 4; i++) {
+			if (mCornersX[i] < mMinX) mMinX = mCornersX[i];
+			if (mCornersX[i] > mMaxX) mMaxX = mCornersX[i];
+			if (mCornersY[i] < mMinY) mMinY = mCornersY[i];
+			if (mCornersY[i] > mMaxY) mMaxY = mCornersY[i];
+		}
+		_x1 = static_cast<int>(floorf(_tx + mMinX));
+		_y1 = static_cast<int>(floorf(_ty + mMinY));
+		_x2 = static_cast<int>(ceilf(_tx + mMaxX));
+		_y2 = static_cast<int>(ceilf(_ty + mMaxY));
+
+		return 1;
+	}
+
+	// pCount (1 to 64) world pixels of row pY, from column pX
+	MASK_WORD getWorldBits(int pX, int pY, int pCount) const {
+		MASK_WORD mBits = 0;
+
+		if (_isUnit) {
+			int mY = pY - _unitY;
+			int mX = pX - _unitX;
+			if (mY < 0 || mY >= _height || mX >= _width || mX + pCount <= 0) return 0;
+
+			mBits = _mask->getBits(_offX + mX, _offY + mY);
+
+			// Pixels out of the region
+			if (mX < 0) mBits &= ~static_cast<MASK_WORD>(0) << (-mX);
+			int mInside = _width - mX;
+			if (mInside < pCount) pCount = mInside;
+		} else {
+			float mWorldX = pX + 0.5f - _tx;
+			float mWorldY = pY + 0.5f - _ty;
+			float mLocalX = _invA * mWorldX + _invB * mWorldY;
+			float mLocalY = _invC * mWorldX + _invD * mWorldY;
+
+			for (int i = 0; i < pCount; i++, mLocalX += _invA, mLocalY += _invC) {
+				if (mLocalX < 0.0f || mLocalY < 0.0f) continue;
+				int mX = static_cast<int>(mLocalX);
+				int mY = static_cast<int>(mLocalY);
+				if (mX < _width && mY < _height && _mask->isSolid(_offX + mX, _offY + mY)) {
+					mBits |= static_cast<MASK_WORD>(1) << i;
+				}
+			}
+		}
+
+		if (pCount < ALPHAMASK_WORD_BITS) {
+			mBits &= (static_cast<MASK_WORD>(1) << pCount) - 1;
+		}
+		return mBits;
+	}
+
+	// ----- Box in world pixels (x2, y2 not included) -----
+
+	int _x1, _y1, _x2, _y2;
+
+private:
+
+	// ----- Private -----
+
+	const AlphaMask *_mask;
+	int _offX;
+	int _offY;
+	int _width;
+	int _height;
+
+	bool _isUnit;
+	int _unitX;
+	int _unitY;
+
+	float _tx, _ty;
+	float _invA, _invB, _invC, _invD;
+};
+
+/** @endcond */
+
+#endif // _ALPHAMASK_H_
@@ -0,0 +1,362 @@
+/*****************************************************************************************
+ * File: CollisionCache2d.h
+ * Desc: Bounding areas of a 2d entity transformed to world coordinates, with their boxes
+ *****************************************************************************************/
+
+/*********************************** The zlib License ************************************
+ *
+ * Copyright (c) 2013 Indielib-crossplatform Development Team
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software
+ * in a product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ *
+ *****************************************************************************************/
+
+
+#ifndef _COLLISIONCACHE2D_H_
+#define _COLLISIONCACHE2D_H_
+
+#include "Defines.h"
+#include "IND_Math.h"
+#include <list>
+#include <vector>
+#include <algorithm>
+
+/** @cond DOCUMENT_PRIVATEAPI */
+
+// Boxes are grown by this, so rounding never discards a pair that the exact tests find touching
+#define COLLISIONCACHE_BOX_MARGIN 1.0f
+
+// Boxes of bounding areas, one array per coordinate
+struct structWorldBoxes {
+	std::vector<float> _x1, _y1, _x2, _y2;
+
+	void push(float pX1, float pY1, float pX2, float pY2) {
+		_x1.push_back(pX1 - COLLISIONCACHE_BOX_MARGIN);
+		_y1.push_back(pY1 - COLLISIONCACHE_BOX_MARGIN);
+		_x2.push_back(pX2 + COLLISIONCACHE_BOX_MARGIN);
+		_y2.push_back(pY2 + COLLISIONCACHE_BOX_MARGIN);
+	}
+
+	void clear() {
+		_x1.clear();
+		_y1.clear();
+		_x2.clear();
+		_y2.clear();
+	}
+
+	bool isOverlap(size_t pIndex, const float *pBox) const {
+		return _x1[pIndex] <= pBox[2] && pBox[0] <= _x2[pIndex] && _y1[pIndex] <= pBox[3] && pBox[1] <= _y2[pIndex];
+	}
+
+	void getBox(size_t pIndex, float *pBox) const {
+		pBox[0] = _x1[pIndex];
+		pBox[1] = _y1[pIndex];
+		pBox[2] = _x2[pIndex];
+		pBox[3] = _y2[pIndex];
+	}
+};
+typedef struct structWorldBoxes WORLD_BOXES;
+
+// Triangle bounding areas in world coordinates
+struct structWorldTriangles {
+	std::vector<float> _ax, _ay, _bx, _by, _cx, _cy;
+	std::vector<int> _group;
+	WORLD_BOXES _boxes;
+
+	size_t size() const {
+		return _group.size();
+	}
+
+	void clear() {
+		_ax.clear();
+		_ay.clear();
+		_bx.clear();
+		_by.clear();
+		_cx.clear();
+		_cy.clear();
+		_group.clear();
+		_boxes.clear();
+	}
+};
+typedef struct structWorldTriangles WORLD_TRIANGLES;
+
+// Circle bounding areas in world coordinates
+struct structWorldCircles {
+	std::vector<float> _x, _y;
+	std::vector<int> _radius;               // Scaled, same rounding as IND_Math collision methods
+	std::vector<int> _group;
+	WORLD_BOXES _boxes;
+
+	size_t size() const {
+		return _group.size();
+	}
+
+	void clear() {
+		_x.clear();
+		_y.clear();
+		_radius.clear();
+		_group.clear();
+		_boxes.clear();
+	}
+};
+typedef struct structWorldCircles WORLD_CIRCLES;
+
+// Box enclosing all the bounding areas of a collision group
+struct structWorldGroup {
+	int _group;
+	float _box [4];
+};
+typedef struct structWorldGroup WORLD_GROUP;
+
+// --------------------------------------------------------------------------------
+//								 CollisionCache2d
+// --------------------------------------------------------------------------------
+
+// Bounding areas of an entity are transformed once, and used for every collision check until the
+// entity is transformed again or its bounding areas change. Triangles and circles are kept apart,
+// in contiguous arrays, so checks walk them in order instead of following the bounding list.
+class CollisionCache2d {
+public:
+
+	// ----- Init/End -----
+
+	CollisionCache2d(): _list(NULL), _scale(0.0f), _valid(false)  { }
+
+	// ----- Public methods -----
+
+	void invalidate() {
+		_valid = false;
+	}
+
+	// Still valid for these bounding areas (animations change them with each frame) and scale
+	bool isValid(std::list<BOUNDING_COLLISION *> *pList, float pScale) const {
+		return _valid && _list == pList && _scale == pScale;
+	}
+
+	void build(std::list<BOUNDING_COLLISION *> *pList, const IND_Matrix &pMat, float pScale, const IND_Math *pMath) {
+		_list = pList;
+		_scale = pScale;
+		_valid = true;
+		_triangles.clear();
+		_circles.clear();
+		_groups.clear();
+
+		std::list<BOUNDING_COLLISION *>::iterator mIter;
+		for (mIter = pList->begin(); mIter != pList->end(); mIter++) {
+			float mBox [4];
+
+			// Triangle
+			if ((*mIter)->getType() == 0) {
+				IND_Vector2 mA((float) (*mIter)->_ax, (float) (*mIter)->_ay);
+				IND_Vector2 mB((float) (*mIter)->_bx, (float) (*mIter)->_by);
+				IND_Vector2 mC((float) (*mIter)->_cx, (float) (*mIter)->_cy);
+				pMath->transformVector2DbyMatrix4D(mA, pMat);
+				pMath->transformVector2DbyMatrix4D(mB, pMat);
+				pMath->transformVector2DbyMatrix4D(mC, pMat);
+
+				_triangles._ax.push_back(mA._x);
+				_triangles._ay.push_back(mA._y);
+				_triangles._bx.push_back(mB._x);
+				_triangles._by.push_back(mB._y);
+				_triangles._cx.push_back(mC._x);
+				_triangles._cy.push_back(mC._y);
+				_triangles._group.push_back((*mIter)->getGroup());
+				_triangles._boxes.push(std::min(mA._x, std::min(mB._x, mC._x)),
+				                       std::min(mA._y, std::min(mB._y, mC._y)),
+				                       std::max(mA._x, std::max(mB._x, mC._x)),
+				                       std::max(mA._y, std::max(mB._y, mC._y)));
+				_triangles._boxes.getBox(_triangles.size() - 1, mBox);
+			}
+			// Circle
+			else {
+				IND_Vector2 mCenter((float) (*mIter)->_posX, (float) (*mIter)->_posY);
+				pMath->transformVector2DbyMatrix4D(mCenter, pMat);
+				int mRadius = (int)((*mIter)->_radius * pScale);
+				float mExtent = (float) abs(mRadius);
+
+				_circles._x.push_back(mCenter._x);
+				_circles._y.push_back(mCenter._y);
+				_circles._radius.push_back(mRadius);
+				_circles._group.push_back((*mIter)->getGroup());
+				_circles._boxes.push(mCenter._x - mExtent, mCenter._y - mExtent, mCenter._x + mExtent, mCenter._y + mExtent);
+				_circles._boxes.getBox(_circles.size() - 1, mBox);
+			}
+
+			addToGroup((*mIter)->getGroup(), mBox);
+		}
+	}
+
+	// Box of the bounding areas of a group (IND_COLLISION_GROUP_ANY for all of them). False if there is none
+	bool getBox(int pGroup, float *pBox) const {
+		bool mFound = false;
+		for (size_t i = 0; i < _groups.size(); i++) {
+			if (isInGroup(pGroup, _groups[i]._group)) {
+				if (!mFound) {
+					memcpy(pBox, _groups[i]._box, sizeof(_groups[i]._box));
+					mFound = true;
+				} else {
+					growBox(pBox, _groups[i]._box);
+				}
+			}
+		}
+		return mFound;
+	}
+
+	// Checks the bounding areas of a group against the ones of a group of other entity. Groups are
+	// first checked by their boxes, and then each pair of bounding areas
+	bool isCollision(int pGroup, CollisionCache2d &pOther, int pOtherGroup, IND_Math *pMath) {
+		float mBox [4];
+		float mOtherBox [4];
+
+		// No bounding areas of those groups, or too far away
+		if (!getBox(pGroup, mBox) || !pOther.getBox(pOtherGroup, mOtherBox)) return 0;
+		if (!isOverlap(mBox, mOtherBox)) return 0;
+
+		// Triangles to triangles and circles of the other entity
+		for (size_t i = 0; i < _triangles.size(); i++) {
+			if (!isInGroup(pGroup, _triangles._group[i]) || !_triangles._boxes.isOverlap(i, mOtherBox)) continue;
+
+			float mTriangleBox [4];
+			_triangles._boxes.getBox(i, mTriangleBox);
+			IND_Vector2 mA(_triangles._ax[i], _triangles._ay[i]);
+			IND_Vector2 mB(_triangles._bx[i], _triangles._by[i]);
+			IND_Vector2 mC(_triangles._cx[i], _triangles._cy[i]);
+
+			const WORLD_TRIANGLES &mTriangles = pOther._triangles;
+			for (size_t j = 0; j < mTriangles.size(); j++) {
+				if (!isInGroup(pOtherGroup, mTriangles._group[j]) || !mTriangles._boxes.isOverlap(j, mTriangleBox)) continue;
+
+				IND_Vector2 mA2(mTriangles._ax[j], mTriangles._ay[j]);
+				IND_Vector2 mB2(mTriangles._bx[j], mTriangles._by[j]);
+				IND_Vector2 mC2(mTriangles._cx[j], mTriangles._cy[j]);
+				if (pMath->isTriangleToTriangleCollision(mA, mB, mC, mA2, mB2, mC2))
+					return 1;
+			}
+
+			const WORLD_CIRCLES &mCircles = pOther._circles;
+			for (size_t j = 0; j < mCircles.size(); j++) {
+				if (!isInGroup(pOtherGroup, mCircles._group[j]) || !mCircles._boxes.isOverlap(j, mTriangleBox)) continue;
+
+				IND_Vector2 mCenter(mCircles._x[j], mCircles._y[j]);
+				if (pMath->isCircleToTriangleCollision(mCenter, mCircles._radius[j], mA, mB, mC))
+					return 1;
+			}
+		}
+
+		// Circles to triangles and circles of the other entity
+		for (size_t i = 0; i < _circles.size(); i++) {
+			if (!isInGroup(pGroup, _circles._group[i]) || !_circles._boxes.isOverlap(i, mOtherBox)) continue;
+
+			float mCircleBox [4];
+			_circles._boxes.getBox(i, mCircleBox);
+			IND_Vector2 mCenter(_circles._x[i], _circles._y[i]);
+
+			const WORLD_TRIANGLES &mTriangles = pOther._triangles;
+			for (size_t j = 0; j < mTriangles.size(); j++) {
+				if (!isInGroup(pOtherGroup, mTriangles._group[j]) || !mTriangles._boxes.isOverlap(j, mCircleBox)) continue;
+
+				IND_Vector2 mA2(mTriangles._ax[j], mTriangles._ay[j]);
+				IND_Vector2 mB2(mTriangles._bx[j], mTriangles._by[j]);
+				IND_Vector2 mC2(mTriangles._cx[j], mTriangles._cy[j]);
+				if (pMath->isCircleToTriangleCollision(mCenter, _circles._radius[i], mA2, mB2, mC2))
+					return 1;
+			}
+
+			const WORLD_CIRCLES &mCircles = pOther._circles;
+			for (size_t j = 0; j < mCircles.size(); j++) {
+				if (!isInGroup(pOtherGroup, mCircles._group[j]) || !mCircles._boxes.isOverlap(j, mCircleBox)) continue;
+
+				IND_Vector2 mCenter2(mCircles._x[j], mCircles._y[j]);
+				if (pMath->isCircleToCircleCollision(mCenter, _circles._radius[i], mCenter2, mCircles._radius[j]))
+					return 1;
+			}
+		}
+
+		return 0;
+	}
+
+	// True if any bounding area contains the point
+	bool isPointInside(float pX, float pY) const {
+		IND_Vector2 mPoint(pX, pY);
+
+		for (size_t i = 0; i < _triangles.size(); i++) {
+			IND_Vector2 mA(_triangles._ax[i], _triangles._ay[i]);
+			IND_Vector2 mB(_triangles._bx[i], _triangles._by[i]);
+			IND_Vector2 mC(_triangles._cx[i], _triangles._cy[i]);
+			if (IND_Math::isPointInsideTriangle(mPoint, mA, mB, mC))
+				return 1;
+		}
+
+		for (size_t i = 0; i < _circles.size(); i++) {
+			IND_Vector2 mCenter(_circles._x[i], _circles._y[i]);
+			if (mCenter.distance(mPoint) <= _circles._radius[i])
+				return 1;
+		}
+
+		return 0;
+	}
+
+	// Same group matching as IND_Entity2dManager::isCollision(): "*" means any group
+	static bool isInGroup(int pGroup, int pAreaGroup) {
+		return pGroup == IND_COLLISION_GROUP_ANY || pGroup == pAreaGroup;
+	}
+
+	static bool isOverlap(const float *pBox1, const float *pBox2) {
+		return pBox1[0] <= pBox2[2] && pBox2[0] <= pBox1[2] && pBox1[1] <= pBox2[3] && pBox2[1] <= pBox1[3];
+	}
+
+private:
+
+	// ----- Private -----
+
+	std::list<BOUNDING_COLLISION *> *_list;
+	float _scale;
+	bool _valid;
+	WORLD_TRIANGLES _triangles;
+	WORLD_CIRCLES _circles;
+	std::vector<WORLD_GROUP> _groups;
+
+	// ----- Private methods -----
+
+	static void growBox(float *pBox, const float *pOther) {
+		pBox[0] = std::min(pBox[0], pOther[0]);
+		pBox[1] = std::min(pBox[1], pOther[1]);
+		pBox[2] = std::max(pBox[2], pOther[2]);
+		pBox[3] = std::max(pBox[3], pOther[3]);
+	}
+
+	void addToGroup(int pGroup, const float *pBox) {
+		for (size_t i = 0; i < _groups.size(); i++) {
+			if (_groups[i]._group == pGroup) {
+				growBox(_groups[i]._box, pBox);
+				return;
+			}
+		}
+
+		WORLD_GROUP mGroup;
+		mGroup._group = pGroup;
+		memcpy(mGroup._box, pBox, sizeof(mGroup._box));
+		_groups.push_back(mGroup);
+	}
+};
+
+/** @endcond */
+
+#endif // _COLLISIONCACHE2D_H_
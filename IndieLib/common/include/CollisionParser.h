@@ -35,6 +35,8 @@
 // ----- Includes -----
 
 #include <list>
+#include <map>
+#include <string>
 
 
 // --------------------------------------------------------------------------------
@@ -54,6 +56,8 @@ public:
 	void setBoundingCircle(list <BOUNDING_COLLISION *> *pBList, const char *pId, int pOffsetX, int pOffsetY, int pRadius);
 	void setBoundingRectangle(list <BOUNDING_COLLISION *> *pBList, const char *pId, int pOffsetX, int pOffsetY, int pWidth, int pHeight);
 	void deleteBoundingAreas(list <BOUNDING_COLLISION *> *pBList, const char *pId);
+	int registerGroup(const char *pId);
+	int findGroup(const char *pId);
 
 protected:
 
@@ -63,6 +67,9 @@ protected:
 
 private:
 	static CollisionParser *_pinstance;
+
+	// Number of each collision group id, in order of registration
+	map <string, int> _groups;
 };
 
 /** @endcond */
@@ -1189,6 +1189,11 @@ typedef int IND_InitializationMode;
  * @ingroup Types
  */
 /**@{*/
+//! Collision group number meaning any group (same as the "*" id)
+#define IND_COLLISION_GROUP_ANY             -1
+//! Collision group number of an id not used by any bounding area
+#define IND_COLLISION_GROUP_NONE            -2
+
 //! Encapsulates information about a parsed bounding collision information from xml
 struct structBoundingCollision {
 public:
@@ -1204,11 +1209,14 @@ public:
 private:
     int _type;                          //!< 0 = Triange, 1 = Circle
 	char *_id;                          //!< Group Id for grouping bounding areas
+	int _group;                         //!< Number of the group, registered from the id
     
 public:
     //! Default constructor
 	structBoundingCollision() {
 		_type = _posX = _posY = _radius = _ax = _ay = _bx = _by = _cx = _cy = 0;
+		_id = NULL;
+		_group = IND_COLLISION_GROUP_NONE;
 	}
     
     /**
@@ -1220,6 +1228,7 @@ public:
         _type = type;
         _id = new char[strlen(identifier) + 1];
         strcpy(_id, identifier);
+        _group = IND_COLLISION_GROUP_NONE;
         _posX = _posY = _radius = _ax = _ay = _bx = _by = _cx = _cy = 0;
     }
     ~structBoundingCollision() {
@@ -1236,6 +1245,16 @@ public:
     int getType() {
         return _type;
     }
+
+    //!Returns the number of the group of this collision
+    int getGroup() {
+        return _group;
+    }
+
+    //!Sets the number of the group, as registered for the id
+    void setGroup(int group) {
+        _group = group;
+    }
 };
 //! Alias for the bounding collision structure
 typedef struct structBoundingCollision BOUNDING_COLLISION;
@@ -154,6 +154,11 @@ public:
 	bool                    getIsActive(unsigned int pSequence);
 	void                    setIsActive(unsigned int pSequence, bool pAct);
 
+	//! This function returns the position, in the vector of frames of the animation, of a frame of the sequence.
+	unsigned int                     getFramePosInVec(unsigned int pSequence, unsigned int pPos);
+	//! This function returns the time, in milliseconds, that a frame of the sequence is displayed.
+	unsigned int                     getFrameTime(unsigned int pSequence, unsigned int pPos);
+
 	// ----- Public sets ------
 
 	//! This function establishes a IND_Image object in a frame. It can be useful for modifying some frames of animations.Note: It is convenient to eliminate any IND_Image object that would be there before setting the actual one.
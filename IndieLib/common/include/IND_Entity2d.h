@@ -36,10 +36,13 @@
 
 #include "Defines.h"
 #include <list>
+#include <vector>
 #include "IND_Object.h"
 
 // ----- Forward declarations -----
 class CollisionParser;
+class CollisionCache2d;
+class IND_Entity2dManager;
 class IND_Animation;
 class IND_Surface;
 class IND_Font;
@@ -210,6 +213,10 @@ public:
 	int     getNumReplays()      {
 		return _numReplays;
 	}
+	//! Returns the frame of the sequence shown by the entity. Each entity plays its animation on its own, even if the animation is shared.
+	int     getActualFrame()      {
+		return _animFrame;
+	}
 	//! Returns X position of the entity.
 	float   getPosX()      {
 		return _x;
@@ -462,6 +469,12 @@ private:
 	int _numReplays;        // Num of replays of the sequence
 	int _firstTime;         // Flag
 
+	// Animation playback (the animation itself is shared, and never changed by the entity)
+	int _animFrame;                 // Frame of the sequence being shown
+	unsigned long _animElapsed;     // Time the frame has been shown
+	unsigned long _animTicks;       // Time of the animation clock when it was last advanced
+	bool _animPlaying;              // The clock has been read since the sequence started
+
 	// 2d primitive attributes
 	int _x1, _y1, _x2, _y2; // Line
 	int _radius;            // Radius
@@ -476,6 +489,13 @@ private:
 	int _lineSpacing;       // Space between lines
 	char *_text;            // Text
 
+	// Text geometry, laid out by the render only when the text or the way to draw it changes
+	vector <CUSTOMVERTEX2D> _textVertices;  // Quads of the letters, in the coordinates of the entity
+	bool _textDirty;                        // The text must be laid out again
+	bool _textCached;                       // The render could lay out the text into _textVertices
+	float _textScaleX;                      // Scaling used for the layout
+	float _textScaleY;
+
 	// Collision attributes
 	bool _showCollisionAreas;
 
@@ -489,9 +509,38 @@ private:
     
     unsigned int _id;
 
+	IND_Entity2dManager *_manager;  // Manager holding the entity, if any
+	int _slotLayer;                 // Layer of the manager holding the entity
+	int _slot;                      // Position in that layer
+
+	// Broadphase attributes (see IND_Entity2dManager::queryCollisions())
+	float _collisionBox [4];        // World box of all the bounding areas: x1, y1, x2, y2
+	int _collisionCells [4];        // Broadphase cells covered by the box: x1, y1, x2, y2
+	bool _inBroadphase;             // Stored in the broadphase of its layer
+	bool _broadphaseDirty;          // Waiting for its box to be calculated again
+
+	CollisionCache2d *_worldCollision;  // Bounding areas in world coords, calculated when first checked
+
+	// Culling attributes (see IND_Entity2dManager::renderEntities2d())
+	float _renderBox [4];           // World box of the drawn surface: x1, y1, x2, y2
+	bool _renderBoxDirty;           // Waiting for its box to be calculated again
+
+	// Render index attributes (see IND_Entity2dManager::setLayerStatic())
+	int _renderCells [4];           // Cells of the index covered by the box: x1, y1, x2, y2
+	bool _inRenderIndex;            // Stored in the render index of its layer
+	bool _renderIndexDirty;         // Waiting to be placed again in the index
+	unsigned int _renderStamp;      // Last query of the index that found it
+
+	// Frame preparation (see IND_Entity2dManager::prepareEntities2d())
+	bool _prepareCulled;            // Out of the screen
+	bool _prepareCollisionDirty;    // Bounding areas moved
+
 	// ----- Private methods -----
 
 	void    initAttrib();
+	void    setZ(int pZ);
+	void    collisionChanged();
+	void    transformChanged();
 
 	// ----- Friends -----
 
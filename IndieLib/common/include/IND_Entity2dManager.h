@@ -45,11 +45,20 @@ class IND_Render;
 class CollisionParser;
 class IND_Entity2d;
 class IND_Math;
+class SpatialHash2d;
+class CollisionCache2d;
+class AlphaMaskPlacement;
+class WorkerPool;
+class IND_Timer;
+class IND_Frame;
 
 // ----- Defines -----
 
 #define NUM_LAYERS 64
 
+//! Function called by IND_Entity2dManager::queryCollisions() for each pair of colliding entities
+typedef void (*IND_CollisionCallback)(IND_Entity2d *pEn1, IND_Entity2d *pEn2, void *pUserData);
+
 // --------------------------------------------------------------------------------
 //									IND_Entity2dManager
 // --------------------------------------------------------------------------------
@@ -73,7 +82,7 @@ public:
 
 	// ----- Init/End -----
 
-	IND_Entity2dManager(): _ok(false),_render(NULL),_math(NULL)  { }
+	IND_Entity2dManager(): _ok(false),_render(NULL),_math(NULL),_broadphaseCellSize(128.0f),_workers(NULL),_numThreads(1),_animationTimer(NULL),_animationManual(false),_animationTicks(0)  { }
 	~IND_Entity2dManager()              {
 		end();
 	}
@@ -87,6 +96,8 @@ public:
 	bool            add(IND_Entity2d *pNewEntity2d);
 	bool            add(int pLayer, IND_Entity2d *pNewEntity2d);
 	bool            remove(IND_Entity2d *pEn);
+	bool            remove(IND_Entity2d **pEntities, int pNumEntities);
+	bool            removeAll(int pLayer);
 
 	/**
 	@b Operation:
@@ -99,6 +110,16 @@ public:
 		renderEntities2d(0);
 	};
 	void     renderEntities2d(int pLayer);
+	void     prepareEntities2d();
+
+	void     setNumThreads(int pNumThreads);
+	int      getNumThreads();
+
+	void     advanceAnimations(unsigned long pElapsed);
+	void     setLayerStatic(int pLayer, bool pStatic);
+	bool     isLayerStatic(int pLayer);
+	int      getNumEntities(int pLayer);
+	int      getNumVisitedEntities(int pLayer);
 	void     renderCollisionAreas(unsigned char pR, unsigned char pG, unsigned char pB, unsigned char pA);
 	void     renderCollisionAreas(int pLayer, unsigned char pR, unsigned char pG, unsigned char pB, unsigned char pA);
 	/**
@@ -114,6 +135,14 @@ public:
 	void     renderGridAreas(int pLayer, unsigned char pR, unsigned char pG, unsigned char pB, unsigned char pA);
 
 	bool     isCollision(IND_Entity2d *pEn1, const char *pId1, IND_Entity2d *pEn2, const char *pId2);
+	bool     isCollision(IND_Entity2d *pEn1, int pGroup1, IND_Entity2d *pEn2, int pGroup2);
+	int      getCollisionGroup(const char *pId);
+	bool     isPixelCollision(IND_Entity2d *pEn1, IND_Entity2d *pEn2);
+
+	void     setBroadphaseCellSize(int pCellSize);
+	int      queryCollisions(int pLayer, const char *pId1, const char *pId2, IND_CollisionCallback pCallback, void *pUserData);
+	int      queryRect(int pLayer, float pX1, float pY1, float pX2, float pY2, vector <IND_Entity2d *> &pResult);
+	int      queryPoint(int pLayer, float pX, float pY, vector <IND_Entity2d *> &pResult);
 
 private:
 	/** @cond DOCUMENT_PRIVATEAPI */
@@ -130,20 +159,100 @@ private:
 
 	vector <IND_Entity2d *> *_listEntities2d  [NUM_LAYERS];
 
-	// ----- Private methods -----
+	// Layers with entities out of z order, since the last time they were rendered
+	bool _layerUnsorted [NUM_LAYERS];
+
+	// Slots left empty by removed entities in each layer, until the layer is compacted
+	int _layerHoles [NUM_LAYERS];
+
+	// Collision broadphase of each layer, built the first time the layer is queried
+	SpatialHash2d *_broadphase [NUM_LAYERS];
+	vector <IND_Entity2d *> _broadphaseDirty [NUM_LAYERS];
+	float _broadphaseCellSize;
+
+	// Render index of each static layer, built the first time the layer is rendered
+	bool _layerStatic [NUM_LAYERS];
+	SpatialHash2d *_renderIndex [NUM_LAYERS];
+	vector <IND_Entity2d *> _renderIndexDirty [NUM_LAYERS];
+	vector <IND_Entity2d *> _renderVisible [NUM_LAYERS];
+	unsigned int _renderStamp [NUM_LAYERS];
+
+	// Entities gone through the last time each layer was rendered
+	int _layerVisited [NUM_LAYERS];
 
-	bool isCollision(list <BOUNDING_COLLISION *> *pBoundingList1, list <BOUNDING_COLLISION *> *pBoundingList2,
-	                 const char *pId1, const char *pId2,
-	                 IND_Matrix pMat1, IND_Matrix pMat2,
-	                 float pScale1, float pScale2);
+	// Chunk of a layer prepared by one task (see prepareEntities2d())
+	struct PREPARE_TASK {
+		int _layer;
+		int _begin;
+		int _end;
+	};
+
+	// Frame preparation, on a pool of threads when there is more than one
+	WorkerPool *_workers;
+	int _numThreads;
+	bool _layerPrepared [NUM_LAYERS];
+	vector <IND_Entity2d *> *_prepareList [NUM_LAYERS];     // Entities gone through in each layer
+	vector <IND_Entity2d *> _drawList [NUM_LAYERS];         // Entities left to draw in each layer
+	int _prepareDiscarded [NUM_LAYERS];
+	vector <PREPARE_TASK> _prepareTasks;
+	float _prepareView [4];                                 // Screen box used to prepare the layers
+	bool _prepareViewOk;
+	unsigned long _prepareTicks;                            // Clock of the animations when the layers were prepared
+
+	// Clock of the animations: the system one, or moved by hand with advanceAnimations()
+	IND_Timer *_animationTimer;
+	bool _animationManual;
+	unsigned long _animationTicks;
+
+	// ----- Private methods -----
 
 	bool isNullMatrix(IND_Matrix pMat);
 
+	list <BOUNDING_COLLISION *> *getBoundingList(IND_Entity2d *pEn);
+	CollisionCache2d *getWorldCollision(IND_Entity2d *pEn);
+	bool calculateCollisionBox(IND_Entity2d *pEn);
+	bool placeAlphaMask(IND_Entity2d *pEn, AlphaMaskPlacement &pPlacement);
+	void calculateRenderBox(IND_Entity2d *pEn);
+	bool cullEntity(IND_Entity2d *pEn);
+	bool hasRenderBox(IND_Entity2d *pEn);
+	void updateTransform(IND_Entity2d *pEn);
+	void calculateTransform(IND_Entity2d *pEn);
+	void runTasks(int pNumTasks, void (*pTask)(void *pManager, int pTask));
+	static void prepareLayerTask(void *pManager, int pLayer);
+	static void prepareEntitiesTask(void *pManager, int pTask);
+	static void finishLayerTask(void *pManager, int pLayer);
+	bool isPreparedView();
+	unsigned long getAnimationTicks();
+	void advanceAnimation(IND_Entity2d *pEn, unsigned long pTicks);
+	IND_Frame *getAnimationFrame(IND_Entity2d *pEn);
+	void blitAnimationFrame(IND_Entity2d *pEn);
+	void setRenderDirty(IND_Entity2d *pEn);
+	void updateRenderIndex(int pLayer);
+	bool queryRenderIndex(int pLayer, vector <IND_Entity2d *> &pResult);
+	void removeFromRenderIndex(IND_Entity2d *pEn);
+	void releaseRenderIndex(int pLayer);
+	static bool slotIsLess(IND_Entity2d *pLhs, IND_Entity2d *pRhs);
+	void setCollisionDirty(IND_Entity2d *pEn);
+	void updateBroadphase(int pLayer);
+	void removeFromBroadphase(IND_Entity2d *pEn);
+	void releaseBroadphase(int pLayer);
+	bool isCollisionPair(IND_Entity2d *pEn1, IND_Entity2d *pEn2, int pGroup1, int pGroup2,
+	                     IND_CollisionCallback pCallback, void *pUserData);
+
 	void addToList(int pLayer, IND_Entity2d *pNewEntity2d);
+	void removeFromList(IND_Entity2d *pEn);
+	void compactLayer(int pLayer);
+
+	void setLayerUnsorted(int pLayer);
+	void sortLayer(int pLayer);
 
 	void writeMessage();
 	void initVars();
 	void freeVars();
+
+	// ----- Friends -----
+
+	friend class IND_Entity2d;
     /** @endcond */
 };
 /**@}*/
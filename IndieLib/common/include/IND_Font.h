@@ -35,6 +35,7 @@
 #define MAX_CHARS 4096
 
 #include "IND_Object.h"
+#include <vector>
 
 class IND_Surface;
 // --------------------------------------------------------------------------------
@@ -143,6 +144,12 @@ private:
 	};
 	typedef struct structKerning KERNING;
 
+	// Order of the kerning array: by first character, then by second character
+	static bool kerningIsLess(const KERNING &pLhs, const KERNING &pRhs) {
+		if (pLhs._first != pRhs._first) return pLhs._first < pRhs._first;
+		return pLhs._second < pRhs._second;
+	}
+
 	// FONT
 	struct structFont {
 		LETTER *_letters;       // Letter array
@@ -152,7 +159,10 @@ private:
 
         FONTTYPE _type;         // Font type that is being used. ( MudFont / AngelCode )
         int     _numKernings;   // Num of kernings (angelcode specific).
-        KERNING *_kernings;     // Kerning array (angelcode specific).
+        KERNING *_kernings;     // Kerning array (angelcode specific), sorted by first and second character.
+
+        int     _letterIndex[256];  // Position in _letters of each character, -1 if the font doesn't have it
+        int     _kerningIndex[257]; // Kernings with first character c are the ones from _kerningIndex[c] to _kerningIndex[c + 1]
         
                                 // TODO: add the toplevel info variables here if needed ( see angelcode documentation )
         
@@ -167,6 +177,8 @@ private:
             _kernings(NULL){
                 _name = new char[MAX_TOKEN];
                 memset(_name, (int)'\0', MAX_TOKEN);
+                memset(_letterIndex, -1, sizeof(_letterIndex));
+                memset(_kerningIndex, 0, sizeof(_kerningIndex));
 		}
         ~structFont() {
             DISPOSEARRAY(_name);
@@ -219,6 +231,52 @@ private:
 		return _font._type;
 	}
 
+	// Letter of a character, NULL if the font doesn't have it
+	LETTER *getLetter(unsigned char pChar) {
+		int mPos = _font._letterIndex[pChar];
+		return mPos < 0 ? NULL : &_font._letters[mPos];
+	}
+
+	// How much the x position is adjusted when pSecond is drawn just after pFirst
+	int getKerning(unsigned char pFirst, unsigned char pSecond) {
+		int mBegin = _font._kerningIndex[pFirst];
+		int mEnd = _font._kerningIndex[pFirst + 1];
+		while (mBegin < mEnd) {
+			int mMiddle = (mBegin + mEnd) / 2;
+			if (_font._kernings[mMiddle]._second < pSecond) {
+				mBegin = mMiddle + 1;
+			} else {
+				mEnd = mMiddle;
+			}
+		}
+		if (mBegin < _font._kerningIndex[pFirst + 1] && _font._kernings[mBegin]._second == pSecond)
+			return _font._kernings[mBegin]._amount;
+		return 0;
+	}
+
+	// Width in pixels of each line of the text (a line ends in \n or \0), all of them measured in one pass
+	void getLineWidths(const char *pText, int pOffset, std::vector<int> &pWidths) {
+		pWidths.clear();
+		int mWidth = 0;
+		unsigned char mLast = 0;
+		for (const char *mChar = pText; ; mChar++) {
+			unsigned char mActual = static_cast<unsigned char>(*mChar);
+			if (mActual == '\0' || mActual == '\n') {
+				pWidths.push_back(mWidth);
+				if (mActual == '\0') return;
+				mWidth = 0;
+				mLast = 0;
+				continue;
+			}
+
+			LETTER *mLetter = getLetter(mActual);
+			if (mLetter) {
+				mWidth += getKerning(mLast, mActual) + mLetter->_width + pOffset;
+			}
+			mLast = mActual;
+		}
+	}
+
 
 	// ----- Friends -----
 
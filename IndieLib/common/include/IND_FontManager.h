@@ -133,6 +133,7 @@ private:
 
 	bool                parseMudFont(IND_Font *pNewFont,const char *pFontName);
     bool                parseAngelCodeFont(IND_Font *pNewFont,const char *pFontName, IND_Type pType, IND_Quality pQuality);
+	void                buildLookupTables(IND_Font *pNewFont);
 
 	void                addToList(IND_Font *pNewFont);
 	void                delFromlist(IND_Font *pFo);
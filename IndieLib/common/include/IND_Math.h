@@ -41,6 +41,17 @@
 #include "IND_Vector2.h"
 #include "IND_Vector3.h"
 
+// SIMD instructions for the batch collision methods. Define IND_MATH_NO_SIMD to use only scalar code
+#ifndef IND_MATH_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IND_MATH_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define IND_MATH_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
 // --------------------------------------------------------------------------------
 //									   IND_Math
 // --------------------------------------------------------------------------------
@@ -68,6 +79,11 @@ You know what this is..
 */
 #define PI 3.14159265358979323846f
 
+/**
+Maximum number of shapes checked by a call to the batch collision methods (one bit each in the returned mask)
+*/
+#define IND_MATH_BATCH_SIZE 32
+
 
 /**
  @brief Encapsulates common math operations used through the library
@@ -323,6 +339,47 @@ public:
 
 		return mResult;
 	}
+
+	/** @brief Calculates the box of the plane z = 0 seen through a frustrum (the screen, in 2d)
+
+		The box encloses the corners where the side planes of the frustrum cross the plane z = 0, so it
+		is bigger than the view when the camera is rotated.
+		Note: the viewing frustum must be calculated first
+
+		@param pFrustrum Frustrum structure as per camera position, specified by 6 planes
+		@param pBox Box calculated: x1, y1, x2, y2
+		@return False if the side planes don't cross the plane z = 0 in 4 corners
+	*/
+	bool calculateFrustumBox2d(const FRUSTRUMPLANES &pFrustrum, float *pBox) const {
+		int mNumCorners = 0;
+
+		// Side planes are the first 4 ones. Each corner is where two non parallel ones cross
+		for (int i = 0; i < 4; i++) {
+			for (int j = i + 1; j < 4; j++) {
+				const StructFrustrumPlane &mPlane1 = pFrustrum._planes[i];
+				const StructFrustrumPlane &mPlane2 = pFrustrum._planes[j];
+
+				float mDet = mPlane1._normal._x * mPlane2._normal._y - mPlane1._normal._y * mPlane2._normal._x;
+				if (fabs(mDet) < 0.0001f) continue;
+
+				float mX = (mPlane1._normal._y * mPlane2._distance - mPlane2._normal._y * mPlane1._distance) / mDet;
+				float mY = (mPlane2._normal._x * mPlane1._distance - mPlane1._normal._x * mPlane2._distance) / mDet;
+
+				if (!mNumCorners) {
+					pBox[0] = pBox[2] = mX;
+					pBox[1] = pBox[3] = mY;
+				} else {
+					if (mX < pBox[0]) pBox[0] = mX;
+					if (mY < pBox[1]) pBox[1] = mY;
+					if (mX > pBox[2]) pBox[2] = mX;
+					if (mY > pBox[3]) pBox[3] = mY;
+				}
+				mNumCorners++;
+			}
+		}
+
+		return mNumCorners == 4;
+	}
 	/**@}*/
 
     /**
@@ -490,7 +547,26 @@ public:
 		if (isPointInsideTriangle(c2, a1, b1, c1)) return 1;
 		if (isPointInsideTriangle(c2, a1, b1, c1)) return 1;
 
-		// Checks if any segment of triange 1 intersects with any segment of triange 2
+		if (isTriangleSegmentsIntersection(a1, b1, c1, a2, b2, c2)) return 1;
+
+		return 0;
+	}
+
+
+	/**
+	 Check if any segment of a triangle intersects with any segment of other triangle. Second part of
+	 isTriangleToTriangleCollision(). Like isSegmentIntersection(), it may move the vertices slightly.
+     @param a1,b1,c1 First triangle coordinates
+     @param a2,b2,c2 Second triangle coordinates
+     
+     @return true if any segments intersect, false otherwise
+	*/
+	bool isTriangleSegmentsIntersection(IND_Vector2 &a1,
+                                        IND_Vector2 &b1,
+                                        IND_Vector2 &c1,
+                                        IND_Vector2 &a2,
+                                        IND_Vector2 &b2,
+                                        IND_Vector2 &c2) {
 		// Segment (a1 - b1)
 		if (isSegmentIntersection(a1, b1, a2, b2)) return 1;
 		if (isSegmentIntersection(a1, b1, b2, c2)) return 1;
@@ -696,6 +772,196 @@ public:
 
 		return 1;
 	}
+
+	/**
+	 Check collision between a circle and several circles, all in same coordinate system.
+	 Gives the same results as isCircleToCircleCollision() for each circle, checking 4 at once with
+	 SSE2 or NEON (64 bits) instructions when available.
+
+	 @param pP1 Center of the circle
+	 @param pRadius1 Radius of the circle
+	 @param pX2, pY2 Centers of the other circles
+	 @param pRadius2 Radius of the other circles
+	 @param pCount Number of other circles (IND_MATH_BATCH_SIZE at most)
+
+	 @return Mask with bit i set if the circle collides with circle i
+	*/
+	unsigned int isCircleToCircleCollisionBatch(const IND_Vector2 &pP1,
+	                                            int pRadius1,
+	                                            const float *pX2,
+	                                            const float *pY2,
+	                                            const int *pRadius2,
+	                                            int pCount) {
+		assert(pCount <= IND_MATH_BATCH_SIZE);
+		unsigned int mHits = 0;
+		int i = 0;
+
+#if defined(IND_MATH_SSE2)
+		// Same operations as the scalar version: float differences, squared as doubles
+		__m128 mX1 = _mm_set1_ps(pP1._x);
+		__m128 mY1 = _mm_set1_ps(pP1._y);
+		__m128i mRadius1 = _mm_set1_epi32(pRadius1);
+		for (; i + 4 <= pCount; i += 4) {
+			__m128 mDeltaX = _mm_sub_ps(mX1, _mm_loadu_ps(pX2 + i));
+			__m128 mDeltaY = _mm_sub_ps(mY1, _mm_loadu_ps(pY2 + i));
+			__m128i mSumRadii = _mm_add_epi32(mRadius1, _mm_loadu_si128(reinterpret_cast<const __m128i *>(pRadius2 + i)));
+
+			__m128d mDeltaXLow = _mm_cvtps_pd(mDeltaX);
+			__m128d mDeltaXHigh = _mm_cvtps_pd(_mm_movehl_ps(mDeltaX, mDeltaX));
+			__m128d mDeltaYLow = _mm_cvtps_pd(mDeltaY);
+			__m128d mDeltaYHigh = _mm_cvtps_pd(_mm_movehl_ps(mDeltaY, mDeltaY));
+			__m128d mSumLow = _mm_cvtepi32_pd(mSumRadii);
+			__m128d mSumHigh = _mm_cvtepi32_pd(_mm_shuffle_epi32(mSumRadii, _MM_SHUFFLE(1, 0, 3, 2)));
+
+			__m128d mDistLow = _mm_add_pd(_mm_mul_pd(mDeltaXLow, mDeltaXLow), _mm_mul_pd(mDeltaYLow, mDeltaYLow));
+			__m128d mDistHigh = _mm_add_pd(_mm_mul_pd(mDeltaXHigh, mDeltaXHigh), _mm_mul_pd(mDeltaYHigh, mDeltaYHigh));
+
+			unsigned int mMask = _mm_movemask_pd(_mm_cmple_pd(mDistLow, _mm_mul_pd(mSumLow, mSumLow))) |
+			                     (_mm_movemask_pd(_mm_cmple_pd(mDistHigh, _mm_mul_pd(mSumHigh, mSumHigh))) << 2);
+			mHits |= mMask << i;
+		}
+#elif defined(IND_MATH_NEON)
+		float32x4_t mX1 = vdupq_n_f32(pP1._x);
+		float32x4_t mY1 = vdupq_n_f32(pP1._y);
+		int32x4_t mRadius1 = vdupq_n_s32(pRadius1);
+		for (; i + 4 <= pCount; i += 4) {
+			float32x4_t mDeltaX = vsubq_f32(mX1, vld1q_f32(pX2 + i));
+			float32x4_t mDeltaY = vsubq_f32(mY1, vld1q_f32(pY2 + i));
+			int32x4_t mSumRadii = vaddq_s32(mRadius1, vld1q_s32(pRadius2 + i));
+
+			float64x2_t mDeltaXLow = vcvt_f64_f32(vget_low_f32(mDeltaX));
+			float64x2_t mDeltaXHigh = vcvt_high_f64_f32(mDeltaX);
+			float64x2_t mDeltaYLow = vcvt_f64_f32(vget_low_f32(mDeltaY));
+			float64x2_t mDeltaYHigh = vcvt_high_f64_f32(mDeltaY);
+			float64x2_t mSumLow = vcvtq_f64_s64(vmovl_s32(vget_low_s32(mSumRadii)));
+			float64x2_t mSumHigh = vcvtq_f64_s64(vmovl_high_s32(mSumRadii));
+
+			float64x2_t mDistLow = vaddq_f64(vmulq_f64(mDeltaXLow, mDeltaXLow), vmulq_f64(mDeltaYLow, mDeltaYLow));
+			float64x2_t mDistHigh = vaddq_f64(vmulq_f64(mDeltaXHigh, mDeltaXHigh), vmulq_f64(mDeltaYHigh, mDeltaYHigh));
+			uint64x2_t mInLow = vcleq_f64(mDistLow, vmulq_f64(mSumLow, mSumLow));
+			uint64x2_t mInHigh = vcleq_f64(mDistHigh, vmulq_f64(mSumHigh, mSumHigh));
+
+			unsigned int mMask = (vgetq_lane_u64(mInLow, 0) & 1) | ((vgetq_lane_u64(mInLow, 1) & 1) << 1) |
+			                     ((vgetq_lane_u64(mInHigh, 0) & 1) << 2) | ((vgetq_lane_u64(mInHigh, 1) & 1) << 3);
+			mHits |= mMask << i;
+		}
+#endif
+
+		// Remaining circles, or all of them without SIMD
+		IND_Vector2 mP1(pP1._x, pP1._y);
+		for (; i < pCount; i++) {
+			IND_Vector2 mP2(pX2[i], pY2[i]);
+			if (isCircleToCircleCollision(mP1, pRadius1, mP2, pRadius2[i]))
+				mHits |= 1u << i;
+		}
+
+		return mHits;
+	}
+
+	/**
+	 Check if a point is inside several triangles. Gives the same results as isPointInsideTriangle()
+	 for each triangle, checking 4 at once with SSE2 or NEON (64 bits) instructions when available.
+
+	 @param p A point
+	 @param pAx, pAy, pBx, pBy, pCx, pCy Vertices of the triangles
+	 @param pCount Number of triangles (IND_MATH_BATCH_SIZE at most)
+
+	 @return Mask with bit i set if the point is inside triangle i
+	*/
+	unsigned int isPointInsideTriangleBatch(const IND_Vector2 &p,
+	                                        const float *pAx, const float *pAy,
+	                                        const float *pBx, const float *pBy,
+	                                        const float *pCx, const float *pCy,
+	                                        int pCount) {
+		assert(pCount <= IND_MATH_BATCH_SIZE);
+		unsigned int mHits = 0;
+		int i = 0;
+
+#if defined(IND_MATH_SSE2) || defined(IND_MATH_NEON)
+		for (; i + 4 <= pCount; i += 4) {
+			mHits |= pointInsideTriangle4(set4(p._x), set4(p._y),
+			                              load4(pAx + i), load4(pAy + i), load4(pBx + i), load4(pBy + i), load4(pCx + i), load4(pCy + i)) << i;
+		}
+#endif
+
+		// Remaining triangles, or all of them without SIMD
+		IND_Vector2 mP(p._x, p._y);
+		for (; i < pCount; i++) {
+			IND_Vector2 mA(pAx[i], pAy[i]);
+			IND_Vector2 mB(pBx[i], pBy[i]);
+			IND_Vector2 mC(pCx[i], pCy[i]);
+			if (isPointInsideTriangle(mP, mA, mB, mC))
+				mHits |= 1u << i;
+		}
+
+		return mHits;
+	}
+
+	/**
+	 Check collision between a triangle and several triangles, all in same coordinate system.
+	 Gives the same results as isTriangleToTriangleCollision() for each triangle. The vertex inside
+	 triangle checks are done 4 triangles at once with SSE2 or NEON (64 bits) instructions when
+	 available; segment intersections are checked one by one, only for triangles still not colliding.
+
+	 @param a1,b1,c1 Triangle coordinates
+	 @param pAx, pAy, pBx, pBy, pCx, pCy Vertices of the other triangles
+	 @param pCount Number of other triangles (IND_MATH_BATCH_SIZE at most)
+
+	 @return Mask with bit i set if the triangle collides with triangle i
+	*/
+	unsigned int isTriangleToTriangleCollisionBatch(const IND_Vector2 &a1,
+	                                                const IND_Vector2 &b1,
+	                                                const IND_Vector2 &c1,
+	                                                const float *pAx, const float *pAy,
+	                                                const float *pBx, const float *pBy,
+	                                                const float *pCx, const float *pCy,
+	                                                int pCount) {
+		assert(pCount <= IND_MATH_BATCH_SIZE);
+		unsigned int mHits = 0;
+		int i = 0;
+
+#if defined(IND_MATH_SSE2) || defined(IND_MATH_NEON)
+		Float4 mAx1 = set4(a1._x), mAy1 = set4(a1._y);
+		Float4 mBx1 = set4(b1._x), mBy1 = set4(b1._y);
+		Float4 mCx1 = set4(c1._x), mCy1 = set4(c1._y);
+		for (; i + 4 <= pCount; i += 4) {
+			Float4 mAx2 = load4(pAx + i), mAy2 = load4(pAy + i);
+			Float4 mBx2 = load4(pBx + i), mBy2 = load4(pBy + i);
+			Float4 mCx2 = load4(pCx + i), mCy2 = load4(pCy + i);
+
+			// Vertices of the triangle inside the other triangles
+			unsigned int mMask = pointInsideTriangle4(mAx1, mAy1, mAx2, mAy2, mBx2, mBy2, mCx2, mCy2) |
+			                     pointInsideTriangle4(mBx1, mBy1, mAx2, mAy2, mBx2, mBy2, mCx2, mCy2) |
+			                     pointInsideTriangle4(mCx1, mCy1, mAx2, mAy2, mBx2, mBy2, mCx2, mCy2);
+
+			// Vertices of the other triangles inside the triangle (same vertices as the scalar version)
+			mMask |= pointInsideTriangle4(mAx2, mAy2, mAx1, mAy1, mBx1, mBy1, mCx1, mCy1);
+			mMask |= pointInsideTriangle4(mCx2, mCy2, mAx1, mAy1, mBx1, mBy1, mCx1, mCy1);
+
+			for (int j = 0; j < 4; j++) {
+				if (mMask & (1u << j)) {
+					mHits |= 1u << (i + j);
+					continue;
+				}
+
+				IND_Vector2 mA1(a1._x, a1._y), mB1(b1._x, b1._y), mC1(c1._x, c1._y);
+				IND_Vector2 mA2(pAx[i + j], pAy[i + j]), mB2(pBx[i + j], pBy[i + j]), mC2(pCx[i + j], pCy[i + j]);
+				if (isTriangleSegmentsIntersection(mA1, mB1, mC1, mA2, mB2, mC2))
+					mHits |= 1u << (i + j);
+			}
+		}
+#endif
+
+		// Remaining triangles, or all of them without SIMD
+		for (; i < pCount; i++) {
+			IND_Vector2 mA1(a1._x, a1._y), mB1(b1._x, b1._y), mC1(c1._x, c1._y);
+			IND_Vector2 mA2(pAx[i], pAy[i]), mB2(pBx[i], pBy[i]), mC2(pCx[i], pCy[i]);
+			if (isTriangleToTriangleCollision(mA1, mB1, mC1, mA2, mB2, mC2))
+				mHits |= 1u << i;
+		}
+
+		return mHits;
+	}
     
     /**@}*/
     
@@ -899,6 +1165,60 @@ public:
 		  m._44 = 1.0f;
 	}
 	
+	/**
+	 Initializes matrix as the 2d transform of an entity. The result is the same as multiplying, in this
+	 order: translation, scale, rotation around z, hotspot translation and mirroring (see IND_Render::setTransform2d()),
+	 but computed directly with just one sin/cos pair. Rotations around x and y axes are not supported.
+     
+	 As in IND_Render::setTransform2d(), z coordinates are scaled to 0 when there is any scaling.
+     
+     @param m Matrix to initialize
+     @param transx, transy Translation
+     @param angledegrees Angle around z axis IN DEGREES
+     @param scalex, scaley Scale values
+     @param axisx, axisy Hotspot translation
+     @param mirrorx, mirrory Mirroring in each axis
+     @param width, height Size of the mirrored object
+	*/
+	inline void matrix4DSetTransform2d(IND_Matrix &m,
+	                                   float transx, float transy,
+	                                   float angledegrees,
+	                                   float scalex, float scaley,
+	                                   float axisx, float axisy,
+	                                   bool mirrorx, bool mirrory,
+	                                   float width, float height) const {
+		  float c (1.0f);
+		  float s (0.0f);
+		  if (angledegrees != 0.0f) {
+			  float angle = angleToRadians(angledegrees);
+			  c = cosf(angle);
+			  s = sinf(angle);
+		  }
+
+		  // Mirroring flips the object inside its own area, then the hotspot moves it
+		  float fx (mirrorx ? -1.0f : 1.0f);
+		  float fy (mirrory ? -1.0f : 1.0f);
+		  float ex ((mirrorx ? width : 0.0f) + axisx);
+		  float ey ((mirrory ? height : 0.0f) + axisy);
+
+		  m._11 = scalex * c * fx;
+		  m._12 = -scalex * s * fy;
+		  m._13 = 0.0f;
+		  m._14 = transx + scalex * (c * ex - s * ey);
+		  m._21 = scaley * s * fx;
+		  m._22 = scaley * c * fy;
+		  m._23 = 0.0f;
+		  m._24 = transy + scaley * (s * ex + c * ey);
+		  m._31 = 0.0f;
+		  m._32 = 0.0f;
+		  m._33 = (scalex != 1.0f || scaley != 1.0f) ? 0.0f : fx * fy;
+		  m._34 = 0.0f;
+		  m._41 = 0.0f;
+		  m._42 = 0.0f;
+		  m._43 = 0.0f;
+		  m._44 = 1.0f;
+	}
+
 
 	/**
 	 Initializes a matrix to represent a rotation matrix from 3 axes: r (right), u(up), l(look) AND p (pos).
@@ -1174,6 +1494,67 @@ private:
 
 	// ----- Private methods -----
 
+#if defined(IND_MATH_SSE2)
+	typedef __m128 Float4;
+
+	static Float4 load4(const float *p)     { return _mm_loadu_ps(p); }
+	static Float4 set4(float f)             { return _mm_set1_ps(f); }
+	static Float4 add4(Float4 a, Float4 b)  { return _mm_add_ps(a, b); }
+	static Float4 sub4(Float4 a, Float4 b)  { return _mm_sub_ps(a, b); }
+	static Float4 mul4(Float4 a, Float4 b)  { return _mm_mul_ps(a, b); }
+	static Float4 div4(Float4 a, Float4 b)  { return _mm_div_ps(a, b); }
+
+	// (u > 0) && (v > 0) && (u + v < 1) of each lane, one bit per lane
+	static unsigned int barycentricMask4(Float4 u, Float4 v) {
+		__m128 mZero = _mm_setzero_ps();
+		__m128 mInside = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(u, mZero), _mm_cmpgt_ps(v, mZero)),
+		                            _mm_cmplt_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+		return static_cast<unsigned int>(_mm_movemask_ps(mInside));
+	}
+#elif defined(IND_MATH_NEON)
+	typedef float32x4_t Float4;
+
+	static Float4 load4(const float *p)     { return vld1q_f32(p); }
+	static Float4 set4(float f)             { return vdupq_n_f32(f); }
+	static Float4 add4(Float4 a, Float4 b)  { return vaddq_f32(a, b); }
+	static Float4 sub4(Float4 a, Float4 b)  { return vsubq_f32(a, b); }
+	static Float4 mul4(Float4 a, Float4 b)  { return vmulq_f32(a, b); }
+	static Float4 div4(Float4 a, Float4 b)  { return vdivq_f32(a, b); }
+
+	// (u > 0) && (v > 0) && (u + v < 1) of each lane, one bit per lane
+	static unsigned int barycentricMask4(Float4 u, Float4 v) {
+		float32x4_t mZero = vdupq_n_f32(0.0f);
+		uint32x4_t mInside = vandq_u32(vandq_u32(vcgtq_f32(u, mZero), vcgtq_f32(v, mZero)),
+		                               vcltq_f32(vaddq_f32(u, v), vdupq_n_f32(1.0f)));
+		return (vgetq_lane_u32(mInside, 0) & 1) | ((vgetq_lane_u32(mInside, 1) & 1) << 1) |
+		       ((vgetq_lane_u32(mInside, 2) & 1) << 2) | ((vgetq_lane_u32(mInside, 3) & 1) << 3);
+	}
+#endif
+
+#if defined(IND_MATH_SSE2) || defined(IND_MATH_NEON)
+	// isPointInsideTriangle() of 4 points and triangles at once, with the same operations in the same order
+	static unsigned int pointInsideTriangle4(Float4 px, Float4 py,
+	                                         Float4 ax, Float4 ay,
+	                                         Float4 bx, Float4 by,
+	                                         Float4 cx, Float4 cy) {
+		Float4 v0x = sub4(cx, ax), v0y = sub4(cy, ay);
+		Float4 v1x = sub4(bx, ax), v1y = sub4(by, ay);
+		Float4 v2x = sub4(px, ax), v2y = sub4(py, ay);
+
+		Float4 dot00 = add4(mul4(v0x, v0x), mul4(v0y, v0y));
+		Float4 dot01 = add4(mul4(v0x, v1x), mul4(v0y, v1y));
+		Float4 dot02 = add4(mul4(v0x, v2x), mul4(v0y, v2y));
+		Float4 dot11 = add4(mul4(v1x, v1x), mul4(v1y, v1y));
+		Float4 dot12 = add4(mul4(v1x, v2x), mul4(v1y, v2y));
+
+		Float4 invDenom = div4(set4(1.0f), sub4(mul4(dot00, dot11), mul4(dot01, dot01)));
+		Float4 u = mul4(sub4(mul4(dot11, dot02), mul4(dot01, dot12)), invDenom);
+		Float4 v = mul4(sub4(mul4(dot00, dot12), mul4(dot01, dot02)), invDenom);
+
+		return barycentricMask4(u, v);
+	}
+#endif
+
 	void                initVars();
 	void                freeVars();
     
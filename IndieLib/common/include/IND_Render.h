@@ -39,6 +39,7 @@
 #include "IND_Timer.h"
 #include "IND_Window.h"
 #include "IND_AnimationManager.h"
+#include <vector>
 
 // ----- Forward Declarations -----
 #ifdef INDIERENDER_DIRECTX
@@ -414,6 +415,8 @@ public:
 	char *getRenderer();
 	//! This function returns the maximum texture size allowed by the graphic card.
 	int  getMaxTextureSize();
+	//! This function returns true if the graphic card supports textures of any size. Surfaces are then created using a single texture of the same size as the image (when not bigger than IND_Render::getMaxTextureSize()).
+	bool isNPOTTextureSupported();
 
 	//! This function returns the actual fps (frames per second) in a string of chars.
 	//! @param[in,out] pBuffer buffer capable to hold string representation of integer FPS value
@@ -446,6 +449,7 @@ public:
 	void getNumDiscardedObjectsString(char* pBuffer);
 
 	//! This function returns the number of renderered objects in one frame (integer)
+	//! With sprite batching on, each batch sent to the graphic card counts as one object
 	//! @return The number of objects
 	int getNumrenderedObjectsInt();
 
@@ -459,6 +463,67 @@ public:
 	//! Resets the counters for discarded objects
 	void resetNumDiscardedObjects();
 
+	//! Turns on or off sprite batching
+	/**
+	When on (default), consecutive surface blocks sharing texture, filter and blending are accumulated
+	and sent to the graphic card in a single draw call. Only the OpenGL renderer batches sprites.
+	@param pSwitch true = batching on, false = every block is drawn on its own
+	*/
+	void setSpriteBatching(bool pSwitch);
+
+	//! Returns true if sprite batching is on
+	bool isSpriteBatching();
+
+	//! Turns on or off instanced rendering
+	/**
+	When on (default), consecutive surfaces of a single block sharing texture, filter and blending
+	are drawn as copies of the same quad in one instanced call, sending only the transform and tint
+	of each copy. Needs hardware instancing and shaders; without them, or when it is turned off,
+	surfaces go through the sprite batch. Each instanced draw is counted as one rendered object.
+	@param pSwitch true = instancing on, false = off
+	*/
+	void setInstancing(bool pSwitch);
+
+	//! Returns true if instancing is on and supported by the hardware
+	bool isInstancing();
+
+	//! Returns true if the hardware supports instanced rendering
+	bool isInstancingSupported();
+
+	//! Turns on or off the drawing of surfaces as distance fields
+	/**
+	When on, the alpha channel of the surfaces drawn is a distance to an edge, 0.5 being the edge itself
+	(like the glyphs of distance field fonts, see IND_TTF_Font::loadTTFFontFromDisk()). Pixels are solid
+	inside the edge and transparent outside, so the shape stays sharp at any scale. A fragment program
+	smooths the edge over one screen pixel; without shaders, an alpha test cuts it. Surfaces must be
+	drawn with linear filtering. Pending sprite batches are drawn first when the mode changes.
+	Only the OpenGL renderer supports it.
+	@param pSwitch true = distance fields on, false = off (default)
+	*/
+	void setDistanceField(bool pSwitch);
+
+	//! Returns true if surfaces can be drawn as distance fields
+	bool isDistanceFieldSupported();
+
+	//! This function returns the number of render state changes sent to the graphic card in one frame
+	//! @param[in,out] pBuffer buffer capable to hold string representation of integer. Recommended size is 15
+	void getNumIssuedStateChangesString(char* pBuffer);
+
+	//! This function returns the number of render state changes skipped in one frame, because the graphic card already had that state
+	//! @param[in,out] pBuffer buffer capable to hold string representation of integer. Recommended size is 15
+	void getNumSkippedStateChangesString(char* pBuffer);
+
+	//! This function returns the number of render state changes sent to the graphic card in one frame (integer)
+	//! @return The number of state changes
+	int getNumIssuedStateChangesInt();
+
+	//! This function returns the number of render state changes skipped in one frame (integer)
+	//! @return The number of state changes
+	int getNumSkippedStateChangesInt();
+
+	//! Resets the counters for issued and skipped render state changes
+	void resetNumStateChanges();
+
 private:
     /** @cond DOCUMENT_PRIVATEAPI */
 	// ----- Objects -----
@@ -492,6 +557,51 @@ private:
 
 	// ----- Private Interface (for friend classes) -----
 	void reCalculateFrustrumPlanes();
+	bool cullBox2d(float pX1, float pY1, float pX2, float pY2);
+	bool isBox2dOut(float pX1, float pY1, float pX2, float pY2);
+	void addNumDiscardedObjects(int pNum);
+	bool getFrustumBox2d(float *pBox);
+	void calculateTransform2d(int pX,
+	                          int  pY,
+	                          float pAngleX,
+	                          float pAngleY,
+	                          float pAngleZ,
+	                          float pScaleX,
+	                          float pScaleY,
+	                          int pAxisCalX,
+	                          int pAxisCalY,
+	                          bool pMirrorX,
+	                          bool pMirrorY,
+	                          int pWidth,
+	                          int pHeight,
+	                          IND_Matrix &pMatrix);
+	void flushSpriteBatch();
+	bool buildTextGeometry(IND_Font *pFo,
+	                       char *pText,
+	                       int pOffset,
+	                       int pLineSpacing,
+	                       float pScaleX,
+	                       float pScaleY,
+	                       IND_Align pAlign,
+	                       std::vector<CUSTOMVERTEX2D> &pVertices);
+	void blitTextGeometry(IND_Font *pFo,
+	                      std::vector<CUSTOMVERTEX2D> &pVertices,
+	                      int pX,
+	                      int pY,
+	                      float pScaleX,
+	                      float pScaleY,
+	                      unsigned char pR,
+	                      unsigned char pG,
+	                      unsigned char pB,
+	                      unsigned char pA,
+	                      unsigned char pFadeR,
+	                      unsigned char pFadeG,
+	                      unsigned char pFadeB,
+	                      unsigned char pFadeA,
+	                      IND_Filter pLinearFilter,
+	                      IND_BlendingType pSo,
+	                      IND_BlendingType pDs);
+	void forgetTextureState(unsigned int *pTextures, int pNumTextures);
 	void blitCollisionCircle(int pPosX, int pPosY, int pRadius, float pScale, unsigned char pR, unsigned char pG, unsigned char pB, unsigned char pA, IND_Matrix pWorldMatrix);
 	void blitCollisionLine(int pPosX1, int pPosY1, int pPosX2, int pPosY2,  unsigned char pR, unsigned char pG, unsigned char pB, unsigned char pA, IND_Matrix pIndWorldMatrix);
 
@@ -499,6 +609,8 @@ private:
 	friend class IND_Entity2dManager;
 	friend class IND_Input;
 	friend class DirectXTextureBuilder;
+	friend class IND_SurfaceManager;
+	friend class OpenGLTextureBuilder;
     
     /** @endcond */
 };
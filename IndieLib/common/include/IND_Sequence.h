@@ -159,6 +159,12 @@ private:
 	int                     getActualFrameTime()                      {
 		return (*getListFrames()) [getActualFramePos()]->_time;
 	}
+	int                     getFramePosInVec(int pPos)                      {
+		return (*getListFrames()) [pPos]->_pos;
+	}
+	int                     getFrameTime(int pPos)                      {
+		return (*getListFrames()) [pPos]->_time;
+	}
 
 
 	// ----- Friends -----
@@ -94,6 +94,10 @@ public:
 	bool        isHaveSurface();
 	//! This function returns 1 if the surface has a grid assigned.
 	bool        isHaveGrid();
+	//! This function returns 1 if the surface shares an atlas texture with other surfaces. See IND_SurfaceManager::setAtlasing().
+	bool        isAtlased();
+	//! This function returns 1 if the surface has an alpha mask for pixel collisions. See IND_SurfaceManager::setAlphaMasks().
+	bool        isHaveAlphaMask();
 	//! This function returns the type of surface in a string.
 	string      getTypeString();
 	//! This function returns the quality of the surface in a string. See ::IND_Quality.
@@ -157,6 +161,7 @@ private:
 	// ----- Friends -----
 
 	friend class IND_SurfaceManager;
+	friend class IND_Entity2dManager;
 	friend class DirectXTextureBuilder;
 	friend class OpenGLTextureBuilder;
 	friend class DirectXRender;
@@ -153,6 +153,20 @@ public:
 
 	bool remove(IND_Surface *pSu);
 
+	bool update(IND_Surface *pSu, IND_Image *pImage, int pX, int pY, int pWidth, int pHeight);
+
+	// ----- Atlas packing -----
+
+	void    setAtlasing(bool pSwitch, int pPageSize);
+	bool    isAtlasing();
+	int     getNumAtlasPages();
+	float   getAtlasPageOccupancy(int pPage);
+
+	// ----- Alpha masks -----
+
+	void    setAlphaMasks(bool pSwitch, int pThreshold);
+	bool    isAlphaMasks();
+
 private:
 	/** @cond DOCUMENT_PRIVATEAPI */
 	// ----- Private -----
@@ -165,6 +179,9 @@ private:
 	IND_Render *_render;
 
 	TextureBuilder *_textureBuilder;
+
+	bool _alphaMasks;
+	int _alphaMaskThreshold;
 	// ----- Containers -----
 
     std::list <IND_Surface *> *_listSurfaces;
@@ -40,6 +40,7 @@
 #include "IND_Surface.h"
 
 #include <map>
+#include <vector>
 
 
 // NOTE: This class uses STL, the perfermance will be a lot better in Release version.
@@ -60,6 +61,7 @@
 #define DT_EX_BACKCOLOR	               0x00000400
 
 class free_type_impl;               // forward-declare private "implementation" class.
+struct raster_glyph;                // forward-declare glyph rasterized by FreeType
 class free_type_ptr_wrapped_impl;   // forward-declare the freetype wrapped pointer delivered by the manger in the init method
 
 // --------------------------------------------------------------------------------
@@ -81,9 +83,11 @@ public:
 
     // ----- Public methods -----
         
-	// load a TTF font from disk file
+	// load a TTF font from disk file. With iDistanceFieldSize > 0 the glyphs are cached once as
+	// distance fields rasterized at that size, and drawn sharp at any size and scale (if the
+	// renderer can't threshold them, the font is loaded with bitmap glyphs)
 	bool loadTTFFontFromDisk(	const std::string& strname, const std::string& strpath,
-								int iSize, bool bBold, bool bItalic);
+								int iSize, bool bBold, bool bItalic, int iDistanceFieldSize = 0);
 
 	// unload the TTF font and free all variables
 	void unloadFont();
@@ -97,6 +101,18 @@ public:
 	// clear all the cache entries
 	void clearAllCache();
 
+	// queue chars to be rasterized in a background thread, so drawing them later doesn't wait
+	// for FreeType. They are cached by uploadPendingGlyphs()
+	bool queueCharset(const std::wstring& str);
+
+	// cache the chars rasterized in the background, spending at most fMaxMs milliseconds
+	// (at least one char is cached if any is ready). Call it once per frame from the render thread.
+	// Returns the number of chars cached
+	int uploadPendingGlyphs(float fMaxMs);
+
+	// number of queued chars not cached yet
+	int getNumPendingGlyphs();
+
 	// draw a tring
 	bool drawText(	const std::wstring& s, float x, float y, uint32_t clrFont,bool bFlipX, bool bFlipY,
 					float fZRotate, byte btTrans, bool bKerning, bool bUnderl);
@@ -110,6 +126,16 @@ public:
 	// get the font name 
 	const std::string getFontName(){return _strName;}
 
+	// change the font size. Distance field fonts keep their cache, bitmap fonts cache again
+	// their glyphs at the new size
+	bool setSize(int iSize);
+
+	// get the font size
+	int getSize() {return _CharHeight;}
+
+	// are the glyphs cached as distance fields
+	bool isDistanceField() {return _nSdfSize > 0;}
+
 	// set auto cache status
 	void setAutoCache(bool bautocache) {_bAutoCache = bautocache;}
 
@@ -137,26 +163,68 @@ public:
 	// set x/y hotspot when bliting
 	void setHotspot(float spot) {_fXHotSpot = _fYHotSpot = spot;}
 
+	// set the number of atlas pages kept for cached glyphs (at least 1). When a new page would
+	// exceed it, the page drawn least recently is cleared and reused, and its glyphs are cached again
+	// when needed (only if auto cache is enabled)
+	void setMaxCachePages(int nPages);
+
+	// get the number of atlas pages kept for cached glyphs
+	int getMaxCachePages() {return _nMaxCachePages;}
+
+	// get the number of atlas pages holding cached glyphs
+	int getNumCachePages() {return (int)_CachePages.size();}
+
 private:
     
     // ----- Structures ------
     
+	// Row of glyphs in an atlas page, as tall as the tallest glyph placed in it
+	struct CacheShelf
+	{
+		int			y;								// first image row of the shelf
+		int			height;							// rows of the shelf
+		int			x;								// first free column
+	};
+
+	// Atlas page shared by cached glyphs: the image keeps the glyphs and the surface is
+	// updated from it before drawing
+	struct CachePage
+	{
+		IND_Image	*pImage;						// glyph pixels
+		IND_Surface *pSurface;						// texture of the page
+		std::vector<CacheShelf> shelves;			// rows of glyphs
+		int			nextShelfY;						// first image row not used by shelves
+		uint32_t	lastUse;						// draw call that used the page last
+		int			dirtyX0, dirtyY0;				// image area changed since last upload
+		int			dirtyX1, dirtyY1;				// (empty when dirtyX0 >= dirtyX1)
+	};
+
 	// Struct for every cached character
-	// Finally character is cached in an IND_Surface for bliting
+	// Finally character is cached in an area of an atlas page for bliting
 	struct CharCacheNode
 	{
 		wchar_t		charCode;						// unicode char value
 		uint32_t	charGlyphIndex;					// glyph index in the font face
 		uint32_t	charAdvance;					// advance value
+		int			rasterAdvance;					// advance at the rasterized size, in 1/64 pixels
 
 		int			charLeftBearing;				// left bearing of the glyph in the image
 		int			charTopBearing;					// top bearing of the glyph in the image
 
-		IND_Surface *pSurface;						// where the glyph texture stored
+		CachePage	*pPage;							// where the glyph texture stored
+		int			pageX, pageY;					// position of the glyph in the page image
+		int			width, height;					// size of the glyph
 	};
     typedef std::map<wchar_t, CharCacheNode*> CharCacheMap;
     typedef CharCacheMap::iterator CharCacheMapIterator;
 
+	// Glyph waiting to be drawn together with the rest of its page
+	struct GlyphQuad
+	{
+		CharCacheNode *pNode;
+		float		x, y;							// top left corner of the glyph
+	};
+
 	// ----- Objects -----
     
     //Number of spaces in a tab
@@ -194,6 +262,17 @@ private:
 
 	CharCacheMap			_FontCharCache;         // character cache map
 
+	std::vector<CachePage*>	_CachePages;            // atlas pages of the cached glyphs
+	int						_nMaxCachePages;        // most pages kept
+	int						_nPageSize;             // width and height of the pages
+	uint32_t				_nUseStamp;             // current draw call, for least recently used pages
+
+	std::vector<GlyphQuad>	_GlyphQueue;            // glyphs of the current draw call
+
+	int						_nSdfSize;              // size the distance fields are rasterized at, 0 for bitmap glyphs
+	int						_nSdfSpread;            // distance range around the glyph edges, in pixels
+	float					_fGlyphScale;           // font size / rasterized size
+
 private:
     
     // ----- Private methods -----
@@ -208,8 +287,44 @@ private:
 	// get char cache entry
 	CharCacheNode* getCharCacheNode(wchar_t charCode);
 
-	// render glyph to image
-	bool renderGlyph(free_type_impl* impl, IND_Image *pImage);
+	// set the size glyphs are rasterized at
+	bool setRasterSize(int iRasterSize);
+
+	// scale the metrics of a cached glyph to the font size
+	void scaleCharMetrics(CharCacheNode *pNode);
+
+	// cache a rasterized glyph in the atlas pages
+	bool cacheGlyph(const raster_glyph &glyph);
+
+	// render glyph to image, at the given position
+	bool renderGlyph(const raster_glyph &glyph, IND_Image *pImage, int iX, int iY);
+
+	// start the background rasterization thread, with its own font face
+	bool startGlyphWorker();
+
+	// stop the background rasterization thread and drop the chars not cached yet
+	void stopGlyphWorker();
+
+	// find room in the atlas pages for a glyph
+	CachePage* allocGlyphSpace(int iWidth, int iHeight, int &iX, int &iY);
+
+	// find room in a page for a glyph
+	bool insertInPage(CachePage *pPage, int iWidth, int iHeight, int &iX, int &iY);
+
+	// create an empty atlas page
+	CachePage* newCachePage();
+
+	// drop the glyphs of a page and empty it
+	void evictCachePage(CachePage *pPage);
+
+	// free a page
+	void freeCachePage(CachePage *pPage);
+
+	// upload the changed areas of the pages
+	void uploadCachePages();
+
+	// draw the queued glyphs, page by page
+	void flushGlyphs(uint32_t clrFont, bool bFlipX, bool bFlipY, float fZRotate, byte btTrans);
 
 	// advance with space 
 	uint32_t getSpaceAdvance();
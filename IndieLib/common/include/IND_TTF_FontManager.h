@@ -62,12 +62,15 @@ public:
 	bool isInitialized() {return _bInit;}
 
 	bool addFont(	const std::string& strName, const std::string& strPath, int iSize = 20,
-					bool bBold = false, bool bItalic = false);
+					bool bBold = false, bool bItalic = false, int iDistanceFieldSize = 0);
 	bool isFontLoaded(const std::string& strName);
 	void unloadFont(const std::string& strName);
 	IND_TTF_Font* getFontByName(const std::string& strName);
 
 	bool CacheFontString(const std::string& strFontName, const std::wstring& s);
+	bool queueFontCharset(const std::string& strFontName, const std::wstring& s);
+	int uploadPendingGlyphs(float fMaxMs);
+	void setGlyphUploadBudget(float fMaxMs) {_fGlyphUploadBudget = fMaxMs;}
 
 	void drawText(	uint32_t uiIndex, const std::string strFontName, float x, float y, uint32_t clrFont,
 					bool bFlipX, bool bFlipY, float fZRotate, byte btTrans, bool bKerning, 
@@ -89,6 +92,7 @@ public:
 	void setFontAutoCache(const std::string& strFontName, bool ba);
 	void setFontHotSpot(const std::string& strFontName, float hsx, float hsy);
 	void setFontScale(const std::string& strFontName, float sx, float sy);
+	bool setFontSize(const std::string& strFontName, int iSize);
 
 private:
 	typedef std::map<const std::string, IND_TTF_Font*> IND_TTF_FontList;
@@ -103,6 +107,7 @@ private:
 	IND_Render                  *_pIndieRender;
 	IND_ImageManager            *_pIndieImageManager;
 	IND_SurfaceManager          *_pIndieSurfaceManager;
+	float                       _fGlyphUploadBudget;    // milliseconds per frame for glyphs rasterized in the background
 
     // ----- Structures ------
     
@@ -33,6 +33,7 @@
 #define _IND_IMAGECUTTER_H_
 
 #include "Defines.h"
+#include <vector>
 
 // ----- Forward declarations -----
 
@@ -75,12 +76,12 @@ public:
 
 	// ----- Init/End -----
 
-	ImageCutter(): _ok(false)  { }
+	ImageCutter(): _ok(false), _npotTextures(false)  { }
 	~ImageCutter()          {
 		end();
 	}
 
-	bool    init(IND_ImageManager *pImageManager, int pMaxTextureSize);
+	bool    init(IND_ImageManager *pImageManager, int pMaxTextureSize, bool pNPOTTextures = false);
 	void    end();
 	bool    isOK()           const {
 		return _ok;
@@ -106,6 +107,7 @@ private:
 
 	bool _ok;
 	int _maxTextureSize;
+	bool _npotTextures;                 // Blocks don't need to be power of two
 
 	// ----- Objects -----
 
@@ -119,6 +121,61 @@ private:
 	void    freeVars();
 };
 
+
+// --------------------------------------------------------------------------------
+//								 SkylinePacker
+// --------------------------------------------------------------------------------
+
+// Places rectangles inside a bigger one (an atlas page), keeping the "skyline" of the
+// already used area. Each rectangle goes where its top edge ends lowest (bottom-left rule).
+// Space is never reclaimed: a page is released as a whole when it gets empty.
+class SkylinePacker {
+public:
+
+	// ----- Init/End -----
+
+	SkylinePacker(): _width(0), _height(0), _padding(0), _usedArea(0)  { }
+
+	void    init(int pWidth, int pHeight, int pPadding);
+
+	// ----- Public methods -----
+
+	bool    insert(int pWidth, int pHeight, int *pX, int *pY);
+	void    release(int pWidth, int pHeight);
+
+	int     getWidth()       const {
+		return _width;
+	}
+	int     getHeight()      const {
+		return _height;
+	}
+	int     getUsedArea()    const {
+		return _usedArea;
+	}
+	float   getOccupancy()   const;
+
+private:
+
+	// ----- Private -----
+
+	// Horizontal segment of the skyline, from _x to _x + _width, at height _y
+	struct SkylineSegment {
+		int _x;
+		int _y;
+		int _width;
+	};
+
+	int _width;
+	int _height;
+	int _padding;
+	int _usedArea;
+	std::vector<SkylineSegment> _skyline;
+
+	// ----- Private methods -----
+
+	int     fitAt(size_t pSegment, int pWidth, int pHeight);
+};
+
 /** @endcond */
 
 #endif // _IND_IMAGECUTTER_H_
@@ -0,0 +1,155 @@
+/*****************************************************************************************
+ * File: SpatialHash2d.h
+ * Desc: Uniform grid of 2d entities, hashed in a fixed number of buckets (collision broadphase)
+ *****************************************************************************************/
+
+/*********************************** The zlib License ************************************
+ *
+ * Copyright (c) 2013 Indielib-crossplatform Development Team
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software
+ * in a product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ *
+ *****************************************************************************************/
+
+
+#ifndef _SPATIALHASH2D_H_
+#define _SPATIALHASH2D_H_
+
+#include "Defines.h"
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+// ----- Forward declarations -----
+
+class IND_Entity2d;
+
+/** @cond DOCUMENT_PRIVATEAPI */
+
+// Entities covering more cells than this (in any axis) are kept apart, and checked against everything
+#define SPATIALHASH_MAX_CELLS_PER_AXIS 32
+
+// --------------------------------------------------------------------------------
+//								 SpatialHash2d
+// --------------------------------------------------------------------------------
+
+// The plane is divided in square cells. Each entity is stored in every cell its box covers. Cells
+// are not allocated: the cell coordinates are hashed into a fixed table of buckets, so cells far away
+// may share a bucket. That only adds candidates, which are discarded later comparing boxes.
+class SpatialHash2d {
+public:
+
+	// ----- Init/End -----
+
+	SpatialHash2d(): _cellSize(128.0f), _mask(0)  { }
+
+	void init(float pCellSize, int pNumBuckets) {
+		// Number of buckets is rounded up to a power of two, so hashes are masked
+		int mNumBuckets = 1;
+		while (mNumBuckets < pNumBuckets)
+			mNumBuckets <<= 1;
+
+		_cellSize = pCellSize;
+		_mask = static_cast<unsigned int>(mNumBuckets - 1);
+		_buckets.assign(mNumBuckets, std::vector<IND_Entity2d *>());
+		_large.clear();
+	}
+
+	// ----- Public methods -----
+
+	float getCellSize() const {
+		return _cellSize;
+	}
+
+	int cellCoord(float pCoord) const {
+		return static_cast<int>(floorf(pCoord / _cellSize));
+	}
+
+	// True if a range of cells is too big to be stored cell by cell
+	static bool isLarge(int pCellX1, int pCellY1, int pCellX2, int pCellY2) {
+		return pCellX2 - pCellX1 >= SPATIALHASH_MAX_CELLS_PER_AXIS || pCellY2 - pCellY1 >= SPATIALHASH_MAX_CELLS_PER_AXIS;
+	}
+
+	void insert(IND_Entity2d *pEn, int pCellX1, int pCellY1, int pCellX2, int pCellY2) {
+		if (isLarge(pCellX1, pCellY1, pCellX2, pCellY2)) {
+			_large.push_back(pEn);
+			return;
+		}
+
+		// Two cells of the entity may share a bucket: it is stored there only once
+		for (int y = pCellY1; y <= pCellY2; y++) {
+			for (int x = pCellX1; x <= pCellX2; x++) {
+				std::vector<IND_Entity2d *> &mBucket = _buckets[bucketIndex(x, y)];
+				if (std::find(mBucket.begin(), mBucket.end(), pEn) == mBucket.end())
+					mBucket.push_back(pEn);
+			}
+		}
+	}
+
+	void remove(IND_Entity2d *pEn, int pCellX1, int pCellY1, int pCellX2, int pCellY2) {
+		if (isLarge(pCellX1, pCellY1, pCellX2, pCellY2)) {
+			removeFrom(_large, pEn);
+			return;
+		}
+
+		for (int y = pCellY1; y <= pCellY2; y++)
+			for (int x = pCellX1; x <= pCellX2; x++)
+				removeFrom(_buckets[bucketIndex(x, y)], pEn);
+	}
+
+	// Entities that may be in a cell (and some others that share its bucket)
+	const std::vector<IND_Entity2d *> &getBucket(int pCellX, int pCellY) const {
+		return _buckets[bucketIndex(pCellX, pCellY)];
+	}
+
+	// Entities too big to be stored by cells
+	const std::vector<IND_Entity2d *> &getLarge() const {
+		return _large;
+	}
+
+private:
+
+	// ----- Private -----
+
+	float _cellSize;
+	unsigned int _mask;
+	std::vector<std::vector<IND_Entity2d *> > _buckets;
+	std::vector<IND_Entity2d *> _large;
+
+	// ----- Private methods -----
+
+	unsigned int bucketIndex(int pCellX, int pCellY) const {
+		// Large primes mixing both coordinates (Teschner et al.)
+		return ((static_cast<unsigned int>(pCellX) * 73856093u) ^ (static_cast<unsigned int>(pCellY) * 19349663u)) & _mask;
+	}
+
+	// Order inside a bucket doesn't matter, so the last element fills the hole
+	static void removeFrom(std::vector<IND_Entity2d *> &pList, IND_Entity2d *pEn) {
+		std::vector<IND_Entity2d *>::iterator mIter = std::find(pList.begin(), pList.end(), pEn);
+		if (mIter != pList.end()) {
+			*mIter = pList.back();
+			pList.pop_back();
+		}
+	}
+};
+
+/** @endcond */
+
+#endif // _SPATIALHASH2D_H_
@@ -73,6 +73,7 @@ CollisionParser *CollisionParser::instance() {
 */
 void CollisionParser::setBoundingTriangle(list <BOUNDING_COLLISION *> *pBList, const char *pId, int pAx, int pAy, int pBx, int pBy, int pCx, int pCy) {
 	BOUNDING_COLLISION *_b = new BOUNDING_COLLISION (0,pId);
+	_b->setGroup(registerGroup(pId));
 
 	_b->_ax     = pAx;
 	_b->_ay     = pAy;
@@ -95,6 +96,7 @@ void CollisionParser::setBoundingTriangle(list <BOUNDING_COLLISION *> *pBList, c
 */
 void CollisionParser::setBoundingCircle(list <BOUNDING_COLLISION *> *pBList, const char *pId, int pOffsetX, int pOffsetY, int pRadius) {
 	BOUNDING_COLLISION *_b = new BOUNDING_COLLISION(1,pId);
+	_b->setGroup(registerGroup(pId));
 
 	_b->_posX       = pOffsetX;
 	_b->_posY       = pOffsetY;
@@ -115,7 +117,10 @@ void CollisionParser::setBoundingCircle(list <BOUNDING_COLLISION *> *pBList, con
 */
 void CollisionParser::setBoundingRectangle(list <BOUNDING_COLLISION *> *pBList, const char *pId, int pOffsetX, int pOffsetY, int pWidth, int pHeight) {
 	// First triangle
+	int mGroup = registerGroup(pId);
+
 	BOUNDING_COLLISION *mB1 = new BOUNDING_COLLISION(0,pId);
+	mB1->setGroup(mGroup);
 
 	mB1->_ax    = pOffsetX;
 	mB1->_ay    = pOffsetY;
@@ -127,7 +132,8 @@ void CollisionParser::setBoundingRectangle(list <BOUNDING_COLLISION *> *pBList,
 	pBList->push_back(mB1);
 
 	// Second triangle
-	BOUNDING_COLLISION *mB2 = new BOUNDING_COLLISION(0,pId);;
+	BOUNDING_COLLISION *mB2 = new BOUNDING_COLLISION(0,pId);
+	mB2->setGroup(mGroup);
 
 	mB2->_ax    = pOffsetX + pWidth;
 	mB2->_ay    = pOffsetY;
@@ -283,4 +289,38 @@ void CollisionParser::deleteBoundingAreas(list <BOUNDING_COLLISION *> *pBList, c
 	}
 }
 
+/**
+* Number of a collision group id, registering it the first time. Bounding areas store it, so
+* collision checks compare numbers instead of ids.
+* @param pId		id of the group.
+*/
+int CollisionParser::registerGroup(const char *pId) {
+	map <string, int>::iterator mIter = _groups.find(pId);
+	if (mIter != _groups.end()) {
+		return mIter->second;
+	}
+
+	int mGroup = static_cast<int>(_groups.size());
+	_groups[pId] = mGroup;
+	return mGroup;
+}
+
+/**
+* Number of a collision group id. IND_COLLISION_GROUP_ANY for "*", and IND_COLLISION_GROUP_NONE
+* if no bounding area has ever used that id.
+* @param pId		id of the group.
+*/
+int CollisionParser::findGroup(const char *pId) {
+	if (!strcmp(pId, "*")) {
+		return IND_COLLISION_GROUP_ANY;
+	}
+
+	map <string, int>::iterator mIter = _groups.find(pId);
+	if (mIter == _groups.end()) {
+		return IND_COLLISION_GROUP_NONE;
+	}
+
+	return mIter->second;
+}
+
 /** @endcond */
@@ -175,6 +175,35 @@ unsigned int IND_Animation::getActualFrameTime(unsigned int pSequence) {
 	return frameTime;
 }
 
+/**
+ * Get the position, in the vector of frames of the animation, of a frame of the sequence.
+ * It doesn't depend on the frame being played, so several entities can play the sequence at once.
+ * @param pSequence			The sequence number of a sequence in the list of sequences.
+ * @param pPos				Position of the frame in the sequence.
+ */
+unsigned int IND_Animation::getFramePosInVec(unsigned int pSequence, unsigned int pPos) {
+	unsigned int framePos = 0;
+	vector <IND_Sequence *> *sequences = getListSequences();
+	if (sequences && sequences->size() > pSequence && (*sequences) [pSequence]->getListFrames()->size() > pPos) {
+		framePos = (*sequences) [pSequence]->getFramePosInVec(pPos);
+	}
+	return framePos;
+}
+
+/**
+ * Get the time, in milliseconds, that a frame of the sequence is displayed.
+ * @param pSequence			The sequence number of a sequence in the list of sequences.
+ * @param pPos				Position of the frame in the sequence.
+ */
+unsigned int IND_Animation::getFrameTime(unsigned int pSequence, unsigned int pPos) {
+	unsigned int frameTime = 0;
+	vector <IND_Sequence *> *sequences = getListSequences();
+	if (sequences && sequences->size() > pSequence && (*sequences) [pSequence]->getListFrames()->size() > pPos) {
+		frameTime = (*sequences) [pSequence]->getFrameTime(pPos);
+	}
+	return frameTime;
+}
+
 /**
  * TODO describtion.
  * @param pSequence			The sequence number of a sequence in the list of sequences.
@@ -37,6 +37,8 @@
 #include "IND_Animation.h"
 #include "IND_Surface.h"
 #include "IND_Font.h"
+#include "IND_Entity2dManager.h"
+#include "CollisionCache2d.h"
 
 #if defined (PLATFORM_LINUX)
 #include <stdlib.h>
@@ -65,7 +67,7 @@ void IND_Entity2d::destroy() {
 }
 
 
-IND_Entity2d::IND_Entity2d() : _text(NULL),  _listBoundingCollision(NULL) {
+IND_Entity2d::IND_Entity2d() : _text(NULL), _textDirty(true), _textCached(false), _textScaleX(1.0f), _textScaleY(1.0f), _listBoundingCollision(NULL), _manager(NULL), _slotLayer(0), _slot(-1), _inBroadphase(false), _broadphaseDirty(false), _worldCollision(NULL), _renderBoxDirty(true), _inRenderIndex(false), _renderIndexDirty(false), _renderStamp(0), _prepareCulled(false), _prepareCollisionDirty(false) {
 	initAttrib();
 }
 
@@ -79,6 +81,7 @@ IND_Entity2d::~IND_Entity2d() {
     }
     
 	DISPOSE(_listBoundingCollision);
+	DISPOSE(_worldCollision);
     DISPOSEARRAY(_text);
 }
 
@@ -164,6 +167,7 @@ void IND_Entity2d::setFont(IND_Font *pFont) {
 	
 	initAttrib();
 	_font = pFont;
+	_textDirty = 1;
 }
 
 /**
@@ -178,14 +182,17 @@ void IND_Entity2d::setShow(bool pShow) {
 /**
  * This function sets the frame number of the sequence that will be drawn.
  * Default: 0.
+ * The entity starts playing the sequence from its first frame.
  * @param pSequence				Frame number of the sequence to draw.
  */
 void IND_Entity2d::setSequence(unsigned int pSequence) {
 	if (_an) {
-		_an->setActualFramePos(_sequence, 0);
-		_an->setIsActive(_sequence, false); //Reset
-        _sequence = pSequence;
-        _an->setIsActive(_sequence, true); //Set
+		_sequence = pSequence;
+
+		// Starts again from the first frame
+		_animFrame = 0;
+		_animElapsed = 0;
+		_animPlaying = 0;
 	}
 }
 
@@ -295,7 +302,10 @@ void IND_Entity2d::setNumLines(int pNumLines) {
  * @param pAlign				Text alignment. See ::IND_Align.
  */
 void IND_Entity2d::setAlign(IND_Align pAlign) {
-	_align = pAlign;
+	if (pAlign != _align) {
+		_align = pAlign;
+		_textDirty = 1;
+	}
 }
 
 /**
@@ -304,7 +314,10 @@ void IND_Entity2d::setAlign(IND_Align pAlign) {
  * @param pCharSpacing				Width of the additional space between letters.
  */
 void IND_Entity2d::setCharSpacing(int pCharSpacing) {
-	_charSpacing = pCharSpacing;
+	if (pCharSpacing != _charSpacing) {
+		_charSpacing = pCharSpacing;
+		_textDirty = 1;
+	}
 }
 
 /**
@@ -313,11 +326,16 @@ void IND_Entity2d::setCharSpacing(int pCharSpacing) {
  * @param pLineSpacing				Height of the line spacing between lines.
  */
 void IND_Entity2d::setLineSpacing(int pLineSpacing) {
-	_lineSpacing = pLineSpacing;
+	if (pLineSpacing != _lineSpacing) {
+		_lineSpacing = pLineSpacing;
+		_textDirty = 1;
+	}
 }
 
 /**
  * Sets the text that is going to be shown on screen.
+ * The letters are laid out only when the text, the font, the spacing, the alignment or the scaling
+ * change, and the same layout is drawn in the next frames.
  * Default: "" (Empty String).
  * @param pText					Text to draw in the screen.
  */
@@ -330,6 +348,7 @@ void IND_Entity2d::setText(const char *pText) {
 		_text = new char [textSize + 1];
 		//Cooy string contents
 		strcpy(_text,pText);
+		_textDirty = 1;
 	}
 }
 
@@ -346,9 +365,9 @@ void IND_Entity2d::setPosition(float pX, float pY, int pZ) {
 	if (pX != _x || pY != _y) {
 		_x = pX;
 		_y = pY;
-		_updateTransFlag = 1;
+		transformChanged();
 	}
-	_z = pZ;
+	setZ(pZ);
 }
 
 /**
@@ -364,7 +383,7 @@ void IND_Entity2d::setAngleXYZ(float pAnX, float pAnY, float pAnZ) {
 		_angleX = pAnX;
 		_angleY = pAnY;
 		_angleZ = pAnZ;
-		_updateTransFlag = 1;
+		transformChanged();
 	}
 }
 
@@ -378,7 +397,7 @@ void IND_Entity2d::setScale(float pSx, float pSy) {
 	if (pSx != _scaleX || pSy != _scaleY) {
 		_scaleX = pSx;
 		_scaleY = pSy;
-		_updateTransFlag = 1;
+		transformChanged();
 	}
 }
 
@@ -394,7 +413,7 @@ void IND_Entity2d::setBackCull(bool pCull) {
 	// If updated
 	if (pCull != _cull) {
 		_cull = pCull;
-		_updateTransFlag = 1;
+		transformChanged();
 	}
 }
 
@@ -407,7 +426,7 @@ void IND_Entity2d::setMirrorX(bool pMx) {
 	// If updated
 	if (pMx != _mirrorX) {
 		_mirrorX = pMx;
-		_updateTransFlag = 1;
+		transformChanged();
 	}
 }
 
@@ -420,7 +439,7 @@ void IND_Entity2d::setMirrorY(bool pMy) {
 	// If updated
 	if (pMy != _mirrorY) {
 		_mirrorY = pMy;
-		_updateTransFlag = 1;
+		transformChanged();
 	}
 }
 
@@ -442,7 +461,7 @@ void IND_Entity2d::setFilter(IND_Filter pF) {
 	// If updated
 	if (pF != _filter) {
 		_filter = pF;
-		_updateTransFlag = 1;
+		transformChanged();
 	}
 }
 
@@ -467,7 +486,7 @@ bool IND_Entity2d::setHotSpot(float pX, float pY) {
 
 	// If updated
 	if (pX != _hotSpotX || pY != _hotSpotY) {
-		_updateTransFlag = 1;
+		transformChanged();
 
 		if (_su) {
 			_hotSpotX = pX;
@@ -526,6 +545,8 @@ bool IND_Entity2d::setRegion(int pOffX, int pOffY, int pRegionWidth, int pRegion
 	_offY           = pOffY;
 	_regionWidth    = pRegionWidth;
 	_regionHeight   = pRegionHeight;
+	_renderBoxDirty = 1;
+	transformChanged();
 
 	return 1;
 }
@@ -683,6 +704,7 @@ bool IND_Entity2d::setBoundingAreas(const char *pFile) {
 		g_debug->header("Fatal error, cannot load the collision xml file", DebugApi::LogHeaderError);
 		return 0;
 	}
+	collisionChanged();
 
 	// ----- g_debug -----
 
@@ -732,6 +754,7 @@ bool IND_Entity2d::setBoundingTriangle(const char *pId,
 	char *pIdCharTemp = strcpy(stringTemp, pId);
 
 	_collisionParser->setBoundingTriangle(_listBoundingCollision, pIdCharTemp, pAx, pAy, pBx, pBy, pCx, pCy);
+	collisionChanged();
 
 	return 1;
 }
@@ -776,6 +799,7 @@ bool IND_Entity2d::setBoundingCircle(const char *pId, int pOffsetX, int pOffsetY
 	char *pIdCharTemp = strcpy(stringTemp, pId);
 
 	_collisionParser->setBoundingCircle(_listBoundingCollision, pIdCharTemp, pOffsetX, pOffsetY, pRadius);
+	collisionChanged();
 
 	return 1;
 }
@@ -822,6 +846,7 @@ bool IND_Entity2d::setBoundingRectangle(const char *pId, int pOffsetX, int pOffs
 	char *pIdCharTemp = strcpy(stringTemp, pId);
 
 	_collisionParser->setBoundingRectangle(_listBoundingCollision, pIdCharTemp, pOffsetX, pOffsetY, pWidth, pHeight);
+	collisionChanged();
 
 	return 1;
 }
@@ -843,6 +868,7 @@ bool IND_Entity2d::deleteBoundingAreas(const char *pId) {
 	char *pIdCharTemp = strcpy(stringTemp, pId);
 
 	_collisionParser->deleteBoundingAreas(_listBoundingCollision, pIdCharTemp);
+	collisionChanged();
 
 	return 1;
 }
@@ -895,10 +921,11 @@ void IND_Entity2d::initAttrib() {
 	_show = 1;
 
 	// Space transformation attributes
-	_updateTransFlag = 1;
+	_renderBoxDirty = 1;
+	transformChanged();
 	_x = 0;
 	_y = 0;
-	_z = 0;
+	setZ(0);
 	_angleX = 0;
 	_angleY = 0;
 	_angleZ = 0;
@@ -940,6 +967,10 @@ void IND_Entity2d::initAttrib() {
 	_sequence = 0;
 	_numReplays = -1;
 	_firstTime = 1;
+	_animFrame = 0;
+	_animElapsed = 0;
+	_animTicks = 0;
+	_animPlaying = 0;
 
 	// 2d primitive attributes
 	_x1 = 0;
@@ -965,9 +996,50 @@ void IND_Entity2d::initAttrib() {
 	_collisionParser = CollisionParser::instance();
     DISPOSE(_listBoundingCollision);
 	_listBoundingCollision = new list <BOUNDING_COLLISION *>;
+	collisionChanged();
 
 	// Show grid areas
 	_showGridAreas = 1;
 }
 
+/*
+==================
+Changes the depth. The layer holding the entity only needs to be sorted again if it actually changes
+==================
+*/
+void IND_Entity2d::setZ(int pZ) {
+	if (_manager && pZ != _z) {
+		_manager->setLayerUnsorted(_slotLayer);
+	}
+	_z = pZ;
+}
+
+/*
+==================
+Bounding areas (or the matrix placing them) changed, the manager has to know for its collision queries
+==================
+*/
+void IND_Entity2d::collisionChanged() {
+	if (_worldCollision) {
+		_worldCollision->invalidate();
+	}
+
+	if (_manager) {
+		_manager->setCollisionDirty(this);
+	}
+}
+
+/*
+==================
+The entity has to be transformed again. The manager places it again in the render index of its layer
+==================
+*/
+void IND_Entity2d::transformChanged() {
+	_updateTransFlag = 1;
+
+	if (_manager) {
+		_manager->setRenderDirty(this);
+	}
+}
+
 /** @endcond */
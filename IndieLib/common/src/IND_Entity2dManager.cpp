@@ -44,9 +44,27 @@
 #include "CollisionParser.h"
 #include "IND_Entity2d.h"
 #include "IND_Math.h"
+#include "SpatialHash2d.h"
+#include "CollisionCache2d.h"
+#include "AlphaMask.h"
+#include "TextureDefinitions.h"
+#include "WorkerPool.h"
+#include "IND_Timer.h"
 
 /** @cond DOCUMENT_PRIVATEAPI */
 
+// Above this number of entities out of place, a layer is sorted from scratch instead of by insertion
+#define MAX_INSERTION_SORT_DESCENTS 16
+
+// Minimum number of buckets of a broadphase. There are twice as many as entities in the layer, if more
+#define MIN_BROADPHASE_BUCKETS 1024
+
+// Size of the cells of the render index of static layers
+#define RENDER_INDEX_CELL_SIZE 256.0f
+
+// Entities of a layer prepared by each task of prepareEntities2d()
+#define PREPARE_CHUNK_SIZE 1024
+
 /**
  * For sorting the vector
  */
@@ -91,6 +109,8 @@ bool IND_Entity2dManager::init(IND_Render *pRender) {
 
 	_math = new IND_Math();
 	_math->init();
+	_animationTimer = new IND_Timer();
+	_animationTimer->start();
 	g_debug->header("Entity2dManager OK", DebugApi::LogHeaderEnd);
 
 	return _ok;
@@ -104,6 +124,11 @@ void IND_Entity2dManager::end() {
 	if (_ok) {
 		g_debug->header("Finalizing Entity2dManager", DebugApi::LogHeaderBegin);
 		DISPOSE (_math);
+		DISPOSE (_workers);
+		_numThreads = 1;
+		DISPOSE (_animationTimer);
+		_animationManual = false;
+		_animationTicks = 0;
 		g_debug->header("Freeing 2d entities" , DebugApi::LogHeaderBegin);
 		freeVars();
 		g_debug->header("Entities freed", DebugApi::LogHeaderEnd);
@@ -143,6 +168,12 @@ bool IND_Entity2dManager::add(IND_Entity2d *pNewEntity2d) {
 		return 0;
 	}
 
+	// An entity can only be in one place
+	if (pNewEntity2d->_manager) {
+		g_debug->header("Entity already added to a manager", DebugApi::LogHeaderError);
+		return 0;
+	}
+
 	// ----- Puts the entity into the manager -----
 
 	addToList(0, pNewEntity2d);
@@ -186,6 +217,12 @@ bool IND_Entity2dManager::add(int pLayer, IND_Entity2d *pNewEntity2d) {
 	// Only allow NUM_LAYERS
 	if (pLayer < 0 || pLayer > NUM_LAYERS - 1) return 0;
 
+	// An entity can only be in one place
+	if (pNewEntity2d->_manager) {
+		g_debug->header("Entity already added to a manager", DebugApi::LogHeaderError);
+		return 0;
+	}
+
 	// ----- Puts the entity into the manager -----
 
 	addToList(pLayer, pNewEntity2d);
@@ -201,109 +238,190 @@ bool IND_Entity2dManager::add(int pLayer, IND_Entity2d *pNewEntity2d) {
 /**
  * Returns 1(true) if the entity object passed as parameter exists
  * and is deleted from the manager successfully.
+ * The entity leaves the manager in constant time, no matter how many entities there are.
  * @param pEn				Pointer to an entity object.
  */
 bool IND_Entity2dManager::remove(IND_Entity2d *pEn) {
 	g_debug->header("Freeing 2d entity", DebugApi::LogHeaderBegin);
+
+	if (!_ok || !pEn) {
+		writeMessage();
+		return 0;
+	}
+
 	g_debug->header("Name:", DebugApi::LogHeaderInfo);
 	g_debug->dataInt(pEn->getId(), 1);
 
-	if (!_ok || !pEn) {
+	// The entity knows where it is
+	if (pEn->_manager != this) {
+		g_debug->header("Entity not found", DebugApi::LogHeaderEnd);
+		return 0;
+	}
+
+	// ----- Delete object from list -----
+
+	removeFromList(pEn);
+
+	g_debug->header("Ok", DebugApi::LogHeaderEnd);
+
+	return 1;
+}
+
+/**
+ * Returns 1(true) if all the entity objects passed as parameter exist
+ * and are deleted from the manager successfully. Entities not found in the manager are skipped.
+ * Each entity leaves the manager in constant time.
+ * @param pEntities			Array of pointers to entity objects.
+ * @param pNumEntities		Number of entities in the array.
+ */
+bool IND_Entity2dManager::remove(IND_Entity2d **pEntities, int pNumEntities) {
+	g_debug->header("Freeing 2d entities", DebugApi::LogHeaderBegin);
+	g_debug->header("Number of entities:", DebugApi::LogHeaderInfo);
+	g_debug->dataInt(pNumEntities, 1);
+
+	if (!_ok || !pEntities) {
 		writeMessage();
 		return 0;
 	}
 
-	// Search object in all the layers
-	for (int i = 0; i < NUM_LAYERS; i++) {
-		bool mIs = 0;
-		vector <IND_Entity2d *>::iterator _listIter;
-		for (_listIter  = _listEntities2d[i]->begin();
-		        _listIter  != _listEntities2d[i]->end();
-		        _listIter++) {
-			if ((*_listIter) == pEn) {
-				mIs = 1;
-				break;
-			}
+	int mNotFound = 0;
+	for (int i = 0; i < pNumEntities; i++) {
+		if (pEntities[i] && pEntities[i]->_manager == this) {
+			removeFromList(pEntities[i]);
+		} else {
+			mNotFound++;
 		}
+	}
 
-		// Found
-		if (mIs) {
-			// ----- Delete object from list -----
+	if (mNotFound) {
+		g_debug->header("Entities not found:", DebugApi::LogHeaderInfo);
+		g_debug->dataInt(mNotFound, 1);
+		g_debug->header("Entities freed", DebugApi::LogHeaderEnd);
+		return 0;
+	}
+
+	g_debug->header("Ok", DebugApi::LogHeaderEnd);
+
+	return 1;
+}
+
+/**
+ * Returns 1(true) if the layer exists and all its entities are deleted from the manager successfully.
+ * The entities are not freed, same as with remove().
+ * @param pLayer				Number of layer (0 - 63 layers allowed).
+ */
+bool IND_Entity2dManager::removeAll(int pLayer) {
+	g_debug->header("Freeing 2d entities of layer", DebugApi::LogHeaderBegin);
+	g_debug->header("Layer:", DebugApi::LogHeaderInfo);
+	g_debug->dataInt(pLayer, 1);
 
-			// Quit from list
-			_listEntities2d[i]->erase(_listIter);
+	if (!_ok || pLayer < 0 || pLayer > NUM_LAYERS - 1) {
+		writeMessage();
+		return 0;
+	}
 
-			g_debug->header("Ok", DebugApi::LogHeaderEnd);
+	releaseBroadphase(pLayer);
+	releaseRenderIndex(pLayer);
+	_layerPrepared[pLayer] = 0;
 
-			return 1;
+	vector <IND_Entity2d *>::iterator mIter;
+	for (mIter  = _listEntities2d[pLayer]->begin();
+	        mIter != _listEntities2d[pLayer]->end();
+	        mIter++) {
+		if (*mIter) {
+			(*mIter)->_manager = NULL;
+			(*mIter)->_slot = -1;
 		}
 	}
 
-	g_debug->header("Entity not found", DebugApi::LogHeaderEnd);
-	return 0;
+	_listEntities2d[pLayer]->clear();
+	_layerHoles[pLayer] = 0;
+	_layerUnsorted[pLayer] = false;
+
+	g_debug->header("Ok", DebugApi::LogHeaderEnd);
+
+	return 1;
 }
 
 /**
  * Renders (draws on the screen) all the entities of the manager of a concrete layer.
+ * In static layers (see setLayerStatic()), only the entities near the screen are gone through.
+ * If the layer was prepared with prepareEntities2d(), only its list of entities to draw is gone through.
  */
 void IND_Entity2dManager::renderEntities2d(int pLayer) {
 	if (!_ok || _listEntities2d[pLayer]->empty()) return;
 
+	// A prepared layer is drawn only once
+	bool mPrepared = _layerPrepared[pLayer];
+	_layerPrepared[pLayer] = 0;
+
+	// Close the gaps of removed entities
+	compactLayer(pLayer);
+
 	// Sort the list by z value ONLY if the z value of an entity has changed
-	// TODO: How to know if an entity has changed z-value from here int order to avoid sorting?
-	sort(_listEntities2d[pLayer]->begin(), _listEntities2d[pLayer]->end(), zIsLess);
+	if (_layerUnsorted[pLayer]) {
+		sortLayer(pLayer);
+	}
 
 	//Set cull region
 	_render->reCalculateFrustrumPlanes();
 
+	// Prepared for other camera: gone through as usual
+	if (mPrepared && !isPreparedView()) {
+		mPrepared = 0;
+	}
+
+	// Same time for all the animations of the layer
+	unsigned long mTicks = getAnimationTicks();
+
+	vector <IND_Entity2d *> *mEntities = _listEntities2d[pLayer];
+	if (mPrepared) {
+		// Already transformed and culled by prepareEntities2d()
+		mEntities = &_drawList[pLayer];
+		_render->addNumDiscardedObjects(_prepareDiscarded[pLayer]);
+	} else {
+		// Static layers: only the entities found in the cells seen by the camera
+		if (_layerStatic[pLayer] && queryRenderIndex(pLayer, _renderVisible[pLayer])) {
+			mEntities = &_renderVisible[pLayer];
+		}
+		_layerVisited[pLayer] = static_cast<int>(mEntities->size());
+	}
+
 	// Iterates the list
 	vector <IND_Entity2d *>::iterator mIter;
-	for (mIter  = _listEntities2d[pLayer]->begin();
-	        mIter != _listEntities2d[pLayer]->end();
+	for (mIter  = mEntities->begin();
+	        mIter != mEntities->end();
 	        mIter++) {
 		// Only render it if "show" flag is true
 		if ((*mIter)->_show) {
 			// If it has an animation or a surface assigned
 			if ((*mIter)->_su || (*mIter)->_an) {
-				// Set transformations ONLY if the entity space attributes has been modified
-				if ((*mIter)->_updateTransFlag) {
-					(*mIter)->_updateTransFlag = 0;
-
-					int mWidthTemp = 0;
-					int mHeightTemp = 0;
-
-					// ---- We obtain the width and height of the animation or the surface -----
+				// Each entity goes on with its own frames, by the time passed since it was last drawn. It is
+				// done first, as the transform and the bounding areas are the ones of the frame shown
+				if ((*mIter)->_an) {
+					advanceAnimation(*mIter, mTicks);
+				}
 
-					if ((*mIter)->_su) {
-						mWidthTemp  = (*mIter)->_su->getWidth();
-						mHeightTemp = (*mIter)->_su->getHeight();
+				// Prepared entities are already transformed and culled, unless they were changed after that
+				if (!mPrepared || (*mIter)->_updateTransFlag) {
+					// Set transformations ONLY if the entity space attributes has been modified
+					if ((*mIter)->_updateTransFlag) {
+						updateTransform(*mIter);
 					} else {
-						if ((*mIter)->_an->getActualSurface((*mIter)->getSequence())) {
-							mWidthTemp  = (*mIter)->_an->getActualSurface((*mIter)->getSequence())->getWidth();
-							mHeightTemp = (*mIter)->_an->getActualSurface((*mIter)->getSequence())->getHeight();
+						// Each frame of an animation has its own bounding areas
+						if ((*mIter)->_an) {
+							setCollisionDirty(*mIter);
 						}
 					}
 
-					// ----- Transformations -----
+					// ----- Culling -----
 
-					_render->setTransform2d((int)(*mIter)->_x,
-					                        (int)(*mIter)->_y,
-					                        (*mIter)->_angleX,
-					                        (*mIter)->_angleY,
-					                        (*mIter)->_angleZ,
-					                        (*mIter)->_scaleX,
-					                        (*mIter)->_scaleY,
-					                        (*mIter)->_axisCalX,
-					                        (*mIter)->_axisCalY,
-					                        (*mIter)->_mirrorX,
-					                        (*mIter)->_mirrorY,
-					                        mWidthTemp,
-					                        mHeightTemp,
-					                        &(*mIter)->_mat);
-				} else {
-					_render->setTransform2d((*mIter)->_mat);
+					// Out of the screen: skipped before any transform or color is set
+					if (cullEntity(*mIter)) continue;
 				}
 
+				_render->setTransform2d((*mIter)->_mat);
+
 				// ----- Color attributes -----
 
 				_render->setRainbow2d((*mIter)->getType(),
@@ -352,49 +470,7 @@ void IND_Entity2dManager::renderEntities2d(int pLayer) {
 				// ----- Animation blitting -----
 
 				else {
-					// Animation is looping
-					if ((*mIter)->_numReplays == -1) {
-						// Blits the animation, returns -1 when finishes
-						if (_render->blitAnimation((*mIter)->_an,
-						                           (*mIter)->_sequence,
-						                           (*mIter)->_offX,
-						                           (*mIter)->_offY,
-						                           (*mIter)->_regionWidth,
-						                           (*mIter)->_regionHeight,
-						                           (*mIter)->_wrap,
-						                           (*mIter)->_uDisplace,
-						                           (*mIter)->_vDisplace) == -1) {
-							// Reset the animation
-							(*mIter)->_an->setActualFramePos((*mIter)->_sequence, 0);
-						}
-					} else
-						// If there is a stablished number or replays
-					{
-						// Blits the animation, returns -1 when finishes
-						if (_render->blitAnimation((*mIter)->_an,
-						                           (*mIter)->_sequence,
-						                           (*mIter)->_offX,
-						                           (*mIter)->_offY,
-						                           (*mIter)->_regionWidth,
-						                           (*mIter)->_regionHeight,
-						                           (*mIter)->_wrap,
-						                           (*mIter)->_uDisplace,
-						                           (*mIter)->_vDisplace) == -1) {
-							// There are replays
-							if ((*mIter)->_numReplays > 0) {
-								// Reset animation
-								(*mIter)->_an->setActualFramePos((*mIter)->_sequence, 0);
-
-								// Decrease the number of replays
-								(*mIter)->_numReplays--;
-							}
-							// There are no replays
-							else {
-								// Blits the last frame
-								(*mIter)->_an->setActualFramePos((*mIter)->_sequence, (*mIter)->_an->getNumFrames((*mIter)->_sequence) - 1);
-							}
-						}
-					}
+					blitAnimationFrame(*mIter);
 				}
 			} else
 				// If it has a 2d primitive assigned
@@ -483,32 +559,222 @@ void IND_Entity2dManager::renderEntities2d(int pLayer) {
 				} else
 					// If it has a font assigned
 					if ((*mIter)->_font) {
+						IND_Entity2d *mEn = *mIter;
+
+						// The text is laid out again only when it, or the way to draw it, has changed
+						if (mEn->_textDirty || mEn->_textScaleX != mEn->_scaleX || mEn->_textScaleY != mEn->_scaleY) {
+							mEn->_textCached = _render->buildTextGeometry(mEn->_font,
+							                                              mEn->_text,
+							                                              mEn->_charSpacing,
+							                                              mEn->_lineSpacing,
+							                                              mEn->_scaleX,
+							                                              mEn->_scaleY,
+							                                              mEn->_align,
+							                                              mEn->_textVertices);
+							mEn->_textScaleX = mEn->_scaleX;
+							mEn->_textScaleY = mEn->_scaleY;
+							mEn->_textDirty = 0;
+						}
 
-						_render->blitText((*mIter)->_font,
-						                  (*mIter)->_text,
-						                  (int)(*mIter)->_x,
-						                  (int)(*mIter)->_y,
-						                  (*mIter)->_charSpacing,
-						                  (*mIter)->_lineSpacing,
-						                  (*mIter)->_scaleX,
-						                  (*mIter)->_scaleY,
-						                  (*mIter)->_r,
-						                  (*mIter)->_g,
-						                  (*mIter)->_b,
-						                  (*mIter)->_a,
-						                  (*mIter)->_fadeR,
-						                  (*mIter)->_fadeG,
-						                  (*mIter)->_fadeB,
-						                  (*mIter)->_fadeA,
-						                  (*mIter)->_filter,
-						                  (*mIter)->_so,
-						                  (*mIter)->_ds,
-						                  (*mIter)->_align);
+						if (mEn->_textCached) {
+							_render->blitTextGeometry(mEn->_font,
+							                          mEn->_textVertices,
+							                          (int)mEn->_x,
+							                          (int)mEn->_y,
+							                          mEn->_scaleX,
+							                          mEn->_scaleY,
+							                          mEn->_r,
+							                          mEn->_g,
+							                          mEn->_b,
+							                          mEn->_a,
+							                          mEn->_fadeR,
+							                          mEn->_fadeG,
+							                          mEn->_fadeB,
+							                          mEn->_fadeA,
+							                          mEn->_filter,
+							                          mEn->_so,
+							                          mEn->_ds);
+						} else {
+							_render->blitText(mEn->_font,
+							                  mEn->_text,
+							                  (int)mEn->_x,
+							                  (int)mEn->_y,
+							                  mEn->_charSpacing,
+							                  mEn->_lineSpacing,
+							                  mEn->_scaleX,
+							                  mEn->_scaleY,
+							                  mEn->_r,
+							                  mEn->_g,
+							                  mEn->_b,
+							                  mEn->_a,
+							                  mEn->_fadeR,
+							                  mEn->_fadeG,
+							                  mEn->_fadeB,
+							                  mEn->_fadeA,
+							                  mEn->_filter,
+							                  mEn->_so,
+							                  mEn->_ds,
+							                  mEn->_align);
+						}
 					}
 		}
 	}
 }
 
+/**
+ * Prepares all the layers to be rendered: sorts them, calculates the transformations of the entities
+ * that have been modified and discards the ones out of the screen. This work is shared by the threads set
+ * with setNumThreads(), so it can be done before drawing the layers with renderEntities2d(), which is left
+ * with the calls to the render. The entities drawn are exactly the same as without preparing the layers.
+ *
+ * It must be called after setting the camera, and after changing the entities (that is, just before
+ * rendering the layers). A prepared layer is rendered only once: if it is rendered again (for example,
+ * with other camera) it is gone through as usual. Layers with entities moved, added or removed after
+ * preparing them are also gone through as usual.
+ */
+void IND_Entity2dManager::prepareEntities2d() {
+	if (!_ok) return;
+
+	_render->reCalculateFrustrumPlanes();
+	_prepareViewOk = _render->getFrustumBox2d(_prepareView);
+	_prepareTicks = getAnimationTicks();
+
+	// Sort the layers and choose the entities to go through
+	runTasks(NUM_LAYERS, prepareLayerTask);
+
+	// Transform and cull the entities, in chunks of the same size
+	_prepareTasks.clear();
+	for (int i = 0; i < NUM_LAYERS; i++) {
+		if (!_prepareList[i]) continue;
+
+		int mSize = static_cast<int>(_prepareList[i]->size());
+		for (int j = 0; j < mSize; j += PREPARE_CHUNK_SIZE) {
+			PREPARE_TASK mTask;
+			mTask._layer = i;
+			mTask._begin = j;
+			mTask._end = min(j + PREPARE_CHUNK_SIZE, mSize);
+			_prepareTasks.push_back(mTask);
+		}
+	}
+	runTasks(static_cast<int>(_prepareTasks.size()), prepareEntitiesTask);
+
+	// Lists of entities to draw, in the order of each layer
+	runTasks(NUM_LAYERS, finishLayerTask);
+}
+
+/**
+ * Sets the number of threads used by prepareEntities2d(), counting the calling one. Default: 1 (all the
+ * work is done by the calling thread).
+ * @param pNumThreads			Number of threads. 0 = as many as processors.
+ */
+void IND_Entity2dManager::setNumThreads(int pNumThreads) {
+	if (!_ok || pNumThreads < 0) return;
+
+	if (!pNumThreads) {
+		pNumThreads = SDL_GetCPUCount();
+	}
+
+	DISPOSE(_workers);
+	_numThreads = 1;
+
+	if (pNumThreads > 1) {
+		_workers = new WorkerPool();
+		if (!_workers->init(pNumThreads)) {
+			DISPOSE(_workers);
+			return;
+		}
+		_numThreads = _workers->getNumThreads();
+	}
+}
+
+/**
+ * Returns the number of threads used by prepareEntities2d(). See setNumThreads().
+ */
+int IND_Entity2dManager::getNumThreads() {
+	return _numThreads;
+}
+
+/**
+ * Moves the clock of the animations forward. Each entity plays its animation on its own, going
+ * through as many frames as the time passed since it was last drawn (see IND_Entity2d::getActualFrame()).
+ * By default, that time is read from the system clock. After calling this method, it is only moved by
+ * hand with this method: for example, with the time step of a game updated at a fixed rate, or not
+ * moved at all to pause all the animations.
+ * @param pElapsed				Time passed, in milliseconds.
+ */
+void IND_Entity2dManager::advanceAnimations(unsigned long pElapsed) {
+	if (!_ok) return;
+
+	if (!_animationManual) {
+		_animationTicks = getAnimationTicks();
+		_animationManual = true;
+	}
+
+	_animationTicks += pElapsed;
+}
+
+/**
+ * Makes a layer static or dynamic. Default: dynamic.
+ *
+ * Entities of a static layer are placed in a grid of cells by their position. When the layer is
+ * rendered, only the entities in the cells seen by the camera are gone through, so layers with lots
+ * of entities spread on a big world (decoration of a level) are drawn in the time of the ones visible.
+ * Entities of dynamic layers are gone through one by one, every time they are rendered.
+ *
+ * Entities of a static layer can still be moved, added or removed, as it is done in the rest of
+ * layers, but every change places them again in the grid. So layers with entities moving every frame
+ * are better left dynamic.
+ *
+ * Only surfaces are placed by their position. Animations, primitives, fonts and surfaces with a grid or
+ * rotated in the x or y axis are gone through every time the layer is rendered.
+ * @param pLayer				Number of layer (0 - 63 layers allowed).
+ * @param pStatic				True = static layer, false = dynamic layer.
+ */
+void IND_Entity2dManager::setLayerStatic(int pLayer, bool pStatic) {
+	if (!_ok || pLayer < 0 || pLayer > NUM_LAYERS - 1) return;
+
+	_layerStatic[pLayer] = pStatic;
+	_layerPrepared[pLayer] = 0;
+
+	// The grid is built the next time the layer is rendered
+	if (!pStatic) {
+		releaseRenderIndex(pLayer);
+	}
+}
+
+/**
+ * Returns 1 (true) if the layer is static. See setLayerStatic().
+ * @param pLayer				Number of layer (0 - 63 layers allowed).
+ */
+bool IND_Entity2dManager::isLayerStatic(int pLayer) {
+	if (!_ok || pLayer < 0 || pLayer > NUM_LAYERS - 1) return 0;
+
+	return _layerStatic[pLayer];
+}
+
+/**
+ * Returns the number of entities of a layer.
+ * @param pLayer				Number of layer (0 - 63 layers allowed).
+ */
+int IND_Entity2dManager::getNumEntities(int pLayer) {
+	if (!_ok || pLayer < 0 || pLayer > NUM_LAYERS - 1) return 0;
+
+	return static_cast<int>(_listEntities2d[pLayer]->size()) - _layerHoles[pLayer];
+}
+
+/**
+ * Returns the number of entities gone through the last time the layer was rendered, including the
+ * ones found out of the screen. Same as getNumEntities() for dynamic layers; in static layers
+ * (see setLayerStatic()) it is about the number of entities near the screen.
+ * @param pLayer				Number of layer (0 - 63 layers allowed).
+ */
+int IND_Entity2dManager::getNumVisitedEntities(int pLayer) {
+	if (!_ok || pLayer < 0 || pLayer > NUM_LAYERS - 1) return 0;
+
+	return _layerVisited[pLayer];
+}
+
+
 /**
  * Renders (blits on the screen) all the collision areas of the entities. It's good to use this method
  * in order to check that our collision areas are accurate.
@@ -526,6 +792,8 @@ void IND_Entity2dManager::renderCollisionAreas(unsigned char pR, unsigned char p
 void IND_Entity2dManager::renderCollisionAreas(int pLayer, unsigned char pR, unsigned char pG, unsigned char pB, unsigned char pA) {
 	if (!_ok || _listEntities2d[pLayer]->empty()) return;
 
+	compactLayer(pLayer);
+
 	// Iterate the list
 	vector <IND_Entity2d *>::iterator mIter;
 	for (mIter  = _listEntities2d[pLayer]->begin();
@@ -544,10 +812,9 @@ void IND_Entity2dManager::renderCollisionAreas(int pLayer, unsigned char pR, uns
 				// Bounding list of a frame in an animation
 				if ((*mIter)->_an) {
 
-					vector <IND_Frame*> *frames = (*mIter)->_an->getVectorFrames();
-					unsigned int framePos = (*mIter)->_an->getActualFramePos((*mIter)->getSequence());
-					if (frames && frames->size() > framePos) {
-						mBoundingListToRender = (*frames) [framePos]->GetListBoundingCollision();
+					IND_Frame *mFrame = getAnimationFrame(*mIter);
+					if (mFrame) {
+						mBoundingListToRender = mFrame->GetListBoundingCollision();
 					}
 				}
 
@@ -586,6 +853,8 @@ void IND_Entity2dManager::renderCollisionAreas(int pLayer, unsigned char pR, uns
 void IND_Entity2dManager::renderGridAreas(int pLayer, unsigned char pR, unsigned char pG, unsigned char pB, unsigned char pA) {
 	if (!_ok || _listEntities2d[pLayer]->empty()) return;
 
+	compactLayer(pLayer);
+
 	// Iterate the list
 	vector <IND_Entity2d *>::iterator mIter;
 	for (mIter  = _listEntities2d[pLayer]->begin();
@@ -603,7 +872,10 @@ void IND_Entity2dManager::renderGridAreas(int pLayer, unsigned char pR, unsigned
 
 				// Surface of current frame
 				if ((*mIter)->_an) {
-					surface = (*mIter)->_an->getActualSurface((*mIter)->getSequence());
+					IND_Frame *mFrame = getAnimationFrame(*mIter);
+					if (mFrame) {
+						surface = mFrame->getSurface();
+					}
 				}
 
 				if (surface) {
@@ -655,106 +927,278 @@ void IND_Entity2dManager::renderGridAreas(int pLayer, unsigned char pR, unsigned
  * @param pId2						Id of a group of collison areas. Use "*" for checking all the groups.
  */
 bool IND_Entity2dManager::isCollision(IND_Entity2d *pEn1, const char *pId1, IND_Entity2d *pEn2, const char *pId2) {
+	return isCollision(pEn1, getCollisionGroup(pId1), pEn2, getCollisionGroup(pId2));
+}
+
+/**
+ * Same as isCollision() using ids, but with the numbers of the collision groups (see getCollisionGroup()).
+ * Faster when checking many entities.
+ * @param pEn1						Pointer to an entity object.
+ * @param pGroup1					Number of a group of collison areas. Use ::IND_COLLISION_GROUP_ANY for checking all the groups.
+ * @param pEn2						Pointer to an entity object.
+ * @param pGroup2					Number of a group of collison areas. Use ::IND_COLLISION_GROUP_ANY for checking all the groups.
+ */
+bool IND_Entity2dManager::isCollision(IND_Entity2d *pEn1, int pGroup1, IND_Entity2d *pEn2, int pGroup2) {
+	if (pGroup1 == IND_COLLISION_GROUP_NONE || pGroup2 == IND_COLLISION_GROUP_NONE) return 0;
 	if (!pEn1->_su && !pEn1->_an) return 0;
 	if (!pEn2->_su && !pEn2->_an) return 0;
 
-	list <BOUNDING_COLLISION *> *mBoundingList1;
-	list <BOUNDING_COLLISION *> *mBoundingList2;
+	CollisionCache2d *mWorld1 = getWorldCollision(pEn1);
+	CollisionCache2d *mWorld2 = getWorldCollision(pEn2);
+	if (!mWorld1 || !mWorld2) return 0;
 
-	// Is a surface
-	if (pEn1->_su) {
-		mBoundingList1 = pEn1->_listBoundingCollision;
-	}
-	// Is an animation
-	else {
-		mBoundingList1 = (*(pEn1->_an->getVectorFrames())) [pEn1->_an->getActualFramePosInVec(pEn1->getSequence())]->GetListBoundingCollision();
-	}
+	if (mWorld1->isCollision(pGroup1, *mWorld2, pGroup2, _math))
+		return 1;
 
-	// Is a surface
-	if (pEn2->_su) {
-		mBoundingList2 = pEn2->_listBoundingCollision;
-	}
-	// Is an animation
-	else {
-		mBoundingList2 = (*(pEn2->_an->getVectorFrames())) [pEn2->_an->getActualFramePosInVec(pEn2->getSequence())]->GetListBoundingCollision();
-	}
+	return 0;
+}
 
-	if (isCollision(mBoundingList1, mBoundingList2,
-	                pId1, pId2,
-	                pEn1->_mat, pEn2->_mat,
-	                pEn1->_scaleX, pEn2->_scaleX))
-		return 1;
+
+/**
+ * Returns the number of a collision group id, used by the bounding areas created with that id.
+ * Returns ::IND_COLLISION_GROUP_ANY for "*", and ::IND_COLLISION_GROUP_NONE if no bounding area
+ * has been created with that id yet.
+ * @param pId						Id of a group of collison areas.
+ */
+int IND_Entity2dManager::getCollisionGroup(const char *pId) {
+	return CollisionParser::instance()->findGroup(pId);
+}
+
+
+/**
+ * Checks if the visible pixels of two entities overlap. Returns 1 (true) if they do.
+ *
+ * The surfaces (or the frames of the animations) must have been loaded with alpha masks enabled
+ * (see IND_SurfaceManager::setAlphaMasks()). Otherwise, or if the entities don't overlap at all,
+ * it returns 0 (false). Bounding areas are not used.
+ *
+ * Positions of the entities are the ones of the last time they were rendered, same as in isCollision().
+ *
+ * Rotations allowed of the object: yes.
+ * Scaling allowed of the object: yes.
+ * Mirroring allowed of the object: yes.
+ * Regions of surfaces are supported, but not wrapping.
+ *
+ * Entities moved by whole pixels, not scaled nor rotated, are compared 64 pixels at a time, so
+ * that is the fastest case.
+ * @param pEn1						Pointer to an entity object.
+ * @param pEn2						Pointer to an entity object.
+ */
+bool IND_Entity2dManager::isPixelCollision(IND_Entity2d *pEn1, IND_Entity2d *pEn2) {
+	if (!_ok || !pEn1 || !pEn2) return 0;
+
+	AlphaMaskPlacement mPlacement1, mPlacement2;
+	if (!placeAlphaMask(pEn1, mPlacement1) || !placeAlphaMask(pEn2, mPlacement2)) return 0;
+
+	// Overlap of the boxes
+	int mX1 = max(mPlacement1._x1, mPlacement2._x1);
+	int mY1 = max(mPlacement1._y1, mPlacement2._y1);
+	int mX2 = min(mPlacement1._x2, mPlacement2._x2);
+	int mY2 = min(mPlacement1._y2, mPlacement2._y2);
+	if (mX1 >= mX2 || mY1 >= mY2) return 0;
+
+	// Rows of the overlap, 64 pixels at a time
+	for (int y = mY1; y < mY2; y++) {
+		for (int x = mX1; x < mX2; x += ALPHAMASK_WORD_BITS) {
+			int mCount = min(ALPHAMASK_WORD_BITS, mX2 - x);
+			if (mPlacement1.getWorldBits(x, y, mCount) & mPlacement2.getWorldBits(x, y, mCount))
+				return 1;
+		}
+	}
 
 	return 0;
 }
 
 
-// --------------------------------------------------------------------------------
-//									 Private methods
-// --------------------------------------------------------------------------------
+/**
+ * Sets the size of the cells used to find colliding entities quickly (see queryCollisions()).
+ * Entities are placed in a grid of square cells, and only entities sharing a cell are checked
+ * against each other. A good size is around the size of the usual entity. Default: 128.
+ * @param pCellSize				Size of the cells in pixels.
+ */
+void IND_Entity2dManager::setBroadphaseCellSize(int pCellSize) {
+	if (!_ok || pCellSize <= 0) return;
 
-/** @cond DOCUMENT_PRIVATEAPI */
+	_broadphaseCellSize = static_cast<float>(pCellSize);
 
-/*
-==================
-Check the collision between bounding areas
-==================
-*/
-inline bool IND_Entity2dManager::isCollision(list <BOUNDING_COLLISION *> *pBoundingList1, list <BOUNDING_COLLISION *> *pBoundingList2,
-        const char *pId1, const char *pId2,
-        IND_Matrix pMat1, IND_Matrix pMat2,
-        float pScale1, float pScale2) {
-	list <BOUNDING_COLLISION *>::iterator i;
-	list <BOUNDING_COLLISION *>::iterator j;
-
-	bool mCollision = 0;
-
-	// Check all the collisions
-	for (i  = pBoundingList1->begin();
-	        i != pBoundingList1->end();
-	        i++) {
-		for (j  = pBoundingList2->begin();
-		        j != pBoundingList2->end();
-		        j++) {
-			// Check only if the group is correct
-            const char* const id1 = (*i)->getId();
-            const char* const id2 = (*j)->getId();
-			if (    (!strcmp(pId1, id1)  && !strcmp(pId2, id2))   ||      // "group1", "group2"
-			        (!strcmp(pId1, "*"      )  && !strcmp(id2, pId2))   ||      // "*", "group"
-			        (!strcmp(id1, pId1)  && !strcmp(pId2 , "*")     )   ||      // "group", "*"
-			        (!strcmp(pId1, "*"      )  && !strcmp(pId2 , "*")     )     ) {   // "*", "*"
-				
-				// Triangle to triangle
-				if ((*i)->getType() == 0 && (*j)->getType() == 0) {
-					if (_math->isTriangleToTriangleCollision((*i), pMat1, (*j), pMat2))
-						mCollision = 1;
-				}
+	// Grids are built again, with the new size, the next time they are queried
+	for (int i = 0; i < NUM_LAYERS; i++) {
+		releaseBroadphase(i);
+	}
+}
 
-				// Circle to triangle
-				if ((*i)->getType() == 1 && (*j)->getType() == 0) {
-					if (_math->isCircleToTriangleCollision((*i), pMat1, pScale1, (*j), pMat2))
-						mCollision = 1;
-				}
+/**
+ * Finds all the pairs of entities of a layer that collide, and returns the number of pairs found.
+ * For each pair, pCallback is called with the entity having the bounding areas of group pId1
+ * first, and the one having group pId2 second. Use "*" for any group, same as in isCollision().
+ *
+ * Only entities close to each other are checked (they are placed in a grid, see setBroadphaseCellSize()).
+ * Positions of the entities are the ones of the last time they were rendered, same as in isCollision().
+ * Entities can't be added to or removed from the manager in the callback.
+ * @param pLayer				Number of layer (0 - 63 layers allowed).
+ * @param pId1					Id of the first collision group.
+ * @param pId2					Id of the second collision group.
+ * @param pCallback				Function called for each colliding pair. Can be NULL, for just counting.
+ * @param pUserData				Pointer passed to the callback.
+ */
+int IND_Entity2dManager::queryCollisions(int pLayer, const char *pId1, const char *pId2, IND_CollisionCallback pCallback, void *pUserData) {
+	if (!_ok || pLayer < 0 || pLayer > NUM_LAYERS - 1 || !pId1 || !pId2) return 0;
 
-				// Triangle to circle
-				if ((*i)->getType() == 0 && (*j)->getType() == 1) {
-					if (_math->isCircleToTriangleCollision((*j), pMat2, pScale2, (*i), pMat1))
-						mCollision = 1;
-				}
+	int mGroup1 = getCollisionGroup(pId1);
+	int mGroup2 = getCollisionGroup(pId2);
+	if (mGroup1 == IND_COLLISION_GROUP_NONE || mGroup2 == IND_COLLISION_GROUP_NONE) return 0;
+
+	updateBroadphase(pLayer);
+
+	SpatialHash2d *mHash = _broadphase[pLayer];
+	vector <IND_Entity2d *> &mList = *_listEntities2d[pLayer];
+	int mNumCollisions = 0;
+
+	for (size_t i = 0; i < mList.size(); i++) {
+		IND_Entity2d *mEn1 = mList[i];
+		if (!mEn1 || !mEn1->_inBroadphase) continue;
+
+		const int *mCells1 = mEn1->_collisionCells;
+		const float *mBox1 = mEn1->_collisionBox;
+
+		// Too big for the grid: checked against every entity of the layer
+		if (SpatialHash2d::isLarge(mCells1[0], mCells1[1], mCells1[2], mCells1[3])) {
+			for (size_t j = 0; j < mList.size(); j++) {
+				IND_Entity2d *mEn2 = mList[j];
+				if (!mEn2 || mEn2 == mEn1 || !mEn2->_inBroadphase) continue;
+
+				// Two big entities are checked only once
+				const int *mCells2 = mEn2->_collisionCells;
+				if (j < i && SpatialHash2d::isLarge(mCells2[0], mCells2[1], mCells2[2], mCells2[3])) continue;
+
+				const float *mBox2 = mEn2->_collisionBox;
+				if (mBox1[0] > mBox2[2] || mBox2[0] > mBox1[2] || mBox1[1] > mBox2[3] || mBox2[1] > mBox1[3]) continue;
+
+				if (isCollisionPair(mEn1, mEn2, mGroup1, mGroup2, pCallback, pUserData))
+					mNumCollisions++;
+			}
+			continue;
+		}
+
+		for (int y = mCells1[1]; y <= mCells1[3]; y++) {
+			for (int x = mCells1[0]; x <= mCells1[2]; x++) {
+				const vector <IND_Entity2d *> &mBucket = mHash->getBucket(x, y);
+				for (size_t j = 0; j < mBucket.size(); j++) {
+					IND_Entity2d *mEn2 = mBucket[j];
+
+					// Each pair once
+					if (mEn2->_slot <= mEn1->_slot) continue;
 
-				// Circle to circle
-				if ((*i)->getType() == 1 && (*j)->getType() == 1) {
-					if (_math->isCircleToCircleCollision((*i), pMat1, pScale1, (*j), pMat2, pScale2))
-						mCollision = 1;
+					const float *mBox2 = mEn2->_collisionBox;
+					if (mBox1[0] > mBox2[2] || mBox2[0] > mBox1[2] || mBox1[1] > mBox2[3] || mBox2[1] > mBox1[3]) continue;
+
+					// Entities sharing several cells are checked only in the first one
+					const int *mCells2 = mEn2->_collisionCells;
+					if (max(mCells1[0], mCells2[0]) != x || max(mCells1[1], mCells2[1]) != y) continue;
+
+					if (isCollisionPair(mEn1, mEn2, mGroup1, mGroup2, pCallback, pUserData))
+						mNumCollisions++;
 				}
 			}
 		}
 	}
 
-	return mCollision;
+	return mNumCollisions;
+}
+
+/**
+ * Adds to pResult the entities of a layer whose bounding areas may be inside a rectangle (the box
+ * enclosing all their bounding areas overlaps it). Returns the number of entities added.
+ * @param pLayer				Number of layer (0 - 63 layers allowed).
+ * @param pX1, pY1				Corner of the rectangle.
+ * @param pX2, pY2				Opposite corner of the rectangle.
+ * @param pResult				Vector where the entities found are added.
+ */
+int IND_Entity2dManager::queryRect(int pLayer, float pX1, float pY1, float pX2, float pY2, vector <IND_Entity2d *> &pResult) {
+	if (!_ok || pLayer < 0 || pLayer > NUM_LAYERS - 1) return 0;
+
+	updateBroadphase(pLayer);
+
+	SpatialHash2d *mHash = _broadphase[pLayer];
+	float mBox [4] = {min(pX1, pX2), min(pY1, pY2), max(pX1, pX2), max(pY1, pY2)};
+	int mCells [4] = {mHash->cellCoord(mBox[0]), mHash->cellCoord(mBox[1]), mHash->cellCoord(mBox[2]), mHash->cellCoord(mBox[3])};
+	size_t mFirst = pResult.size();
+
+	if (SpatialHash2d::isLarge(mCells[0], mCells[1], mCells[2], mCells[3])) {
+		// Rectangle too big for the grid: all entities are checked
+		vector <IND_Entity2d *> &mList = *_listEntities2d[pLayer];
+		for (size_t i = 0; i < mList.size(); i++) {
+			IND_Entity2d *mEn = mList[i];
+			if (!mEn || !mEn->_inBroadphase) continue;
+
+			const float *mBoxEn = mEn->_collisionBox;
+			if (mBox[0] > mBoxEn[2] || mBoxEn[0] > mBox[2] || mBox[1] > mBoxEn[3] || mBoxEn[1] > mBox[3]) continue;
+
+			pResult.push_back(mEn);
+		}
+		return static_cast<int>(pResult.size() - mFirst);
+	}
+
+	for (int y = mCells[1]; y <= mCells[3]; y++) {
+		for (int x = mCells[0]; x <= mCells[2]; x++) {
+			const vector <IND_Entity2d *> &mBucket = mHash->getBucket(x, y);
+			for (size_t i = 0; i < mBucket.size(); i++) {
+				IND_Entity2d *mEn = mBucket[i];
+				const float *mBoxEn = mEn->_collisionBox;
+				if (mBox[0] > mBoxEn[2] || mBoxEn[0] > mBox[2] || mBox[1] > mBoxEn[3] || mBoxEn[1] > mBox[3]) continue;
+
+				// Entities in several cells of the rectangle are added only from the first one
+				const int *mCellsEn = mEn->_collisionCells;
+				if (max(mCells[0], mCellsEn[0]) != x || max(mCells[1], mCellsEn[1]) != y) continue;
+
+				pResult.push_back(mEn);
+			}
+		}
+	}
+
+	const vector <IND_Entity2d *> &mLarge = mHash->getLarge();
+	for (size_t i = 0; i < mLarge.size(); i++) {
+		const float *mBoxEn = mLarge[i]->_collisionBox;
+		if (mBox[0] > mBoxEn[2] || mBoxEn[0] > mBox[2] || mBox[1] > mBoxEn[3] || mBoxEn[1] > mBox[3]) continue;
+
+		pResult.push_back(mLarge[i]);
+	}
+
+	return static_cast<int>(pResult.size() - mFirst);
+}
+
+/**
+ * Adds to pResult the entities of a layer having a bounding area (of any group) that contains a point.
+ * Returns the number of entities added.
+ * @param pLayer				Number of layer (0 - 63 layers allowed).
+ * @param pX, pY				Point, in world coordinates.
+ * @param pResult				Vector where the entities found are added.
+ */
+int IND_Entity2dManager::queryPoint(int pLayer, float pX, float pY, vector <IND_Entity2d *> &pResult) {
+	if (!_ok || pLayer < 0 || pLayer > NUM_LAYERS - 1) return 0;
+
+	// Candidates are the entities whose box contains the point
+	vector <IND_Entity2d *> mCandidates;
+	queryRect(pLayer, pX, pY, pX, pY, mCandidates);
+
+	size_t mFirst = pResult.size();
+
+	for (size_t i = 0; i < mCandidates.size(); i++) {
+		if (getWorldCollision(mCandidates[i])->isPointInside(pX, pY)) {
+			pResult.push_back(mCandidates[i]);
+		}
+	}
+
+	return static_cast<int>(pResult.size() - mFirst);
 }
 
 
+// --------------------------------------------------------------------------------
+//									 Private methods
+// --------------------------------------------------------------------------------
+
+/** @cond DOCUMENT_PRIVATEAPI */
+
 /*
 ==================
 Checks if the matrix has all its member equal to zero
@@ -773,11 +1217,977 @@ bool IND_Entity2dManager::isNullMatrix(IND_Matrix pMat) {
 
 /*
 ==================
-Inserts object into the manager in a certain layer
+Bounding areas of an entity: the ones of its surface, or the ones of the current frame of its animation
 ==================
 */
-void IND_Entity2dManager::addToList(int pLayer, IND_Entity2d *pNewEntity2d) {
-	_listEntities2d[pLayer]->push_back(pNewEntity2d);
+list <BOUNDING_COLLISION *> *IND_Entity2dManager::getBoundingList(IND_Entity2d *pEn) {
+	// Is a surface
+	if (pEn->_su) {
+		return pEn->_listBoundingCollision;
+	}
+
+	// Is an animation
+	if (pEn->_an) {
+		IND_Frame *mFrame = getAnimationFrame(pEn);
+		return mFrame ? mFrame->GetListBoundingCollision() : NULL;
+	}
+
+	return NULL;
+}
+
+
+/*
+==================
+Bounding areas of an entity in world coords. They are transformed again only if the entity has
+been transformed, or its bounding areas changed, since the last time
+==================
+*/
+CollisionCache2d *IND_Entity2dManager::getWorldCollision(IND_Entity2d *pEn) {
+	list <BOUNDING_COLLISION *> *mBoundingList = getBoundingList(pEn);
+	if (!mBoundingList) return NULL;
+
+	if (!pEn->_worldCollision) {
+		pEn->_worldCollision = new CollisionCache2d();
+	}
+
+	if (!pEn->_worldCollision->isValid(mBoundingList, pEn->_scaleX)) {
+		pEn->_worldCollision->build(mBoundingList, pEn->_mat, pEn->_scaleX, _math);
+	}
+
+	return pEn->_worldCollision;
+}
+
+
+/*
+==================
+Calculates the box (in world coords) enclosing all the bounding areas of an entity.
+Returns false if the entity has no bounding areas, or has never been placed
+==================
+*/
+bool IND_Entity2dManager::calculateCollisionBox(IND_Entity2d *pEn) {
+	CollisionCache2d *mWorld = getWorldCollision(pEn);
+	if (!mWorld || isNullMatrix(pEn->_mat)) return 0;
+
+	return mWorld->getBox(IND_COLLISION_GROUP_ANY, pEn->_collisionBox);
+}
+
+
+/*
+==================
+Calculates the box (in world coords) enclosing the surface of an entity, or the frame of its
+animation, as drawn
+==================
+*/
+void IND_Entity2dManager::calculateRenderBox(IND_Entity2d *pEn) {
+	pEn->_renderBoxDirty = 0;
+
+	float mX = 0.0f;
+	float mY = 0.0f;
+	float mWidth, mHeight;
+	if (pEn->_su) {
+		mWidth = static_cast<float>(pEn->_su->getWidth());
+		mHeight = static_cast<float>(pEn->_su->getHeight());
+	} else {
+		// Frames are moved by their offset (see blitAnimationFrame())
+		IND_Frame *mFrame = getAnimationFrame(pEn);
+		mX = static_cast<float>(mFrame->GetOffsetX());
+		mY = static_cast<float>(mFrame->GetOffsetY());
+		mWidth = static_cast<float>(mFrame->getSurface()->getWidth());
+		mHeight = static_cast<float>(mFrame->getSurface()->getHeight());
+	}
+
+	// Surface region specified (wrapping or not)
+	if (pEn->_regionWidth > 0 && pEn->_regionHeight > 0) {
+		mWidth = static_cast<float>(pEn->_regionWidth);
+		mHeight = static_cast<float>(pEn->_regionHeight);
+	}
+
+	IND_Vector2 mCorners [4] = {IND_Vector2(mX, mY), IND_Vector2(mX + mWidth, mY),
+	                            IND_Vector2(mX, mY + mHeight), IND_Vector2(mX + mWidth, mY + mHeight)};
+	for (int i = 0; i < 4; i++) {
+		_math->transformVector2DbyMatrix4D(mCorners[i], pEn->_mat);
+	}
+
+	pEn->_renderBox[0] = pEn->_renderBox[2] = mCorners[0]._x;
+	pEn->_renderBox[1] = pEn->_renderBox[3] = mCorners[0]._y;
+	for (int i = 1; i < 4; i++) {
+		pEn->_renderBox[0] = min(pEn->_renderBox[0], mCorners[i]._x);
+		pEn->_renderBox[1] = min(pEn->_renderBox[1], mCorners[i]._y);
+		pEn->_renderBox[2] = max(pEn->_renderBox[2], mCorners[i]._x);
+		pEn->_renderBox[3] = max(pEn->_renderBox[3], mCorners[i]._y);
+	}
+}
+
+
+/*
+==================
+Discards an entity out of the screen, using its box. Returns true if it must not be drawn.
+Animations are discarded by the box of the frame shown: their frames go on by the time passed, so
+they don't need to be drawn. Surfaces with a grid or rotated in the x or y axis are left to the
+render, as their blocks can go out of the box
+==================
+*/
+bool IND_Entity2dManager::cullEntity(IND_Entity2d *pEn) {
+	if (!hasRenderBox(pEn)) return 0;
+
+	return _render->cullBox2d(pEn->_renderBox[0], pEn->_renderBox[1], pEn->_renderBox[2], pEn->_renderBox[3]);
+}
+
+
+/*
+==================
+Calculates the box of an entity if needed. Returns false if it has no box (see cullEntity())
+==================
+*/
+bool IND_Entity2dManager::hasRenderBox(IND_Entity2d *pEn) {
+	IND_Surface *mSurface = pEn->_su;
+	if (!mSurface && pEn->_an) {
+		IND_Frame *mFrame = getAnimationFrame(pEn);
+		mSurface = mFrame ? mFrame->getSurface() : NULL;
+	}
+
+	if (!mSurface || mSurface->isHaveGrid()) return 0;
+	if (pEn->_angleX != 0.0f || pEn->_angleY != 0.0f) return 0;
+
+	if (pEn->_renderBoxDirty) {
+		calculateRenderBox(pEn);
+	}
+
+	return 1;
+}
+
+
+/*
+==================
+Calculates the world matrix of an entity which space attributes have been modified. The render state
+is not changed until the entity is known to be visible
+==================
+*/
+void IND_Entity2dManager::updateTransform(IND_Entity2d *pEn) {
+	calculateTransform(pEn);
+
+	// Bounding areas moved with it
+	setCollisionDirty(pEn);
+}
+
+
+/*
+==================
+Calculates the world matrix and marks the drawn box to be calculated again. It only changes the
+entity, so entities can be calculated on several threads
+==================
+*/
+void IND_Entity2dManager::calculateTransform(IND_Entity2d *pEn) {
+	pEn->_updateTransFlag = 0;
+
+	int mWidthTemp = 0;
+	int mHeightTemp = 0;
+
+	// ---- We obtain the width and height of the animation or the surface -----
+
+	if (pEn->_su) {
+		mWidthTemp  = pEn->_su->getWidth();
+		mHeightTemp = pEn->_su->getHeight();
+	} else {
+		IND_Frame *mFrame = getAnimationFrame(pEn);
+		if (mFrame && mFrame->getSurface()) {
+			mWidthTemp  = mFrame->getSurface()->getWidth();
+			mHeightTemp = mFrame->getSurface()->getHeight();
+		}
+	}
+
+	// ----- Transformations -----
+
+	_render->calculateTransform2d((int)pEn->_x,
+	                              (int)pEn->_y,
+	                              pEn->_angleX,
+	                              pEn->_angleY,
+	                              pEn->_angleZ,
+	                              pEn->_scaleX,
+	                              pEn->_scaleY,
+	                              pEn->_axisCalX,
+	                              pEn->_axisCalY,
+	                              pEn->_mirrorX,
+	                              pEn->_mirrorY,
+	                              mWidthTemp,
+	                              mHeightTemp,
+	                              pEn->_mat);
+
+	pEn->_renderBoxDirty = 1;
+}
+
+
+/*
+==================
+Runs tasks of the frame preparation on the pool of threads, or one after the other if there is no pool
+==================
+*/
+void IND_Entity2dManager::runTasks(int pNumTasks, void (*pTask)(void *pManager, int pTask)) {
+	if (_workers) {
+		_workers->run(pNumTasks, pTask, this);
+		return;
+	}
+
+	for (int i = 0; i < pNumTasks; i++) {
+		pTask(this, i);
+	}
+}
+
+
+/*
+==================
+First step of prepareEntities2d(), one layer each task: sorts the layer and chooses the entities to go
+through (only the ones near the screen in static layers). Layers only change their own lists
+==================
+*/
+void IND_Entity2dManager::prepareLayerTask(void *pManager, int pLayer) {
+	IND_Entity2dManager *mThis = static_cast<IND_Entity2dManager *>(pManager);
+
+	mThis->_layerPrepared[pLayer] = 0;
+	mThis->_prepareList[pLayer] = NULL;
+	if (mThis->_listEntities2d[pLayer]->empty()) return;
+
+	mThis->compactLayer(pLayer);
+	if (mThis->_layerUnsorted[pLayer]) {
+		mThis->sortLayer(pLayer);
+	}
+
+	vector <IND_Entity2d *> *mEntities = mThis->_listEntities2d[pLayer];
+	if (mThis->_layerStatic[pLayer] && mThis->queryRenderIndex(pLayer, mThis->_renderVisible[pLayer])) {
+		mEntities = &mThis->_renderVisible[pLayer];
+	}
+	mThis->_layerVisited[pLayer] = static_cast<int>(mEntities->size());
+	mThis->_prepareList[pLayer] = mEntities;
+}
+
+
+/*
+==================
+Second step of prepareEntities2d(), one chunk of a layer each task: transforms and culls the entities
+as renderEntities2d() does. Only the entities are changed; what is shared by the layer (collision
+broadphase, discarded objects) is left for the last step, so it is done in the same order
+==================
+*/
+void IND_Entity2dManager::prepareEntitiesTask(void *pManager, int pTask) {
+	IND_Entity2dManager *mThis = static_cast<IND_Entity2dManager *>(pManager);
+	const PREPARE_TASK &mTask = mThis->_prepareTasks[pTask];
+	vector <IND_Entity2d *> &mList = *mThis->_prepareList[mTask._layer];
+
+	for (int i = mTask._begin; i < mTask._end; i++) {
+		IND_Entity2d *mEn = mList[i];
+		mEn->_prepareCulled = 0;
+		mEn->_prepareCollisionDirty = 0;
+
+		if (!mEn->_show || (!mEn->_su && !mEn->_an)) continue;
+
+		if (mEn->_an) {
+			mThis->advanceAnimation(mEn, mThis->_prepareTicks);
+		}
+
+		if (mEn->_updateTransFlag) {
+			mThis->calculateTransform(mEn);
+			mEn->_prepareCollisionDirty = 1;
+		} else if (mEn->_an) {
+			mEn->_prepareCollisionDirty = 1;
+		}
+
+		if (mThis->hasRenderBox(mEn)) {
+			mEn->_prepareCulled = mThis->_render->isBox2dOut(mEn->_renderBox[0], mEn->_renderBox[1], mEn->_renderBox[2], mEn->_renderBox[3]);
+		}
+	}
+}
+
+
+/*
+==================
+Last step of prepareEntities2d(), one layer each task: marks the bounding areas moved and makes the
+list of entities to draw, in the order of the layer
+==================
+*/
+void IND_Entity2dManager::finishLayerTask(void *pManager, int pLayer) {
+	IND_Entity2dManager *mThis = static_cast<IND_Entity2dManager *>(pManager);
+	if (!mThis->_prepareList[pLayer]) return;
+
+	vector <IND_Entity2d *> &mList = *mThis->_prepareList[pLayer];
+	vector <IND_Entity2d *> &mDraw = mThis->_drawList[pLayer];
+
+	mDraw.clear();
+	mThis->_prepareDiscarded[pLayer] = 0;
+
+	for (size_t i = 0; i < mList.size(); i++) {
+		IND_Entity2d *mEn = mList[i];
+		if (mEn->_prepareCollisionDirty) {
+			mThis->setCollisionDirty(mEn);
+		}
+
+		if (mEn->_prepareCulled) {
+			mThis->_prepareDiscarded[pLayer]++;
+		} else {
+			mDraw.push_back(mEn);
+		}
+	}
+
+	mThis->_layerPrepared[pLayer] = 1;
+}
+
+
+/*
+==================
+Checks that the screen is the same that was used to prepare the layers
+==================
+*/
+bool IND_Entity2dManager::isPreparedView() {
+	float mView [4];
+	bool mViewOk = _render->getFrustumBox2d(mView);
+
+	if (mViewOk != _prepareViewOk) return 0;
+
+	return !mViewOk || !memcmp(mView, _prepareView, sizeof(mView));
+}
+
+
+/*
+==================
+Time of the clock of the animations, in milliseconds
+==================
+*/
+unsigned long IND_Entity2dManager::getAnimationTicks() {
+	if (_animationManual) {
+		return _animationTicks;
+	}
+
+	return static_cast<unsigned long>(_animationTimer->getTicks());
+}
+
+
+/*
+==================
+Moves the animation of an entity to the frame it has to show at the given time. All the frames whose
+time has passed are gone through at once (the animation doesn't slow down when it is drawn at a lower
+rate than its frames), looping or taking replays out as when it was drawn frame by frame.
+Only the entity changes: the animation is shared by all the entities playing it
+==================
+*/
+void IND_Entity2dManager::advanceAnimation(IND_Entity2d *pEn, unsigned long pTicks) {
+	IND_Animation *mAn = pEn->_an;
+	unsigned int mSequence = pEn->_sequence;
+	int mNumFrames = static_cast<int>(mAn->getNumFrames(mSequence));
+	if (!mNumFrames) return;
+
+	// First time drawn: the first frame starts now
+	if (!pEn->_animPlaying) {
+		pEn->_animPlaying = 1;
+		pEn->_animTicks = pTicks;
+		return;
+	}
+
+	pEn->_animElapsed += pTicks - pEn->_animTicks;
+	pEn->_animTicks = pTicks;
+
+	int mFrame = pEn->_animFrame;
+	unsigned long mFrameTime;
+	while (pEn->_animElapsed > (mFrameTime = mAn->getFrameTime(mSequence, pEn->_animFrame))) {
+		pEn->_animElapsed -= mFrameTime;
+		pEn->_animFrame++;
+
+		if (pEn->_animFrame < mNumFrames) continue;
+
+		// ----- End of the sequence -----
+
+		// No replays left: the last frame stays
+		if (!pEn->_numReplays) {
+			pEn->_animFrame = mNumFrames - 1;
+			pEn->_animElapsed = 0;
+			break;
+		}
+
+		if (pEn->_numReplays > 0) {
+			pEn->_numReplays--;
+		}
+		pEn->_animFrame = 0;
+
+		// Whole sequences passed: they are skipped at once, instead of frame by frame
+		unsigned long mSequenceTime = 0;
+		for (int i = 0; i < mNumFrames; i++) {
+			mSequenceTime += mAn->getFrameTime(mSequence, i);
+		}
+
+		if (!mSequenceTime) {
+			pEn->_animElapsed = 0;
+			break;
+		}
+
+		if (pEn->_animElapsed > mSequenceTime) {
+			unsigned long mTurns = (pEn->_animElapsed - 1) / mSequenceTime;
+
+			// Not looping: only the replays left
+			if (pEn->_numReplays >= 0) {
+				mTurns = min(mTurns, static_cast<unsigned long>(pEn->_numReplays));
+				pEn->_numReplays -= static_cast<int>(mTurns);
+			}
+			pEn->_animElapsed -= mTurns * mSequenceTime;
+		}
+	}
+
+	// Frames can have other sizes and bounding areas
+	if (pEn->_animFrame != mFrame) {
+		pEn->_updateTransFlag = 1;
+	}
+}
+
+
+/*
+==================
+Frame of the animation shown by an entity. Returns NULL if the sequence doesn't exist
+==================
+*/
+IND_Frame *IND_Entity2dManager::getAnimationFrame(IND_Entity2d *pEn) {
+	IND_Animation *mAn = pEn->_an;
+	if (pEn->_sequence >= mAn->getNumSequences() ||
+	        pEn->_animFrame >= static_cast<int>(mAn->getNumFrames(pEn->_sequence))) return NULL;
+
+	return (*mAn->getVectorFrames()) [mAn->getFramePosInVec(pEn->_sequence, pEn->_animFrame)];
+}
+
+
+/*
+==================
+Blits the frame shown by an animated entity, moved by the offset of the frame. Same as
+IND_Render::blitAnimation(), without changing the animation
+==================
+*/
+void IND_Entity2dManager::blitAnimationFrame(IND_Entity2d *pEn) {
+	IND_Frame *mFrame = getAnimationFrame(pEn);
+	if (!mFrame || !mFrame->getSurface()) return;
+
+	IND_Surface *mSurface = mFrame->getSurface();
+
+	// ----- Offset of the frame -----
+
+	IND_Matrix mOffset, mWorld;
+	_math->matrix4DSetTranslation(mOffset,
+	                              static_cast<float>(mFrame->GetOffsetX()),
+	                              static_cast<float>(mFrame->GetOffsetY()),
+	                              0.0f);
+	_math->matrix4DMultiply(pEn->_mat, mOffset, mWorld);
+	_render->setTransform2d(mWorld);
+
+	// ----- Blitting -----
+
+	// Blits all the surface
+	if (!pEn->_offX && !pEn->_offY && !pEn->_regionWidth && !pEn->_regionHeight) {
+		_render->blitSurface(mSurface);
+		return;
+	}
+
+	// Regions can only be blitted from surfaces of one texture
+	if (mSurface->getNumTextures() > 1) return;
+
+	if (pEn->_wrap) {
+		_render->blitWrapSurface(mSurface, pEn->_regionWidth, pEn->_regionHeight, pEn->_uDisplace, pEn->_vDisplace);
+	} else {
+		_render->blitRegionSurface(mSurface, pEn->_offX, pEn->_offY, pEn->_regionWidth, pEn->_regionHeight);
+	}
+}
+
+
+/*
+==================
+Marks an entity to be placed again in the render index of its layer before the next render (nothing
+to do while the layer is not static, or hasn't been rendered)
+==================
+*/
+void IND_Entity2dManager::setRenderDirty(IND_Entity2d *pEn) {
+	int mLayer = pEn->_slotLayer;
+	_layerPrepared[mLayer] = 0;
+
+	if (!_renderIndex[mLayer] || pEn->_renderIndexDirty) return;
+
+	pEn->_renderIndexDirty = 1;
+	_renderIndexDirty[mLayer].push_back(pEn);
+}
+
+
+/*
+==================
+Builds the render index of a static layer the first time, and places again the entities changed since
+the last time. Entities without a box are kept with the large ones, which are always gone through
+==================
+*/
+void IND_Entity2dManager::updateRenderIndex(int pLayer) {
+	if (!_renderIndex[pLayer]) {
+		vector <IND_Entity2d *> &mList = *_listEntities2d[pLayer];
+
+		_renderIndex[pLayer] = new SpatialHash2d();
+		_renderIndex[pLayer]->init(RENDER_INDEX_CELL_SIZE, max(MIN_BROADPHASE_BUCKETS, static_cast<int>(mList.size()) * 2));
+
+		for (size_t i = 0; i < mList.size(); i++) {
+			if (mList[i]) {
+				setRenderDirty(mList[i]);
+			}
+		}
+	}
+
+	SpatialHash2d *mHash = _renderIndex[pLayer];
+	vector <IND_Entity2d *> &mDirty = _renderIndexDirty[pLayer];
+
+	for (size_t i = 0; i < mDirty.size(); i++) {
+		IND_Entity2d *mEn = mDirty[i];
+		int *mCells = mEn->_renderCells;
+		int mOldCells [4] = {mCells[0], mCells[1], mCells[2], mCells[3]};
+		bool mWasIn = mEn->_inRenderIndex;
+
+		// The box needs the world matrix
+		if (mEn->_updateTransFlag && (mEn->_su || mEn->_an)) {
+			updateTransform(mEn);
+		}
+
+		// Frames of an animation can have other sizes: animations are kept in all the cells
+		if (!mEn->_an && hasRenderBox(mEn)) {
+			mCells[0] = mHash->cellCoord(mEn->_renderBox[0]);
+			mCells[1] = mHash->cellCoord(mEn->_renderBox[1]);
+			mCells[2] = mHash->cellCoord(mEn->_renderBox[2]);
+			mCells[3] = mHash->cellCoord(mEn->_renderBox[3]);
+		} else {
+			mCells[0] = mCells[1] = mCells[3] = 0;
+			mCells[2] = SPATIALHASH_MAX_CELLS_PER_AXIS;
+		}
+
+		mEn->_renderIndexDirty = 0;
+
+		// Still in the same cells
+		if (mWasIn && !memcmp(mOldCells, mCells, sizeof(mOldCells))) continue;
+
+		if (mWasIn) {
+			mHash->remove(mEn, mOldCells[0], mOldCells[1], mOldCells[2], mOldCells[3]);
+		}
+		mHash->insert(mEn, mCells[0], mCells[1], mCells[2], mCells[3]);
+		mEn->_inRenderIndex = 1;
+	}
+
+	mDirty.clear();
+}
+
+
+/*
+==================
+Entities of a static layer in the cells seen by the camera, in the order of the layer. Returns false
+if the layer must be gone through as usual: the screen can't be placed, or it covers more cells than
+entities in the layer
+==================
+*/
+bool IND_Entity2dManager::queryRenderIndex(int pLayer, vector <IND_Entity2d *> &pResult) {
+	float mView [4];
+	if (!_render->getFrustumBox2d(mView)) return 0;
+
+	// Cells are checked before updating the index, so a zoomed out camera doesn't build it at all
+	float mCellSize = _renderIndex[pLayer] ? _renderIndex[pLayer]->getCellSize() : RENDER_INDEX_CELL_SIZE;
+	int mCells [4];
+	for (int i = 0; i < 4; i++) {
+		mCells[i] = static_cast<int>(floorf(mView[i] / mCellSize));
+	}
+
+	double mNumCells = static_cast<double>(mCells[2] - mCells[0] + 1) * static_cast<double>(mCells[3] - mCells[1] + 1);
+	if (mNumCells > static_cast<double>(_listEntities2d[pLayer]->size())) return 0;
+
+	updateRenderIndex(pLayer);
+	SpatialHash2d *mHash = _renderIndex[pLayer];
+
+	pResult.clear();
+
+	// Entities of several cells, or sharing bucket, are found more than once
+	unsigned int mStamp = ++_renderStamp[pLayer];
+
+	const vector <IND_Entity2d *> &mLarge = mHash->getLarge();
+	for (size_t i = 0; i < mLarge.size(); i++) {
+		mLarge[i]->_renderStamp = mStamp;
+		pResult.push_back(mLarge[i]);
+	}
+
+	for (int y = mCells[1]; y <= mCells[3]; y++) {
+		for (int x = mCells[0]; x <= mCells[2]; x++) {
+			const vector <IND_Entity2d *> &mBucket = mHash->getBucket(x, y);
+			for (size_t i = 0; i < mBucket.size(); i++) {
+				IND_Entity2d *mEn = mBucket[i];
+				if (mEn->_renderStamp == mStamp) continue;
+				mEn->_renderStamp = mStamp;
+
+				// Entities of other cells in the same bucket
+				if (mEn->_renderBox[2] < mView[0] || mEn->_renderBox[0] > mView[2] ||
+				        mEn->_renderBox[3] < mView[1] || mEn->_renderBox[1] > mView[3]) continue;
+
+				pResult.push_back(mEn);
+			}
+		}
+	}
+
+	// Same order as in the layer (by z)
+	sort(pResult.begin(), pResult.end(), slotIsLess);
+
+	return 1;
+}
+
+
+/*
+==================
+Takes an entity out of the render index of its layer
+==================
+*/
+void IND_Entity2dManager::removeFromRenderIndex(IND_Entity2d *pEn) {
+	int mLayer = pEn->_slotLayer;
+
+	if (pEn->_inRenderIndex) {
+		const int *mCells = pEn->_renderCells;
+		_renderIndex[mLayer]->remove(pEn, mCells[0], mCells[1], mCells[2], mCells[3]);
+		pEn->_inRenderIndex = 0;
+	}
+
+	if (pEn->_renderIndexDirty) {
+		vector <IND_Entity2d *> &mDirty = _renderIndexDirty[mLayer];
+		vector <IND_Entity2d *>::iterator mIter = find(mDirty.begin(), mDirty.end(), pEn);
+		if (mIter != mDirty.end()) {
+			*mIter = mDirty.back();
+			mDirty.pop_back();
+		}
+		pEn->_renderIndexDirty = 0;
+	}
+}
+
+
+/*
+==================
+Frees the render index of a layer
+==================
+*/
+void IND_Entity2dManager::releaseRenderIndex(int pLayer) {
+	if (!_renderIndex[pLayer]) return;
+
+	vector <IND_Entity2d *> &mList = *_listEntities2d[pLayer];
+	for (size_t i = 0; i < mList.size(); i++) {
+		if (mList[i]) {
+			mList[i]->_inRenderIndex = 0;
+			mList[i]->_renderIndexDirty = 0;
+		}
+	}
+
+	_renderIndexDirty[pLayer].clear();
+	DISPOSE(_renderIndex[pLayer]);
+}
+
+
+/*
+==================
+For sorting entities of the same layer in the order of the layer
+==================
+*/
+bool IND_Entity2dManager::slotIsLess(IND_Entity2d *pLhs, IND_Entity2d *pRhs) {
+	return pLhs->_slot < pRhs->_slot;
+}
+
+
+/*
+==================
+Places the alpha mask of the surface (or current frame) of an entity, using its world matrix.
+Returns false if there is no mask, or the entity has never been placed
+==================
+*/
+bool IND_Entity2dManager::placeAlphaMask(IND_Entity2d *pEn, AlphaMaskPlacement &pPlacement) {
+	IND_Surface *mSurface = NULL;
+	if (pEn->_su) {
+		mSurface = pEn->_su;
+	} else if (pEn->_an && getAnimationFrame(pEn)) {
+		mSurface = getAnimationFrame(pEn)->getSurface();
+	}
+
+	if (!mSurface || !mSurface->_surface || !mSurface->_surface->_alphaMask || isNullMatrix(pEn->_mat)) return 0;
+	if (pEn->_wrap) return 0;
+
+	const AlphaMask *mMask = mSurface->_surface->_alphaMask;
+
+	// Surface region specified
+	if (pEn->_regionWidth > 0 && pEn->_regionHeight > 0) {
+		return pPlacement.place(mMask, pEn->_mat, pEn->_offX, pEn->_offY, pEn->_regionWidth, pEn->_regionHeight);
+	}
+
+	return pPlacement.place(mMask, pEn->_mat, 0, 0, mMask->getWidth(), mMask->getHeight());
+}
+
+
+/*
+==================
+Forgets the bounding areas of an entity in world coords, and marks it to be placed again in the
+broadphase of its layer before the next query (nothing to do while the layer hasn't been queried)
+==================
+*/
+void IND_Entity2dManager::setCollisionDirty(IND_Entity2d *pEn) {
+	if (pEn->_worldCollision) {
+		pEn->_worldCollision->invalidate();
+	}
+
+	int mLayer = pEn->_slotLayer;
+	if (!_broadphase[mLayer] || pEn->_broadphaseDirty) return;
+
+	pEn->_broadphaseDirty = 1;
+	_broadphaseDirty[mLayer].push_back(pEn);
+}
+
+
+/*
+==================
+Brings the broadphase of a layer up to date. It is created (with all the entities) the first time;
+after that, only entities whose transform or bounding areas changed are placed again, and only
+if they moved to other cells
+==================
+*/
+void IND_Entity2dManager::updateBroadphase(int pLayer) {
+	if (!_broadphase[pLayer]) {
+		vector <IND_Entity2d *> &mList = *_listEntities2d[pLayer];
+
+		_broadphase[pLayer] = new SpatialHash2d();
+		_broadphase[pLayer]->init(_broadphaseCellSize, max(MIN_BROADPHASE_BUCKETS, static_cast<int>(mList.size()) * 2));
+
+		for (size_t i = 0; i < mList.size(); i++) {
+			if (mList[i]) {
+				setCollisionDirty(mList[i]);
+			}
+		}
+	}
+
+	SpatialHash2d *mHash = _broadphase[pLayer];
+	vector <IND_Entity2d *> &mDirty = _broadphaseDirty[pLayer];
+
+	for (size_t i = 0; i < mDirty.size(); i++) {
+		IND_Entity2d *mEn = mDirty[i];
+		int *mCells = mEn->_collisionCells;
+		int mOldCells [4] = {mCells[0], mCells[1], mCells[2], mCells[3]};
+		bool mWasIn = mEn->_inBroadphase;
+
+		bool mIn = calculateCollisionBox(mEn);
+		if (mIn) {
+			mCells[0] = mHash->cellCoord(mEn->_collisionBox[0]);
+			mCells[1] = mHash->cellCoord(mEn->_collisionBox[1]);
+			mCells[2] = mHash->cellCoord(mEn->_collisionBox[2]);
+			mCells[3] = mHash->cellCoord(mEn->_collisionBox[3]);
+		}
+
+		// Still in the same cells
+		if (mWasIn && mIn && !memcmp(mOldCells, mCells, sizeof(mOldCells))) {
+			mEn->_broadphaseDirty = 0;
+			continue;
+		}
+
+		if (mWasIn) {
+			mHash->remove(mEn, mOldCells[0], mOldCells[1], mOldCells[2], mOldCells[3]);
+		}
+		if (mIn) {
+			mHash->insert(mEn, mCells[0], mCells[1], mCells[2], mCells[3]);
+		}
+
+		mEn->_inBroadphase = mIn;
+		mEn->_broadphaseDirty = 0;
+	}
+
+	mDirty.clear();
+}
+
+
+/*
+==================
+Takes an entity out of the broadphase of its layer
+==================
+*/
+void IND_Entity2dManager::removeFromBroadphase(IND_Entity2d *pEn) {
+	int mLayer = pEn->_slotLayer;
+
+	if (pEn->_inBroadphase) {
+		const int *mCells = pEn->_collisionCells;
+		_broadphase[mLayer]->remove(pEn, mCells[0], mCells[1], mCells[2], mCells[3]);
+		pEn->_inBroadphase = 0;
+	}
+
+	if (pEn->_broadphaseDirty) {
+		vector <IND_Entity2d *> &mDirty = _broadphaseDirty[mLayer];
+		vector <IND_Entity2d *>::iterator mIter = find(mDirty.begin(), mDirty.end(), pEn);
+		if (mIter != mDirty.end()) {
+			*mIter = mDirty.back();
+			mDirty.pop_back();
+		}
+		pEn->_broadphaseDirty = 0;
+	}
+}
+
+
+/*
+==================
+Deletes the broadphase of a layer. It will be built again if the layer is queried
+==================
+*/
+void IND_Entity2dManager::releaseBroadphase(int pLayer) {
+	if (!_broadphase[pLayer]) return;
+
+	vector <IND_Entity2d *> &mList = *_listEntities2d[pLayer];
+	for (size_t i = 0; i < mList.size(); i++) {
+		if (mList[i]) {
+			mList[i]->_inBroadphase = 0;
+			mList[i]->_broadphaseDirty = 0;
+		}
+	}
+
+	_broadphaseDirty[pLayer].clear();
+	DISPOSE(_broadphase[pLayer]);
+}
+
+
+/*
+==================
+Checks a pair of entities found by the broadphase, in both orders if groups differ
+==================
+*/
+bool IND_Entity2dManager::isCollisionPair(IND_Entity2d *pEn1, IND_Entity2d *pEn2, int pGroup1, int pGroup2,
+        IND_CollisionCallback pCallback, void *pUserData) {
+	if (isCollision(pEn1, pGroup1, pEn2, pGroup2)) {
+		if (pCallback) pCallback(pEn1, pEn2, pUserData);
+		return 1;
+	}
+
+	// The second entity may be the one with the first group
+	if (pGroup1 != pGroup2 && isCollision(pEn2, pGroup1, pEn1, pGroup2)) {
+		if (pCallback) pCallback(pEn2, pEn1, pUserData);
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/*
+==================
+Inserts object into the manager in a certain layer
+==================
+*/
+void IND_Entity2dManager::addToList(int pLayer, IND_Entity2d *pNewEntity2d) {
+	// The layer stays sorted unless the new entity is below the last one
+	if (!_listEntities2d[pLayer]->empty() && zIsLess(pNewEntity2d, _listEntities2d[pLayer]->back())) {
+		_layerUnsorted[pLayer] = true;
+	}
+
+	_listEntities2d[pLayer]->push_back(pNewEntity2d);
+	pNewEntity2d->_manager = this;
+	pNewEntity2d->_slotLayer = pLayer;
+	pNewEntity2d->_slot = static_cast<int>(_listEntities2d[pLayer]->size()) - 1;
+	pNewEntity2d->_renderStamp = 0;
+
+	setCollisionDirty(pNewEntity2d);
+	setRenderDirty(pNewEntity2d);
+}
+
+
+/*
+==================
+Takes an entity out of the manager, in constant time. Its slot is left empty (so the order of the
+rest doesn't change) and the layer is compacted later, before going through it. Empty slots at the
+end of the layer are dropped right away, so the last slot always holds an entity
+==================
+*/
+void IND_Entity2dManager::removeFromList(IND_Entity2d *pEn) {
+	vector <IND_Entity2d *> &mList = *_listEntities2d[pEn->_slotLayer];
+	int mLayer = pEn->_slotLayer;
+
+	removeFromBroadphase(pEn);
+	removeFromRenderIndex(pEn);
+	_layerPrepared[mLayer] = 0;
+
+	if (pEn->_slot == static_cast<int>(mList.size()) - 1) {
+		mList.pop_back();
+		while (!mList.empty() && !mList.back()) {
+			mList.pop_back();
+			_layerHoles[mLayer]--;
+		}
+	} else {
+		mList[pEn->_slot] = NULL;
+		_layerHoles[mLayer]++;
+	}
+
+	pEn->_manager = NULL;
+	pEn->_slot = -1;
+}
+
+
+/*
+==================
+Removes the empty slots of a layer, keeping the order of the entities
+==================
+*/
+void IND_Entity2dManager::compactLayer(int pLayer) {
+	if (!_layerHoles[pLayer]) {
+		return;
+	}
+
+	vector <IND_Entity2d *> &mList = *_listEntities2d[pLayer];
+	size_t mTo = 0;
+	for (size_t i = 0; i < mList.size(); i++) {
+		if (mList[i]) {
+			mList[mTo] = mList[i];
+			mList[mTo]->_slot = static_cast<int>(mTo);
+			mTo++;
+		}
+	}
+	mList.resize(mTo);
+
+	_layerHoles[pLayer] = 0;
+}
+
+
+/*
+==================
+Marks a layer to be sorted before rendering it (an entity of the layer changed its z)
+==================
+*/
+void IND_Entity2dManager::setLayerUnsorted(int pLayer) {
+	if (pLayer >= 0 && pLayer < NUM_LAYERS) {
+		_layerUnsorted[pLayer] = true;
+	}
+}
+
+
+/*
+==================
+Sorts a layer by z. Entities with the same z keep the order they had (the order in which they
+were added, if they never moved). Usually only a few entities changed their z since the last
+sort, so insertion sort does it in almost linear time; if many did, a stable merge sort is used
+==================
+*/
+void IND_Entity2dManager::sortLayer(int pLayer) {
+	vector <IND_Entity2d *> &mList = *_listEntities2d[pLayer];
+
+	// Count the places where the order breaks
+	int mDescents = 0;
+	for (size_t i = 1; i < mList.size() && mDescents <= MAX_INSERTION_SORT_DESCENTS; i++) {
+		if (zIsLess(mList[i], mList[i - 1]))
+			mDescents++;
+	}
+
+	if (mDescents > MAX_INSERTION_SORT_DESCENTS) {
+		stable_sort(mList.begin(), mList.end(), zIsLess);
+	} else {
+		for (size_t i = 1; i < mList.size(); i++) {
+			IND_Entity2d *mEntity = mList[i];
+			size_t j = i;
+			// Strict comparison: never moves an entity past another one with the same z
+			while (j > 0 && zIsLess(mEntity, mList[j - 1])) {
+				mList[j] = mList[j - 1];
+				j--;
+			}
+			mList[j] = mEntity;
+		}
+	}
+
+	// Entities changed their place
+	for (size_t i = 0; i < mList.size(); i++) {
+		mList[i]->_slot = static_cast<int>(i);
+	}
+
+	_layerUnsorted[pLayer] = false;
 }
 
 
@@ -799,8 +2209,19 @@ Init manager vars
 ==================
 */
 void IND_Entity2dManager::initVars() {
-	for (int i = 0; i < NUM_LAYERS; i++)
+	for (int i = 0; i < NUM_LAYERS; i++) {
 		_listEntities2d [i] = new vector <IND_Entity2d *>;
+		_layerUnsorted [i] = false;
+		_layerHoles [i] = 0;
+		_broadphase [i] = NULL;
+		_layerStatic [i] = false;
+		_renderIndex [i] = NULL;
+		_layerVisited [i] = 0;
+		_renderStamp [i] = 0;
+		_layerPrepared [i] = false;
+		_prepareList [i] = NULL;
+		_prepareDiscarded [i] = 0;
+	}
 }
 
 
@@ -814,6 +2235,10 @@ void IND_Entity2dManager::freeVars() {
 	vector <IND_Entity2d *>::iterator mEntityListIter;
 
 	for (int i = 0; i < NUM_LAYERS; i++) {
+		releaseBroadphase(i);
+		releaseRenderIndex(i);
+		compactLayer(i);
+
 		for (mEntityListIter  = _listEntities2d[i]->begin();
 		        mEntityListIter != _listEntities2d[i]->end();
 		        mEntityListIter++) {
@@ -40,6 +40,7 @@
 #include "IND_Image.h"
 #include "IND_ImageManager.h"
 #include "IND_Math.h"
+#include <algorithm>
 
 // --------------------------------------------------------------------------------
 //							  Initialization / Destruction
@@ -424,6 +425,8 @@ bool IND_FontManager::parseMudFont(IND_Font *pNewFont,const char *pFontName) {
 	mXmlDoc->Clear();
 	delete mXmlDoc;
 
+	buildLookupTables(pNewFont);
+
 	return 1;
 }
 
@@ -796,10 +799,39 @@ bool IND_FontManager::parseAngelCodeFont(IND_Font *pNewFont,const char *pFileNam
     
 	mXmlDoc->Clear();
 	delete mXmlDoc;
+
+	buildLookupTables(pNewFont);
     
 	return 1;
 }
 
+/*
+==================
+Builds the tables used to find a letter, and the kerning of two letters, without searching the arrays
+==================
+*/
+void IND_FontManager::buildLookupTables(IND_Font *pNewFont) {
+	// Letters: when a character is declared twice, the first one is used
+	memset(pNewFont->_font._letterIndex, -1, sizeof(pNewFont->_font._letterIndex));
+	for (int i = pNewFont->getNumChars() - 1; i >= 0; i--) {
+		pNewFont->_font._letterIndex[pNewFont->getLetters() [i]._letter] = i;
+	}
+
+	// Kernings: sorted by first and second character, each first character owns a range of the array
+	int mNumKernings = pNewFont->getNumKernings();
+	if (pNewFont->getKernings()) {
+		sort(pNewFont->getKernings(), pNewFont->getKernings() + mNumKernings, IND_Font::kerningIsLess);
+	} else {
+		mNumKernings = 0;
+	}
+
+	int mPos = 0;
+	for (int i = 0; i <= 256; i++) {
+		while (mPos < mNumKernings && pNewFont->getKernings() [mPos]._first < i) mPos++;
+		pNewFont->_font._kerningIndex[i] = mPos;
+	}
+}
+
 
 
 /*
@@ -1357,6 +1357,10 @@ int  IND_Render::getMaxTextureSize()      {
 	return _wrappedRenderer->getMaxTextureSize();
 }
 
+bool IND_Render::isNPOTTextureSupported()      {
+	return _wrappedRenderer->isNPOTTextureSupported();
+}
+
 void IND_Render::getFpsString(char *pBuffer)     {
 	IND_Math::itoa(_lastFps, pBuffer);
 }
@@ -1390,6 +1394,54 @@ void IND_Render::resetNumDiscardedObjects()      {
 	_wrappedRenderer->resetNumDiscardedObjects();
 }
 
+void IND_Render::setSpriteBatching(bool pSwitch)      {
+	_wrappedRenderer->setSpriteBatching(pSwitch);
+}
+
+bool IND_Render::isSpriteBatching()      {
+	return _wrappedRenderer->isSpriteBatching();
+}
+
+void IND_Render::setInstancing(bool pSwitch)      {
+	_wrappedRenderer->setInstancing(pSwitch);
+}
+
+bool IND_Render::isInstancing()      {
+	return _wrappedRenderer->isInstancing();
+}
+
+bool IND_Render::isInstancingSupported()      {
+	return _wrappedRenderer->isInstancingSupported();
+}
+
+void IND_Render::setDistanceField(bool pSwitch)      {
+	_wrappedRenderer->setDistanceField(pSwitch);
+}
+
+bool IND_Render::isDistanceFieldSupported()      {
+	return _wrappedRenderer->isDistanceFieldSupported();
+}
+
+void IND_Render::getNumIssuedStateChangesString(char* pBuffer)      {
+	_wrappedRenderer->getNumIssuedStateChangesString(pBuffer);
+}
+
+void IND_Render::getNumSkippedStateChangesString(char* pBuffer)      {
+	_wrappedRenderer->getNumSkippedStateChangesString(pBuffer);
+}
+
+int IND_Render::getNumIssuedStateChangesInt()      {
+	return _wrappedRenderer->getNumIssuedStateChangesInt();
+}
+
+int IND_Render::getNumSkippedStateChangesInt()      {
+	return _wrappedRenderer->getNumSkippedStateChangesInt();
+}
+
+void IND_Render::resetNumStateChanges()      {
+	_wrappedRenderer->resetNumStateChanges();
+}
+
 // --------------------------------------------------------------------------------
 //							        Private methods
 // --------------------------------------------------------------------------------
@@ -1448,6 +1500,136 @@ void IND_Render::reCalculateFrustrumPlanes() {
 }
 
 
+/*
+==================
+Checks a box (in world coords) against the frustum planes of the underlying renderer. Returns true
+if it is out of the screen; then it is counted as a discarded object
+==================
+*/
+bool IND_Render::cullBox2d(float pX1, float pY1, float pX2, float pY2) {
+	return _wrappedRenderer->cullBox2d(pX1, pY1, pX2, pY2);
+}
+
+
+/*
+==================
+Same check as cullBox2d(), without counting the box as discarded. Safe to call from worker threads
+while the frustum planes are not recalculated
+==================
+*/
+bool IND_Render::isBox2dOut(float pX1, float pY1, float pX2, float pY2) {
+	return _wrappedRenderer->isBox2dOut(pX1, pY1, pX2, pY2);
+}
+
+
+/*
+==================
+Counts objects discarded out of the render (see isBox2dOut())
+==================
+*/
+void IND_Render::addNumDiscardedObjects(int pNum) {
+	_wrappedRenderer->addNumDiscardedObjects(pNum);
+}
+
+
+/*
+==================
+Box of the screen in world coords (x1, y1, x2, y2), from the frustum planes of the underlying renderer
+==================
+*/
+bool IND_Render::getFrustumBox2d(float *pBox) {
+	return _wrappedRenderer->getFrustumBox2d(pBox);
+}
+
+
+/*
+==================
+Calculates the same matrix as setTransform2d(), without applying it
+==================
+*/
+void IND_Render::calculateTransform2d(int pX,
+                                      int pY,
+                                      float pAngleX,
+                                      float pAngleY,
+                                      float pAngleZ,
+                                      float pScaleX,
+                                      float pScaleY,
+                                      int pAxisCalX,
+                                      int pAxisCalY,
+                                      bool pMirrorX,
+                                      bool pMirrorY,
+                                      int pWidth,
+                                      int pHeight,
+                                      IND_Matrix &pMatrix) {
+	_wrappedRenderer->calculateTransform2d(pX, pY, pAngleX, pAngleY, pAngleZ, pScaleX, pScaleY, pAxisCalX, pAxisCalY, pMirrorX, pMirrorY, pWidth, pHeight, pMatrix);
+}
+
+
+/*
+==================
+Draws quads pending in the sprite batch of the underlying renderer
+==================
+*/
+void IND_Render::flushSpriteBatch() {
+	_wrappedRenderer->flushSpriteBatch();
+}
+
+
+/*
+==================
+Lays out a text into quads of letters (positions in the coordinates of the text and mapping coords), the
+same way blitText() draws it. Returns false if the underlying renderer can't draw text geometry
+==================
+*/
+bool IND_Render::buildTextGeometry(IND_Font *pFo,
+                                   char *pText,
+                                   int pOffset,
+                                   int pLineSpacing,
+                                   float pScaleX,
+                                   float pScaleY,
+                                   IND_Align pAlign,
+                                   std::vector<CUSTOMVERTEX2D> &pVertices) {
+	return _wrappedRenderer->buildTextGeometry(pFo, pText, pOffset, pLineSpacing, pScaleX, pScaleY, pAlign, pVertices);
+}
+
+
+/*
+==================
+Draws a text laid out with buildTextGeometry()
+==================
+*/
+void IND_Render::blitTextGeometry(IND_Font *pFo,
+                                  std::vector<CUSTOMVERTEX2D> &pVertices,
+                                  int pX,
+                                  int pY,
+                                  float pScaleX,
+                                  float pScaleY,
+                                  unsigned char pR,
+                                  unsigned char pG,
+                                  unsigned char pB,
+                                  unsigned char pA,
+                                  unsigned char pFadeR,
+                                  unsigned char pFadeG,
+                                  unsigned char pFadeB,
+                                  unsigned char pFadeA,
+                                  IND_Filter pLinearFilter,
+                                  IND_BlendingType pSo,
+                                  IND_BlendingType pDs) {
+	_wrappedRenderer->blitTextGeometry(pFo, pVertices, pX, pY, pScaleX, pScaleY, pR, pG, pB, pA,
+	                                   pFadeR, pFadeG, pFadeB, pFadeA, pLinearFilter, pSo, pDs);
+}
+
+
+/*
+==================
+Drops render state cached for textures which have just been created
+==================
+*/
+void IND_Render::forgetTextureState(unsigned int *pTextures, int pNumTextures) {
+	_wrappedRenderer->forgetTextureState(pTextures, pNumTextures);
+}
+
+
 /*
 ==================
 Calculates 6 planes defining the frustum
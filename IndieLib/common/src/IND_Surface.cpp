@@ -178,6 +178,20 @@ bool IND_Surface::isHaveGrid() {
 	return _surface->_attributes._isHaveGrid;
 }
 
+/**
+ * Returns 1 if the surface shares an atlas texture with other surfaces. See IND_SurfaceManager::setAtlasing().
+ */
+bool IND_Surface::isAtlased() {
+	return _surface->_attributes._isAtlased;
+}
+
+/**
+ * Returns 1 if the surface has an alpha mask for pixel collisions. See IND_SurfaceManager::setAlphaMasks().
+ */
+bool IND_Surface::isHaveAlphaMask() {
+	return _surface && _surface->_alphaMask;
+}
+
 /**
  * Returns the type of surface in a string.
  */
@@ -601,7 +615,10 @@ void IND_Surface::freeTextureData() {
         }//LOOP END
 #endif
 #ifdef INDIERENDER_OPENGL
-		glDeleteTextures(numTextures,_surface->_texturesArray);
+		//Atlas pages are owned by the texture builder
+		if (!_surface->_attributes._isAtlased) {
+			glDeleteTextures(numTextures,_surface->_texturesArray);
+		}
 #endif
 	}
 
@@ -626,11 +643,13 @@ void IND_Surface::pushVertex(CUSTOMVERTEX2D *pVertices,
                              float pU,
                              float pV) {
 
+	// Mapping coords are relative to the image, which can be a sub-rectangle of the texture (atlas)
+	const ATTRIBUTES &mAttributes = _surface->_attributes;
 	pVertices [pPosVert]._x = (float) pVx;
 	pVertices [pPosVert]._y = (float) pVy;
 	pVertices [pPosVert]._z = (float) pVz;
-	pVertices [pPosVert]._u = pU;
-	pVertices [pPosVert]._v = pV;
+	pVertices [pPosVert]._u = mAttributes._u0 + pU * (mAttributes._u1 - mAttributes._u0);
+	pVertices [pPosVert]._v = mAttributes._v0 + pV * (mAttributes._v1 - mAttributes._v0);
 
 	pVertices [pPosVert]._x = (float) pVx;
 	pVertices [pPosVert]._y = (float) pVy;
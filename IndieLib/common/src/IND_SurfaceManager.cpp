@@ -421,10 +421,20 @@ bool IND_SurfaceManager::clone(IND_Surface *pNewSurface, IND_Surface *pSurfaceTo
 	pNewSurface->_surface->_attributes._heightBlock = pSurfaceToClone->_surface->_attributes._heightBlock;
 	pNewSurface->_surface->_attributes._isHaveSurface = pSurfaceToClone->_surface->_attributes._isHaveSurface;
 	pNewSurface->_surface->_attributes._isHaveGrid = pSurfaceToClone->_surface->_attributes._isHaveGrid;
+	pNewSurface->_surface->_attributes._isAtlased = pSurfaceToClone->_surface->_attributes._isAtlased;
+	pNewSurface->_surface->_attributes._u0 = pSurfaceToClone->_surface->_attributes._u0;
+	pNewSurface->_surface->_attributes._v0 = pSurfaceToClone->_surface->_attributes._v0;
+	pNewSurface->_surface->_attributes._u1 = pSurfaceToClone->_surface->_attributes._u1;
+	pNewSurface->_surface->_attributes._v1 = pSurfaceToClone->_surface->_attributes._v1;
 
 	// Reference to texture
 	pNewSurface->_surface->_texturesArray =  pSurfaceToClone->_surface->_texturesArray;
 
+	// Copy alpha mask
+	if (pSurfaceToClone->_surface->_alphaMask) {
+		pNewSurface->_surface->_alphaMask = new AlphaMask(*pSurfaceToClone->_surface->_alphaMask);
+	}
+
 	// Copy vertex data
 	int _numVertices = pSurfaceToClone->getBlocksX() * pSurfaceToClone->getBlocksY() * 4;
 	pNewSurface->_surface->_vertexArray = new CUSTOMVERTEX2D [_numVertices];
@@ -472,6 +482,12 @@ bool IND_SurfaceManager::remove(IND_Surface *pSu) {
 
 	// ----- Free object -----
 
+	// Pending sprite batches could still reference its textures
+	_render->flushSpriteBatch();
+
+	// Atlas page could be freed when no other surface uses it
+	_textureBuilder->releaseTexture(pSu);
+
 	// Quit from list
 	delFromlist(pSu);
 
@@ -481,6 +497,169 @@ bool IND_SurfaceManager::remove(IND_Surface *pSu) {
 }
 
 
+/**
+@b parameters:
+
+@arg @b pSu             Pointer to a surface object of the manager
+@arg @b pImage          Image the surface was created from, changed after that
+@arg <b>pX, pY</b>      Upper-left corner of the changed area, in pixels from the upper-left corner of the image
+@arg <b>pWidth, pHeight</b> Size of the changed area
+
+@b Operation:
+
+This function returns 1 (true) if the texture of the surface is updated with the changed area of the image.
+The image must have the same size and format as when the surface was created. This is faster than creating
+the surface again when only a small part of a big image changes, for example when glyphs are added to
+a font page.
+
+Only the OpenGL renderer updates the area alone, and only for surfaces using one texture. Otherwise the
+whole texture is created again from the image.
+*/
+bool IND_SurfaceManager::update(IND_Surface *pSu, IND_Image *pImage, int pX, int pY, int pWidth, int pHeight) {
+	if (!_ok || !pSu || !pSu->_surface || !pImage) {
+		writeMessage();
+		return false;
+	}
+
+	// Pending sprite batches could still use the old texels
+	_render->flushSpriteBatch();
+
+	if (!_textureBuilder->updateTexture(pSu, pImage, pX, pY, pWidth, pHeight)) {
+		if (!_textureBuilder->createNewTexture(pSu, pImage, 0, 0)) {
+			return false;
+		}
+	}
+
+	// Alpha mask follows the new pixels
+	if (pSu->_surface->_alphaMask) {
+		if (!pSu->_surface->_alphaMask->build(pImage->getPointer(), pImage->getWidth(), pImage->getHeight(), _alphaMaskThreshold)) {
+			DISPOSE(pSu->_surface->_alphaMask);
+		}
+	}
+
+	return true;
+}
+
+
+/**
+@b parameters:
+
+@arg @b pSwitch         True = pack small surfaces into shared textures, false = one texture set per surface
+@arg @b pPageSize       Width and height, in pixels, of each shared texture (atlas page)
+
+@b Operation:
+
+This function enables or disables atlas packing for the surfaces added afterwards. Surfaces already
+created are not changed. Atlasing is disabled by default.
+
+When enabled, surfaces added without specifying a block size, and not bigger than half of the page
+size in each dimension, are placed in a shared texture (atlas page) together with other surfaces
+with the same color format. Bigger surfaces are cut in blocks as usual. This way, lots of small
+sprites, animation frames or fonts can be drawn without texture changes, and they can be batched together
+(see IND_Render::setSpriteBatching()).
+
+An atlased surface (see IND_Surface::isAtlased()) can be blitted normally, by regions, or as
+part of animations and fonts. It can't be used for wrapping blits (IND_Entity2d::toggleWrap()), as
+texture repetition is not possible in a sub-rectangle of a texture.
+
+The page size is limited to the maximum texture size of the hardware. Only the OpenGL renderer
+supports atlasing currently.
+*/
+void IND_SurfaceManager::setAtlasing(bool pSwitch, int pPageSize) {
+	if (!_ok) {
+		writeMessage();
+		return;
+	}
+
+	_textureBuilder->setAtlasing(pSwitch, pPageSize);
+}
+
+/**
+@b Operation:
+
+This function returns 1 (true) if new small surfaces are packed into shared textures. See IND_SurfaceManager::setAtlasing().
+*/
+bool IND_SurfaceManager::isAtlasing() {
+	if (!_ok) {
+		return false;
+	}
+
+	return _textureBuilder->isAtlasing();
+}
+
+/**
+@b Operation:
+
+This function returns the number of shared textures (atlas pages) in use.
+*/
+int IND_SurfaceManager::getNumAtlasPages() {
+	if (!_ok) {
+		return 0;
+	}
+
+	return _textureBuilder->getNumAtlasPages();
+}
+
+/**
+@b parameters:
+
+@arg @b pPage           Index of the atlas page, from 0 to IND_SurfaceManager::getNumAtlasPages() - 1
+
+@b Operation:
+
+This function returns the proportion (0.0f - 1.0f) of the page area used by surfaces. Area of removed surfaces
+is not reused, so the page is only freed when all of them are removed.
+*/
+float IND_SurfaceManager::getAtlasPageOccupancy(int pPage) {
+	if (!_ok) {
+		return 0.0f;
+	}
+
+	return _textureBuilder->getAtlasPageOccupancy(pPage);
+}
+
+/**
+@b parameters:
+
+@arg @b pSwitch         True = build an alpha mask for each new surface, false = no masks
+@arg @b pThreshold      Minimum alpha (0-255) of a pixel to be solid in the mask
+
+@b Operation:
+
+This function enables or disables the creation of alpha masks for the surfaces added afterwards.
+Surfaces already created are not changed. Alpha masks are disabled by default.
+
+An alpha mask keeps one bit per pixel, set when the alpha of the pixel is at least pThreshold. Only
+surfaces of type ::IND_ALPHA get a mask. Masks are used by IND_Entity2dManager::isPixelCollision(),
+for checking collisions of the visible pixels. As animation frames are surfaces too, animations
+loaded while the masks are enabled get one mask per frame.
+
+Each mask takes width * height / 8 bytes of memory, apart from the textures.
+*/
+void IND_SurfaceManager::setAlphaMasks(bool pSwitch, int pThreshold) {
+	if (!_ok) {
+		writeMessage();
+		return;
+	}
+
+	_alphaMasks = pSwitch;
+	_alphaMaskThreshold = pThreshold;
+}
+
+/**
+@b Operation:
+
+This function returns 1 (true) if new surfaces get an alpha mask. See IND_SurfaceManager::setAlphaMasks().
+*/
+bool IND_SurfaceManager::isAlphaMasks() {
+	if (!_ok) {
+		return false;
+	}
+
+	return _alphaMasks;
+}
+
+
 // --------------------------------------------------------------------------------
 //										Private methods
 // --------------------------------------------------------------------------------
@@ -516,6 +695,15 @@ bool IND_SurfaceManager::addMain(IND_Surface    *pNewSurface,
 	}
 	assert(pNewSurface);
 
+	// Alpha mask for pixel collisions
+	if (_alphaMasks && pType == IND_ALPHA && pNewSurface->_surface && pImage->getBytespp() == 4) {
+		DISPOSE(pNewSurface->_surface->_alphaMask);
+		pNewSurface->_surface->_alphaMask = new AlphaMask();
+		if (!pNewSurface->_surface->_alphaMask->build(pImage->getPointer(), pImage->getWidth(), pImage->getHeight(), _alphaMaskThreshold)) {
+			DISPOSE(pNewSurface->_surface->_alphaMask);
+		}
+	}
+
 	// ----- Puts the object into the manager  -----
 
 	addToList(pNewSurface);
@@ -704,6 +892,8 @@ Init manager vars
 */
 void IND_SurfaceManager::initVars() {
 	_listSurfaces = new list <IND_Surface *>;
+	_alphaMasks = false;
+	_alphaMaskThreshold = 128;
 }
 
 
@@ -34,23 +34,244 @@
 #include "IND_TTF_Font.h"
 //#include "IND_TTF_FontManager.h"
 #include "FreeTypeHandle.h"
+#include "dependencies/SDL-2.0/include/SDL.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <vector>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_OUTLINE_H
 
 
+// glyph rasterized by FreeType, ready to be copied to an atlas page
+struct raster_glyph {
+	wchar_t					charCode;               // unicode char value
+	FT_UInt					glyphIndex;             // glyph index in the font face
+	int						advance;                // advance value, in 1/64 pixels
+	int						leftBearing;            // left bearing of the glyph
+	int						topBearing;             // top bearing of the glyph
+	int						width;                  // glyph size
+	int						height;
+	std::vector<unsigned char> alpha;               // width * height coverage values, upper row first
+};
+
+
 class free_type_impl {
 public:
     FT_Library				_FTLib;                 // freetype lib
 	FT_Face					_Face;                  // THIS font face
     FT_Matrix				_matItalic;             // transformation matrix for italic
 
+	// background rasterization. FreeType objects can't be shared between threads,
+	// so the worker has its own library and face
+	FT_Library				_workerLib;
+	FT_Face					_workerFace;
+	bool					_workerBold;
+	bool					_workerItalic;
+	int						_workerSpread;          // distance field spread, 0 for bitmap glyphs
+	SDL_Thread				*_workerThread;
+	SDL_mutex				*_workerMutex;          // guards the rest of members
+	SDL_cond				*_workerWake;           // new chars, or end of the thread
+	bool					_workerQuit;
+	int						_workerBusy;            // chars being rasterized
+	std::deque<wchar_t>		_workerPending;         // chars waiting for the worker
+	std::deque<raster_glyph*> _workerDone;          // glyphs waiting for the render thread
+
 public:
     friend class IND_TTF_Font;
 };
 
 
+// squared distance to the nearest seed along a row or column of n values (0 for seeds, a big value
+// for the rest). Lower envelope of parabolas, from Felzenszwalb and Huttenlocher
+static void distanceTransform1d(const float *f, float *d, int n, int *v, float *z) {
+	int k = 0;
+	v[0] = 0;
+	z[0] = -1e20f;
+	z[1] = 1e20f;
+
+	for (int q = 1; q < n; q++) {
+		float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+		while (s <= z[k]) {
+			k--;
+			s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+		}
+		k++;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = 1e20f;
+	}
+
+	k = 0;
+	for (int q = 0; q < n; q++) {
+		while (z[k + 1] < q)
+			k++;
+		float dq = (float)(q - v[k]);
+		d[q] = dq * dq + f[v[k]];
+	}
+}
+
+
+// squared distance from every pixel to the nearest seed: columns first, then rows
+static void distanceTransform2d(std::vector<float> &grid, int iWidth, int iHeight) {
+	int n = (std::max)(iWidth, iHeight);
+	std::vector<float> f(n), d(n), z(n + 1);
+	std::vector<int> v(n);
+
+	for (int x = 0; x < iWidth; x++) {
+		for (int y = 0; y < iHeight; y++)
+			f[y] = grid[y * iWidth + x];
+		distanceTransform1d(&f[0], &d[0], iHeight, &v[0], &z[0]);
+		for (int y = 0; y < iHeight; y++)
+			grid[y * iWidth + x] = d[y];
+	}
+
+	for (int y = 0; y < iHeight; y++) {
+		std::copy(grid.begin() + y * iWidth, grid.begin() + (y + 1) * iWidth, f.begin());
+		distanceTransform1d(&f[0], &grid[y * iWidth], iWidth, &v[0], &z[0]);
+	}
+}
+
+
+// turn the coverage of a glyph into a signed distance field with iSpread pixels of margin. The edge
+// is at alpha 128, and alpha reaches 0 outside (255 inside) iSpread pixels away from it
+static void buildDistanceField(raster_glyph &glyph, int iSpread) {
+	int iWidth = glyph.width + 2 * iSpread;
+	int iHeight = glyph.height + 2 * iSpread;
+
+	// distances to the nearest inside pixel, and to the nearest outside one
+	std::vector<float> outside(iWidth * iHeight), inside(iWidth * iHeight);
+	for (int y = 0; y < iHeight; y++) {
+		for (int x = 0; x < iWidth; x++) {
+			int gx = x - iSpread;
+			int gy = y - iSpread;
+			bool bInside =	gx >= 0 && gx < glyph.width && gy >= 0 && gy < glyph.height &&
+							glyph.alpha[gy * glyph.width + gx] >= 128;
+			outside[y * iWidth + x] = bInside ? 0.0f : 1e20f;
+			inside[y * iWidth + x] = bInside ? 1e20f : 0.0f;
+		}
+	}
+	distanceTransform2d(outside, iWidth, iHeight);
+	distanceTransform2d(inside, iWidth, iHeight);
+
+	glyph.alpha.resize(iWidth * iHeight);
+	for (int i = 0; i < iWidth * iHeight; i++) {
+		// the edge is half a pixel away from the centers of the pixels next to it
+		float fDist = outside[i] > 0.0f ? std::sqrt(outside[i]) - 0.5f : 0.5f - std::sqrt(inside[i]);
+		float fAlpha = 0.5f - fDist / (2.0f * iSpread);
+		fAlpha = (std::min)(1.0f, (std::max)(0.0f, fAlpha));
+		glyph.alpha[i] = (unsigned char)(fAlpha * 255.0f + 0.5f);
+	}
+
+	glyph.width = iWidth;
+	glyph.height = iHeight;
+	glyph.leftBearing -= iSpread;
+	glyph.topBearing += iSpread;
+}
+
+
+// rasterize a glyph with FreeType, as a distance field if iSpread > 0. Glyphs without pixels fail,
+// as they aren't cached
+static bool rasterizeGlyph(	FT_Face face, FT_Matrix *pMatItalic, bool bBold, bool bItalic, int iSpread,
+							wchar_t charCode, raster_glyph &glyph) {
+	glyph.charCode = charCode;
+	glyph.glyphIndex = FT_Get_Char_Index(face, charCode);
+
+	if (glyph.glyphIndex == 0)
+		return false;
+
+	FT_Load_Char(face, charCode, FT_LOAD_DEFAULT /*| FT_LOAD_NO_BITMAP*/);
+
+	// Bold
+	if(bBold) {
+		int strength = 1 << 6;
+		FT_Outline_Embolden(&face->glyph->outline, strength);
+	}
+
+	// Italic
+	if(bItalic) {
+		// set transformation 
+		FT_Outline_Transform(&face->glyph->outline, pMatItalic);
+	}
+
+	if(FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL))
+		return false;
+
+	FT_Bitmap* ftBMP = &face->glyph->bitmap;
+	glyph.width = ftBMP->width;
+	glyph.height = ftBMP->rows;
+
+	if (glyph.width == 0 || glyph.height == 0)
+		return false;
+
+	glyph.alpha.resize(glyph.width * glyph.height);
+	for(int y = 0 ; y < glyph.height; y++) {
+		const unsigned char *pSrc = ftBMP->buffer + y * ftBMP->pitch;
+		unsigned char *pDst = &glyph.alpha[y * glyph.width];
+
+		for(int x = 0 ; x < glyph.width; x++) {
+			switch (ftBMP->pixel_mode) {
+				case FT_PIXEL_MODE_GRAY:
+					pDst[x] = pSrc[x];
+					break;
+				case FT_PIXEL_MODE_MONO:
+					pDst[x] = (pSrc[x / 8] & (0x80 >> (x & 7))) ? 0xFF : 0x00;
+					break;
+				default:
+					pDst[x] = 0x00;
+					break;
+			}
+		}
+	}
+
+	glyph.leftBearing = face->glyph->bitmap_left;
+	glyph.topBearing = face->glyph->bitmap_top;
+	glyph.advance = face->glyph->advance.x;
+
+	if (iSpread > 0)
+		buildDistanceField(glyph, iSpread);
+
+	return true;
+}
+
+
+// background rasterization thread
+static int SDLCALL glyphWorkerMain(void *pData) {
+	free_type_impl *impl = static_cast<free_type_impl *>(pData);
+
+	SDL_LockMutex(impl->_workerMutex);
+	for (;;) {
+		while (!impl->_workerQuit && impl->_workerPending.empty())
+			SDL_CondWait(impl->_workerWake, impl->_workerMutex);
+		if (impl->_workerQuit)
+			break;
+
+		wchar_t charCode = impl->_workerPending.front();
+		impl->_workerPending.pop_front();
+		impl->_workerBusy++;
+		SDL_UnlockMutex(impl->_workerMutex);
+
+		raster_glyph *pGlyph = new raster_glyph;
+		if (!rasterizeGlyph(impl->_workerFace, &impl->_matItalic, impl->_workerBold, impl->_workerItalic,
+							impl->_workerSpread, charCode, *pGlyph)) {
+			delete pGlyph;
+			pGlyph = NULL;
+		}
+
+		SDL_LockMutex(impl->_workerMutex);
+		impl->_workerBusy--;
+		if (pGlyph)
+			impl->_workerDone.push_back(pGlyph);
+	}
+	SDL_UnlockMutex(impl->_workerMutex);
+
+	return 0;
+}
+
+
 // --------------------------------------------------------------------------------
 //							  Initialization / Destruction
 // --------------------------------------------------------------------------------
@@ -71,6 +292,12 @@ IND_TTF_Font::IND_TTF_Font( free_type_ptr_wrapped_impl *freetype_wrapped, IND_Re
     _fYHotSpot              = 0.5f;
     _bBold                  = false;
     _bItalic                = false;
+    _nMaxCachePages         = 4;
+    _nPageSize              = 512;
+    _nUseStamp              = 0;
+    _nSdfSize               = 0;
+    _nSdfSpread             = 0;
+    _fGlyphScale            = 1.0f;
 
     _impl = new free_type_impl();               // TODO: remember to delete this
     _impl->_FTLib = freetype_wrapped->_FTLib;
@@ -79,6 +306,17 @@ IND_TTF_Font::IND_TTF_Font( free_type_ptr_wrapped_impl *freetype_wrapped, IND_Re
 	_impl->_matItalic.xy = 0x5800;
 	_impl->_matItalic.yx = 0;
 	_impl->_matItalic.yy = 1 << 16;
+
+	_impl->_workerLib = NULL;
+	_impl->_workerFace = NULL;
+	_impl->_workerBold = false;
+	_impl->_workerItalic = false;
+	_impl->_workerSpread = 0;
+	_impl->_workerThread = NULL;
+	_impl->_workerMutex = NULL;
+	_impl->_workerWake = NULL;
+	_impl->_workerQuit = false;
+	_impl->_workerBusy = 0;
     
 }
 
@@ -91,7 +329,7 @@ IND_TTF_Font::~IND_TTF_Font() {
 // --------------------------------------------------------------------------------
 
 bool IND_TTF_Font::loadTTFFontFromDisk(const std::string& strname, const std::string& strpath,
-										int iSize, bool bBold, bool bItalic) {
+										int iSize, bool bBold, bool bItalic, int iDistanceFieldSize) {
 	unloadFont();
 
 	//create new face
@@ -110,10 +348,17 @@ bool IND_TTF_Font::loadTTFFontFromDisk(const std::string& strname, const std::st
 	_CharWidth	= iSize;
 	_CharHeight = iSize;
 
-	if (FT_Set_Pixel_Sizes(_impl->_Face, _CharWidth, _CharHeight) != 0)
-		return false;
+	// distance fields are rasterized once at their size, and scaled to the font size when drawn.
+	// Without a way to threshold them in the renderer, they would look blurred: use bitmap glyphs
+	_nSdfSize = 0;
+	_nSdfSpread = 0;
+	if (iDistanceFieldSize > 0 && _pIndieRender->isDistanceFieldSupported()) {
+		_nSdfSize = iDistanceFieldSize;
+		_nSdfSpread = (std::max)(2, iDistanceFieldSize / 8);
+	}
 
-    _fFaceAscender = _impl->_Face->ascender * _impl->_Face->size->metrics.y_scale * float(1.0/64.0) * (1.0f/65536.0f);
+	if (!setRasterSize(_nSdfSize ? _nSdfSize : iSize))
+		return false;
 
 	_bBold = bBold;
 	_bItalic = bItalic;
@@ -121,7 +366,32 @@ bool IND_TTF_Font::loadTTFFontFromDisk(const std::string& strname, const std::st
 	return true;
 }
 
+bool IND_TTF_Font::setSize(int iSize) {
+	if (!_impl->_Face || iSize < 1)
+		return false;
+
+	if (_nSdfSize) {
+		// the distance fields serve any size, only the metrics change
+		_CharWidth = iSize;
+		_CharHeight = iSize;
+		_fGlyphScale = (float)iSize / _nSdfSize;
+
+		for (CharCacheMapIterator it = _FontCharCache.begin(); it != _FontCharCache.end(); ++it)
+			scaleCharMetrics(it->second);
+		return true;
+	}
+
+	// bitmap glyphs are rasterized again at the new size
+	stopGlyphWorker();
+	clearAllCache();
+
+	_CharWidth = iSize;
+	_CharHeight = iSize;
+	return setRasterSize(iSize);
+}
+
 void IND_TTF_Font::unloadFont() {
+	stopGlyphWorker();
 	clearAllCache();
 
 	if (_impl->_Face) {
@@ -134,6 +404,9 @@ void IND_TTF_Font::unloadFont() {
 bool IND_TTF_Font::buildStringCache(const std::wstring& str) {
 	bool bRet = true;
 
+	// glyphs of the string don't evict each other
+	_nUseStamp++;
+
 	for (std::size_t i = 0; i < str.length(); i++) {
 		if (!buildCharCache(str[i]))
 			bRet = false;
@@ -149,15 +422,99 @@ void IND_TTF_Font::clearAllCache() {
 	while (!_FontCharCache.empty()) {
 		CharCacheNode* pNode = _FontCharCache.begin()->second;
 		_FontCharCache.erase(_FontCharCache.begin());
-		
-		// delete surface object firstly
-		if(pNode->pSurface) {
-			_pIndieSurfaceManager->remove(pNode->pSurface);
-			//DISPOSEMANAGED(pNode->pSurface); // TODO: figure out why a diposemanaged gives an exeption, ... the surface needs to be deleted
-		}
-				
 		delete pNode;
 	}
+
+	// glyph textures are in the pages
+	for (std::size_t i = 0; i < _CachePages.size(); i++)
+		freeCachePage(_CachePages[i]);
+	_CachePages.clear();
+	_GlyphQueue.clear();
+}
+
+bool IND_TTF_Font::queueCharset(const std::wstring& str) {
+	if (!_impl->_Face || !startGlyphWorker())
+		return false;
+
+	SDL_LockMutex(_impl->_workerMutex);
+	for (std::size_t i = 0; i < str.length(); i++) {
+		// chars drawn without glyphs, or already there
+		if (str[i] == L' ' || str[i] == L'\t' || str[i] == L'\n' || _FontCharCache.count(str[i]))
+			continue;
+		_impl->_workerPending.push_back(str[i]);
+	}
+	SDL_CondSignal(_impl->_workerWake);
+	SDL_UnlockMutex(_impl->_workerMutex);
+
+	return true;
+}
+
+int IND_TTF_Font::uploadPendingGlyphs(float fMaxMs) {
+	if (!_impl->_workerMutex)
+		return 0;
+
+	Uint64 start = SDL_GetPerformanceCounter();
+	Uint64 budget = (Uint64)(fMaxMs * 0.001f * SDL_GetPerformanceFrequency());
+
+	// glyphs cached now don't evict each other
+	_nUseStamp++;
+
+	int nCached = 0;
+	for (;;) {
+		raster_glyph *pGlyph = NULL;
+		SDL_LockMutex(_impl->_workerMutex);
+		if (!_impl->_workerDone.empty()) {
+			pGlyph = _impl->_workerDone.front();
+			_impl->_workerDone.pop_front();
+		}
+		SDL_UnlockMutex(_impl->_workerMutex);
+
+		if (!pGlyph)
+			break;
+
+		// it could be cached meanwhile, when drawn with auto cache
+		if (!isCharCached(pGlyph->charCode) && cacheGlyph(*pGlyph))
+			nCached++;
+		delete pGlyph;
+
+		if (SDL_GetPerformanceCounter() - start >= budget)
+			break;
+	}
+
+	// textures get the new glyphs now instead of in the next draw
+	if (nCached)
+		uploadCachePages();
+
+	return nCached;
+}
+
+int IND_TTF_Font::getNumPendingGlyphs() {
+	if (!_impl->_workerMutex)
+		return 0;
+
+	SDL_LockMutex(_impl->_workerMutex);
+	int nPending = (int)(_impl->_workerPending.size() + _impl->_workerDone.size()) + _impl->_workerBusy;
+	SDL_UnlockMutex(_impl->_workerMutex);
+
+	return nPending;
+}
+
+void IND_TTF_Font::setMaxCachePages(int nPages) {
+	if (nPages < 1)
+		nPages = 1;
+	_nMaxCachePages = nPages;
+
+	// drop the least recently used pages above the new limit
+	while ((int)_CachePages.size() > _nMaxCachePages) {
+		std::size_t iOldest = 0;
+		for (std::size_t i = 1; i < _CachePages.size(); i++) {
+			if (_CachePages[i]->lastUse < _CachePages[iOldest]->lastUse)
+				iOldest = i;
+		}
+		evictCachePage(_CachePages[iOldest]);
+		freeCachePage(_CachePages[iOldest]);
+		_CachePages.erase(_CachePages.begin() + iOldest);
+	}
 }
 
 
@@ -169,6 +526,9 @@ bool IND_TTF_Font::drawText(const std::wstring& s, float x, float y, uint32_t cl
 	FT_Vector Delta;
 	CharCacheNode* pNode = NULL;
 
+	// pages used from now on are kept until the glyphs are drawn
+	_nUseStamp++;
+
 	int nSpace = getSpaceAdvance();
 
 	//std::size_t Length = s.length();
@@ -211,8 +571,8 @@ bool IND_TTF_Font::drawText(const std::wstring& s, float x, float y, uint32_t cl
 		//Kerning
 		if (previousGlyph != 0 && _bHasKerning && bKerning && !bFlipX && !bFlipY && fZRotate == 0) {
 			FT_Get_Kerning(_impl->_Face, previousGlyph, pNode->charGlyphIndex, FT_KERNING_DEFAULT, &Delta);
-			penX += Delta.x >> 6;
-			penY += Delta.y >> 6;
+			penX += Delta.x * _fGlyphScale / 64;
+			penY += Delta.y * _fGlyphScale / 64;
 		}
 		if (!renderChar(s[i], penX, penY, clrFont, bFlipX, bFlipY, fZRotate, btTrans, bKerning, bUnderl))
 			Ret = false;
@@ -221,6 +581,8 @@ bool IND_TTF_Font::drawText(const std::wstring& s, float x, float y, uint32_t cl
 		previousGlyph = pNode->charGlyphIndex;
 	}
 
+	flushGlyphs(clrFont, bFlipX, bFlipY, fZRotate, btTrans);
+
 	// Draw underline
 	if(bUnderl && ((penX - original_Pen_x) > 0.1f)) {
 		doDrawBorder(original_Pen_x, penX, penY + _CharHeight, clrFont, btTrans);
@@ -248,6 +610,9 @@ int IND_TTF_Font::drawTextEx(const std::wstring& sText, float fLeft, float fTop,
 		return -1;
 	}
 
+	// pages used from now on are kept until the glyphs are drawn
+	_nUseStamp++;
+
 	//the format must contain one para for horizontal align and one for vertical
 	if( !(nFormat & (DT_EX_LEFT | DT_EX_CENTER | DT_EX_RIGHT)) ||
 		!(nFormat & (DT_EX_TOP | DT_EX_VCENTER | DT_EX_BOTTOM)))
@@ -431,6 +796,7 @@ int IND_TTF_Font::drawTextEx(const std::wstring& sText, float fLeft, float fTop,
 						bFlipY, fZRotate, btTrans, bKerning, bUnderl);
 		line++;
 	}
+	flushGlyphs(clrFont, bFlipX, bFlipY, fZRotate, btTrans);
 
 	//8. Display border if reauired
 	if(nFormat & DT_EX_BORDER) {
@@ -455,78 +821,16 @@ bool IND_TTF_Font::renderChar(wchar_t charCode, float x, float y, uint32_t clrFo
 		buildCharCache(charCode);
 
 	CharCacheNode* pNode = getCharCacheNode(charCode);
-	if (!pNode || !pNode->pSurface)
+	if (!pNode || !pNode->pPage)
 		return false;
 
-	float origin_x, origin_y;
-	origin_x = x;
-	origin_y = y;
-
-	x += pNode->charLeftBearing;
-	y += _fFaceAscender - pNode->charTopBearing;
-	
-	//Bliting the font surfaces to screen
-	// 1) We apply the world space transformation (translation, rotation, scaling).
-	// If you want to recieve the transformation in a single matrix you can pass
-	// and IND_Matrix object by reference.
-
-	int mWidth = pNode->pSurface->getWidth();
-	int mHeight = pNode->pSurface->getHeight();
-
-	/*
-	if( (x + mWidth  <= 0) || (y + mHeight <= 0) ||
-		(x > m_pIndieRender->GetWindow()->GetWidth()) || (y > m_pIndieRender->GetWindow()->GetHeight()))
-		return false;//not visible, just drop it
-	*/
-	//
-	IND_Matrix mMatrix;
-	// We want the start position (x,y) to be the top left corner 
-	_pIndieRender->setTransform2d(
-									(int)(x + _fXHotSpot * mWidth),		// x pos
-									(int)(y + _fYHotSpot * mHeight),	// y pos
-									0,                                  // Angle x
-									0,                                  // Angle y
-									fZRotate,                           // Angle z
-									_fXScale,                           // Scale x
-									_fYScale,                           // Scale y
-									(int) (_fXHotSpot * mWidth * -1),	// Axis cal x
-									(int) (_fYHotSpot * mHeight * -1),	// Axis cal y
-									bFlipX,                             // Mirror x
-									bFlipY,                             // Mirror y
-									mWidth,                             // Width
-									mHeight,                            // Height
-									&mMatrix);                          // Matrix in wich the transformation will be applied (optional)			
- 
-	//2) We apply the color, blending and culling transformations.
-	//modified by Joel Gao Mar,4th 2009
-	byte r,g,b;
-	r = clrFont & 0xFF;
-	g = (clrFont >> 8) & 0xFF;
-	b = (clrFont >> 16) & 0xFF;
-
-	_pIndieRender->setRainbow2d(
-									IND_ALPHA,			// IND_Type
-									1,					// Back face culling 0/1 => off / on
-									bFlipX,				// Mirror x
-									bFlipY,				// Mirror y
-									IND_FILTER_LINEAR,	// IND_Filter
-									r,                  // R Component	for tinting
-									g,                  // G Component	for tinting
-									b,                  // B Component	for tinting
-									btTrans,			// A Component	for tinting
-									0,					// R Component	for fading to a color		
-									0,					// G Component	for fading to a color		
-									0,					// B Component	for fading to a color			
-									255,//btTrans,		// Amount of fading
-									IND_SRCALPHA,		// IND_BlendingType (source)
-									IND_INVSRCALPHA);	// IND_BlendingType (destination)
-	//
+	// the glyph is drawn with the rest of its page at the end of the draw call
+	GlyphQuad quad;
+	quad.pNode = pNode;
+	quad.x = x + pNode->charLeftBearing * _fGlyphScale;
+	quad.y = y + (_fFaceAscender - pNode->charTopBearing) * _fGlyphScale;
+	_GlyphQueue.push_back(quad);
 
-
-	// 3) Blit the IND_Surface
-	//m_pIndieLib->Render->BlitRegionSurface(theGlyph->pSurface, (int)x, (int)y, mWidth,mHeight);
-	_pIndieRender->blitSurface(pNode->pSurface);
-	
 	return true;
 }
 
@@ -538,136 +842,404 @@ bool IND_TTF_Font::buildCharCache(wchar_t charCode) {
 	if (isCharCached(charCode))
 		return true;
 
+	raster_glyph glyph;
+	if (!rasterizeGlyph(_impl->_Face, &_impl->_matItalic, _bBold, _bItalic, _nSdfSpread, charCode, glyph))
+		return false;
+
+	return cacheGlyph(glyph);
+}
+
+bool IND_TTF_Font::setRasterSize(int iRasterSize) {
+	if (FT_Set_Pixel_Sizes(_impl->_Face, iRasterSize, iRasterSize) != 0)
+		return false;
+
+	// atlas pages hold at least 8 rows of glyphs, if the hardware allows it
+	int iMaxTextureSize = _pIndieRender->getMaxTextureSize();
+	_nPageSize = 512;
+	while (_nPageSize < (iRasterSize + 2 * _nSdfSpread) * 8)
+		_nPageSize *= 2;
+	if (iMaxTextureSize > 0 && _nPageSize > iMaxTextureSize)
+		_nPageSize = iMaxTextureSize;
+
+    _fFaceAscender = _impl->_Face->ascender * _impl->_Face->size->metrics.y_scale * float(1.0/64.0) * (1.0f/65536.0f);
+	_fGlyphScale = (float)_CharHeight / iRasterSize;
+
+	return true;
+}
+
+void IND_TTF_Font::scaleCharMetrics(CharCacheNode *pNode) {
+	pNode->charAdvance = (uint32_t)(pNode->rasterAdvance * _fGlyphScale / 64.0f + 0.5f);
+}
+
+bool IND_TTF_Font::cacheGlyph(const raster_glyph &glyph) {
 	CharCacheNode* pNode = new CharCacheNode;
 	//////////
 	//init the struct pointers
-	pNode->pSurface = NULL;
+	pNode->pPage = NULL;
 	//////////
-	pNode->charCode = charCode;
-	pNode->charGlyphIndex = FT_Get_Char_Index(_impl->_Face, charCode);
-
-	if (pNode->charGlyphIndex == 0) {
+	pNode->charCode = glyph.charCode;
+	pNode->charGlyphIndex = glyph.glyphIndex;
+
+	// find room in the atlas pages
+	int iWidth = glyph.width;
+	int iHeight = glyph.height;
+	int iX, iY;
+	CachePage *pPage = allocGlyphSpace(iWidth, iHeight, iX, iY);
+	if (!pPage) {
 		delete pNode;
 		return false;
 	}
 
-	FT_Load_Char(_impl->_Face, charCode, FT_LOAD_DEFAULT /*| FT_LOAD_NO_BITMAP*/);
-
-	// Bold
-	if(_bBold) {
-		int strength = 1 << 6;
-		FT_Outline_Embolden(&_impl->_Face->glyph->outline, strength);
+	// render the glyph image to the page, it is uploaded before the next draw
+	renderGlyph(glyph, pPage->pImage, iX, iY);
+
+	if (pPage->dirtyX0 >= pPage->dirtyX1) {
+		pPage->dirtyX0 = iX;
+		pPage->dirtyY0 = iY;
+		pPage->dirtyX1 = iX + iWidth;
+		pPage->dirtyY1 = iY + iHeight;
+	} else {
+		pPage->dirtyX0 = (std::min)(pPage->dirtyX0, iX);
+		pPage->dirtyY0 = (std::min)(pPage->dirtyY0, iY);
+		pPage->dirtyX1 = (std::max)(pPage->dirtyX1, iX + iWidth);
+		pPage->dirtyY1 = (std::max)(pPage->dirtyY1, iY + iHeight);
 	}
+	pPage->lastUse = _nUseStamp;
+
+	pNode->pPage = pPage;
+	pNode->pageX = iX;
+	pNode->pageY = iY;
+	pNode->width = iWidth;
+	pNode->height = iHeight;
+
+	pNode->charLeftBearing = glyph.leftBearing;
+	pNode->charTopBearing = glyph.topBearing;
+	pNode->rasterAdvance = glyph.advance;
+	scaleCharMetrics(pNode);
+	
+	_FontCharCache.insert(std::pair<wchar_t, CharCacheNode*>(glyph.charCode, pNode));
 
-	// Italic
-	if(_bItalic) {
-		// set transformation 
-		FT_Outline_Transform(&_impl->_Face->glyph->outline, &_impl->_matItalic);
+	//cache entry built
+	return true;
+}
+
+IND_TTF_Font::CharCacheNode* IND_TTF_Font::getCharCacheNode(wchar_t charCode) {
+	CharCacheMapIterator it = _FontCharCache.find(charCode);
+	if(it == _FontCharCache.end())
+		return NULL;
+
+	// the page is in use by the current draw call
+	it->second->pPage->lastUse = _nUseStamp;
+	return it->second;
+}
+
+bool IND_TTF_Font::renderGlyph(const raster_glyph &glyph, IND_Image *pImage, int iX, int iY) {
+	if(pImage == NULL)
+		return false;
+
+	for(int x = 0 ; x < glyph.width; x++) {
+		for(int y = 0 ; y < glyph.height; y++) {
+			pImage->putPixel(iX + x, iY + y, 255,255,255, glyph.alpha[y * glyph.width + x]);
+		}
 	}
 	
+	//Test effects here
+	//pImage->Pixelize(2);
+	//
+	return true;
+}
 
-	if(FT_Render_Glyph(_impl->_Face->glyph, FT_RENDER_MODE_NORMAL)) {
-		delete pNode;
-		return false;
+IND_TTF_Font::CachePage* IND_TTF_Font::allocGlyphSpace(int iWidth, int iHeight, int &iX, int &iY) {
+	// the glyph doesn't fit even in an empty page
+	if (iWidth + 1 > _nPageSize || iHeight + 1 > _nPageSize)
+		return NULL;
+
+	for (std::size_t i = 0; i < _CachePages.size(); i++) {
+		if (insertInPage(_CachePages[i], iWidth, iHeight, iX, iY))
+			return _CachePages[i];
 	}
 
-	// build an image
+	// all pages are full: reuse the least recently drawn one when no more pages are allowed.
+	// pages used by the current draw call are kept, so the limit can be exceeded meanwhile
+	CachePage *pPage = NULL;
+	if ((int)_CachePages.size() >= _nMaxCachePages) {
+		for (std::size_t i = 0; i < _CachePages.size(); i++) {
+			if (_CachePages[i]->lastUse != _nUseStamp &&
+				(!pPage || _CachePages[i]->lastUse < pPage->lastUse))
+				pPage = _CachePages[i];
+		}
+		if (pPage)
+			evictCachePage(pPage);
+	}
+
+	if (!pPage) {
+		pPage = newCachePage();
+		if (!pPage)
+			return NULL;
+		_CachePages.push_back(pPage);
+	}
+
+	if (!insertInPage(pPage, iWidth, iHeight, iX, iY))
+		return NULL;
+	return pPage;
+}
+
+bool IND_TTF_Font::insertInPage(CachePage *pPage, int iWidth, int iHeight, int &iX, int &iY) {
+	// one empty texel after each glyph, so linear filtering doesn't blend neighbours
+	int iSlotWidth = iWidth + 1;
+	int iSlotHeight = iHeight + 1;
+
+	// the lowest shelf with room for the glyph wastes less space
+	CacheShelf *pBest = NULL;
+	for (std::size_t i = 0; i < pPage->shelves.size(); i++) {
+		CacheShelf &shelf = pPage->shelves[i];
+		if (shelf.height >= iSlotHeight && shelf.x + iSlotWidth <= _nPageSize &&
+			(!pBest || shelf.height < pBest->height))
+			pBest = &shelf;
+	}
+
+	// new shelf below the others
+	if (!pBest) {
+		if (pPage->nextShelfY + iSlotHeight > _nPageSize)
+			return false;
+
+		CacheShelf shelf;
+		shelf.y = pPage->nextShelfY;
+		shelf.height = iSlotHeight;
+		shelf.x = 0;
+		pPage->shelves.push_back(shelf);
+		pPage->nextShelfY += iSlotHeight;
+		pBest = &pPage->shelves.back();
+	}
+
+	iX = pBest->x;
+	iY = pBest->y;
+	pBest->x += iSlotWidth;
+	return true;
+}
+
+IND_TTF_Font::CachePage* IND_TTF_Font::newCachePage() {
 	IND_Image *pImage = IND_Image::newImage();
-	assert(pImage);
+	if (!_pIndieImageManager->add(pImage, _nPageSize, _nPageSize, IND_RGBA)) {
+		DISPOSEMANAGED(pImage);
+		return NULL;
+	}
+	// transparent white, as the glyph edges
+	pImage->clear(255, 255, 255, 0);
+
+	IND_Surface *pSurface = IND_Surface::newSurface();
+	if (!_pIndieSurfaceManager->add(pSurface, pImage, IND_ALPHA, IND_32)) {
+		DISPOSEMANAGED(pSurface);
+		_pIndieImageManager->remove(pImage);
+		return NULL;
+	}
+
+	CachePage *pPage = new CachePage;
+	pPage->pImage = pImage;
+	pPage->pSurface = pSurface;
+	pPage->nextShelfY = 0;
+	pPage->lastUse = _nUseStamp;
+	pPage->dirtyX0 = pPage->dirtyY0 = pPage->dirtyX1 = pPage->dirtyY1 = 0;
+	return pPage;
+}
+
+void IND_TTF_Font::evictCachePage(CachePage *pPage) {
+	CharCacheMapIterator it = _FontCharCache.begin();
+	while (it != _FontCharCache.end()) {
+		if (it->second->pPage == pPage) {
+			delete it->second;
+			_FontCharCache.erase(it++);
+		} else {
+			++it;
+		}
+	}
 
-	// render the glyph image to IND_Image
-	if(!renderGlyph(_impl, pImage)) // &_impl->_Face->glyph->bitmap, pImage
+	pPage->pImage->clear(255, 255, 255, 0);
+	pPage->shelves.clear();
+	pPage->nextShelfY = 0;
+
+	// old glyphs must leave the texture too, including the texels around the new ones
+	pPage->dirtyX0 = 0;
+	pPage->dirtyY0 = 0;
+	pPage->dirtyX1 = _nPageSize;
+	pPage->dirtyY1 = _nPageSize;
+}
+
+bool IND_TTF_Font::startGlyphWorker() {
+	if (_impl->_workerThread)
+		return true;
+
+	if (FT_Init_FreeType(&_impl->_workerLib) != 0) {
+		_impl->_workerLib = NULL;
 		return false;
-		
-	//building the surface from image
-	pNode->pSurface = IND_Surface::newSurface();
+	}
 
-	bool bOK = true;
-	if (!_pIndieSurfaceManager->add (pNode->pSurface, pImage, IND_ALPHA, IND_32)) {
-		bOK = false;
+	if (FT_New_Face(_impl->_workerLib, _strFilePath.c_str(), 0, &_impl->_workerFace) != 0) {
+		_impl->_workerFace = NULL;
+		stopGlyphWorker();
+		return false;
 	}
-    
-	// free the image
-	_pIndieImageManager->remove(pImage);
-	//DISPOSEMANAGED(pImage);  // TODO: figure out why a diposemanaged gives an exeption, ... the image needs to be deleted
-    // pImage->destroy();      // TODO: ... this also does not work ..
-    
-	if(!bOK) {
-		delete pNode;
+
+	_impl->_workerBold = _bBold;
+	_impl->_workerItalic = _bItalic;
+	_impl->_workerSpread = _nSdfSpread;
+	_impl->_workerQuit = false;
+	_impl->_workerMutex = SDL_CreateMutex();
+	_impl->_workerWake = SDL_CreateCond();
+
+	int iRasterSize = _nSdfSize ? _nSdfSize : _CharHeight;
+	if (FT_Set_Pixel_Sizes(_impl->_workerFace, iRasterSize, iRasterSize) != 0 ||
+		!_impl->_workerMutex || !_impl->_workerWake) {
+		stopGlyphWorker();
 		return false;
 	}
 
-	pNode->charLeftBearing = _impl->_Face->glyph->bitmap_left;
-	pNode->charTopBearing = _impl->_Face->glyph->bitmap_top;
-	pNode->charAdvance = _impl->_Face->glyph->advance.x / 64;
-	
-	_FontCharCache.insert(std::pair<wchar_t, CharCacheNode*>(charCode, pNode));
+	_impl->_workerThread = SDL_CreateThread(glyphWorkerMain, "IndieLibGlyphs", _impl);
+	if (!_impl->_workerThread) {
+		stopGlyphWorker();
+		return false;
+	}
 
-	//cache entry built
 	return true;
 }
 
-IND_TTF_Font::CharCacheNode* IND_TTF_Font::getCharCacheNode(wchar_t charCode) {
-	CharCacheMapIterator it = _FontCharCache.find(charCode);
-	if(it == _FontCharCache.end())
-		return NULL;
-	else
-		return it->second;
+void IND_TTF_Font::stopGlyphWorker() {
+	if (_impl->_workerThread) {
+		SDL_LockMutex(_impl->_workerMutex);
+		_impl->_workerQuit = true;
+		SDL_CondSignal(_impl->_workerWake);
+		SDL_UnlockMutex(_impl->_workerMutex);
+
+		SDL_WaitThread(_impl->_workerThread, NULL);
+		_impl->_workerThread = NULL;
+	}
+
+	if (_impl->_workerWake)
+		SDL_DestroyCond(_impl->_workerWake);
+	if (_impl->_workerMutex)
+		SDL_DestroyMutex(_impl->_workerMutex);
+	_impl->_workerWake = NULL;
+	_impl->_workerMutex = NULL;
+
+	_impl->_workerPending.clear();
+	while (!_impl->_workerDone.empty()) {
+		delete _impl->_workerDone.front();
+		_impl->_workerDone.pop_front();
+	}
+	_impl->_workerBusy = 0;
+
+	if (_impl->_workerFace)
+		FT_Done_Face(_impl->_workerFace);
+	if (_impl->_workerLib)
+		FT_Done_FreeType(_impl->_workerLib);
+	_impl->_workerFace = NULL;
+	_impl->_workerLib = NULL;
 }
 
-bool IND_TTF_Font::renderGlyph(free_type_impl* impl, IND_Image *pImage) {
-	
-    //free_type_impl* impl
-    
-    FT_Bitmap* ftBMP = &impl->_Face->glyph->bitmap;
-    
-    uint32_t glyphWidth = ftBMP->width;
-	uint32_t glyphHeight = ftBMP->rows;
+void IND_TTF_Font::freeCachePage(CachePage *pPage) {
+	_pIndieSurfaceManager->remove(pPage->pSurface);
+	_pIndieImageManager->remove(pPage->pImage);
+	delete pPage;
+}
 
-	if (glyphWidth == 0 || glyphHeight == 0)
-		return false;
+void IND_TTF_Font::uploadCachePages() {
+	for (std::size_t i = 0; i < _CachePages.size(); i++) {
+		CachePage *pPage = _CachePages[i];
+		if (pPage->dirtyX0 >= pPage->dirtyX1)
+			continue;
 
-	_pIndieImageManager->add(pImage, glyphWidth, glyphHeight, IND_RGBA);
-	if(pImage == NULL)
-		return false;
+		// surface rows count from the top, image rows from the bottom
+		_pIndieSurfaceManager->update(	pPage->pSurface, pPage->pImage,
+										pPage->dirtyX0,
+										_nPageSize - pPage->dirtyY1,
+										pPage->dirtyX1 - pPage->dirtyX0,
+										pPage->dirtyY1 - pPage->dirtyY0);
+		pPage->dirtyX0 = pPage->dirtyX1 = 0;
+	}
+}
+
+void IND_TTF_Font::flushGlyphs(uint32_t clrFont, bool bFlipX, bool bFlipY, float fZRotate, byte btTrans) {
+	if (_GlyphQueue.empty())
+		return;
+
+	uploadCachePages();
 
-	byte *pSrc = ftBMP->buffer;
-	/*
 	byte r,g,b;
-	r = m_FontColor & 0xFF;
-	g = (m_FontColor >> 8) & 0xFF;
-	b = (m_FontColor >> 16) & 0xFF;
-	*/
+	r = clrFont & 0xFF;
+	g = (clrFont >> 8) & 0xFF;
+	b = (clrFont >> 16) & 0xFF;
 
-	for(uint32_t x = 0 ; x <  glyphWidth; x++) {
-		
-        for(uint32_t y = 0 ; y <  glyphHeight; y++) {
-			
-            switch (ftBMP->pixel_mode) {
-				
-                case FT_PIXEL_MODE_GRAY:
-					//pImage->PutPixel(x, y, r,g,b,pSrc[y * glyphWidth + x]);
-					pImage->putPixel(x, y, 255,255,255,pSrc[y * glyphWidth + x]);
-					break;
-				case FT_PIXEL_MODE_MONO:
-					pSrc = ftBMP->buffer + (y * ftBMP->pitch);
-					if((pSrc [x / 8] & (0x80 >> (x & 7))))
-						//pImage->PutPixel(x, y, r,g,b,0xFF);
-						pImage->putPixel(x, y, 255,255,255,0xFF);
-					else
-						//pImage->PutPixel(x, y, r,g,b,0x00);
-						pImage->putPixel(x, y, 255,255,255,0x00);
-					break;
-				default:
-					break;
-			}
+	// distance field glyphs are scaled to the font size, and cut at their edge
+	if (_nSdfSize)
+		_pIndieRender->setDistanceField(true);
+
+	// glyphs of the same page go one after another, so the renderer can draw each page at once
+	for (std::size_t p = 0; p < _CachePages.size(); p++) {
+		CachePage *pPage = _CachePages[p];
+
+		for (std::size_t i = 0; i < _GlyphQueue.size(); i++) {
+			CharCacheNode *pNode = _GlyphQueue[i].pNode;
+			if (pNode->pPage != pPage)
+				continue;
+
+			int mWidth = pNode->width;
+			int mHeight = pNode->height;
+			float fWidth = mWidth * _fGlyphScale;
+			float fHeight = mHeight * _fGlyphScale;
+			float x = _GlyphQueue[i].x;
+			float y = _GlyphQueue[i].y;
+
+			//Bliting the font surfaces to screen
+			// 1) We apply the world space transformation (translation, rotation, scaling).
+			// We want the start position (x,y) to be the top left corner 
+			IND_Matrix mMatrix;
+			_pIndieRender->setTransform2d(
+											(int)(x + _fXHotSpot * fWidth),		// x pos
+											(int)(y + _fYHotSpot * fHeight),	// y pos
+											0,                                  // Angle x
+											0,                                  // Angle y
+											fZRotate,                           // Angle z
+											_fXScale * _fGlyphScale,            // Scale x
+											_fYScale * _fGlyphScale,            // Scale y
+											(int) (_fXHotSpot * mWidth * -1),	// Axis cal x
+											(int) (_fYHotSpot * mHeight * -1),	// Axis cal y
+											bFlipX,                             // Mirror x
+											bFlipY,                             // Mirror y
+											mWidth,                             // Width
+											mHeight,                            // Height
+											&mMatrix);                          // Matrix in wich the transformation will be applied (optional)
+
+			//2) We apply the color, blending and culling transformations.
+			_pIndieRender->setRainbow2d(
+											IND_ALPHA,			// IND_Type
+											1,					// Back face culling 0/1 => off / on
+											bFlipX,				// Mirror x
+											bFlipY,				// Mirror y
+											IND_FILTER_LINEAR,	// IND_Filter
+											r,                  // R Component	for tinting
+											g,                  // G Component	for tinting
+											b,                  // B Component	for tinting
+											btTrans,			// A Component	for tinting
+											0,					// R Component	for fading to a color
+											0,					// G Component	for fading to a color
+											0,					// B Component	for fading to a color
+											255,				// Amount of fading
+											IND_SRCALPHA,		// IND_BlendingType (source)
+											IND_INVSRCALPHA);	// IND_BlendingType (destination)
+
+			// 3) Blit the area of the page (regions count rows from the top)
+			_pIndieRender->blitRegionSurface(	pPage->pSurface,
+												pNode->pageX,
+												_nPageSize - pNode->pageY - mHeight,
+												mWidth,
+												mHeight);
 		}
 	}
-	
-	//Test effects here
-	//pImage->Pixelize(2);
-	//
-	return true;
+
+	if (_nSdfSize)
+		_pIndieRender->setDistanceField(false);
+
+	_GlyphQueue.clear();
 }
 
 IND_TTF_Font::uint32_t IND_TTF_Font::getSpaceAdvance() {
@@ -757,7 +1329,7 @@ std::wstring IND_TTF_Font::textFormat(	const std::wstring& sText, float &fLineWi
 		if (previousGlyph != 0 && _bHasKerning && bKerning && !bFlipX && !bFlipY && fZRotate == 0)
 		{
 			FT_Get_Kerning(_impl->_Face, previousGlyph, pNode->charGlyphIndex, FT_KERNING_DEFAULT, &Delta);
-			fCurrentLineWidth += Delta.x >> 6;
+			fCurrentLineWidth += Delta.x * _fGlyphScale / 64;
 		}
 
 		if(bLineWrap && (fCurrentLineWidth + pNode->charAdvance > fLineWidth))
@@ -819,7 +1391,7 @@ IND_TTF_Font::uint32_t IND_TTF_Font::getLineWidth(const std::wstring& sText, boo
         
 		if (previousGlyph != 0 && _bHasKerning  && bKerning && !bFlipX && !bFlipY && fZRotate == 0) {
 			FT_Get_Kerning(_impl->_Face, previousGlyph, pNode->charGlyphIndex, FT_KERNING_DEFAULT, &Delta);
-			nRet += Delta.x >> 6;
+			nRet += (int)(Delta.x * _fGlyphScale / 64);
 		}
 
 		nRet += pNode->charAdvance;
@@ -888,8 +1460,8 @@ void IND_TTF_Font::drawTextLineEx(const std::wstring& sText, float penX, float p
 		if (!bR2L && previousGlyph != 0 && _bHasKerning  && bKerning && !bFlipX && !bFlipY && fZRotate == 0)
 		{
 			FT_Get_Kerning(_impl->_Face, previousGlyph, pNode->charGlyphIndex, FT_KERNING_DEFAULT, &Delta);
-			penX += Delta.x >> 6;
-			penY += Delta.y >> 6;
+			penX += Delta.x * _fGlyphScale / 64;
+			penY += Delta.y * _fGlyphScale / 64;
 		}
 		
 
@@ -35,6 +35,7 @@
 #include "IND_TTF_FontManager.h"
 #include "IND_Math.h"
 #include "FreeTypeHandle.h"
+#include "dependencies/SDL-2.0/include/SDL.h"
 #include <assert.h>
 
 #include <ft2build.h>
@@ -47,10 +48,11 @@
 
 IND_TTF_FontManager::IND_TTF_FontManager(void)
 : _bInit(false),
+_freetype(NULL),
 _pIndieRender(NULL),
 _pIndieImageManager(NULL),
 _pIndieSurfaceManager(NULL),
-_freetype(NULL)
+_fGlyphUploadBudget(2.0f)
 {
 }
 
@@ -169,8 +171,11 @@ bool IND_TTF_FontManager::init(IND_Render *pRender, IND_ImageManager *pImageMana
  * @param iSize						Size of the font.
  * @param bBold                     Bold true / false.
  * @param bItalic					Italic true / false.
+ * @param iDistanceFieldSize		Size the glyphs are rasterized at as distance fields, to draw them at any size
+ *									with one cache. 0 caches bitmap glyphs of iSize.
  */
-bool IND_TTF_FontManager::addFont(const std::string& strName, const std::string& strPath, int iSize, bool bBold, bool bItalic) {
+bool IND_TTF_FontManager::addFont(const std::string& strName, const std::string& strPath, int iSize, bool bBold, bool bItalic,
+								  int iDistanceFieldSize) {
 	if(iSize < 5)
 		return false; // too small
 
@@ -181,7 +186,7 @@ bool IND_TTF_FontManager::addFont(const std::string& strName, const std::string&
 		return true;
 
 	IND_TTF_Font* ptrNewFont = new IND_TTF_Font(_freetype, _pIndieRender, _pIndieImageManager, _pIndieSurfaceManager);
-	if (!ptrNewFont->loadTTFFontFromDisk(strName, strPath, iSize, bBold, bItalic)) {
+	if (!ptrNewFont->loadTTFFontFromDisk(strName, strPath, iSize, bBold, bItalic, iDistanceFieldSize)) {
 		delete ptrNewFont;
 		return false;
 	}
@@ -377,6 +382,44 @@ bool IND_TTF_FontManager::CacheFontString(const std::string& strFontName, const
 	return false;
 }
 
+/**
+ * Queues the chars of a string (a charset, for example all the texts of a language) to be rasterized
+ * in a background thread, so they don't stall the frame when they are drawn for the first time. They are
+ * cached little by little by renderAllTexts(), see setGlyphUploadBudget(), or by uploadPendingGlyphs().
+ *
+ * @param strFontName				Name of the font.
+ * @param s                         Chars to rasterize.
+ */
+bool IND_TTF_FontManager::queueFontCharset(const std::string& strFontName, const std::wstring& s) {
+	IND_TTF_Font *pFont = getFontByName(strFontName);
+	if(pFont)
+		return pFont->queueCharset(s);
+
+	return false;
+}
+
+/**
+ * Caches the chars of all the fonts rasterized in the background, spending at most the given time.
+ * It is called by renderAllTexts() with the time set by setGlyphUploadBudget() (2 ms by default).
+ * Returns the number of chars cached.
+ *
+ * @param fMaxMs					Milliseconds to spend.
+ */
+int IND_TTF_FontManager::uploadPendingGlyphs(float fMaxMs) {
+	Uint64 start = SDL_GetPerformanceCounter();
+	float fMsPerTick = 1000.0f / SDL_GetPerformanceFrequency();
+
+	int nCached = 0;
+	for(IND_TTF_FontListIterator it = _FontList.begin() ; it != _FontList.end() ; it++) {
+		float fLeftMs = fMaxMs - (SDL_GetPerformanceCounter() - start) * fMsPerTick;
+		if (fLeftMs <= 0.0f)
+			break;
+		nCached += it->second->uploadPendingGlyphs(fLeftMs);
+	}
+
+	return nCached;
+}
+
 /**
  * TODO:describtion
  *
@@ -419,6 +462,24 @@ void IND_TTF_FontManager::setFontScale(const std::string& strFontName, float sx,
 	}
 }
 
+/**
+ * Changes the size of a font. Fonts added with distance field glyphs keep their cache, the others
+ * cache again their glyphs at the new size.
+ *
+ * @param strFontName				Name of the font.
+ * @param iSize						New size of the font.
+ */
+bool IND_TTF_FontManager::setFontSize(const std::string& strFontName, int iSize) {
+	if(iSize < 5)
+		return false; // too small
+
+	IND_TTF_Font *pFont = getFontByName(strFontName);
+	if(!pFont)
+		return false;
+
+	return pFont->setSize(iSize);
+}
+
 /**
  * TODO:describtion
  *
@@ -489,6 +550,9 @@ void IND_TTF_FontManager::drawTextEx(uint32_t uiIndex, const std::string& strFon
  * TODO:describtion
  */
 void IND_TTF_FontManager::renderAllTexts() {
+	// glyphs rasterized in the background, a few each frame
+	uploadPendingGlyphs(_fGlyphUploadBudget);
+
 	// render simple text from DrawText method
 	DrawTextRequestNode *pReq = NULL;
 	for(DTRListIterator it = _DTRList.begin() ; it != _DTRList.end() ; it++) {
@@ -50,13 +50,16 @@
  * Init.
  *  pImageManager		TODO: describtion
  *  pMaxTextureSize	TODO: describtion
+ *  pNPOTTextures		True if the renderer supports textures of any size, so images
+ *				fitting in one texture are not cut in power of two blocks
  */
-bool ImageCutter::init(IND_ImageManager *pImageManager, int pMaxTextureSize) {
+bool ImageCutter::init(IND_ImageManager *pImageManager, int pMaxTextureSize, bool pNPOTTextures) {
 	end();
 	initVars();
 
 	_imageManager = pImageManager;
 	_maxTextureSize = pMaxTextureSize;
+	_npotTextures = pNPOTTextures;
 
 	_ok = true;
 	return _ok;
@@ -107,6 +110,12 @@ void ImageCutter::fillInfoSurface(IND_Image *pImage,
 	if (pI->_widthBlock  > mBlockSize)  pI->_widthBlock  = mBlockSize;
 	if (pI->_heightBlock > mBlockSize)  pI->_heightBlock = mBlockSize;
 
+	// With non power of two textures, an image that fits in a texture is just one exact size block
+	if (_npotTextures && _width <= mBlockSize && _height <= mBlockSize) {
+		pI->_widthBlock   = _width;
+		pI->_heightBlock  = _height;
+	}
+
 	// If the user has choosen a size block, we change the values
 	if (pBlockSizeX != 0) {
 		pI->_widthBlock     = pBlockSizeX;
@@ -200,6 +209,149 @@ void ImageCutter::cutBlock(unsigned char *pPtrBlock,
 }
 
 
+// --------------------------------------------------------------------------------
+//							        SkylinePacker
+// --------------------------------------------------------------------------------
+
+/**
+ * Init. Resets the packer to an empty area.
+ *  @param pWidth		width of the area where rectangles are placed
+ *  @param pHeight		height of the area where rectangles are placed
+ *  @param pPadding		empty texels left at right and top of every rectangle
+ */
+void SkylinePacker::init(int pWidth, int pHeight, int pPadding) {
+	_width = pWidth;
+	_height = pHeight;
+	_padding = pPadding;
+	_usedArea = 0;
+
+	_skyline.clear();
+	SkylineSegment mGround = {0, 0, pWidth};
+	_skyline.push_back(mGround);
+}
+
+/**
+ * Finds a place for a rectangle and reserves it. Returns false if it doesn't fit.
+ *  @param pWidth, pHeight	size of the rectangle
+ *  @param pX, pY			returned position of the lower-left corner of the rectangle
+ */
+bool SkylinePacker::insert(int pWidth, int pHeight, int *pX, int *pY) {
+	int mWidth = pWidth + _padding;
+	int mHeight = pHeight + _padding;
+
+	// Best position: lowest top edge, and narrowest segment on ties
+	int mBestSegment = -1;
+	int mBestTop = _height + 1;
+	int mBestWidth = _width + 1;
+	for (size_t i = 0; i < _skyline.size(); i++) {
+		int mY = fitAt(i, mWidth, mHeight);
+		if (mY < 0) {
+			continue;
+		}
+
+		if (mY + mHeight < mBestTop || (mY + mHeight == mBestTop && _skyline[i]._width < mBestWidth)) {
+			mBestSegment = static_cast<int>(i);
+			mBestTop = mY + mHeight;
+			mBestWidth = _skyline[i]._width;
+		}
+	}
+
+	if (mBestSegment < 0) {
+		return false;
+	}
+
+	*pX = _skyline[mBestSegment]._x;
+	*pY = mBestTop - mHeight;
+
+	// New segment on top of the rectangle
+	SkylineSegment mNew = {*pX, mBestTop, mWidth};
+	_skyline.insert(_skyline.begin() + mBestSegment, mNew);
+
+	// Segments now under the rectangle are shrunk or removed
+	for (size_t i = mBestSegment + 1; i < _skyline.size(); i++) {
+		int mPrevEnd = _skyline[i - 1]._x + _skyline[i - 1]._width;
+		if (_skyline[i]._x >= mPrevEnd) {
+			break;
+		}
+
+		int mShrink = mPrevEnd - _skyline[i]._x;
+		_skyline[i]._x += mShrink;
+		_skyline[i]._width -= mShrink;
+		if (_skyline[i]._width > 0) {
+			break;
+		}
+
+		_skyline.erase(_skyline.begin() + i);
+		i--;
+	}
+
+	// Merge neighbour segments at the same height
+	for (size_t i = 0; i + 1 < _skyline.size(); i++) {
+		if (_skyline[i]._y == _skyline[i + 1]._y) {
+			_skyline[i]._width += _skyline[i + 1]._width;
+			_skyline.erase(_skyline.begin() + i + 1);
+			i--;
+		}
+	}
+
+	_usedArea += pWidth * pHeight;
+	return true;
+}
+
+/**
+ * Takes back the area of a rectangle for occupancy accounting. The space itself can't be
+ * reused until the packer is initialized again.
+ *  @param pWidth, pHeight	size of the rectangle
+ */
+void SkylinePacker::release(int pWidth, int pHeight) {
+	_usedArea -= pWidth * pHeight;
+	if (_usedArea < 0) {
+		_usedArea = 0;
+	}
+}
+
+/**
+ * Proportion (0 to 1) of the area covered by rectangles in use.
+ */
+float SkylinePacker::getOccupancy() const {
+	if (!_width || !_height) {
+		return 0.0f;
+	}
+	return static_cast<float>(_usedArea) / (static_cast<float>(_width) * static_cast<float>(_height));
+}
+
+/**
+ * Height at which a rectangle would be placed starting at the given skyline segment,
+ * or -1 if it doesn't fit there.
+ *  @param pSegment		first segment under the rectangle
+ *  @param pWidth, pHeight	size of the rectangle (padding included)
+ */
+int SkylinePacker::fitAt(size_t pSegment, int pWidth, int pHeight) {
+	int mX = _skyline[pSegment]._x;
+	if (mX + pWidth > _width) {
+		return -1;
+	}
+
+	int mY = 0;
+	int mWidthLeft = pWidth;
+	size_t i = pSegment;
+	while (mWidthLeft > 0) {
+		if (i >= _skyline.size()) {
+			return -1;
+		}
+		if (_skyline[i]._y > mY) {
+			mY = _skyline[i]._y;
+		}
+		if (mY + pHeight > _height) {
+			return -1;
+		}
+		mWidthLeft -= _skyline[i]._width;
+		i++;
+	}
+
+	return mY;
+}
+
 // --------------------------------------------------------------------------------
 //							        Private methods
 // --------------------------------------------------------------------------------
@@ -52,6 +52,15 @@ public:
 	                              IND_Image       *pImage,
 	                              int             pBlockSizeX,
 	                              int             pBlockSizeY) = 0;
+
+	//----- Optional features (builders without them keep the defaults) -----
+	virtual void setAtlasing(bool pSwitch, int pPageSize)   {}
+	virtual bool isAtlasing()                               { return false; }
+	virtual int getNumAtlasPages()                          { return 0; }
+	virtual float getAtlasPageOccupancy(int pPage)          { return 0.0f; }
+	virtual void releaseTexture(IND_Surface *pSurface)      {}
+	virtual bool updateTexture(IND_Surface *pSurface, IND_Image *pImage,
+	                           int pX, int pY, int pWidth, int pHeight) { return false; }
 };
 
 /** @endcond */
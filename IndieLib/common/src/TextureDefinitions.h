@@ -35,6 +35,7 @@
 // ----- Includes -----
 
 #include "Defines.h"
+#include "AlphaMask.h"
 
 /** @cond DOCUMENT_PRIVATEAPI */
 
@@ -74,7 +75,12 @@ struct structAttributes {
 		_widthBlock(0),
 		_heightBlock(0),
 		_isHaveSurface(false),
-		_isHaveGrid(false){}
+		_isHaveGrid(false),
+		_isAtlased(false),
+		_u0(0.0f),
+		_v0(0.0f),
+		_u1(1.0f),
+		_v1(1.0f){}
 
     IND_Type    _type;                      // Surface type
     IND_Quality _quality;                   // Color quality
@@ -90,13 +96,18 @@ struct structAttributes {
     int         _heightBlock;               // Block height
     bool        _isHaveSurface;             // Surface loaded or not
     bool        _isHaveGrid;
+    bool        _isAtlased;                 // Texture is a shared atlas page (owned by the texture builder)
+    float       _u0;                        // UV sub-rectangle of the image in the texture
+    float       _v0;                        // (lower-left and upper-right corners)
+    float       _u1;
+    float       _v1;
 };
 typedef struct structAttributes ATTRIBUTES;
 
 // TYPE
 struct SURFACE {
-    SURFACE() : _vertexArray(NULL), _texturesArray(NULL){}
-    SURFACE(int pNumBlocks, int numVertices) : _vertexArray(NULL), _texturesArray(NULL) {
+    SURFACE() : _vertexArray(NULL), _texturesArray(NULL), _alphaMask(NULL){}
+    SURFACE(int pNumBlocks, int numVertices) : _vertexArray(NULL), _texturesArray(NULL), _alphaMask(NULL) {
         // This buffer will be used for drawing the IND_Surface using DrawPrimitiveUp
         _vertexArray = new CUSTOMVERTEX2D[numVertices];
         // Each block, needs a texture. We use an array of textures in order to store them.
@@ -107,10 +118,13 @@ struct SURFACE {
         DISPOSEARRAY(_texturesArray);
 	    // Free vertex buffer
 	    DISPOSEARRAY(_vertexArray);
+	    // Free alpha mask
+	    DISPOSE(_alphaMask);
     }
 	CUSTOMVERTEX2D *_vertexArray;       // Vertex array (store the blocks (quads) of the IND_Surface
 	TEXTURE *_texturesArray;            // Texture array (one texture per block)
 	ATTRIBUTES _attributes;             // Attributes
+	AlphaMask *_alphaMask;              // Alpha mask for pixel collisions (only if enabled when loaded)
 };
 
 /** @endcond */
@@ -0,0 +1,211 @@
+/*****************************************************************************************
+ * File: WorkerPool.h
+ * Desc: Small pool of threads running numbered tasks
+ *****************************************************************************************/
+
+/*********************************** The zlib License ************************************
+ *
+ * Copyright (c) 2013 Indielib-crossplatform Development Team
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software
+ * in a product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ *
+ *****************************************************************************************/
+
+#ifndef _WORKERPOOL_
+#define _WORKERPOOL_
+
+// ----- Includes -----
+
+#include "Defines.h"
+#include "dependencies/SDL-2.0/include/SDL.h"
+#include <vector>
+
+/** @cond DOCUMENT_PRIVATEAPI */
+
+//! Task run by the pool: it gets the number of the task, from 0 to the number of tasks - 1
+typedef void (*WORKER_TASK)(void *pUserData, int pTask);
+
+// --------------------------------------------------------------------------------
+//									 WorkerPool
+// --------------------------------------------------------------------------------
+
+/*
+Runs a set of numbered tasks on some threads, and returns when all of them are done. The calling
+thread also takes tasks, so a pool of n threads creates n - 1 of them. Tasks are taken in any order,
+so they must not depend on each other
+*/
+class WorkerPool {
+public:
+
+	// ----- Init/End -----
+
+	WorkerPool() : _mutex(0), _wake(0), _idle(0), _quit(0), _generation(0), _busy(0),
+		_task(0), _userData(0), _numTasks(0) {
+		SDL_AtomicSet(&_nextTask, 0);
+	}
+	~WorkerPool() {
+		end();
+	}
+
+	bool init(int pNumThreads) {
+		end();
+
+		_mutex = SDL_CreateMutex();
+		_wake = SDL_CreateCond();
+		_idle = SDL_CreateCond();
+		if (!_mutex || !_wake || !_idle) {
+			end();
+			return 0;
+		}
+
+		for (int i = 1; i < pNumThreads; i++) {
+			SDL_Thread *mThread = SDL_CreateThread(threadMain, "IndieLibWorker", this);
+			if (!mThread) break;
+			_threads.push_back(mThread);
+		}
+
+		return 1;
+	}
+
+	void end() {
+		if (_mutex) {
+			SDL_LockMutex(_mutex);
+			_quit = 1;
+			SDL_CondBroadcast(_wake);
+			SDL_UnlockMutex(_mutex);
+		}
+
+		for (size_t i = 0; i < _threads.size(); i++) {
+			SDL_WaitThread(_threads[i], 0);
+		}
+		_threads.clear();
+
+		if (_idle) SDL_DestroyCond(_idle);
+		if (_wake) SDL_DestroyCond(_wake);
+		if (_mutex) SDL_DestroyMutex(_mutex);
+		_idle = _wake = 0;
+		_mutex = 0;
+		_quit = 0;
+	}
+
+	// ----- Public methods -----
+
+	// Number of threads running tasks, counting the calling one
+	int getNumThreads() {
+		return static_cast<int>(_threads.size()) + 1;
+	}
+
+	void run(int pNumTasks, WORKER_TASK pTask, void *pUserData) {
+		if (_threads.empty()) {
+			for (int i = 0; i < pNumTasks; i++) {
+				pTask(pUserData, i);
+			}
+			return;
+		}
+
+		// Threads late for the last run must leave before the tasks are changed
+		SDL_LockMutex(_mutex);
+		while (_busy) {
+			SDL_CondWait(_idle, _mutex);
+		}
+		_task = pTask;
+		_userData = pUserData;
+		_numTasks = pNumTasks;
+		SDL_AtomicSet(&_nextTask, 0);
+		_generation++;
+		SDL_CondBroadcast(_wake);
+		SDL_UnlockMutex(_mutex);
+
+		work(pTask, pUserData, pNumTasks);
+
+		// All the tasks are taken: wait for the ones still running
+		SDL_LockMutex(_mutex);
+		while (_busy) {
+			SDL_CondWait(_idle, _mutex);
+		}
+		SDL_UnlockMutex(_mutex);
+	}
+
+private:
+
+	// ----- Private -----
+
+	std::vector<SDL_Thread *> _threads;
+	SDL_mutex *_mutex;
+	SDL_cond *_wake;                    // New tasks, or end of the pool
+	SDL_cond *_idle;                    // No thread is running tasks
+	bool _quit;
+	unsigned int _generation;           // Number of runs, to wake up only once for each one
+	int _busy;                          // Threads running tasks
+
+	// Tasks of the current run
+	WORKER_TASK _task;
+	void *_userData;
+	int _numTasks;
+	SDL_atomic_t _nextTask;
+
+	// ----- Private methods -----
+
+	void work(WORKER_TASK pTask, void *pUserData, int pNumTasks) {
+		for (;;) {
+			int mTask = SDL_AtomicAdd(&_nextTask, 1);
+			if (mTask >= pNumTasks) return;
+			pTask(pUserData, mTask);
+		}
+	}
+
+	static int SDLCALL threadMain(void *pData) {
+		WorkerPool *mPool = static_cast<WorkerPool *>(pData);
+
+		SDL_LockMutex(mPool->_mutex);
+		unsigned int mSeen = mPool->_generation;
+		for (;;) {
+			while (!mPool->_quit && mPool->_generation == mSeen) {
+				SDL_CondWait(mPool->_wake, mPool->_mutex);
+			}
+			if (mPool->_quit) break;
+
+			mSeen = mPool->_generation;
+			WORKER_TASK mTask = mPool->_task;
+			void *mUserData = mPool->_userData;
+			int mNumTasks = mPool->_numTasks;
+			mPool->_busy++;
+			SDL_UnlockMutex(mPool->_mutex);
+
+			mPool->work(mTask, mUserData, mNumTasks);
+
+			SDL_LockMutex(mPool->_mutex);
+			if (!--mPool->_busy) {
+				SDL_CondBroadcast(mPool->_idle);
+			}
+		}
+		SDL_UnlockMutex(mPool->_mutex);
+
+		return 0;
+	}
+
+	// Not copyable
+	WorkerPool(const WorkerPool &);
+	WorkerPool &operator=(const WorkerPool &);
+};
+
+/** @endcond */
+
+#endif // _WORKERPOOL_
@@ -215,6 +215,21 @@ public:
 
 	void setTransform2d(IND_Matrix &pTransformMatrix);
 
+	void calculateTransform2d(int pX,
+	                          int  pY,
+	                          float pAngleX,
+	                          float pAngleY,
+	                          float pAngleZ,
+	                          float pScaleX,
+	                          float pScaleY,
+	                          int pAxisCalX,
+	                          int pAxisCalY,
+	                          bool pMirrorX,
+	                          bool pMirrorY,
+	                          int pWidth,
+	                          int pHeight,
+	                          IND_Matrix &pMatrix);
+
 	void setIdentityTransform2d ();
 
 	void setTransform3d(float pX,
@@ -318,6 +333,12 @@ public:
 
 	// ----- Rendering steps -----
 	void reCalculateFrustrumPlanes();
+	bool cullBox2d(float pX1, float pY1, float pX2, float pY2);
+	bool isBox2dOut(float pX1, float pY1, float pX2, float pY2);
+	void addNumDiscardedObjects(int pNum) {
+		_numDiscardedObjects += pNum;
+	}
+	bool getFrustumBox2d(float *pBox);
 
 	// ----- Atributtes -----
 
@@ -354,6 +375,12 @@ public:
 		return _info._maxTextureSize;
 	}
 
+	//Surfaces are cut in power of two blocks: the texture builder creates D3DX textures of the block size,
+	//which are only kept exact on hardware without D3DPTEXTURECAPS_POW2
+	bool isNPOTTextureSupported() {
+		return false;
+	}
+
 	//This function returns the pointer to Direct3d.
 	LPDIRECT3D9 GetDirect3d()      {
 		return _info._direct3d;
@@ -386,6 +413,77 @@ public:
 		_numDiscardedObjects = 0;
 	}
 
+	// ----- Sprite batching -----
+
+	//Rendered objects are drawn as they come, each one in its own draw call
+	void setSpriteBatching(bool)      {
+	}
+
+	bool isSpriteBatching()      {
+		return false;
+	}
+
+	void flushSpriteBatch()      {
+	}
+
+	//Copies of a surface are drawn one by one, there is no instanced path
+	void setInstancing(bool)      {
+	}
+
+	bool isInstancing()      {
+		return false;
+	}
+
+	bool isInstancingSupported()      {
+		return false;
+	}
+
+	//Distance fields can't be thresholded here, so fonts load with bitmap glyphs
+	void setDistanceField(bool)      {
+	}
+
+	bool isDistanceFieldSupported()      {
+		return false;
+	}
+
+	// ----- Render state cache -----
+
+	//Render state changes go straight to the device, so none are counted as skipped
+	void getNumIssuedStateChangesString(char* pBuffer)      {
+		IND_Math::itoa(0, pBuffer);
+	}
+
+	void getNumSkippedStateChangesString(char* pBuffer)      {
+		IND_Math::itoa(0, pBuffer);
+	}
+
+	int getNumIssuedStateChangesInt()      {
+		return 0;
+	}
+
+	int getNumSkippedStateChangesInt()      {
+		return 0;
+	}
+
+	void resetNumStateChanges()      {
+	}
+
+	void forgetTextureState(unsigned int *, int)      {
+	}
+
+	// ----- Text geometry -----
+
+	//Text is drawn with blitText() every frame, there's no geometry to keep
+	bool buildTextGeometry(IND_Font *, char *, int, int, float, float, IND_Align, std::vector<CUSTOMVERTEX2D> &)      {
+		return false;
+	}
+
+	void blitTextGeometry(IND_Font *, std::vector<CUSTOMVERTEX2D> &, int, int, float, float,
+	                      unsigned char, unsigned char, unsigned char, unsigned char,
+	                      unsigned char, unsigned char, unsigned char, unsigned char,
+	                      IND_Filter, IND_BlendingType, IND_BlendingType)      {
+	}
+
 private:
 
 	// ----- Private methods -----
@@ -154,11 +154,36 @@ void DirectXRender::setTransform2d(int pX,
                                    int pWidth,
                                    int pHeight,
                                    IND_Matrix *pMatrix) {
+	IND_Matrix mMatrix;
+	calculateTransform2d(pX, pY, pAngleX, pAngleY, pAngleZ, pScaleX, pScaleY, pAxisCalX, pAxisCalY, pMirrorX, pMirrorY, pWidth, pHeight, mMatrix);
+
+	// ----- Applies the transformation -----
+	setTransform2d(mMatrix);
+
+	// ----- Return World Matrix (in IndieLib format) -----
+	if (pMatrix) {
+		*pMatrix = mMatrix;
+	}
+}
+
+void DirectXRender::calculateTransform2d(int pX,
+                                         int pY,
+                                         float pAngleX,
+                                         float pAngleY,
+                                         float pAngleZ,
+                                         float pScaleX,
+                                         float pScaleY,
+                                         int pAxisCalX,
+                                         int pAxisCalY,
+                                         bool pMirrorX,
+                                         bool pMirrorY,
+                                         int pWidth,
+                                         int pHeight,
+                                         IND_Matrix &pMatrix) {
 	// ----- World matrix initialization -----
 
 	D3DXMATRIX mMatWorld, mMatZ, mMatX, mMatY, mMatTraslation, mMatScale;
-	//Initializes every object transform with pixel to point scale transform
-	_info._device->SetTransform(D3DTS_WORLD, D3DXMatrixIdentity(&mMatWorld));
+	D3DXMatrixIdentity(&mMatWorld);
 
 	// ----- Transformation matrix creation -----
 
@@ -228,12 +253,7 @@ void DirectXRender::setTransform2d(int pX,
 	}
 
 	// ----- Return World Matrix (in IndieLib format) -----
-	if (pMatrix) {
-		pMatrix->readFromArray(&mMatWorld.m[0][0]);
-	}
-
-	// ----- Applies the transformation -----
-	_info._device->SetTransform(D3DTS_WORLD, &mMatWorld);
+	pMatrix.readFromArray(&mMatWorld.m[0][0]);
 }
 
 void DirectXRender::setTransform2d(IND_Matrix &pMatrix) {
@@ -91,6 +91,44 @@ void OpenGLES2Render::reCalculateFrustrumPlanes() {
 	}
 }
 
+/*
+==================
+Checks a box in world coordinates against the frustum planes, before touching the render state.
+Returns true if it is out of the screen (counted as a discarded object)
+==================
+*/
+bool OpenGLES2Render::cullBox2d(float pX1, float pY1, float pX2, float pY2) {
+	if (!isBox2dOut(pX1, pY1, pX2, pY2)) {
+		return false;
+	}
+
+	_numDiscardedObjects++;
+	return true;
+}
+
+/*
+==================
+Same check as cullBox2d(), without counting it. It only reads the frustum planes, so it can be
+called from other threads while the render state is not changed
+==================
+*/
+bool OpenGLES2Render::isBox2dOut(float pX1, float pY1, float pX2, float pY2) {
+	IND_Vector3 mMin (pX1, pY1, 0.0f);
+	IND_Vector3 mMax (pX2, pY2, 0.0f);
+
+	return !_math.cullFrustumBox(mMin, mMax, _frustrumPlanes);
+}
+
+/*
+==================
+Box of the screen in world coordinates (x1, y1, x2, y2), using the frustum planes. Returns false if
+it can't be calculated
+==================
+*/
+bool OpenGLES2Render::getFrustumBox2d(float *pBox) {
+	return _math.calculateFrustumBox2d(_frustrumPlanes, pBox);
+}
+
 /*
 ==================
 Transforms vertices (supposedly from a quad) to world coordinates using the cached
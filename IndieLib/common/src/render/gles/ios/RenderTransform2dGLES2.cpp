@@ -129,15 +129,37 @@ void OpenGLES2Render::setTransform2d(int pX,
                                   int pWidth,
                                   int pHeight,
                                   IND_Matrix *pMatrix) {
+	IND_Matrix mMatrix;
+	calculateTransform2d(pX, pY, pAngleX, pAngleY, pAngleZ, pScaleX, pScaleY, pAxisCalX, pAxisCalY, pMirrorX, pMirrorY, pWidth, pHeight, mMatrix);
+
+	// ----- Applies the transformation -----
+	setTransform2d(mMatrix);
+
+	// ----- Return World Matrix (in IndieLib format) ----
+	if (pMatrix) {
+		*pMatrix = mMatrix;
+	}
+}
+
+void OpenGLES2Render::calculateTransform2d(int pX,
+                                        int pY,
+                                        float pAngleX,
+                                        float pAngleY,
+                                        float pAngleZ,
+                                        float pScaleX,
+                                        float pScaleY,
+                                        int pAxisCalX,
+                                        int pAxisCalY,
+                                        bool pMirrorX,
+                                        bool pMirrorY,
+                                        int pWidth,
+                                        int pHeight,
+                                        IND_Matrix &pMatrix) {
 
 	//Temporal holders for all accumulated transforms
 	IND_Matrix totalTrans;
 	_math.matrix4DSetIdentity(totalTrans);
 
-	//Initialize to identity given matrix, if exists
-	if (pMatrix) {
-		_math.matrix4DSetIdentity(*pMatrix);
-	}
     
 	// Translations
 	if (pX != 0 || pY != 0) {
@@ -213,17 +235,7 @@ void OpenGLES2Render::setTransform2d(int pX,
 			_math.matrix4DMultiplyInPlace(totalTrans,mirrorY);
 		}
 	}
-	//Cache the change
-	_modelToWorld = totalTrans;
-
-	//ModelView matrix will be camera * modelToWorld
-    _math.matrix4DMultiply(_cameraMatrix, _modelToWorld, _shaderModelViewMatrix);
-
-	// ----- Return World Matrix (in IndieLib format) ----
-	//Transformations have been applied where needed
-	if (pMatrix) {
-		*pMatrix = totalTrans;
-	}
+	pMatrix = totalTrans;
 }
 
 void OpenGLES2Render::setTransform2d(IND_Matrix &pMatrix) {
@@ -171,6 +171,9 @@ void OpenGLRender::endScene() {
 	if (!_ok)
 		return;
 
+	//Draw whatever is left in the sprite batch
+	flushSpriteBatch();
+
 	//Swap memory buffers (OS-dependant)
 	_osOpenGLMgr->presentBuffer();
 
@@ -204,6 +207,9 @@ void OpenGLRender::getNumDiscardedObjectsString(char *pBuffer)      {
 void OpenGLRender::end() {
 	if (_ok) {
 		g_debug->header("Finalizing OpenGL", DebugApi::LogHeaderBegin);
+		releaseSpriteBatch();
+		releaseInstancing();
+		releaseDistanceField();
 		_osOpenGLMgr->endOpenGLContext();
 		freeVars();
 		g_debug->header("OpenGL finalized ", DebugApi::LogHeaderEnd);
@@ -223,6 +229,16 @@ Init vars
 void OpenGLRender::initVars() {
 	_numrenderedObjects = 0;
 	_numDiscardedObjects = 0;
+	_numIssuedStateChanges = 0;
+	_numSkippedStateChanges = 0;
+	invalidateGLStateCache();
+	_batchSuspended = false;
+	_batch.numQuads = 0;
+	_instances.numInstances = 0;
+	_currentColor[0] = _currentColor[1] = _currentColor[2] = _currentColor[3] = 255;
+	_cameraMatrix = IND_Matrix::identity();
+	_projectionMatrix = IND_Matrix::identity();
+	_frustrumDirty = true;
 	_window = NULL;
 	_math.init();
 	_osOpenGLMgr = NULL;
@@ -255,6 +271,15 @@ bool OpenGLRender::initializeOpenGLRender() {
 
 	//Get all graphics device information
 	getInfo();
+
+	//Buffers for sprite batching
+	initSpriteBatch();
+
+	//Program and buffers for instanced draws, if the hardware has them
+	initInstancing();
+
+	//Program for distance field surfaces, if the hardware has shaders
+	initDistanceField();
     
     //Window params
     _info._fbWidth = _window->getWidth();
@@ -285,11 +310,267 @@ bool OpenGLRender::checkGLExtensions() {
 
 	strcpy(_info._version, MINIMUM_OPENGL_VERSION_STRING);
 
+	//Textures of any size (surfaces don't need to be cut in power of two blocks)
+	_info._npotTextures = (GLEW_ARB_texture_non_power_of_two != 0);
+
+	//Many copies of a block in one draw call (needs shaders for the per-copy transform)
+	_info._instancing = (GLEW_VERSION_2_0 && GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced);
+
 	//TODO: Other extensions
 
 	return true;
 }
 
+/*
+==================
+Creates the buffers used by the sprite batch. If buffer objects can't be created, batches
+are drawn from client memory
+==================
+*/
+void OpenGLRender::initSpriteBatch() {
+	_batch = SpriteBatch();
+
+	//Quad vertices come in triangle strip order, so (0,1,2),(2,1,3) keeps the winding
+	for (int i = 0; i < MAX_BATCH_QUADS; i++) {
+		GLushort mFirst = static_cast<GLushort>(i * 4);
+		_batchIndices[i * 6]     = mFirst;
+		_batchIndices[i * 6 + 1] = mFirst + 1;
+		_batchIndices[i * 6 + 2] = mFirst + 2;
+		_batchIndices[i * 6 + 3] = mFirst + 2;
+		_batchIndices[i * 6 + 4] = mFirst + 1;
+		_batchIndices[i * 6 + 5] = mFirst + 3;
+	}
+
+	glGenBuffers(1, &_batch.vertexBuffer);
+	glGenBuffers(1, &_batch.indexBuffer);
+	if (!_batch.vertexBuffer || !_batch.indexBuffer) {
+		g_debug->header("Sprite batch buffers not available, using client memory", DebugApi::LogHeaderWarning);
+		releaseSpriteBatch();
+		return;
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _batch.indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(_batchIndices), _batchIndices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+/*
+==================
+Deletes sprite batch buffers. Must be called while the GL context is alive
+==================
+*/
+void OpenGLRender::releaseSpriteBatch() {
+	if (_batch.vertexBuffer) {
+		glDeleteBuffers(1, &_batch.vertexBuffer);
+	}
+	if (_batch.indexBuffer) {
+		glDeleteBuffers(1, &_batch.indexBuffer);
+	}
+	_batch.vertexBuffer = 0;
+	_batch.indexBuffer = 0;
+	_batch.numQuads = 0;
+}
+
+/*
+==================
+Instanced draw shaders. A copy is the block quad (uniform, same for all copies) moved by its
+own 2d transform. Result is the same as the fixed pipeline: texture modulated by the tint
+==================
+*/
+static const char *g_instanceVertexShader =
+    "#version 120\n"
+    "attribute float aCorner;\n"
+    "attribute vec3 aRow0;\n"
+    "attribute vec3 aRow1;\n"
+    "attribute vec4 aColor;\n"
+    "uniform vec4 uQuad[4];\n"
+    "varying vec2 vTexCoord;\n"
+    "varying vec4 vColor;\n"
+    "void main() {\n"
+    "    vec4 corner = uQuad[int(aCorner)];\n"
+    "    vec3 local = vec3(corner.xy, 1.0);\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * vec4(dot(aRow0, local), dot(aRow1, local), 0.0, 1.0);\n"
+    "    vTexCoord = corner.zw;\n"
+    "    vColor = aColor;\n"
+    "}\n";
+
+static const char *g_instanceFragmentShader =
+    "#version 120\n"
+    "uniform sampler2D uTexture;\n"
+    "varying vec2 vTexCoord;\n"
+    "varying vec4 vColor;\n"
+    "void main() {\n"
+    "    gl_FragColor = texture2D(uTexture, vTexCoord) * vColor;\n"
+    "}\n";
+
+static GLuint compileShader(GLenum pType, const char *pSource) {
+	GLuint mShader = glCreateShader(pType);
+	glShaderSource(mShader, 1, &pSource, NULL);
+	glCompileShader(mShader);
+
+	GLint mCompiled = GL_FALSE;
+	glGetShaderiv(mShader, GL_COMPILE_STATUS, &mCompiled);
+	if (!mCompiled) {
+		glDeleteShader(mShader);
+		return 0;
+	}
+	return mShader;
+}
+
+/*
+==================
+Creates the program and buffers for instanced draws. When anything fails instancing stays off,
+and surfaces go through the sprite batch as usual
+==================
+*/
+void OpenGLRender::initInstancing() {
+	_instances = InstanceBatch();
+
+	if (!_info._instancing) {
+		return;
+	}
+
+	GLuint mVertexShader = compileShader(GL_VERTEX_SHADER, g_instanceVertexShader);
+	GLuint mFragmentShader = compileShader(GL_FRAGMENT_SHADER, g_instanceFragmentShader);
+	if (!mVertexShader || !mFragmentShader) {
+		g_debug->header("Instancing shaders not compiled, using sprite batch", DebugApi::LogHeaderWarning);
+		if (mVertexShader) glDeleteShader(mVertexShader);
+		if (mFragmentShader) glDeleteShader(mFragmentShader);
+		return;
+	}
+
+	_instances.program = glCreateProgram();
+	glAttachShader(_instances.program, mVertexShader);
+	glAttachShader(_instances.program, mFragmentShader);
+	glBindAttribLocation(_instances.program, INSTANCE_ATTRIB_CORNER, "aCorner");
+	glBindAttribLocation(_instances.program, INSTANCE_ATTRIB_ROW0, "aRow0");
+	glBindAttribLocation(_instances.program, INSTANCE_ATTRIB_ROW1, "aRow1");
+	glBindAttribLocation(_instances.program, INSTANCE_ATTRIB_COLOR, "aColor");
+	glLinkProgram(_instances.program);
+
+	//Shaders live while the program does
+	glDeleteShader(mVertexShader);
+	glDeleteShader(mFragmentShader);
+
+	GLint mLinked = GL_FALSE;
+	glGetProgramiv(_instances.program, GL_LINK_STATUS, &mLinked);
+	if (!mLinked) {
+		g_debug->header("Instancing program not linked, using sprite batch", DebugApi::LogHeaderWarning);
+		releaseInstancing();
+		return;
+	}
+
+	_instances.quadLocation = glGetUniformLocation(_instances.program, "uQuad");
+	glUseProgram(_instances.program);
+	glUniform1i(glGetUniformLocation(_instances.program, "uTexture"), 0);
+	glUseProgram(0);
+
+	//Index of each block vertex, in triangle strip order
+	const GLfloat mCorners [4] = {0.0f, 1.0f, 2.0f, 3.0f};
+	glGenBuffers(1, &_instances.cornerBuffer);
+	glGenBuffers(1, &_instances.instanceBuffer);
+	if (!_instances.cornerBuffer || !_instances.instanceBuffer) {
+		g_debug->header("Instancing buffers not available, using sprite batch", DebugApi::LogHeaderWarning);
+		releaseInstancing();
+		return;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, _instances.cornerBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(mCorners), mCorners, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/*
+==================
+Deletes instancing program and buffers. Must be called while the GL context is alive
+==================
+*/
+void OpenGLRender::releaseInstancing() {
+	if (_instances.program) {
+		glDeleteProgram(_instances.program);
+	}
+	if (_instances.cornerBuffer) {
+		glDeleteBuffers(1, &_instances.cornerBuffer);
+	}
+	if (_instances.instanceBuffer) {
+		glDeleteBuffers(1, &_instances.instanceBuffer);
+	}
+	_instances.program = 0;
+	_instances.cornerBuffer = 0;
+	_instances.instanceBuffer = 0;
+	_instances.quadLocation = -1;
+	_instances.numInstances = 0;
+}
+
+/*
+==================
+Distance field shader. Texture alpha is the distance to the edge (0.5 at the edge), and the
+edge is smoothed over one screen pixel at any scale. The vertex stage is the fixed pipeline
+==================
+*/
+static const char *g_distanceFieldFragmentShader =
+    "#version 120\n"
+    "uniform sampler2D uTexture;\n"
+    "void main() {\n"
+    "    float distance = texture2D(uTexture, gl_TexCoord[0].xy).a;\n"
+    "    float width = max(fwidth(distance) * 0.5, 0.001);\n"
+    "    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);\n"
+    "    gl_FragColor = vec4(gl_Color.rgb, gl_Color.a * alpha);\n"
+    "}\n";
+
+/*
+==================
+Creates the program for distance field surfaces. When shaders aren't available, or anything
+fails, distance fields use the alpha test
+==================
+*/
+void OpenGLRender::initDistanceField() {
+	_distanceField = false;
+	_distanceFieldProgram = 0;
+
+	if (!GLEW_VERSION_2_0) {
+		return;
+	}
+
+	GLuint mFragmentShader = compileShader(GL_FRAGMENT_SHADER, g_distanceFieldFragmentShader);
+	if (!mFragmentShader) {
+		g_debug->header("Distance field shader not compiled, using alpha test", DebugApi::LogHeaderWarning);
+		return;
+	}
+
+	_distanceFieldProgram = glCreateProgram();
+	glAttachShader(_distanceFieldProgram, mFragmentShader);
+	glLinkProgram(_distanceFieldProgram);
+
+	//Shader lives while the program does
+	glDeleteShader(mFragmentShader);
+
+	GLint mLinked = GL_FALSE;
+	glGetProgramiv(_distanceFieldProgram, GL_LINK_STATUS, &mLinked);
+	if (!mLinked) {
+		g_debug->header("Distance field program not linked, using alpha test", DebugApi::LogHeaderWarning);
+		releaseDistanceField();
+		return;
+	}
+
+	glUseProgram(_distanceFieldProgram);
+	glUniform1i(glGetUniformLocation(_distanceFieldProgram, "uTexture"), 0);
+	glUseProgram(0);
+}
+
+/*
+==================
+Deletes the distance field program. Must be called while the GL context is alive
+==================
+*/
+void OpenGLRender::releaseDistanceField() {
+	if (_distanceFieldProgram) {
+		glDeleteProgram(_distanceFieldProgram);
+	}
+	_distanceFieldProgram = 0;
+	_distanceField = false;
+}
+
 /*
 ==================
 Free memory
@@ -358,6 +639,18 @@ void OpenGLRender::writeInfo() {
 	g_debug->header("Texture units:" , DebugApi::LogHeaderInfo);
 	g_debug->dataInt(_info._textureUnits, 0);
 
+	g_debug->header("Non power of two textures:" , DebugApi::LogHeaderInfo);
+	if (_info._npotTextures)
+		g_debug->dataChar("Yes", 1);
+	else
+		g_debug->dataChar("No", 1);
+
+	g_debug->header("Instanced rendering:" , DebugApi::LogHeaderInfo);
+	if (_info._instancing)
+		g_debug->dataChar("Yes", 1);
+	else
+		g_debug->dataChar("No", 1);
+
 
 	// ----- Vertex Shader version  -----
 
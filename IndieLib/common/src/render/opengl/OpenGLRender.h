@@ -46,6 +46,8 @@
 // ----- Includes -----
 
 #include <string.h>
+#include <map>
+#include <vector>
 #include "Defines.h"
 #include "IND_Math.h"
 #include "IND_Render.h"
@@ -72,6 +74,15 @@ class OSOpenGLManager;
 
 // ----- Defines ------
 #define MAX_PIXELS 2048
+#define MAX_BATCH_QUADS 2048
+#define MAX_INSTANCES 4096
+//Attribute locations of the instancing program. GL requires location 0 to be fed by an array. The rest
+//skip the locations that drivers share with the normal and color arrays of the immediate blits
+#define INSTANCE_ATTRIB_CORNER 0
+#define INSTANCE_ATTRIB_ROW0 5
+#define INSTANCE_ATTRIB_ROW1 6
+#define INSTANCE_ATTRIB_COLOR 7
+#define GLSTATE_UNKNOWN -1
 
 struct InfoStruct {
     InfoStruct():
@@ -85,6 +96,8 @@ struct InfoStruct {
     _antialiasing(0),
     _maxTextureSize(0),
     _textureUnits(0),
+    _npotTextures(false),
+    _instancing(false),
     _pointPixelScale(1.0f){
         strcpy(_version, "NO DATA");
         strcpy(_vendor, "NO DATA");
@@ -103,6 +116,8 @@ struct InfoStruct {
     char _renderer [1024];
     int _maxTextureSize;
     int _textureUnits;
+    bool _npotTextures;
+    bool _instancing;
     float _pointPixelScale;
 };
 
@@ -120,6 +135,114 @@ struct TextureSamplerState {
     GLint wrapT;
 };
 
+//Last values set in GL for the state touched by the 2d renderer. GLSTATE_UNKNOWN means
+//the value has to be set no matter what, as GL could hold anything
+struct GLStateCache {
+    GLStateCache() {
+        invalidate();
+    }
+
+    void invalidate() {
+        boundTexture = GLSTATE_UNKNOWN;
+        texture2d = cullFace = blend = alphaTest = GLSTATE_UNKNOWN;
+        frontFace = blendSrc = blendDst = GLSTATE_UNKNOWN;
+        vertexArray = texCoordArray = colorArray = normalArray = GLSTATE_UNKNOWN;
+        texEnvMode = GLSTATE_UNKNOWN;
+        colorKnown = false;
+    }
+
+    GLint boundTexture;
+    //Capabilities and client arrays: 0 (disabled), 1 (enabled) or unknown
+    GLint texture2d;
+    GLint cullFace;
+    GLint blend;
+    GLint alphaTest;
+    GLint vertexArray;
+    GLint texCoordArray;
+    GLint colorArray;
+    GLint normalArray;
+    GLint frontFace;
+    GLint blendSrc;
+    GLint blendDst;
+    GLint texEnvMode;
+    bool colorKnown;
+    unsigned char color [4];
+    //Filter and wrap are texture object state, so they are kept per texture
+    std::map<GLuint, TextureSamplerState> textureParams;
+};
+
+//Vertex of the sprite batch. Positions are already transformed to world coords
+struct BatchVertex2d {
+    float _x, _y, _z;
+    float _u, _v;
+    unsigned char _r, _g, _b, _a;
+};
+
+//GL state which can't change in the middle of a batch (set from rainbow2d API)
+struct RasterState2d {
+    RasterState2d() :
+    blendSrc(GL_ONE),
+    blendDst(GL_ZERO),
+    cullFace(false),
+    frontFace(GL_CW)
+    {}
+
+    bool operator==(const RasterState2d &pOther) const {
+        return blendSrc == pOther.blendSrc && blendDst == pOther.blendDst &&
+               cullFace == pOther.cullFace && frontFace == pOther.frontFace;
+    }
+
+    GLenum blendSrc;
+    GLenum blendDst;
+    bool cullFace;
+    GLenum frontFace;
+};
+
+//Quads accumulated for a single draw call. All of them share texture, sampler and raster state
+struct SpriteBatch {
+    SpriteBatch() :
+    texture(0),
+    numQuads(0),
+    vertexBuffer(0),
+    indexBuffer(0)
+    {}
+
+    GLuint texture;
+    TextureSamplerState sampler;
+    int numQuads;
+    GLuint vertexBuffer;
+    GLuint indexBuffer;
+};
+
+//Per-copy data of an instanced draw: the two first rows of the 'model-to-world' matrix and the tint
+struct InstanceData2d {
+    float _row0 [3];
+    float _row1 [3];
+    unsigned char _r, _g, _b, _a;
+};
+
+//Copies of one surface block drawn in a single instanced call. All of them share texture, sampler,
+//raster state and block vertices; only transform and tint change from one copy to another
+struct InstanceBatch {
+    InstanceBatch() :
+    texture(0),
+    numInstances(0),
+    program(0),
+    cornerBuffer(0),
+    instanceBuffer(0),
+    quadLocation(-1)
+    {}
+
+    GLuint texture;
+    TextureSamplerState sampler;
+    float quad [16];             //x, y, u, v of the 4 block vertices
+    int numInstances;
+    GLuint program;
+    GLuint cornerBuffer;
+    GLuint instanceBuffer;
+    GLint quadLocation;
+};
+
 /** @cond DOCUMENT_PRIVATEAPI */
 
 // --------------------------------------------------------------------------------
@@ -137,7 +260,14 @@ public:
 		_ok(false),
     	_numrenderedObjects(0),
     	_numDiscardedObjects(0),
-		_doubleBuffer(false)
+    	_numIssuedStateChanges(0),
+    	_numSkippedStateChanges(0),
+		_doubleBuffer(false),
+		_spriteBatching(true),
+		_batchSuspended(false),
+		_instancing(true),
+		_distanceField(false),
+		_distanceFieldProgram(0)
 	{ }
 	~OpenGLRender()              {
 		end();
@@ -270,6 +400,21 @@ public:
 
 	void setTransform2d(IND_Matrix &pTransformMatrix);
 
+	void calculateTransform2d(int pX,
+	                          int  pY,
+	                          float pAngleX,
+	                          float pAngleY,
+	                          float pAngleZ,
+	                          float pScaleX,
+	                          float pScaleY,
+	                          int pAxisCalX,
+	                          int pAxisCalY,
+	                          bool pMirrorX,
+	                          bool pMirrorY,
+	                          int pWidth,
+	                          int pHeight,
+	                          IND_Matrix &pMatrix);
+
 	void setIdentityTransform2d ();
 
 	void setTransform3d(float pX,
@@ -369,6 +514,33 @@ public:
 	              IND_BlendingType pDs,
 	              IND_Align pAlign);
 
+	bool buildTextGeometry(IND_Font *pFo,
+	                       char *pText,
+	                       int pOffset,
+	                       int pLineSpacing,
+	                       float pScaleX,
+	                       float pScaleY,
+	                       IND_Align pAlign,
+	                       std::vector<CUSTOMVERTEX2D> &pVertices);
+
+	void blitTextGeometry(IND_Font *pFo,
+	                      std::vector<CUSTOMVERTEX2D> &pVertices,
+	                      int pX,
+	                      int pY,
+	                      float pScaleX,
+	                      float pScaleY,
+	                      unsigned char pR,
+	                      unsigned char pG,
+	                      unsigned char pB,
+	                      unsigned char pA,
+	                      unsigned char pFadeR,
+	                      unsigned char pFadeG,
+	                      unsigned char pFadeB,
+	                      unsigned char pFadeA,
+	                      IND_Filter pLinearFilter,
+	                      IND_BlendingType pSo,
+	                      IND_BlendingType pDs);
+
 
 	void blit3dMesh(IND_3dMesh *p3dMesh);
 	void set3dMeshSequence(IND_3dMesh *p3dMesh, unsigned int pIndex);	
@@ -408,6 +580,10 @@ public:
 		return _info._maxTextureSize;
 	}
 
+	bool isNPOTTextureSupported() {
+		return _info._npotTextures;
+	}
+
 	//This function returns a pointer to the IND_Window object where the render has been created
 	IND_Window *getWindow()      {
 		return _window;
@@ -431,6 +607,58 @@ public:
 		_numDiscardedObjects = 0;
 	}
 
+	// ----- Sprite batching -----
+
+	void setSpriteBatching(bool pSwitch);
+
+	bool isSpriteBatching()      {
+		return _spriteBatching;
+	}
+
+	void flushSpriteBatch();
+
+	// ----- Instancing -----
+
+	void setInstancing(bool pSwitch);
+
+	bool isInstancing()      {
+		return _instancing && _instances.program;
+	}
+
+	bool isInstancingSupported()      {
+		return _instances.program != 0;
+	}
+
+	// ----- Distance fields -----
+
+	void setDistanceField(bool pSwitch);
+
+	//Without shaders the alpha test is used
+	bool isDistanceFieldSupported()      {
+		return true;
+	}
+
+	// ----- GL state cache -----
+
+	void getNumIssuedStateChangesString(char* pBuffer);
+
+	void getNumSkippedStateChangesString(char* pBuffer);
+
+	int getNumIssuedStateChangesInt()      {
+		return _numIssuedStateChanges;
+	}
+
+	int getNumSkippedStateChangesInt()      {
+		return _numSkippedStateChanges;
+	}
+
+	void resetNumStateChanges()      {
+		_numIssuedStateChanges = 0;
+		_numSkippedStateChanges = 0;
+	}
+
+	void forgetTextureState(const GLuint *pTextures, int pNumTextures);
+
 private:
 
 	// ----- Private methods -----
@@ -457,11 +685,7 @@ private:
 	void blitGridLine (int pPosX1, int pPosY1, int pPosX2, int pPosY2,  unsigned char pR, unsigned char pG, unsigned char pB, unsigned char pA);
 
 	//Text rendering helpers
-	int getLongInPixels(IND_Font *pFo, char *pText, int pPos, int pOffset);
-    
-    void blitCharsMudFont(IND_Font *pFo, char *pText, IND_Align pAlign, int pOffset, float pScaleX, float pScaleY, int pLineSpacing);
-    
-    void blitCharsAngelCodeFont(IND_Font *pFo, char *pText, IND_Align pAlign, int pOffset, float pScaleX, float pScaleY, int pLineSpacing);
+	int getLineTranslation(IND_Align pAlign, int pLine, float pScaleX);
 
 	//Setup helper
 	bool resetViewport(int pWitdh, int pHeight);
@@ -472,7 +696,40 @@ private:
     void setGLClientStateToPrimitive();
     void setGLClientStateToTexturing();
 
-    void setGLBoundTextureParams();
+    void setGLBoundTextureParams(GLint pWrap);
+
+    //GL state cache helpers. GL is only called when the value differs from the cached one
+    void invalidateGLStateCache();
+    void setGLCapability(GLenum pCap, GLint &pCached, bool pEnable);
+    void setGLClientArray(GLenum pArray, GLint &pCached, bool pEnable);
+    void setGLFrontFace(GLenum pMode);
+    void setGLBlendFunc(GLenum pSrc, GLenum pDst);
+    void setGLTexEnvMode(GLint pMode);
+    void setGLColor(const unsigned char *pColor);
+    void bindGLTexture(GLuint pTexture);
+    void setGLTextureParams(const TextureSamplerState &pState);
+
+    //Sprite batching helpers
+    void initSpriteBatch();
+    void releaseSpriteBatch();
+    bool canBatch() {
+        return _spriteBatching && !_batchSuspended;
+    }
+    void addQuadToBatch(GLuint pTexture, GLint pWrap, IND_Vector3 *pWorldVertices, CUSTOMVERTEX2D *pVertices);
+    bool isBatchPending() {
+        return _batch.numQuads || _instances.numInstances;
+    }
+
+    //Instancing helpers
+    void initInstancing();
+    void releaseInstancing();
+    bool canInstance(IND_Surface *pSu);
+    void addInstance(GLuint pTexture, CUSTOMVERTEX2D *pVertices);
+    void flushInstances();
+
+    //Distance field helpers
+    void initDistanceField();
+    void releaseDistanceField();
     
 	// ----- Collisions -----
 	void blitCollisionCircle(int pPosX, int pPosY, int pRadius, float pScale, unsigned char pR, unsigned char pG, unsigned char pB, unsigned char pA, IND_Matrix pWorldMatrix);
@@ -480,6 +737,13 @@ private:
 
 	// ---- Culling helpers ----
 	void reCalculateFrustrumPlanes();
+	bool cullBox2d(float pX1, float pY1, float pX2, float pY2);
+	bool isBox2dOut(float pX1, float pY1, float pX2, float pY2);
+	void addNumDiscardedObjects(int pNum) {
+		_numDiscardedObjects += pNum;
+	}
+	bool getFrustumBox2d(float *pBox);
+	void setProjectionMatrix(const IND_Matrix &pMatrix);
 	void transformVerticesToWorld(float pX1, float pY1,
 											float pX2, float pY2,
 											float pX3, float pY3,
@@ -500,19 +764,43 @@ private:
 
 	int _numrenderedObjects;
 	int _numDiscardedObjects;
+	int _numIssuedStateChanges;
+	int _numSkippedStateChanges;
 
 	bool _doubleBuffer;
 
+	bool _spriteBatching;
+	bool _batchSuspended;
+
+	bool _instancing;
+
+	bool _distanceField;
+	GLuint _distanceFieldProgram;   // Edge smoothing program, 0 when using the alpha test
+
+	std::vector<int> _lineWidths;   // Width of each line of the text being drawn, for the alignment
+	std::vector<CUSTOMVERTEX2D> _textVertices;  // Quads of the text drawn by blitText()
+
 	
 	struct InfoStruct _info;
     
     struct TextureSamplerState _tex2dState;
 
+    //Raster state and color requested via rainbow2d API
+    struct RasterState2d _raster2dState;
+    unsigned char _currentColor [4];
+
+    //What GL holds right now
+    struct GLStateCache _glState;
+
 	//Current 'model-to-world' matrix
 	IND_Matrix _modelToWorld;
 
     //Current 'camera' matrix
     IND_Matrix _cameraMatrix;
+
+    //Current projection matrix. Frustum planes are outdated when any of camera or projection changes
+    IND_Matrix _projectionMatrix;
+    bool _frustrumDirty;
     
 	// ----- Primitives vertices -----
 
@@ -524,6 +812,20 @@ private:
 	// Temporal buffer of vertices for drawing regions of an IND_Surface
 	CUSTOMVERTEX2D _vertices2d [MAX_PIXELS];
 
+	// ----- Sprite batch -----
+
+	// Quads pending to be drawn in one call, in world coords
+	struct SpriteBatch _batch;
+	BatchVertex2d _batchVertices [MAX_BATCH_QUADS * 4];
+	// Two triangles per quad, built once
+	GLushort _batchIndices [MAX_BATCH_QUADS * 6];
+
+	// ----- Instanced draws -----
+
+	// Copies of the same block pending to be drawn in one instanced call
+	struct InstanceBatch _instances;
+	InstanceData2d _instanceData [MAX_INSTANCES];
+
 	// ----- Primitives vertices -----
 
 	// ----- Vertex array -----
@@ -47,15 +47,24 @@
 /** @cond DOCUMENT_PRIVATEAPI */
 
 OpenGLTextureBuilder::OpenGLTextureBuilder(IND_ImageManager *imagemgr, IND_Render *render):
-	_render(render) {
+	_render(render),
+	_atlasing(false),
+	_atlasPageSize(0) {
 	// Image cutter
 	_cutter = new ImageCutter();
-	_cutter->init(imagemgr, _render->getMaxTextureSize());
+	_cutter->init(imagemgr, _render->getMaxTextureSize(), _render->isNPOTTextureSupported());
 }
 
 OpenGLTextureBuilder::~OpenGLTextureBuilder() {
 	// Free cutter object
 	DISPOSE(_cutter);
+
+	// Free atlas pages. Surfaces using them don't own their texture
+	for (size_t i = 0; i < _atlasPages.size(); i++) {
+		glDeleteTextures(1, &_atlasPages[i]->_texture);
+		DISPOSE(_atlasPages[i]);
+	}
+	_atlasPages.clear();
 }
 
 /*
@@ -78,6 +87,16 @@ bool OpenGLTextureBuilder::createNewTexture(IND_Surface  *pNewSurface,
         return false;
     }
 #endif	
+
+    //The surface could be placed in an atlas page from a previous creation
+    releaseTexture(pNewSurface);
+
+    // ----- Atlas packing -----
+    //Only small surfaces without a requested block size go to the shared pages
+    if (_atlasing && !pBlockSizeX && !pBlockSizeY &&
+        pImage->getWidth() <= _atlasPageSize / 2 && pImage->getHeight() <= _atlasPageSize / 2) {
+        return createAtlasTexture(pNewSurface, pImage);
+    }
     
     // ----- Cutting blocks -----
     INFO_SURFACE mI;
@@ -108,6 +127,9 @@ bool OpenGLTextureBuilder::createNewTexture(IND_Surface  *pNewSurface,
 		g_debug->header("OpenGL error while creating textures ", DebugApi::LogHeaderError);
         return false;
     }
+
+    //Texture names could be reused from deleted textures, don't trust cached state for them
+    _render->forgetTextureState(pNewSurface->_surface->_texturesArray, mI._numBlocks);
 	
 	GLint mInternalFormat, mFormat, mType;
 	//Get format and type of surface (image) in GL types (and check for compatibilities)
@@ -134,10 +156,13 @@ bool OpenGLTextureBuilder::createNewTexture(IND_Surface  *pNewSurface,
 	int mActualHeightBlockY (0);
 	float mActualU (0);
 	float mActualV (0);
-	int mActualSpareX (0);
-	int mActualSpareY (0);
 	int mSrcBytespp = pImage->getBytespp(); 
 
+#ifndef INDIERENDER_GLES_IOS
+	// Rows of every block are read from the image, so GL skips the pixels of the other blocks in the row
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, mI._widthImage);
+#endif
+
 	// ----- Cutting blocks -----
 
 	// We iterate the blocks starting from the lower row
@@ -158,8 +183,6 @@ bool OpenGLTextureBuilder::createNewTexture(IND_Surface  *pNewSurface,
 				mActualHeightBlockY = mI._heightBlock;
 				mActualU            = 1.0f;
 				mActualV            = 1.0f;
-				mActualSpareX       = 0;
-				mActualSpareY       = 0;
 			}
 
 			// The ones of the right column
@@ -168,8 +191,6 @@ bool OpenGLTextureBuilder::createNewTexture(IND_Surface  *pNewSurface,
 				mActualHeightBlockY = mI._heightBlock;
 				mActualU            = (float) mI._widthSpareImage / mI._widthBlock;
 				mActualV            = 1.0f;
-				mActualSpareX       = mI._spareX;
-				mActualSpareY       = 0;
 			}
 
 			// The ones of the upper row
@@ -178,8 +199,6 @@ bool OpenGLTextureBuilder::createNewTexture(IND_Surface  *pNewSurface,
 				mActualHeightBlockY = mI._heightSpareImage;
 				mActualU            = 1.0f;
 				mActualV            = (float) mI._heightSpareImage / mI._heightBlock;
-				mActualSpareX       = 0;
-				mActualSpareY       = mI._spareY;
 			}
 
 			// The one of the upper-right corner
@@ -188,8 +207,6 @@ bool OpenGLTextureBuilder::createNewTexture(IND_Surface  *pNewSurface,
 				mActualHeightBlockY = mI._heightSpareImage;
 				mActualU            = (float) mI._widthSpareImage / mI._widthBlock;
 				mActualV            = (float) mI._heightSpareImage / mI._heightBlock;
-				mActualSpareX       = mI._spareX;
-				mActualSpareY       = mI._spareY;
 			}
 
 			// ----- Block creation (using the position, uv coordiantes and texture) -----
@@ -205,19 +222,29 @@ bool OpenGLTextureBuilder::createNewTexture(IND_Surface  *pNewSurface,
 			              mActualU,                                   // U mapping coordinate
 			              mActualV);                                  // V mapping coordinate
 
-			// Cuts a block from the image (bitmap)
+			glBindTexture(GL_TEXTURE_2D,pNewSurface->_surface->_texturesArray[mCont]);
+
+#ifdef INDIERENDER_GLES_IOS
+			// ES2 can't read a block from inside a bigger image, so the block is cut (copied) first.
+			// When the block is the whole image (one exact size texture), the image is uploaded directly
 			unsigned char *mTempBlock = 0;
-			_cutter->cutBlock(mPtrBlock,
-			                  mI._widthImage,
-			                  mI._widthBlock,
-			                  mI._heightBlock,
-			                  mActualSpareX,
-			                  mActualSpareY,
-			                  mSrcBytespp,
-			                  &mTempBlock);
+			bool mIsWholeImage = (1 == mI._numBlocks && !mI._spareX && !mI._spareY);
+			int mActualSpareX = (j == mI._blocksX) ? mI._spareX : 0;
+			int mActualSpareY = (i == 1) ? mI._spareY : 0;
+			if (mIsWholeImage) {
+				mTempBlock = mPtrBlock;
+			} else {
+				_cutter->cutBlock(mPtrBlock,
+				                  mI._widthImage,
+				                  mI._widthBlock,
+				                  mI._heightBlock,
+				                  mActualSpareX,
+				                  mActualSpareY,
+				                  mSrcBytespp,
+				                  &mTempBlock);
+			}
 
 			// We create a texture using the cut bitmap block
-			glBindTexture(GL_TEXTURE_2D,pNewSurface->_surface->_texturesArray[mCont]);
 			glTexImage2D(GL_TEXTURE_2D,
 						0,
 						mInternalFormat,
@@ -229,11 +256,29 @@ bool OpenGLTextureBuilder::createNewTexture(IND_Surface  *pNewSurface,
 						mTempBlock);
 
 			// Free the bitmap cutted block
-			DISPOSEARRAY(mTempBlock);
+			if (!mIsWholeImage) {
+				DISPOSEARRAY(mTempBlock);
+			}
+#else
+			// We create a texture reading the block straight from the image
+			uploadBlock(mPtrBlock,
+			            mI._widthImage,
+			            mI._widthBlock,
+			            mI._heightBlock,
+			            mActualWidthBlockX,
+			            mActualHeightBlockY,
+			            mSrcBytespp,
+			            mInternalFormat,
+			            mFormat,
+			            mType);
+#endif
 
 			GLenum glerror = glGetError();
 			if (glerror) {
 				g_debug->header("OpenGL error while assigning texture to buffer", DebugApi::LogHeaderError);
+#ifndef INDIERENDER_GLES_IOS
+				glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
 				//TODO: Test error and mem. leaks 
 				return false;
 			}
@@ -269,6 +314,152 @@ bool OpenGLTextureBuilder::createNewTexture(IND_Surface  *pNewSurface,
 		}
 	} //LOOP END - All blocks (Y coords)
 
+#ifndef INDIERENDER_GLES_IOS
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+
+	return true;
+}
+
+// --------------------------------------------------------------------------------
+//									Atlas pages
+// --------------------------------------------------------------------------------
+
+/*
+==================
+Enables / disables packing of small surfaces into shared textures (atlas pages) of pPageSize x pPageSize.
+Only affects surfaces created afterwards
+==================
+*/
+void OpenGLTextureBuilder::setAtlasing(bool pSwitch, int pPageSize) {
+	if (pPageSize > _render->getMaxTextureSize()) {
+		pPageSize = _render->getMaxTextureSize();
+	}
+
+	// Pages already created keep their size
+	_atlasing = pSwitch && pPageSize > 0;
+	_atlasPageSize = pPageSize;
+}
+
+bool OpenGLTextureBuilder::isAtlasing() {
+	return _atlasing;
+}
+
+int OpenGLTextureBuilder::getNumAtlasPages() {
+	return static_cast<int>(_atlasPages.size());
+}
+
+float OpenGLTextureBuilder::getAtlasPageOccupancy(int pPage) {
+	if (pPage < 0 || pPage >= getNumAtlasPages()) {
+		return 0.0f;
+	}
+
+	return _atlasPages[pPage]->_packer.getOccupancy();
+}
+
+/*
+==================
+The surface stops using its atlas page. When no surface uses the page, its texture is deleted
+==================
+*/
+void OpenGLTextureBuilder::releaseTexture(IND_Surface *pSurface) {
+	if (!pSurface || !pSurface->_surface || !pSurface->_surface->_attributes._isAtlased) {
+		return;
+	}
+
+	for (size_t i = 0; i < _atlasPages.size(); i++) {
+		ATLAS_PAGE *page = _atlasPages[i];
+		for (size_t j = 0; j < page->_surfaces.size(); j++) {
+			if (page->_surfaces[j] != pSurface) {
+				continue;
+			}
+
+			page->_surfaces.erase(page->_surfaces.begin() + j);
+			page->_packer.release(pSurface->getWidth(), pSurface->getHeight());
+
+			if (page->_surfaces.empty()) {
+				glDeleteTextures(1, &page->_texture);
+				DISPOSE(page);
+				_atlasPages.erase(_atlasPages.begin() + i);
+			}
+			return;
+		}
+	}
+}
+
+/*
+==================
+Uploads again a rectangle of the image to the texture of a surface of its same size. The rectangle
+is given in surface coordinates (pY from the upper row). Only surfaces of one texture, including
+atlased ones, are updated in place; false is returned for the rest
+==================
+*/
+bool OpenGLTextureBuilder::updateTexture(IND_Surface *pSurface, IND_Image *pImage,
+                                         int pX, int pY, int pWidth, int pHeight) {
+	if (!pSurface || !pSurface->_surface || !pImage ||
+	    pSurface->getNumTextures() != 1 ||
+	    pSurface->getWidth() != pImage->getWidth() || pSurface->getHeight() != pImage->getHeight()) {
+		return false;
+	}
+
+	if (pX < 0 || pY < 0 || pWidth <= 0 || pHeight <= 0 ||
+	    pX + pWidth > pImage->getWidth() || pY + pHeight > pImage->getHeight()) {
+		return false;
+	}
+
+	GLint mInternalFormat, mFormat, mType;
+	getGLFormat(pSurface, pImage, &mInternalFormat, &mFormat, &mType);
+	if (GL_NONE == mFormat) {
+		return false;
+	}
+
+	// Atlased surfaces start at their place in the page
+	int mOffsetX (0), mOffsetY (0);
+	if (pSurface->isAtlased()) {
+		ATLAS_PAGE *mPage = NULL;
+		for (size_t i = 0; i < _atlasPages.size() && !mPage; i++) {
+			for (size_t j = 0; j < _atlasPages[i]->_surfaces.size(); j++) {
+				if (_atlasPages[i]->_surfaces[j] == pSurface) {
+					mPage = _atlasPages[i];
+					break;
+				}
+			}
+		}
+		if (!mPage) {
+			return false;
+		}
+
+		float mPageSize (static_cast<float>(mPage->_packer.getWidth()));
+		mOffsetX = static_cast<int>(pSurface->_surface->_attributes._u0 * mPageSize + 0.5f);
+		mOffsetY = static_cast<int>(pSurface->_surface->_attributes._v0 * mPageSize + 0.5f);
+	}
+
+	// Image rows start from the lower one, as texture rows do
+	int mRow = pImage->getHeight() - pY - pHeight;
+	int mBytespp = pImage->getBytespp();
+	unsigned char *mPtr = pImage->getPointer() + (mRow * pImage->getWidth() + pX) * mBytespp;
+
+	//Texture binding changes behind the renderer
+	_render->forgetTextureState(&pSurface->_surface->_texturesArray[0], 0);
+	glBindTexture(GL_TEXTURE_2D, pSurface->_surface->_texturesArray[0]);
+
+#ifdef INDIERENDER_GLES_IOS
+	// No unpack row length in ES2: rows are sent one by one
+	for (int i = 0; i < pHeight; i++) {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, mOffsetX + pX, mOffsetY + mRow + i, pWidth, 1, mFormat, mType,
+		                mPtr + i * pImage->getWidth() * mBytespp);
+	}
+#else
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, pImage->getWidth());
+	glTexSubImage2D(GL_TEXTURE_2D, 0, mOffsetX + pX, mOffsetY + mRow, pWidth, pHeight, mFormat, mType, mPtr);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+
+	if (glGetError()) {
+		g_debug->header("OpenGL error while updating texture", DebugApi::LogHeaderError);
+		return false;
+	}
+
 	return true;
 }
 
@@ -276,6 +467,181 @@ bool OpenGLTextureBuilder::createNewTexture(IND_Surface  *pNewSurface,
 //									Private methods
 // --------------------------------------------------------------------------------
 
+/*
+==================
+Places the image in an atlas page with the same GL format, creating a new page if no one has space.
+The surface gets one block, which vertices map the sub-rectangle of the page
+==================
+*/
+bool OpenGLTextureBuilder::createAtlasTexture(IND_Surface *pNewSurface, IND_Image *pImage) {
+	int mWidth = pImage->getWidth();
+	int mHeight = pImage->getHeight();
+
+	pNewSurface->freeTextureData(); //Guard against using same texture data all over again in same surface
+	pNewSurface->_surface = new SURFACE(1, 4);
+
+	GLint mInternalFormat, mFormat, mType;
+	//Get format and type of surface (image) in GL types (and check for compatibilities)
+	getGLFormat(pNewSurface, pImage, &mInternalFormat, &mFormat, &mType);
+	if (GL_NONE == mFormat) {
+		return false;
+	}
+
+	// ----- Page search -----
+	int mPosX (0), mPosY (0);
+	ATLAS_PAGE *mPage = NULL;
+	int mPageIndex (0);
+	for (size_t i = 0; i < _atlasPages.size(); i++) {
+		ATLAS_PAGE *page = _atlasPages[i];
+		if (page->_internalFormat == mInternalFormat && page->_format == mFormat && page->_type == mType &&
+		    page->_packer.insert(mWidth, mHeight, &mPosX, &mPosY)) {
+			mPage = page;
+			mPageIndex = static_cast<int>(i);
+			break;
+		}
+	}
+
+	if (!mPage) {
+		mPage = newAtlasPage(mInternalFormat, mFormat, mType);
+		if (!mPage || !mPage->_packer.insert(mWidth, mHeight, &mPosX, &mPosY)) {
+			g_debug->header("OpenGL error while creating atlas page", DebugApi::LogHeaderError);
+			return false;
+		}
+		mPageIndex = static_cast<int>(_atlasPages.size()) - 1;
+	}
+
+	// ----- Upload to the page -----
+	//Texture binding changes behind the renderer
+	_render->forgetTextureState(&mPage->_texture, 0);
+	glBindTexture(GL_TEXTURE_2D, mPage->_texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, mPosX, mPosY, mWidth, mHeight, mFormat, mType, pImage->getPointer());
+
+	GLenum glerror = glGetError();
+	if (glerror) {
+		g_debug->header("OpenGL error while assigning texture to atlas page", DebugApi::LogHeaderError);
+		mPage->_packer.release(mWidth, mHeight);
+		return false;
+	}
+	mPage->_surfaces.push_back(pNewSurface);
+
+	// ----- Attributes -----
+	// Image rows start from the lower one, so the sub-rectangle starts at its lower-left corner
+	float mPageSize (static_cast<float>(mPage->_packer.getWidth()));
+	ATTRIBUTES &mAttributes = pNewSurface->_surface->_attributes;
+	mAttributes._blocksX          = 1;
+	mAttributes._blocksY          = 1;
+	mAttributes._spareX           = 0;
+	mAttributes._spareY           = 0;
+	mAttributes._numBlocks        = 1;
+	mAttributes._numTextures      = 1;
+	mAttributes._isHaveGrid       = 0;
+	mAttributes._widthBlock       = mWidth;
+	mAttributes._heightBlock      = mHeight;
+	mAttributes._width            = mWidth;
+	mAttributes._height           = mHeight;
+	mAttributes._isHaveSurface    = 1;
+	mAttributes._isAtlased        = 1;
+	mAttributes._u0               = mPosX / mPageSize;
+	mAttributes._v0               = mPosY / mPageSize;
+	mAttributes._u1               = (mPosX + mWidth) / mPageSize;
+	mAttributes._v1               = (mPosY + mHeight) / mPageSize;
+	pNewSurface->_surface->_texturesArray[0] = mPage->_texture;
+
+	// ----- Vertex creation -----
+	CUSTOMVERTEX2D *mVertices = pNewSurface->_surface->_vertexArray;
+	pushVertex(mVertices, 0, mWidth, 0, 0, mAttributes._u1, mAttributes._v1);        // Upper-right
+	pushVertex(mVertices, 1, mWidth, mHeight, 0, mAttributes._u1, mAttributes._v0);  // Lower-right
+	pushVertex(mVertices, 2, 0, 0, 0, mAttributes._u0, mAttributes._v1);             // Upper-left
+	pushVertex(mVertices, 3, 0, mHeight, 0, mAttributes._u0, mAttributes._v0);       // Lower-left
+
+	g_debug->header("Atlas page:", DebugApi::LogHeaderInfo);
+	g_debug->dataInt(mPageIndex, 1);
+	g_debug->header("Atlas page occupancy:", DebugApi::LogHeaderInfo);
+	g_debug->dataFloat(mPage->_packer.getOccupancy(), 1);
+
+	return true;
+}
+
+/*
+==================
+Creates an empty atlas page texture
+==================
+*/
+ATLAS_PAGE *OpenGLTextureBuilder::newAtlasPage(GLint pGLInternalFormat, GLint pGLFormat, GLint pGLType) {
+	ATLAS_PAGE *mPage = new ATLAS_PAGE();
+	mPage->_internalFormat = pGLInternalFormat;
+	mPage->_format = pGLFormat;
+	mPage->_type = pGLType;
+	// One texel between surfaces
+	mPage->_packer.init(_atlasPageSize, _atlasPageSize, 1);
+
+	glGenTextures(1, &mPage->_texture);
+	_render->forgetTextureState(&mPage->_texture, 1);
+
+	// Space between surfaces must be transparent, so texture is cleared
+	int mBytespp = 4; // Enough for any supported format
+	unsigned char *mClear = new unsigned char [_atlasPageSize * _atlasPageSize * mBytespp];
+	memset(mClear, 0, _atlasPageSize * _atlasPageSize * mBytespp);
+
+	glBindTexture(GL_TEXTURE_2D, mPage->_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, pGLInternalFormat, _atlasPageSize, _atlasPageSize, 0, pGLFormat, pGLType, mClear);
+	DISPOSEARRAY(mClear);
+
+	if (glGetError()) {
+		glDeleteTextures(1, &mPage->_texture);
+		DISPOSE(mPage);
+		return NULL;
+	}
+
+	_atlasPages.push_back(mPage);
+	return mPage;
+}
+
+#ifndef INDIERENDER_GLES_IOS
+/*
+==================
+Creates the bound texture from a block of the image, without copying it. Unpack row length must be
+the image width. Blocks in the right column and upper row are only partially inside the image:
+the rest of the texture is not initialized, except a border repeating the last column and row
+of the image, so filtering at the edges doesn't blend with undefined texels
+==================
+*/
+void OpenGLTextureBuilder::uploadBlock(unsigned char *pPtrBlock,
+                                       int pWidthImage,
+                                       int pWidthBlock,
+                                       int pHeightBlock,
+                                       int pUsedWidth,
+                                       int pUsedHeight,
+                                       int pBytespp,
+                                       GLint pGLInternalFormat,
+                                       GLint pGLFormat,
+                                       GLint pGLType) {
+	// Whole block inside the image
+	if (pUsedWidth == pWidthBlock && pUsedHeight == pHeightBlock) {
+		glTexImage2D(GL_TEXTURE_2D, 0, pGLInternalFormat, pWidthBlock, pHeightBlock, 0, pGLFormat, pGLType, pPtrBlock);
+		return;
+	}
+
+	// Edge block
+	glTexImage2D(GL_TEXTURE_2D, 0, pGLInternalFormat, pWidthBlock, pHeightBlock, 0, pGLFormat, pGLType, NULL);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, pUsedWidth, pUsedHeight, pGLFormat, pGLType, pPtrBlock);
+
+	int mRowSize = pWidthImage * pBytespp;
+	if (pUsedWidth < pWidthBlock) {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, pUsedWidth, 0, 1, pUsedHeight, pGLFormat, pGLType,
+		                pPtrBlock + (pUsedWidth - 1) * pBytespp);
+	}
+	if (pUsedHeight < pHeightBlock) {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, pUsedHeight, pUsedWidth, 1, pGLFormat, pGLType,
+		                pPtrBlock + (pUsedHeight - 1) * mRowSize);
+	}
+	if (pUsedWidth < pWidthBlock && pUsedHeight < pHeightBlock) {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, pUsedWidth, pUsedHeight, 1, 1, pGLFormat, pGLType,
+		                pPtrBlock + (pUsedHeight - 1) * mRowSize + (pUsedWidth - 1) * pBytespp);
+	}
+}
+#endif
+
 /*
 ==================
 Return OpenGL format and type depending on IndieLib defined quality and type
@@ -35,6 +35,8 @@
 #include "Defines.h"
 #include "TextureBuilder.h"
 #include "IND_Render.h"
+#include "ImageCutter.h"
+#include <vector>
 
 #ifdef INDIERENDER_OPENGL
 #include "dependencies/glew-1.9.0/include/GL/glew.h" //Extension loading facilites library
@@ -54,6 +56,19 @@ class IND_Surface;
 class ImageCutter;
 class IND_ImageManager;
 
+// Texture shared by several small surfaces
+struct structAtlasPage {
+	structAtlasPage() : _texture(0), _internalFormat(0), _format(0), _type(0) {}
+
+	GLuint _texture;
+	SkylinePacker _packer;
+	GLint _internalFormat;                      // All surfaces in a page share GL format
+	GLint _format;
+	GLint _type;
+	std::vector<IND_Surface*> _surfaces;        // Surfaces placed in the page
+};
+typedef struct structAtlasPage ATLAS_PAGE;
+
 class OpenGLTextureBuilder : public TextureBuilder {
 public:
 	//------CONSTRUCTOR/DESTRUCTOR------
@@ -66,12 +81,40 @@ public:
 	                              int             pBlockSizeX,
 	                              int             pBlockSizeY) ;
 
+	virtual void setAtlasing(bool pSwitch, int pPageSize);
+	virtual bool isAtlasing();
+	virtual int getNumAtlasPages();
+	virtual float getAtlasPageOccupancy(int pPage);
+	virtual void releaseTexture(IND_Surface *pSurface);
+	virtual bool updateTexture(IND_Surface *pSurface, IND_Image *pImage,
+	                           int pX, int pY, int pWidth, int pHeight);
+
 private:
 	// ----- Private Objects ------
 	ImageCutter *_cutter;
 	IND_Render *_render;
 
+	bool _atlasing;
+	int _atlasPageSize;
+	std::vector<ATLAS_PAGE*> _atlasPages;
+
 	// ----- Private Methods ------
+	bool createAtlasTexture(IND_Surface *pNewSurface, IND_Image *pImage);
+	ATLAS_PAGE *newAtlasPage(GLint pGLInternalFormat, GLint pGLFormat, GLint pGLType);
+
+#ifndef INDIERENDER_GLES_IOS
+	void uploadBlock(unsigned char *pPtrBlock,
+	                 int pWidthImage,
+	                 int pWidthBlock,
+	                 int pHeightBlock,
+	                 int pUsedWidth,
+	                 int pUsedHeight,
+	                 int pBytespp,
+	                 GLint pGLInternalFormat,
+	                 GLint pGLFormat,
+	                 GLint pGLType);
+#endif
+
 	void getGLFormat (IND_Surface *pNewSurface, IND_Image* pNewImage, GLint *pGLInternalFormat, GLint *pGLFormat, GLint *pGLType);
 
 	void pushVertex(CUSTOMVERTEX2D *pVertices,
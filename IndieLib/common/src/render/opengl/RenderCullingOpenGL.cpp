@@ -54,17 +54,18 @@ Plane extraction works as per this:
 http://www8.cs.umu.se/kurser/5DV051/HT12/lab/plane_extraction.pdf
 We calculate planes in model space, that is, before being transformed by camera.
 To perform culling calculations, the comparisons need to be in same space. In our case, model space.
+Projection and camera matrices are kept by the renderer, so planes only change when they do.
 ==================
 */
 void OpenGLRender::reCalculateFrustrumPlanes() {
-	IND_Matrix  mMatProj;
-	float temp [16];
-	glGetFloatv(GL_PROJECTION_MATRIX,temp);
-	mMatProj.readFromArray(temp);
+	if (!_frustrumDirty) {
+		return;
+	}
+	_frustrumDirty = false;
 
 	// Get combined matrix
 	IND_Matrix matComb;
-	_math.matrix4DMultiply(mMatProj,_cameraMatrix,matComb);
+	_math.matrix4DMultiply(_projectionMatrix,_cameraMatrix,matComb);
 
 	// Left clipping plane
 	_frustrumPlanes._planes[0]._normal._x     = (matComb._41 + matComb._11);
@@ -107,6 +108,44 @@ void OpenGLRender::reCalculateFrustrumPlanes() {
 	}
 }
 
+/*
+==================
+Checks a box in world coordinates against the frustum planes, before touching the render state.
+Returns true if it is out of the screen (counted as a discarded object)
+==================
+*/
+bool OpenGLRender::cullBox2d(float pX1, float pY1, float pX2, float pY2) {
+	if (!isBox2dOut(pX1, pY1, pX2, pY2)) {
+		return false;
+	}
+
+	_numDiscardedObjects++;
+	return true;
+}
+
+/*
+==================
+Same check as cullBox2d(), without counting it. It only reads the frustum planes, so it can be
+called from other threads while the render state is not changed
+==================
+*/
+bool OpenGLRender::isBox2dOut(float pX1, float pY1, float pX2, float pY2) {
+	IND_Vector3 mMin (pX1, pY1, 0.0f);
+	IND_Vector3 mMax (pX2, pY2, 0.0f);
+
+	return !_math.cullFrustumBox(mMin, mMax, _frustrumPlanes);
+}
+
+/*
+==================
+Box of the screen in world coordinates (x1, y1, x2, y2), using the frustum planes. Returns false if
+it can't be calculated
+==================
+*/
+bool OpenGLRender::getFrustumBox2d(float *pBox) {
+	return _math.calculateFrustumBox2d(_frustrumPlanes, pBox);
+}
+
 /*
 ==================
 Transforms vertices (supposedly from a quad) to world coordinates using the cached
@@ -31,6 +31,7 @@
 
 #include "Defines.h"
 #include <stdio.h>
+#include <stddef.h>
 
 #ifdef INDIERENDER_OPENGL
 
@@ -62,6 +63,9 @@ void OpenGLRender::blitSurface(IND_Surface *pSu) {
 		                   static_cast<float>(pSu->_surface->_vertexArray[mCont + 3]._x), static_cast<float>(pSu->_surface->_vertexArray[mCont + 3]._y),
 		                   &mP1, &mP2, &mP3, &mP4);
 
+		//World vertices are kept for batching, as the bounding rectangle overwrites them
+		IND_Vector3 mWorld [4] = {mP1, mP2, mP3, mP4};
+
 		//Calculate the bounding rectangle that we are going to try to discard
 		_math.calculateBoundingRectangle(&mP1, &mP2, &mP3, &mP4);
 
@@ -69,6 +73,13 @@ void OpenGLRender::blitSurface(IND_Surface *pSu) {
 
 		if (!_math.cullFrustumBox(mP1, mP2,_frustrumPlanes)) {
 			_numDiscardedObjects++;
+		} else if (canInstance(pSu)) {
+			//Copies of the same block in a row are drawn together, each with its own transform
+			addInstance(pSu->_surface->_texturesArray[0], &pSu->_surface->_vertexArray[0]);
+		} else if (canBatch()) {
+			//With a grid, the same texture is used for all blocks
+			GLuint texture = pSu->isHaveGrid() ? pSu->_surface->_texturesArray[0] : pSu->_surface->_texturesArray[i];
+			addQuadToBatch(texture, GL_CLAMP_TO_EDGE, mWorld, &pSu->_surface->_vertexArray[mCont]);
 		} else {
 #ifdef _DEBUG
             GLboolean enabled;
@@ -79,19 +90,15 @@ void OpenGLRender::blitSurface(IND_Surface *pSu) {
 			if (!pSu->isHaveGrid()) {
 				//Texture ID - If it doesn't have a grid, every other block must be blit by 
 				//a different texture in texture array ID. 
-				glBindTexture(GL_TEXTURE_2D,pSu->_surface->_texturesArray[i]);
+				bindGLTexture(pSu->_surface->_texturesArray[i]);
 			} else {
 				//In a case of rendering a grid. Same texture (but different vertex position)
 				//is rendered all the time. In other words, different pieces of same texture are rendered
-				glBindTexture(GL_TEXTURE_2D,pSu->_surface->_texturesArray[0]);
+				bindGLTexture(pSu->_surface->_texturesArray[0]);
 			}
             
-            //Set texture params requested before (via rainbow2d API)
-            setGLBoundTextureParams();
-            
-			//Override CLAMP for texture
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            //Set texture params requested before (via rainbow2d API), with CLAMP for texture
+            setGLBoundTextureParams(GL_CLAMP_TO_EDGE);
 	        
 			glVertexPointer(3, GL_FLOAT, sizeof(CUSTOMVERTEX2D), &pSu->_surface->_vertexArray[mCont]._x);
 			glTexCoordPointer(2, GL_FLOAT, sizeof(CUSTOMVERTEX2D), &pSu->_surface->_vertexArray[mCont]._u);
@@ -173,6 +180,15 @@ void OpenGLRender::blitRegionSurface(IND_Surface *pSu,
 			fillVertex2d(&_vertices2d [1], width, height, (x + width) / bWidth, (1.0f - ((y + height + spareY) / bHeight)));
 			fillVertex2d(&_vertices2d [2], 0.0f, 0.0f , (x/bWidth), (1.0f - ((y+ spareY) / bHeight)));
 			fillVertex2d(&_vertices2d [3], 0.0f, height, (x/bWidth), (1.0f - (y + height + spareY) / bHeight));
+
+			//Atlased surfaces only use their sub-rectangle of the texture
+			if (pSu->isAtlased()) {
+				const ATTRIBUTES &mRect = pSu->_surface->_attributes;
+				for (int i = 0; i < 4; i++) {
+					_vertices2d [i]._u = mRect._u0 + _vertices2d [i]._u * (mRect._u1 - mRect._u0);
+					_vertices2d [i]._v = mRect._v0 + _vertices2d [i]._v * (mRect._v1 - mRect._v0);
+				}
+			}
 		        
         	//Get vertex world coords, to perform frustrum culling test in world coords
             IND_Vector3 mP1, mP2, mP3, mP4;
@@ -181,6 +197,7 @@ void OpenGLRender::blitRegionSurface(IND_Surface *pSu,
                                      _vertices2d[2]._x, _vertices2d[2]._y,
                                      _vertices2d[3]._x, _vertices2d[3]._y,
                                      &mP1, &mP2, &mP3, &mP4);
+            IND_Vector3 mWorld [4] = {mP1, mP2, mP3, mP4};
             
             //Calculate the bounding rectangle that we are going to try to discard
             _math.calculateBoundingRectangle(&mP1, &mP2, &mP3, &mP4);
@@ -188,6 +205,8 @@ void OpenGLRender::blitRegionSurface(IND_Surface *pSu,
             //Discard bounding rectangle using frustum culling if possible
             if (!_math.cullFrustumBox(mP1, mP2, _frustrumPlanes)) {
                 _numDiscardedObjects++;
+            } else if (canBatch()) {
+                addQuadToBatch(pSu->_surface->_texturesArray[0], GL_CLAMP_TO_EDGE, mWorld, &_vertices2d[0]);
             } else {
 #ifdef _DEBUG
                 GLboolean enabled;
@@ -195,14 +214,10 @@ void OpenGLRender::blitRegionSurface(IND_Surface *pSu,
                 assert(GL_FALSE != enabled); //Should have texturing enabled
 #endif
                 
-                glBindTexture(GL_TEXTURE_2D,pSu->_surface->_texturesArray[0]);
-                
-                //Set texture params requested before (via rainbow2d API)
-                setGLBoundTextureParams();
+                bindGLTexture(pSu->_surface->_texturesArray[0]);
                 
-                //Override CLAMP for texture
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                //Set texture params requested before (via rainbow2d API), with CLAMP for texture
+                setGLBoundTextureParams(GL_CLAMP_TO_EDGE);
                 
                 glVertexPointer(3, GL_FLOAT, sizeof(CUSTOMVERTEX2D), &_vertices2d[0]._x);
                 glTexCoordPointer(2, GL_FLOAT, sizeof(CUSTOMVERTEX2D), &_vertices2d[0]._u);
@@ -229,7 +244,8 @@ bool OpenGLRender::blitWrapSurface(IND_Surface *pSu,
                                    float pUDisplace,
                                    float pVDisplace) {
    bool correctParams = true;
-   if (pSu->getNumTextures() != 1) {
+   //Texture repetition is not possible for a sub-rectangle of an atlas page
+   if (pSu->getNumTextures() != 1 || pSu->isAtlased()) {
 		correctParams = false; 
    }
 
@@ -258,6 +274,7 @@ bool OpenGLRender::blitWrapSurface(IND_Surface *pSu,
                                 _vertices2d[2]._x, _vertices2d[2]._y,
                                 _vertices2d[3]._x, _vertices2d[3]._y,
                                 &mP1, &mP2, &mP3, &mP4);
+       IND_Vector3 mWorld [4] = {mP1, mP2, mP3, mP4};
        
        //Calculate the bounding rectangle that we are going to try to discard
        _math.calculateBoundingRectangle(&mP1, &mP2, &mP3, &mP4);
@@ -265,6 +282,8 @@ bool OpenGLRender::blitWrapSurface(IND_Surface *pSu,
        //Discard bounding rectangle using frustum culling if possible
        if (!_math.cullFrustumBox(mP1, mP2, _frustrumPlanes)) {
            _numDiscardedObjects++;
+       } else if (canBatch()) {
+           addQuadToBatch(pSu->_surface->_texturesArray[0], GL_REPEAT, mWorld, &_vertices2d[0]);
        } else {
 #ifdef _DEBUG
            GLboolean enabled;
@@ -272,14 +291,10 @@ bool OpenGLRender::blitWrapSurface(IND_Surface *pSu,
            assert(GL_FALSE != enabled); //Should have texturing enabled
 #endif
            
-           glBindTexture(GL_TEXTURE_2D,pSu->_surface->_texturesArray[0]);
+           bindGLTexture(pSu->_surface->_texturesArray[0]);
            
-           //Set texture params requested before (via rainbow2d API)
-           setGLBoundTextureParams();
-           
-           //Override CLAMP for texture
-           glTexParameterf(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_REPEAT);
-           glTexParameterf(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_REPEAT);
+           //Set texture params requested before (via rainbow2d API), with REPEAT for texture
+           setGLBoundTextureParams(GL_REPEAT);
            
            glVertexPointer(3, GL_FLOAT, sizeof(CUSTOMVERTEX2D), &_vertices2d[0]._x);
            glTexCoordPointer(2, GL_FLOAT, sizeof(CUSTOMVERTEX2D), &_vertices2d[0]._u);
@@ -324,9 +339,15 @@ int OpenGLRender::blitAnimation(IND_Animation *pAn, unsigned int pSequence,
 			}
 		}
 		
-		glTranslatef(static_cast<float>(pAn->getActualOffsetX(pSequence)),
-					 static_cast<float>(pAn->getActualOffsetY(pSequence)),
-					 0.0f);
+		//Frame offset goes to the cached world matrix (not only to GL), so culling and
+		//batching see the frame where it is actually drawn
+		IND_Matrix mOffset, mWorld;
+		_math.matrix4DSetTranslation(mOffset,
+		                             static_cast<float>(pAn->getActualOffsetX(pSequence)),
+		                             static_cast<float>(pAn->getActualOffsetY(pSequence)),
+		                             0.0f);
+		_math.matrix4DMultiply(_modelToWorld, mOffset, mWorld);
+		setTransform2d(mWorld);
 
 		// Blits all the IND_Surface (all the blocks)
 		if (!pX && !pY && !pWidth && !pHeight) {
@@ -349,6 +370,101 @@ int OpenGLRender::blitAnimation(IND_Animation *pAn, unsigned int pSequence,
 	return mFinish;
 }
 
+void OpenGLRender::setSpriteBatching(bool pSwitch) {
+	if (!pSwitch) {
+		flushSpriteBatch();
+	}
+	_spriteBatching = pSwitch;
+}
+
+void OpenGLRender::setInstancing(bool pSwitch) {
+	if (!pSwitch) {
+		flushSpriteBatch();
+	}
+	_instancing = pSwitch;
+}
+
+void OpenGLRender::setDistanceField(bool pSwitch) {
+	if (pSwitch == _distanceField) {
+		return;
+	}
+
+	//Quads batched before were meant for the other mode
+	flushSpriteBatch();
+	_distanceField = pSwitch;
+
+	if (_distanceFieldProgram) {
+		glUseProgram(pSwitch ? _distanceFieldProgram : 0);
+	} else {
+		//Cut at the edge. Rainbow2d keeps the test on while distance fields are
+		glAlphaFunc(GL_GEQUAL, 0.5f);
+		setGLCapability(GL_ALPHA_TEST, _glState.alphaTest, pSwitch);
+	}
+}
+
+void OpenGLRender::flushSpriteBatch() {
+	//Quads and instances are never pending at the same time
+	if (_instances.numInstances) {
+		flushInstances();
+	}
+
+	if (!_batch.numQuads) {
+		return;
+	}
+
+	//Batched vertices are already in world coords, only the camera is needed
+	float camMatrixArray [16];
+	_cameraMatrix.arrayRepresentation(camMatrixArray);
+	glLoadMatrixf(camMatrixArray);
+
+	bindGLTexture(_batch.texture);
+	setGLTextureParams(_batch.sampler);
+
+	//Vertices go through a streamed buffer object when available, or client memory if not
+	const char *mBase = reinterpret_cast<const char *>(_batchVertices);
+	GLsizeiptr mSize = static_cast<GLsizeiptr>(sizeof(BatchVertex2d) * 4 * _batch.numQuads);
+	if (_batch.vertexBuffer) {
+		glBindBuffer(GL_ARRAY_BUFFER, _batch.vertexBuffer);
+		//Orphan previous storage, so the driver doesn't wait for the last draw using it
+		glBufferData(GL_ARRAY_BUFFER, mSize, NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, mSize, _batchVertices);
+		mBase = NULL;
+	}
+
+	setGLClientArray(GL_COLOR_ARRAY, _glState.colorArray, true);
+	glVertexPointer(3, GL_FLOAT, sizeof(BatchVertex2d), mBase + offsetof(BatchVertex2d, _x));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(BatchVertex2d), mBase + offsetof(BatchVertex2d, _u));
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(BatchVertex2d), mBase + offsetof(BatchVertex2d, _r));
+
+	if (_batch.indexBuffer) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _batch.indexBuffer);
+		glDrawElements(GL_TRIANGLES, _batch.numQuads * 6, GL_UNSIGNED_SHORT, 0);
+	} else {
+		glDrawElements(GL_TRIANGLES, _batch.numQuads * 6, GL_UNSIGNED_SHORT, _batchIndices);
+	}
+
+#ifdef _DEBUG
+	GLenum glerror = glGetError();
+	if (glerror) {
+		g_debug->header("OpenGL error in sprite batch flushing ", DebugApi::LogHeaderError);
+	}
+#endif
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	setGLClientArray(GL_COLOR_ARRAY, _glState.colorArray, false);
+
+	//Leave GL as immediate blits expect it: current color and model-to-world transform
+	setGLColor(_currentColor);
+	float matrixArray [16];
+	_modelToWorld.arrayRepresentation(matrixArray);
+	glMultMatrixf(matrixArray);
+
+	//The whole batch is one rendered object, as it is one draw call
+	_batch.numQuads = 0;
+	_numrenderedObjects++;
+}
+
 // --------------------------------------------------------------------------------
 //							       Private methods
 // --------------------------------------------------------------------------------
@@ -371,6 +487,196 @@ void OpenGLRender::fillVertex2d(CUSTOMVERTEX2D *pVertex2d,
 	pVertex2d->_u       = pU;
 	pVertex2d->_v       = pV;
 }
+
+/*
+==================
+Adds a quad (4 vertices, same order as a surface block) to the sprite batch. Positions
+are given in world coords; mapping coords are taken from pVertices. The batch is flushed
+first when the quad can't share the draw call with the pending ones
+==================
+*/
+void OpenGLRender::addQuadToBatch(GLuint pTexture, GLint pWrap, IND_Vector3 *pWorldVertices, CUSTOMVERTEX2D *pVertices) {
+	//Pending instances were blit before, so they go first
+	if (_instances.numInstances) {
+		flushInstances();
+	}
+
+	if (_batch.numQuads) {
+		if (_batch.numQuads == MAX_BATCH_QUADS ||
+		    _batch.texture != pTexture ||
+		    _batch.sampler.wrapS != pWrap ||
+		    _batch.sampler.minFilter != _tex2dState.minFilter ||
+		    _batch.sampler.magFilter != _tex2dState.magFilter) {
+			flushSpriteBatch();
+		}
+	}
+
+	//First quad defines the state of the batch
+	if (!_batch.numQuads) {
+		_batch.texture = pTexture;
+		_batch.sampler = _tex2dState;
+		_batch.sampler.wrapS = pWrap;
+		_batch.sampler.wrapT = pWrap;
+	}
+
+	BatchVertex2d *mVertex = &_batchVertices[_batch.numQuads * 4];
+	for (int i = 0; i < 4; i++) {
+		mVertex[i]._x = pWorldVertices[i]._x;
+		mVertex[i]._y = pWorldVertices[i]._y;
+		mVertex[i]._z = pWorldVertices[i]._z;
+		mVertex[i]._u = pVertices[i]._u;
+		mVertex[i]._v = pVertices[i]._v;
+		mVertex[i]._r = _currentColor[0];
+		mVertex[i]._g = _currentColor[1];
+		mVertex[i]._b = _currentColor[2];
+		mVertex[i]._a = _currentColor[3];
+	}
+
+	_batch.numQuads++;
+}
+
+/*
+==================
+Returns true if the surface can be drawn as a copy in an instanced call: only surfaces of a
+single block, while instancing is on and supported and sprites are batched
+==================
+*/
+bool OpenGLRender::canInstance(IND_Surface *pSu) {
+	return isInstancing() && canBatch() && 1 == pSu->getNumBlocks();
+}
+
+/*
+==================
+Adds a copy of a block (4 vertices in triangle strip order) to the pending instanced draw, using
+the current 'model-to-world' matrix and color. The draw is flushed first when the copy can't
+share it with the pending ones
+==================
+*/
+void OpenGLRender::addInstance(GLuint pTexture, CUSTOMVERTEX2D *pVertices) {
+	//Pending quads were blit before, so they go first
+	if (_batch.numQuads) {
+		flushSpriteBatch();
+	}
+
+	float mQuad [16];
+	for (int i = 0; i < 4; i++) {
+		mQuad[i * 4]     = pVertices[i]._x;
+		mQuad[i * 4 + 1] = pVertices[i]._y;
+		mQuad[i * 4 + 2] = pVertices[i]._u;
+		mQuad[i * 4 + 3] = pVertices[i]._v;
+	}
+
+	if (_instances.numInstances) {
+		if (_instances.numInstances == MAX_INSTANCES ||
+		    _instances.texture != pTexture ||
+		    _instances.sampler.minFilter != _tex2dState.minFilter ||
+		    _instances.sampler.magFilter != _tex2dState.magFilter ||
+		    memcmp(_instances.quad, mQuad, sizeof(mQuad))) {
+			flushInstances();
+		}
+	}
+
+	//First copy defines the state of the draw
+	if (!_instances.numInstances) {
+		_instances.texture = pTexture;
+		_instances.sampler = _tex2dState;
+		_instances.sampler.wrapS = GL_CLAMP_TO_EDGE;
+		_instances.sampler.wrapT = GL_CLAMP_TO_EDGE;
+		memcpy(_instances.quad, mQuad, sizeof(mQuad));
+	}
+
+	InstanceData2d *mInstance = &_instanceData[_instances.numInstances];
+	mInstance->_row0[0] = _modelToWorld._11;
+	mInstance->_row0[1] = _modelToWorld._12;
+	mInstance->_row0[2] = _modelToWorld._14;
+	mInstance->_row1[0] = _modelToWorld._21;
+	mInstance->_row1[1] = _modelToWorld._22;
+	mInstance->_row1[2] = _modelToWorld._24;
+	mInstance->_r = _currentColor[0];
+	mInstance->_g = _currentColor[1];
+	mInstance->_b = _currentColor[2];
+	mInstance->_a = _currentColor[3];
+
+	_instances.numInstances++;
+}
+
+/*
+==================
+Draws all pending copies with one instanced call
+==================
+*/
+void OpenGLRender::flushInstances() {
+	if (!_instances.numInstances) {
+		return;
+	}
+
+	//Copies are moved to world coords in the shader, only the camera is needed
+	float camMatrixArray [16];
+	_cameraMatrix.arrayRepresentation(camMatrixArray);
+	glLoadMatrixf(camMatrixArray);
+
+	bindGLTexture(_instances.texture);
+	setGLTextureParams(_instances.sampler);
+
+	glUseProgram(_instances.program);
+	glUniform4fv(_instances.quadLocation, 4, _instances.quad);
+
+	//Per-copy data, streamed every draw. Orphaning avoids waiting for the last draw using it
+	GLsizeiptr mSize = static_cast<GLsizeiptr>(sizeof(InstanceData2d) * _instances.numInstances);
+	glBindBuffer(GL_ARRAY_BUFFER, _instances.instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, mSize, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, mSize, _instanceData);
+
+	const char *mBase = NULL;
+	glVertexAttribPointer(INSTANCE_ATTRIB_ROW0, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData2d), mBase + offsetof(InstanceData2d, _row0));
+	glVertexAttribPointer(INSTANCE_ATTRIB_ROW1, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData2d), mBase + offsetof(InstanceData2d, _row1));
+	glVertexAttribPointer(INSTANCE_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(InstanceData2d), mBase + offsetof(InstanceData2d, _r));
+	glVertexAttribDivisorARB(INSTANCE_ATTRIB_ROW0, 1);
+	glVertexAttribDivisorARB(INSTANCE_ATTRIB_ROW1, 1);
+	glVertexAttribDivisorARB(INSTANCE_ATTRIB_COLOR, 1);
+
+	glBindBuffer(GL_ARRAY_BUFFER, _instances.cornerBuffer);
+	glVertexAttribPointer(INSTANCE_ATTRIB_CORNER, 1, GL_FLOAT, GL_FALSE, 0, NULL);
+
+	glEnableVertexAttribArray(INSTANCE_ATTRIB_CORNER);
+	glEnableVertexAttribArray(INSTANCE_ATTRIB_ROW0);
+	glEnableVertexAttribArray(INSTANCE_ATTRIB_ROW1);
+	glEnableVertexAttribArray(INSTANCE_ATTRIB_COLOR);
+
+	glDrawArraysInstancedARB(GL_TRIANGLE_STRIP, 0, 4, _instances.numInstances);
+
+#ifdef _DEBUG
+	GLenum glerror = glGetError();
+	if (glerror) {
+		g_debug->header("OpenGL error in instanced draw ", DebugApi::LogHeaderError);
+	}
+#endif
+
+	//Divisors stay with the locations, later draws must read them once per vertex again
+	glVertexAttribDivisorARB(INSTANCE_ATTRIB_ROW0, 0);
+	glVertexAttribDivisorARB(INSTANCE_ATTRIB_ROW1, 0);
+	glVertexAttribDivisorARB(INSTANCE_ATTRIB_COLOR, 0);
+	glDisableVertexAttribArray(INSTANCE_ATTRIB_CORNER);
+	glDisableVertexAttribArray(INSTANCE_ATTRIB_ROW0);
+	glDisableVertexAttribArray(INSTANCE_ATTRIB_ROW1);
+	glDisableVertexAttribArray(INSTANCE_ATTRIB_COLOR);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	//Location 0 is the vertex array on some drivers, it may be disabled now. Turn it on again, the
+	//immediate and batched blits set their vertex pointer without enabling it
+	_glState.vertexArray = GLSTATE_UNKNOWN;
+	setGLClientArray(GL_VERTEX_ARRAY, _glState.vertexArray, true);
+	glUseProgram(_distanceField ? _distanceFieldProgram : 0);
+
+	//Leave GL as immediate blits expect it: current color and model-to-world transform
+	setGLColor(_currentColor);
+	float matrixArray [16];
+	_modelToWorld.arrayRepresentation(matrixArray);
+	glMultMatrixf(matrixArray);
+
+	_instances.numInstances = 0;
+	_numrenderedObjects++;
+}
 /** @endcond */
 #endif //INDIERENDER_OPENGL
 
@@ -40,6 +40,7 @@
 #include "IND_SurfaceManager.h"
 #include "IND_Font.h"
 #include "IND_Surface.h"
+#include "TextureDefinitions.h"
 
 /** @cond DOCUMENT_PRIVATEAPI */
 
@@ -67,286 +68,227 @@ void OpenGLRender::blitText(IND_Font *pFo,
                             IND_BlendingType pSo,
                             IND_BlendingType pDs,
                             IND_Align pAlign) {
-	// ----- Transform -----
-	bool correctParams = true;
-	if(!pFo->getSurface()) {
-		correctParams = false;
+	//Text given each time is laid out again (IND_Entity2d keeps its own layout instead)
+	if (buildTextGeometry(pFo, pText, pOffset, pLineSpacing, pScaleX, pScaleY, pAlign, _textVertices)) {
+		blitTextGeometry(pFo, _textVertices, pX, pY, pScaleX, pScaleY, pR, pG, pB, pA, pFadeR, pFadeG, pFadeB, pFadeA, pLinearFilter, pSo, pDs);
+	}
+}
+
+
+bool OpenGLRender::buildTextGeometry(IND_Font *pFo,
+                                     char *pText,
+                                     int pOffset,
+                                     int pLineSpacing,
+                                     float pScaleX,
+                                     float pScaleY,
+                                     IND_Align pAlign,
+                                     std::vector<CUSTOMVERTEX2D> &pVertices) {
+	pVertices.clear();
+
+	IND_Surface *mSurface = pFo->getSurface();
+	if (!mSurface) {
+		return 0;
+	}
+	if (!pText) {
+		return 1;
 	}
 
-	if (correctParams) {
-		setTransform2d(pX, pY, 0, 0, 0, pScaleX, pScaleY, 0, 0, 0, 0, pFo->getSurface()->getWidthBlock(), pFo->getSurface()->getHeightBlock(), 0);
-		setRainbow2d(pFo->getSurface()->getTypeInt(), 1, 0, 0, pLinearFilter, pR, pG, pB, pA, pFadeR, pFadeG, pFadeB, pFadeA, pSo, pDs);
+	//Letters are regions of the first texture block of the font bitmap, mapped as in blitRegionSurface()
+	bool mAngelCode = (pFo->getFontType() == IND_Font::FONTTYPE_AngelCode);
+	bool mOneTexture = (mSurface->getNumTextures() == 1);
+	float mBlockWidth = static_cast<float>(mSurface->getWidthBlock());
+	float mBlockHeight = static_cast<float>(mSurface->getHeightBlock());
+	float mSpareY = static_cast<float>(mSurface->getSpareY());
+
+	//Widths of all the lines, for the alignment
+	if (pAlign != IND_LEFT)
+		pFo->getLineWidths(pText, pOffset, _lineWidths);
+
+	unsigned char mLastChar = 0;
+	int mLine = 0;
+	int mTranslationY = 0;
+	float mPenX = 0.0f;    //Position of the next letter in the line
+	float mPenY = 0.0f;
+
+	for (int i = 0; pText [i]; i++) {
+		unsigned char mChar = static_cast<unsigned char>(pText [i]);
 
+		// If it's a new line or it's the first line
+		if (mChar == '\n' || i == 0) {
+			// Lines are counted by '\n', so a text starting with '\n' aligns the letters after it
+			if (mChar == '\n')
+				mLine++;
+			mPenX = static_cast<float>(-getLineTranslation(pAlign, mLine, pScaleX));
+			mPenY = static_cast<float>(mTranslationY);
+			mTranslationY += static_cast<int>(pLineSpacing * pScaleY);
+			mLastChar = 0;
+		}
 
-        switch (pFo->getFontType()) {
-            case IND_Font::FONTTYPE_AngelCode:
-                blitCharsAngelCodeFont(pFo, pText, pAlign, pOffset, pScaleX, pScaleY, pLineSpacing);
-                break;
+		// It's a normal character
+		if (mChar == '\n') {
+			continue;
+		}
 
-            case IND_Font::FONTTYPE_MudFont:
-                 blitCharsMudFont(pFo, pText, pAlign, pOffset, pScaleX, pScaleY, pLineSpacing);
-                break;
-                
-            default:
-                break;
-        }
+		IND_Font::LETTER *mLetter = pFo->getLetter(mChar);
+		if (mLetter) {
+			// Kerning with the previous character of the line
+			mPenX += pFo->getKerning(mLastChar, mChar) * pScaleX;
 
+			// MudFont letters have a 1 pixel border
+			int mBorder = mAngelCode ? 0 : 1;
+			float x (static_cast<float>(mLetter->_x + mBorder));
+			float y (static_cast<float>(mLetter->_y + mBorder));
+			float width (static_cast<float>(mLetter->_width - mBorder));
+			float height (static_cast<float>(mLetter->_height - mBorder));
+			float mTop = mPenY + (mAngelCode ? static_cast<float>(mLetter->_yOffset) : 0.0f);
+
+			if (mOneTexture && x >= 0 && x + width <= mSurface->getWidth() && y >= 0 && y + height <= mSurface->getHeight()) {
+				size_t mFirst = pVertices.size();
+				pVertices.resize(mFirst + 4);
+				CUSTOMVERTEX2D *mQuad = &pVertices [mFirst];
+				fillVertex2d(&mQuad [0], mPenX + width, mTop, ((x + width) / mBlockWidth), (1.0f - ((y + mSpareY) / mBlockHeight)));
+				fillVertex2d(&mQuad [1], mPenX + width, mTop + height, (x + width) / mBlockWidth, (1.0f - ((y + height + mSpareY) / mBlockHeight)));
+				fillVertex2d(&mQuad [2], mPenX, mTop, (x / mBlockWidth), (1.0f - ((y + mSpareY) / mBlockHeight)));
+				fillVertex2d(&mQuad [3], mPenX, mTop + height, (x / mBlockWidth), (1.0f - (y + height + mSpareY) / mBlockHeight));
+
+				//Atlased surfaces only use their sub-rectangle of the texture
+				if (mSurface->isAtlased()) {
+					const ATTRIBUTES &mRect = mSurface->_surface->_attributes;
+					for (int j = 0; j < 4; j++) {
+						mQuad [j]._u = mRect._u0 + mQuad [j]._u * (mRect._u1 - mRect._u0);
+						mQuad [j]._v = mRect._v0 + mQuad [j]._v * (mRect._v1 - mRect._v0);
+					}
+				}
+			}
+
+			//X displacement of the character
+			mPenX += (mLetter->_width + pOffset) * pScaleX;
+		}
+		mLastChar = mChar;
 	}
+
+	return 1;
 }
 
 
-// --------------------------------------------------------------------------------
-//							         Private methods
-// --------------------------------------------------------------------------------
+void OpenGLRender::blitTextGeometry(IND_Font *pFo,
+                                    std::vector<CUSTOMVERTEX2D> &pVertices,
+                                    int pX,
+                                    int pY,
+                                    float pScaleX,
+                                    float pScaleY,
+                                    unsigned char pR,
+                                    unsigned char pG,
+                                    unsigned char pB,
+                                    unsigned char pA,
+                                    unsigned char pFadeR,
+                                    unsigned char pFadeG,
+                                    unsigned char pFadeB,
+                                    unsigned char pFadeA,
+                                    IND_Filter pLinearFilter,
+                                    IND_BlendingType pSo,
+                                    IND_BlendingType pDs) {
+	IND_Surface *mSurface = pFo->getSurface();
+	if (!mSurface || pVertices.empty()) {
+		return;
+	}
 
-void OpenGLRender::blitCharsAngelCodeFont(IND_Font *pFo, char *pText, IND_Align pAlign, int pOffset, float pScaleX, float pScaleY, int pLineSpacing) {
-    
-    // ----- Drawing text   -----
-    
-    unsigned char mChar1;
-    unsigned char mChar2;
-    int mCont1 = 0;
-    int mCont2 = 0;
-    int mTranslationX = 0;
-    int mTranslationY = 0;
-    bool mErrorChar;    // Char that doesn't exist
-    int mSentencePos;
-    int mLongActualSentence;
-    GLfloat mLineTransform[16];  //Maintains a transform inside the entity coord system
-    GLfloat mEntityTransform[16]; //Maintains transform for the whole entity coord system
-    mCont1 = 0;
-    mChar1 = pText [mCont1++];
-    
-    //Store entity transform
-    glGetFloatv(GL_MODELVIEW_MATRIX,mEntityTransform);
-    
-    
-    //LOOP - Blit character by character
-    while (mChar1 != 0) {
-        // If it's a new line or it's the first line
-        if (mChar1 == '\n' || mCont1 == 1) {
-            // First line
-            if (mCont1 == 1) {
-                mSentencePos = 0;
-				//Any other line
-            } else {
-                mSentencePos = mCont1;
-            }
-            
-            // Set the alignment
-            switch (pAlign) {
-                case IND_CENTER: {
-                    mLongActualSentence = static_cast<int>(getLongInPixels(pFo, pText, mSentencePos, pOffset) * pScaleX);
-                    mTranslationX = (int)(mLongActualSentence / 2);
-                    break;
-                }
-                    
-                case IND_RIGHT: {
-                    mLongActualSentence = static_cast<int>(getLongInPixels(pFo, pText, mSentencePos, pOffset) * pScaleX);
-                    mTranslationX = (int)(mLongActualSentence);
-                    
-                    break;
-                }
-                    
-                case IND_LEFT: {
-                    break;
-                }
-            }
-            
-            //Load line transform matrix taking into account entity transform
-            //This effectively resets transform to first character in the new line
-            IND_Matrix transform;
-            _math.matrix4DSetTranslation(transform, static_cast<float>(-mTranslationX), static_cast<float>(mTranslationY), 0.0f);
-            transform.arrayRepresentation(mLineTransform);
-            glLoadMatrixf(mEntityTransform);
-            glMultMatrixf(mLineTransform);
-            mTranslationY += static_cast<int>((pLineSpacing * pScaleY));
-        } //Was first new line or first line
-        
-        // It's a normal character
-        if (mChar1 != '\n') {
-            
-            mErrorChar = 0;
-            mCont2 = 0;
-            mChar2 = pFo->getLetters() [mCont2++]._letter;
-            
-            // Seek its location in the bitmap
-            while (mChar2 != mChar1 && mCont2 < pFo->getNumChars()) {
-                mChar2 = pFo->getLetters() [mCont2++]._letter;
-            }
-            if (mCont2  ==  pFo->getNumChars())
-                mErrorChar = 1;
-            
-            mCont2--;
-            if (!mErrorChar) {
-                
-                // To avoid that Y displacement transform accumulates for every character in the line,
-                // save the untranslated coordinate system.
-                glPushMatrix();
-                
-                float charTranslateY = static_cast<float>(pFo->getLetters()[mCont2]._yOffset);
-                glTranslatef(0.0f, charTranslateY ,0.0f);
-
-                //#warning lookout
-                //mvTransformPresetState();  //Need to preset transform state, as the blit operation will reset the state!!!!
-                blitRegionSurface(pFo->getSurface(),
-                                  pFo->getLetters() [mCont2]._x,
-                                  pFo->getLetters() [mCont2]._y,
-                                  pFo->getLetters() [mCont2]._width,
-                                  pFo->getLetters() [mCont2]._height);
-                
-                // Restore the untranslated coordinate system.
-                glPopMatrix();
-            }
-            
-            //X displacement of the character.
-            //X displacement transform accumulates for every character in the line
-            float charTranslateX = ((pFo->getLetters() [mCont2]._width) + pOffset) * pScaleX;
-            glTranslatef(charTranslateX,0.0f,0.0f);
-        }//Was normal character
-        
-        // Advance one character
-        mChar1 = pText [mCont1++];
-    }//LOOP END - Blit character by character
-    
-}
+	// ----- Transform -----
+	setTransform2d(pX, pY, 0, 0, 0, pScaleX, pScaleY, 0, 0, 0, 0, mSurface->getWidthBlock(), mSurface->getHeightBlock(), 0);
+	setRainbow2d(mSurface->getTypeInt(), 1, 0, 0, pLinearFilter, pR, pG, pB, pA, pFadeR, pFadeG, pFadeB, pFadeA, pSo, pDs);
+
+	int mNumQuads = static_cast<int>(pVertices.size() / 4);
+	GLuint mTexture = mSurface->_surface->_texturesArray[0];
+
+	//Letters join the sprite batch, so all the texts using the font go in the same draw call
+	if (canBatch()) {
+		for (int i = 0; i < mNumQuads; i++) {
+			CUSTOMVERTEX2D *mQuad = &pVertices [i * 4];
+			IND_Vector3 mP1, mP2, mP3, mP4;
+			transformVerticesToWorld(mQuad [0]._x, mQuad [0]._y,
+			                         mQuad [1]._x, mQuad [1]._y,
+			                         mQuad [2]._x, mQuad [2]._y,
+			                         mQuad [3]._x, mQuad [3]._y,
+			                         &mP1, &mP2, &mP3, &mP4);
+			IND_Vector3 mWorld [4] = {mP1, mP2, mP3, mP4};
+
+			_math.calculateBoundingRectangle(&mP1, &mP2, &mP3, &mP4);
+			if (!_math.cullFrustumBox(mP1, mP2, _frustrumPlanes)) {
+				_numDiscardedObjects++;
+			} else {
+				addQuadToBatch(mTexture, GL_CLAMP_TO_EDGE, mWorld, mQuad);
+			}
+		}
+		return;
+	}
 
+	//Without batching, the text is discarded as a whole, and drawn in one call
+	float mMinX = pVertices [0]._x, mMaxX = pVertices [0]._x;
+	float mMinY = pVertices [0]._y, mMaxY = pVertices [0]._y;
+	for (size_t i = 1; i < pVertices.size(); i++) {
+		mMinX = min(mMinX, pVertices [i]._x);
+		mMaxX = max(mMaxX, pVertices [i]._x);
+		mMinY = min(mMinY, pVertices [i]._y);
+		mMaxY = max(mMaxY, pVertices [i]._y);
+	}
+	IND_Vector3 mP1, mP2, mP3, mP4;
+	transformVerticesToWorld(mMaxX, mMinY, mMaxX, mMaxY, mMinX, mMinY, mMinX, mMaxY, &mP1, &mP2, &mP3, &mP4);
+	_math.calculateBoundingRectangle(&mP1, &mP2, &mP3, &mP4);
+	if (!_math.cullFrustumBox(mP1, mP2, _frustrumPlanes)) {
+		_numDiscardedObjects++;
+		return;
+	}
 
-void OpenGLRender::blitCharsMudFont(IND_Font *pFo, char *pText, IND_Align pAlign, int pOffset, float pScaleX, float pScaleY, int pLineSpacing) {
-    
-    // ----- Drawing text   -----
-    
-    unsigned char mChar1;
-    unsigned char mChar2;
-    int mCont1 = 0;
-    int mCont2 = 0;
-    int mTranslationX = 0;
-    int mTranslationY = 0;
-    bool mErrorChar;    // Char that doesn't exist
-    int mSentencePos;
-    int mLongActualSentence;
-    GLfloat mLineTransform[16];  //Maintains a transform inside the entity coord system
-    GLfloat mEntityTransform[16]; //Maintains transform for the whole entity coord system
-    mCont1 = 0;
-    mChar1 = pText [mCont1++];
-    
-    //Store entity transform
-    glGetFloatv(GL_MODELVIEW_MATRIX,mEntityTransform);
-    
-    
-    //LOOP - Blit character by character
-    while (mChar1 != 0) {
-        // If it's a new line or it's the first line
-        if (mChar1 == '\n' || mCont1 == 1) {
-            // First line
-            if (mCont1 == 1) {
-                mSentencePos = 0;
-				//Any other line
-            } else {
-                mSentencePos = mCont1;
-            }
-            
-            // Set the alignment
-            switch (pAlign) {
-                case IND_CENTER: {
-                    mLongActualSentence = static_cast<int>(getLongInPixels(pFo, pText, mSentencePos, pOffset) * pScaleX);
-                    mTranslationX = (int)(mLongActualSentence / 2);
-                    break;
-                }
-                    
-                case IND_RIGHT: {
-                    mLongActualSentence = static_cast<int>(getLongInPixels(pFo, pText, mSentencePos, pOffset) * pScaleX);
-                    mTranslationX = (int)(mLongActualSentence);
-                    
-                    break;
-                }
-                    
-                case IND_LEFT: {
-                    break;
-                }
-            }
-            
-            //Load line transform matrix taking into account entity transform
-            //This effectively resets transform to first character in the new line
-            IND_Matrix transform;
-            _math.matrix4DSetTranslation(transform, static_cast<float>(-mTranslationX), static_cast<float>(mTranslationY), 0.0f);
-            transform.arrayRepresentation(mLineTransform);
-            glLoadMatrixf(mEntityTransform);
-            glMultMatrixf(mLineTransform);
-            mTranslationY += static_cast<int>((pLineSpacing * pScaleY));
-        } //Was first new line or first line
-        
-        // It's a normal character
-        if (mChar1 != '\n') {
-            
-            mErrorChar = 0;
-            mCont2 = 0;
-            mChar2 = pFo->getLetters() [mCont2++]._letter;
-            
-            // Seek its location in the bitmap
-            while (mChar2 != mChar1 && mCont2 < pFo->getNumChars()) {
-                mChar2 = pFo->getLetters() [mCont2++]._letter;
-            }
-            if (mCont2  ==  pFo->getNumChars())
-                mErrorChar = 1;
-            
-            mCont2--;
-            if (!mErrorChar) {
-                //#warning lookout
-                //mvTransformPresetState();  //Need to preset transform state, as the blit operation will reset the state!!!!
-                blitRegionSurface(pFo->getSurface(),
-                                  pFo->getLetters() [mCont2]._x + 1,
-                                  pFo->getLetters() [mCont2]._y + 1,
-                                  pFo->getLetters() [mCont2]._width - 1,
-                                  pFo->getLetters() [mCont2]._height - 1);
-            }
-            
-            //Displacement of the character.
-            //Displacement transform accumulates for every character in the line
-            float charTranslateX = ((pFo->getLetters() [mCont2]._width) + pOffset) * pScaleX;
-            glTranslatef(charTranslateX,0.0f,0.0f);
-        }//Was normal character
-        
-        // Advance one character
-        mChar1 = pText [mCont1++];
-    }//LOOP END - Blit character by character
+	bindGLTexture(mTexture);
+	setGLBoundTextureParams(GL_CLAMP_TO_EDGE);
 
+	//Quads are in the same order as surface blocks, so the indices of the sprite batch draw them
+	if (_batch.indexBuffer) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _batch.indexBuffer);
+	}
+	for (int i = 0; i < mNumQuads; i += MAX_BATCH_QUADS) {
+		int mCount = min(mNumQuads - i, MAX_BATCH_QUADS);
+		glVertexPointer(3, GL_FLOAT, sizeof(CUSTOMVERTEX2D), &pVertices [i * 4]._x);
+		glTexCoordPointer(2, GL_FLOAT, sizeof(CUSTOMVERTEX2D), &pVertices [i * 4]._u);
+		glDrawElements(GL_TRIANGLES, mCount * 6, GL_UNSIGNED_SHORT, _batch.indexBuffer ? 0 : _batchIndices);
+	}
+	if (_batch.indexBuffer) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+#ifdef _DEBUG
+	GLenum glerror = glGetError();
+	if (glerror) {
+		g_debug->header("OpenGL error in text blitting ", DebugApi::LogHeaderError);
+	}
+#endif
+	_numrenderedObjects += mNumQuads;
 }
 
 
+// --------------------------------------------------------------------------------
+//							         Private methods
+// --------------------------------------------------------------------------------
 
 /*
 ==================
-Returns a long in pixels of the sentence that starts in pPos
-A sentence is an array of chars that ends in \n or \0
+Returns the x translation of a line for the alignment, from the widths measured in _lineWidths
 ==================
 */
-int OpenGLRender::getLongInPixels(IND_Font *pFo, char *pText, int pPos, int pOffset) {
-	unsigned char mChar1;
-	unsigned char mChar2;
-	int mCont1 = pPos;
-	int mCont2 = 0;
-	bool mErrorChar;    // Error when nonexistant char
-
-	int mWidthSentence = 0;
-	mChar1 = pText [mCont1++];
-	while (mChar1 != '\0' && mChar1 != '\n') {
-		mErrorChar = 0;
-		mCont2 = 0;
-		mChar2 = pFo->getLetters() [mCont2++]._letter;
-
-		// Search the position
-		while (mChar2 != mChar1 && mCont2 < pFo->getNumChars()) mChar2 = pFo->getLetters() [mCont2++]._letter;
-		if (mCont2  ==  pFo->getNumChars())
-			mErrorChar = 1;
-
-		if (!mErrorChar)
-			mWidthSentence += pFo->getLetters() [mCont2 - 1]._width + pOffset;
-
-		mChar1 = pText [mCont1++];
-	}
+int OpenGLRender::getLineTranslation(IND_Align pAlign, int pLine, float pScaleX) {
+	if (pLine >= static_cast<int>(_lineWidths.size())) return 0;
+
+	int mLongActualSentence = static_cast<int>(_lineWidths [pLine] * pScaleX);
+	switch (pAlign) {
+		case IND_CENTER:
+			return mLongActualSentence / 2;
 
-	return mWidthSentence;
+		case IND_RIGHT:
+			return mLongActualSentence;
+
+		default:
+			return 0;
+	}
 }
 /** @endcond */
 #endif //INDIERENDER_OPENGL
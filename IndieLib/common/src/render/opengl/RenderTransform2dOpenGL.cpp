@@ -60,6 +60,8 @@ bool OpenGLRender::setViewPort2d(int pX,
 
 	// ----- Viewport characteristics -----
 
+	flushSpriteBatch();
+
 	_info._viewPortX      = pX;
 	_info._viewPortY      = pY;
 	_info._viewPortWidth  = pWidth;
@@ -67,6 +69,7 @@ bool OpenGLRender::setViewPort2d(int pX,
     _info._viewPortApectRatio = static_cast<float>(pWidth/pHeight);
 
 	//Clear projection matrix
+	setProjectionMatrix(IND_Matrix::identity());
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
 
@@ -83,6 +86,9 @@ bool OpenGLRender::setViewPort2d(int pX,
 
 
 void OpenGLRender::setCamera2d(IND_Camera2d *pCamera2d) {
+	//Pending quads were meant for the previous camera
+	flushSpriteBatch();
+
 	// ----- Lookat matrix -----
 	//Rotate that axes in Z by the camera angle
 	//Roll is rotation around the z axis (_look)
@@ -107,23 +113,30 @@ void OpenGLRender::setCamera2d(IND_Camera2d *pCamera2d) {
 	assert( mmode == GL_MODELVIEW);
 #endif
 
-	glLoadIdentity();
+	//The camera matrix is composed here, same as GL would do it, so it never has to be read back
+	IND_Matrix camera (IND_Matrix::identity());
     //------ Zooming -----
 	if (pCamera2d->_zoom != 1.0f) {
         //Zoom global scale (around where camera points - screen center)
-        glScalef(pCamera2d->_zoom, pCamera2d->_zoom,0);
+        _math.matrix4DSetScale(camera, pCamera2d->_zoom, pCamera2d->_zoom, 0.0f);
 	} 
 
 	//------ Lookat transform -----
-	glMultMatrixf(reinterpret_cast<GLfloat *>(&lookatmatrix));
+	_math.matrix4DMultiplyInPlace(camera, lookatmatrix);
     
 	//------ Global point to pixel ratio -----
-    glScalef(_info._pointPixelScale, _info._pointPixelScale, 1.0f);
+	IND_Matrix pointPixelScale;
+	_math.matrix4DSetScale(pointPixelScale, _info._pointPixelScale, _info._pointPixelScale, 1.0f);
+	_math.matrix4DMultiplyInPlace(camera, pointPixelScale);
+
+	if (memcmp(&camera, &_cameraMatrix, sizeof(IND_Matrix))) {
+		_cameraMatrix = camera;
+		_frustrumDirty = true;
+	}
 
-    //Store result from GL matrix back to our local matrix
-    float cam[16];
-	glGetFloatv(GL_MODELVIEW_MATRIX, cam);
-    _cameraMatrix.readFromArray(cam);
+	float cam[16];
+	_cameraMatrix.arrayRepresentation(cam);
+	glLoadMatrixf(cam);
     
 	// ----- Projection Matrix -----
 	//Setup a 2d projection (orthogonal)
@@ -155,6 +168,32 @@ void OpenGLRender::setTransform2d(int pX,
                                   int pWidth,
                                   int pHeight,
                                   IND_Matrix *pMatrix) {
+	IND_Matrix mMatrix;
+	calculateTransform2d(pX, pY, pAngleX, pAngleY, pAngleZ, pScaleX, pScaleY, pAxisCalX, pAxisCalY, pMirrorX, pMirrorY, pWidth, pHeight, mMatrix);
+
+	// ----- Applies the transformation -----
+	setTransform2d(mMatrix);
+
+	// ----- Return World Matrix (in IndieLib format) ----
+	if (pMatrix) {
+		*pMatrix = mMatrix;
+	}
+}
+
+void OpenGLRender::calculateTransform2d(int pX,
+                                        int pY,
+                                        float pAngleX,
+                                        float pAngleY,
+                                        float pAngleZ,
+                                        float pScaleX,
+                                        float pScaleY,
+                                        int pAxisCalX,
+                                        int pAxisCalY,
+                                        bool pMirrorX,
+                                        bool pMirrorY,
+                                        int pWidth,
+                                        int pHeight,
+                                        IND_Matrix &pMatrix) {
 
 	//Temporal holders for all accumulated transforms
 	IND_Matrix totalTrans;
@@ -162,114 +201,104 @@ void OpenGLRender::setTransform2d(int pX,
 	IND_Matrix temp;
 	_math.matrix4DSetIdentity(temp);
 
-	//Initialize to identity given matrix, if exists
-	if (pMatrix) {
-		_math.matrix4DSetIdentity(*pMatrix);
-	}
     
-	// Translations
-	if (pX != 0 || pY != 0) {
-		IND_Matrix trans;
-		_math.matrix4DSetTranslation(trans,static_cast<float>(pX),static_cast<float>(pY),0.0f);
-		_math.matrix4DMultiply(totalTrans,trans,temp);
-		totalTrans = temp;
-	}
-
-	// Scaling
-	if (pScaleX != 1.0f || pScaleY != 1.0f) {
-		IND_Matrix scale;
-		_math.matrix4DSetScale(scale,pScaleX,pScaleY,0.0f);
-		_math.matrix4DMultiply(totalTrans,scale,temp);
-		totalTrans = temp;
-	}
-
-	// Rotations
-	if (pAngleX != 0.0f) {
-		IND_Matrix angleX;
-		_math.matrix4DSetRotationAroundAxis(angleX,pAngleX,IND_Vector3(1.0f,0.0f,0.0f));
-		_math.matrix4DMultiply(totalTrans,angleX,temp);
-		totalTrans = temp;
-	}
+	if (0.0f == pAngleX && 0.0f == pAngleY) {
+		// Common 2d case: the whole chain below has a closed form
+		_math.matrix4DSetTransform2d(totalTrans,
+		                             static_cast<float>(pX), static_cast<float>(pY),
+		                             pAngleZ,
+		                             pScaleX, pScaleY,
+		                             static_cast<float>(pAxisCalX), static_cast<float>(pAxisCalY),
+		                             pMirrorX, pMirrorY,
+		                             static_cast<float>(pWidth), static_cast<float>(pHeight));
+	} else {
+		// Translations
+		if (pX != 0 || pY != 0) {
+			IND_Matrix trans;
+			_math.matrix4DSetTranslation(trans,static_cast<float>(pX),static_cast<float>(pY),0.0f);
+			_math.matrix4DMultiply(totalTrans,trans,temp);
+			totalTrans = temp;
+		}
 
-	if (pAngleY != 0.0f) {
-		IND_Matrix angleY;
-		_math.matrix4DSetRotationAroundAxis(angleY,pAngleY,IND_Vector3(0.0f,1.0f,0.0f));
-		_math.matrix4DMultiply(totalTrans,angleY,temp);
-		totalTrans = temp;
-	}
+		// Scaling
+		if (pScaleX != 1.0f || pScaleY != 1.0f) {
+			IND_Matrix scale;
+			_math.matrix4DSetScale(scale,pScaleX,pScaleY,0.0f);
+			_math.matrix4DMultiply(totalTrans,scale,temp);
+			totalTrans = temp;
+		}
 
-	if (pAngleZ != 0.0f) {
-		IND_Matrix angleZ;
-		_math.matrix4DSetRotationAroundAxis(angleZ,pAngleZ,IND_Vector3(0.0f,0.0f,1.0f));
-		_math.matrix4DMultiply(totalTrans,angleZ,temp);
-		totalTrans = temp;
-	}
+		// Rotations
+		if (pAngleX != 0.0f) {
+			IND_Matrix angleX;
+			_math.matrix4DSetRotationAroundAxis(angleX,pAngleX,IND_Vector3(1.0f,0.0f,0.0f));
+			_math.matrix4DMultiply(totalTrans,angleX,temp);
+			totalTrans = temp;
+		}
 
-	// Hotspot - Add hotspot to make all transforms to be affected by it
-	if (pAxisCalX != 0 || pAxisCalY != 0) {
-		IND_Matrix hotspot;
-		_math.matrix4DSetTranslation(hotspot,static_cast<float>(pAxisCalX),static_cast<float>(pAxisCalY),0.0f);
-		_math.matrix4DMultiply(totalTrans,hotspot,temp);
-		totalTrans = temp;
-	}
+		if (pAngleY != 0.0f) {
+			IND_Matrix angleY;
+			_math.matrix4DSetRotationAroundAxis(angleY,pAngleY,IND_Vector3(0.0f,1.0f,0.0f));
+			_math.matrix4DMultiply(totalTrans,angleY,temp);
+			totalTrans = temp;
+		}
 
-    // Mirroring (180 rotations) and translation
-	if (pMirrorX || pMirrorY) {
-		//A mirror is a rotation in desired axis (the actual mirror) and a repositioning because rotation
-		//also moves 'out of place' the entity translation-wise
-		if (pMirrorX) {
-			IND_Matrix mirrorX;
-            //After rotation around origin, move back texture to correct place
-            _math.matrix4DSetTranslation(mirrorX,
-                                         static_cast<float>(pWidth),
-                                         0.0f,
-                                         0.0f);
-			_math.matrix4DMultiply(totalTrans,mirrorX,temp);
+		if (pAngleZ != 0.0f) {
+			IND_Matrix angleZ;
+			_math.matrix4DSetRotationAroundAxis(angleZ,pAngleZ,IND_Vector3(0.0f,0.0f,1.0f));
+			_math.matrix4DMultiply(totalTrans,angleZ,temp);
 			totalTrans = temp;
-            
-            //Rotate in y, to invert texture
-			_math.matrix4DSetRotationAroundAxis(mirrorX,180.0f,IND_Vector3(0.0f,1.0f,0.0f));
-			_math.matrix4DMultiply(totalTrans,mirrorX,temp);
+		}
+
+		// Hotspot - Add hotspot to make all transforms to be affected by it
+		if (pAxisCalX != 0 || pAxisCalY != 0) {
+			IND_Matrix hotspot;
+			_math.matrix4DSetTranslation(hotspot,static_cast<float>(pAxisCalX),static_cast<float>(pAxisCalY),0.0f);
+			_math.matrix4DMultiply(totalTrans,hotspot,temp);
 			totalTrans = temp;
 		}
+
+		// Mirroring (180 rotations) and translation
+		if (pMirrorX || pMirrorY) {
+			//A mirror is a rotation in desired axis (the actual mirror) and a repositioning because rotation
+			//also moves 'out of place' the entity translation-wise
+			if (pMirrorX) {
+				IND_Matrix mirrorX;
+				//After rotation around origin, move back texture to correct place
+				_math.matrix4DSetTranslation(mirrorX,
+				                             static_cast<float>(pWidth),
+				                             0.0f,
+				                             0.0f);
+				_math.matrix4DMultiply(totalTrans,mirrorX,temp);
+				totalTrans = temp;
+            
+				//Rotate in y, to invert texture
+				_math.matrix4DSetRotationAroundAxis(mirrorX,180.0f,IND_Vector3(0.0f,1.0f,0.0f));
+				_math.matrix4DMultiply(totalTrans,mirrorX,temp);
+				totalTrans = temp;
+			}
         
-		//A mirror is a rotation in desired axis (the actual mirror) and a repositioning because rotation
-		//also moves 'out of place' the entity translation-wise
-		if (pMirrorY) {
-			IND_Matrix mirrorY;
-            //After rotation around origin, move back texture to correct place
-            _math.matrix4DSetTranslation(mirrorY,
-                                         0.0f,
-                                         static_cast<float>(pHeight),
-                                         0.0f);
-			_math.matrix4DMultiply(totalTrans,mirrorY,temp);
-			totalTrans = temp;
+			//A mirror is a rotation in desired axis (the actual mirror) and a repositioning because rotation
+			//also moves 'out of place' the entity translation-wise
+			if (pMirrorY) {
+				IND_Matrix mirrorY;
+				//After rotation around origin, move back texture to correct place
+				_math.matrix4DSetTranslation(mirrorY,
+				                             0.0f,
+				                             static_cast<float>(pHeight),
+				                             0.0f);
+				_math.matrix4DMultiply(totalTrans,mirrorY,temp);
+				totalTrans = temp;
             
-            //Rotate in x, to invert texture
-			_math.matrix4DSetRotationAroundAxis(mirrorY,180.0f,IND_Vector3(1.0f,0.0f,0.0f));
-			_math.matrix4DMultiply(totalTrans,mirrorY,temp);
-			totalTrans = temp;
+				//Rotate in x, to invert texture
+				_math.matrix4DSetRotationAroundAxis(mirrorY,180.0f,IND_Vector3(1.0f,0.0f,0.0f));
+				_math.matrix4DMultiply(totalTrans,mirrorY,temp);
+				totalTrans = temp;
+			}
 		}
 	}
-	//Cache the change
-	_modelToWorld = totalTrans;
-
-	//Apply the changes to the GL matrix stack (model view)
-    //Camera transform
-    float camMatrixArray [16];
-    _cameraMatrix.arrayRepresentation(camMatrixArray);
-    glLoadMatrixf(camMatrixArray);
-    
-    //Actual object transform
-    float matrixArray [16];
-    totalTrans.arrayRepresentation(matrixArray);
-	glMultMatrixf(matrixArray);
 
-	// ----- Return World Matrix (in IndieLib format) ----
-	//Transformations have been applied where needed
-	if (pMatrix) {
-		*pMatrix = totalTrans;
-	}
+	pMatrix = totalTrans;
 }
 
 void OpenGLRender::setTransform2d(IND_Matrix &pMatrix) {
@@ -334,116 +363,83 @@ void OpenGLRender::setRainbow2d(IND_Type pType,
     _tex2dState.minFilter = filterType;
 
 	// ----- Back face culling -----
-	if (pCull) {
-		glEnable(GL_CULL_FACE);
-		glFrontFace(GL_CW);    
-	} else {
-		glDisable(GL_CULL_FACE);
-	}
+	// Culling and blending can't change in the middle of a sprite batch, so the requested state is
+	// computed first, and only applied after flushing pending quads (if it differs)
+	RasterState2d state (_raster2dState);
+	state.cullFace = pCull;
+	state.frontFace = GL_CW;
 
-	// ----- Back face culling -----
 	// Mirroring (180 rotations)
-	if (pMirrorX || pMirrorY) {
-		if (pMirrorX && !pMirrorY) {
-			// Back face culling
-			if (pCull) {
-				glEnable(GL_CULL_FACE);
-				glFrontFace(GL_CCW);    
-			} else {
-				glDisable(GL_CULL_FACE);
-			}
-		}
-
-		if (!pMirrorX && pMirrorY) {
-			if (pCull) {
-				glEnable(GL_CULL_FACE);
-				glFrontFace(GL_CCW);    
-			} else {
-				glDisable(GL_CULL_FACE);
-			}
-		}
+	if ((pMirrorX && !pMirrorY) || (!pMirrorX && pMirrorY)) {
+		state.frontFace = GL_CCW;
 	}
 
 	// ----- Blending -----
 	switch (pType) {
         case IND_OPAQUE: {
             // Alphablending and alpha test = OFF
-            glDisable(GL_ALPHA_TEST);
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_ONE, GL_ZERO);
-            
+            state.blendSrc = GL_ONE;
+            state.blendDst = GL_ZERO;
+
             // Tinting
             if (pR != 255 || pG != 255 || pB != 255) {
 				blendR = static_cast<float>(pR) / 255.0f;
 				blendG = static_cast<float>(pG) / 255.0f;
 				blendB = static_cast<float>(pB) / 255.0f;
-                glColor4f(blendR, blendG, blendB, blendA);
             }
-            
+
             // Alpha
             if (pA != 255) {
-				glDisable(GL_ALPHA_TEST);
-				glEnable(GL_BLEND);
-				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				state.blendSrc = GL_SRC_ALPHA;
+				state.blendDst = GL_ONE_MINUS_SRC_ALPHA;
 				blendA = static_cast<float>(pA) / 255.0f;
-                glColor4f(blendR, blendG, blendB, blendA);
             }
-            
+
             // Fade to color
             if (pFadeA != 255) {
-                glDisable(GL_ALPHA_TEST);
-				glEnable(GL_BLEND);
-				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				state.blendSrc = GL_SRC_ALPHA;
+				state.blendDst = GL_ONE_MINUS_SRC_ALPHA;
 				blendA = static_cast<float>(pFadeA) / 255.0f;
                 blendR = static_cast<float>(pFadeR) / 255.0f;
                 blendG = static_cast<float>(pFadeG) / 255.0f;
                 blendB = static_cast<float>(pFadeB) / 255.0f;
-                glColor4f(blendR, blendG, blendB, blendA);
             }
-            
+
             if (pSo && pDs) {
                 //Alpha blending
             }
         }
             break;
-            
+
         case IND_ALPHA: {
             // Alpha test = OFF
-            glDisable(GL_ALPHA_TEST);
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-            glColor4f(blendR, blendG, blendB, blendA);
-            
+            state.blendSrc = GL_SRC_ALPHA;
+            state.blendDst = GL_ONE_MINUS_SRC_ALPHA;
+
             // Tinting
             if (pR != 255 || pG != 255 || pB != 255) {
 				blendR = static_cast<float>(pR) / 255.0f;
 				blendG = static_cast<float>(pG) / 255.0f;
 				blendB = static_cast<float>(pB) / 255.0f;
-                glColor4f(blendR, blendG, blendB, blendA);
             }
-            
+
             // Alpha
             if (pA != 255) {
-				glDisable(GL_ALPHA_TEST);
-				glEnable(GL_BLEND);
-				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 				blendA = static_cast<float>(pA) / 255.0f;
-                glColor4f(blendR, blendG, blendB, blendA);
             }
-            
+
             // Fade to color
             if (pFadeA != 255) {
                 blendA = static_cast<float>(pFadeA) / 255.0f;
                 blendR = static_cast<float>(pFadeR) / 255.0f;
                 blendG = static_cast<float>(pFadeG) / 255.0f;
                 blendB = static_cast<float>(pFadeB) / 255.0f;
-                glColor4f(blendR, blendG, blendB, blendA);
             }
-            
+
             if (!pSo || !pDs) {
                 //Alpha blending
             } else {
-                
+
             }
 
 	}
@@ -452,10 +448,34 @@ void OpenGLRender::setRainbow2d(IND_Type pType,
 	}
 	}
 
+	// ----- Apply state -----
+	if (isBatchPending() && !(state == _raster2dState)) {
+		flushSpriteBatch();
+	}
+	_raster2dState = state;
+
+	setGLCapability(GL_CULL_FACE, _glState.cullFace, state.cullFace);
+	if (state.cullFace) {
+		setGLFrontFace(state.frontFace);
+	}
 
+	setGLCapability(GL_ALPHA_TEST, _glState.alphaTest, _distanceField && !_distanceFieldProgram);
+	setGLCapability(GL_BLEND, _glState.blend, true);
+	setGLBlendFunc(state.blendSrc, state.blendDst);
+
+	// Color goes to GL for immediate blits, and to every batched vertex. An opaque surface
+	// without tinting is drawn with plain white, instead of the last color set
+	_currentColor[0] = static_cast<unsigned char>(blendR * 255.0f + 0.5f);
+	_currentColor[1] = static_cast<unsigned char>(blendG * 255.0f + 0.5f);
+	_currentColor[2] = static_cast<unsigned char>(blendB * 255.0f + 0.5f);
+	_currentColor[3] = static_cast<unsigned char>(blendA * 255.0f + 0.5f);
+	setGLColor(_currentColor);
 }
 
 void OpenGLRender::setDefaultGLState() {
+    //Anything could have been changed outside the renderer, so forget what we knew
+    invalidateGLStateCache();
+
     // ----- 2d GLState -----
 	//Many defaults are GL_FALSE, but for the sake of explicitly safe operations (and code clearness)
 	//I include glDisable explicits
@@ -463,42 +483,240 @@ void OpenGLRender::setDefaultGLState() {
 	glDisable(GL_DEPTH_TEST); //No depth testing
 	glDisable(GL_NORMALIZE); //Don't normalize normal vectors after submitting them
 	glShadeModel(GL_SMOOTH); //Default shading mode (will change it where it is necessary)
-    
+
 	// ----- Texturing settings  -----
 	// the texture wraps over at the edges (repeat)
-    glEnable(GL_TEXTURE_2D);
+    setGLCapability(GL_TEXTURE_2D, _glState.texture2d, true);
+	//Texture color is modulated by vertex color (tinting, fading and transparency)
+	setGLTexEnvMode(GL_MODULATE);
 	//Generally we work with byte-aligned textures.
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	glPixelStorei(GL_PACK_ALIGNMENT, 1);
-    
+
     setGLClientStateToTexturing();
 }
 
 void OpenGLRender::setGLClientStateToPrimitive() {
-    glDisable(GL_TEXTURE_2D);
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_COLOR_ARRAY);
-    
-    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-    glDisableClientState(GL_NORMAL_ARRAY);
+    //Primitives are drawn immediately, so anything batched before must reach the screen first
+    flushSpriteBatch();
+
+    setGLCapability(GL_TEXTURE_2D, _glState.texture2d, false);
+    setGLClientArray(GL_VERTEX_ARRAY, _glState.vertexArray, true);
+    setGLClientArray(GL_COLOR_ARRAY, _glState.colorArray, true);
+
+    setGLClientArray(GL_TEXTURE_COORD_ARRAY, _glState.texCoordArray, false);
+    setGLClientArray(GL_NORMAL_ARRAY, _glState.normalArray, false);
 }
 
 void OpenGLRender::setGLClientStateToTexturing() {
-    glEnable(GL_TEXTURE_2D);
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-    
-    glDisableClientState(GL_COLOR_ARRAY);
-    glDisableClientState(GL_NORMAL_ARRAY);
+    setGLCapability(GL_TEXTURE_2D, _glState.texture2d, true);
+    setGLClientArray(GL_VERTEX_ARRAY, _glState.vertexArray, true);
+    setGLClientArray(GL_TEXTURE_COORD_ARRAY, _glState.texCoordArray, true);
+
+    setGLClientArray(GL_COLOR_ARRAY, _glState.colorArray, false);
+    setGLClientArray(GL_NORMAL_ARRAY, _glState.normalArray, false);
+}
+
+void OpenGLRender::setGLBoundTextureParams(GLint pWrap) {
+    //Filters requested before (via rainbow2d API), wrap mode depends on the kind of blit
+    TextureSamplerState state (_tex2dState);
+    state.wrapS = pWrap;
+    state.wrapT = pWrap;
+    setGLTextureParams(state);
+}
+
+void OpenGLRender::getNumIssuedStateChangesString(char *pBuffer)      {
+	IND_Math::itoa(_numIssuedStateChanges, pBuffer);
+}
+
+void OpenGLRender::getNumSkippedStateChangesString(char *pBuffer)      {
+	IND_Math::itoa(_numSkippedStateChanges, pBuffer);
+}
+
+/*
+==================
+Forgets the parameters cached for the given texture objects. Names of deleted textures are
+reused by GL, and a new texture starts with GL default parameters
+==================
+*/
+void OpenGLRender::forgetTextureState(const GLuint *pTextures, int pNumTextures) {
+    for (int i = 0; i < pNumTextures; i++) {
+        _glState.textureParams.erase(pTextures[i]);
+    }
+    //Texture creation binds the new textures behind our back
+    _glState.boundTexture = GLSTATE_UNKNOWN;
+}
+
+/*
+==================
+Sets every cached GL value as unknown, so next request for it always reaches GL
+==================
+*/
+void OpenGLRender::invalidateGLStateCache() {
+    _glState.invalidate();
+    _glState.textureParams.clear();
+}
+
+/*
+==================
+Enables or disables a GL capability, if not in that state already
+==================
+*/
+void OpenGLRender::setGLCapability(GLenum pCap, GLint &pCached, bool pEnable) {
+    GLint value = pEnable ? 1 : 0;
+    if (pCached == value) {
+        _numSkippedStateChanges++;
+        return;
+    }
+
+    if (pEnable) {
+        glEnable(pCap);
+    } else {
+        glDisable(pCap);
+    }
+    pCached = value;
+    _numIssuedStateChanges++;
+}
+
+/*
+==================
+Enables or disables a GL client array, if not in that state already
+==================
+*/
+void OpenGLRender::setGLClientArray(GLenum pArray, GLint &pCached, bool pEnable) {
+    //Drawing with a color array leaves the current color undefined
+    if (GL_COLOR_ARRAY == pArray && pEnable) {
+        _glState.colorKnown = false;
+    }
+
+    GLint value = pEnable ? 1 : 0;
+    if (pCached == value) {
+        _numSkippedStateChanges++;
+        return;
+    }
+
+    if (pEnable) {
+        glEnableClientState(pArray);
+    } else {
+        glDisableClientState(pArray);
+    }
+    pCached = value;
+    _numIssuedStateChanges++;
+}
+
+void OpenGLRender::setGLFrontFace(GLenum pMode) {
+    if (_glState.frontFace == static_cast<GLint>(pMode)) {
+        _numSkippedStateChanges++;
+        return;
+    }
+
+    glFrontFace(pMode);
+    _glState.frontFace = pMode;
+    _numIssuedStateChanges++;
+}
+
+void OpenGLRender::setGLBlendFunc(GLenum pSrc, GLenum pDst) {
+    if (_glState.blendSrc == static_cast<GLint>(pSrc) && _glState.blendDst == static_cast<GLint>(pDst)) {
+        _numSkippedStateChanges++;
+        return;
+    }
+
+    glBlendFunc(pSrc, pDst);
+    _glState.blendSrc = pSrc;
+    _glState.blendDst = pDst;
+    _numIssuedStateChanges++;
+}
+
+void OpenGLRender::setGLTexEnvMode(GLint pMode) {
+    if (_glState.texEnvMode == pMode) {
+        _numSkippedStateChanges++;
+        return;
+    }
+
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, pMode);
+    _glState.texEnvMode = pMode;
+    _numIssuedStateChanges++;
+}
+
+void OpenGLRender::setGLColor(const unsigned char *pColor) {
+    if (_glState.colorKnown && !memcmp(_glState.color, pColor, sizeof(_glState.color))) {
+        _numSkippedStateChanges++;
+        return;
+    }
+
+    glColor4ub(pColor[0], pColor[1], pColor[2], pColor[3]);
+    memcpy(_glState.color, pColor, sizeof(_glState.color));
+    _glState.colorKnown = true;
+    _numIssuedStateChanges++;
+}
+
+void OpenGLRender::bindGLTexture(GLuint pTexture) {
+    if (_glState.boundTexture == static_cast<GLint>(pTexture)) {
+        _numSkippedStateChanges++;
+        return;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, pTexture);
+    _glState.boundTexture = pTexture;
+    _numIssuedStateChanges++;
 }
 
-void OpenGLRender::setGLBoundTextureParams() {
-    //Texture wrap mode
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,_tex2dState.wrapS);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,_tex2dState.wrapT);
-    //By default select fastest texture filter
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, _tex2dState.magFilter);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, _tex2dState.minFilter);
+/*
+==================
+Sets filter and wrap parameters of the bound texture. Each parameter is only set if that
+texture doesn't have it already
+==================
+*/
+void OpenGLRender::setGLTextureParams(const TextureSamplerState &pState) {
+    //Without a known bound texture, parameters can't be attributed to any texture
+    if (GLSTATE_UNKNOWN == _glState.boundTexture) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, pState.wrapS);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, pState.wrapT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, pState.magFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, pState.minFilter);
+        _numIssuedStateChanges += 4;
+        return;
+    }
+
+    GLuint texture = static_cast<GLuint>(_glState.boundTexture);
+    std::map<GLuint, TextureSamplerState>::iterator it = _glState.textureParams.find(texture);
+    if (it == _glState.textureParams.end()) {
+        //First use of the texture. GL defaults don't match any sampler state we use
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, pState.wrapS);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, pState.wrapT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, pState.magFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, pState.minFilter);
+        _numIssuedStateChanges += 4;
+        _glState.textureParams[texture] = pState;
+        return;
+    }
+
+    TextureSamplerState &cached = it->second;
+    if (cached.wrapS != pState.wrapS) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, pState.wrapS);
+        _numIssuedStateChanges++;
+    } else {
+        _numSkippedStateChanges++;
+    }
+    if (cached.wrapT != pState.wrapT) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, pState.wrapT);
+        _numIssuedStateChanges++;
+    } else {
+        _numSkippedStateChanges++;
+    }
+    if (cached.magFilter != pState.magFilter) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, pState.magFilter);
+        _numIssuedStateChanges++;
+    } else {
+        _numSkippedStateChanges++;
+    }
+    if (cached.minFilter != pState.minFilter) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, pState.minFilter);
+        _numIssuedStateChanges++;
+    } else {
+        _numSkippedStateChanges++;
+    }
+    cached = pState;
 }
 
 /** @endcond */
@@ -47,6 +47,8 @@
 void   OpenGLRender::clearViewPort(unsigned char pR,
                                    unsigned char pG,
                                    unsigned char pB) {
+	flushSpriteBatch();
+
 	//Clear color buffer
 	glClearColor(static_cast<GLclampf>(pR / 255.0f),
 	             static_cast<GLclampf>(pG / 255.0f),
@@ -67,6 +69,8 @@ void OpenGLRender::lookAt(float pEyeX, float pEyeY, float pEyeZ,
 	                           IND_Vector3(pUpX,pUpY,pUpZ),
 	                           lookatmatrix);
 
+	flushSpriteBatch();
+
 #ifdef _DEBUG
 	int mmode;
 	glGetIntegerv(GL_MATRIX_MODE,&mmode);
@@ -81,10 +85,13 @@ void OpenGLRender::perspectiveFov(float pFov, float pAspect, float pNearClipping
 }
 
 void OpenGLRender::perspectiveOrtho(float pWidth, float pHeight, float pNearClippingPlane, float pFarClippingPlane) {
+	flushSpriteBatch();
+
 	//Projection matrix modification
 	glMatrixMode(GL_PROJECTION);
 	IND_Matrix orthoMatrix;
 	_math.matrix4DOrthographicProjectionLH(-pWidth/2,pWidth/2,-pHeight/2,pHeight/2,pNearClippingPlane,pFarClippingPlane,orthoMatrix);
+	setProjectionMatrix(orthoMatrix);
 	glLoadMatrixf(reinterpret_cast<GLfloat *>(&orthoMatrix));
 	
 	//float m[16];
@@ -98,6 +105,18 @@ void OpenGLRender::perspectiveOrtho(float pWidth, float pHeight, float pNearClip
 	glMatrixMode(GL_MODELVIEW);
 }
 
+/*
+==================
+Keeps the projection matrix loaded in GL. Frustum planes are only recalculated when it changes
+==================
+*/
+void OpenGLRender::setProjectionMatrix(const IND_Matrix &pMatrix) {
+	if (memcmp(&pMatrix, &_projectionMatrix, sizeof(IND_Matrix))) {
+		_projectionMatrix = pMatrix;
+		_frustrumDirty = true;
+	}
+}
+
 /** @endcond */
 
 #endif //INDIERENDER_OPENGL
@@ -24,6 +24,11 @@
  *****************************************************************************************/
 #include "dependencies/unittest++/src/UnitTest++.h"
 #include "CIndieLib.h"
+#include "CollisionParser.h"
+#include "CollisionCache2d.h"
+#include <stdio.h>
+
+#define BENCHMARK_POSITIONS 2000
 
 TEST(pointToLineHorizontalDistanceFromMiddleIsSegment) {
 	IND_Vector2 a (10.0f, 10.0f);
@@ -215,4 +220,73 @@ TEST(isPointInsideTriangleOutsideLeftClose) {
 	IND_Vector2 pointInside = IND_Vector2(-0.1f,0.0f);
 
 	CHECK_EQUAL(false,CIndieLib::instance()->_math->isPointInsideTriangle(pointInside,a,b,c));
-}
\ No newline at end of file
+}
+
+// Bounding areas of the old narrowphase: every pair of the lists, transformed on each check
+static bool isCollisionOfLists(IND_Math *pMath, list <BOUNDING_COLLISION *> *pList1, IND_Matrix &pMat1, list <BOUNDING_COLLISION *> *pList2, IND_Matrix &pMat2) {
+	bool collision = false;
+	list <BOUNDING_COLLISION *>::iterator i, j;
+	for (i = pList1->begin(); i != pList1->end(); i++) {
+		for (j = pList2->begin(); j != pList2->end(); j++) {
+			if ((*i)->getType() == 0 && (*j)->getType() == 0 && pMath->isTriangleToTriangleCollision((*i), pMat1, (*j), pMat2))
+				collision = true;
+			if ((*i)->getType() == 1 && (*j)->getType() == 0 && pMath->isCircleToTriangleCollision((*i), pMat1, 1.0f, (*j), pMat2))
+				collision = true;
+			if ((*i)->getType() == 0 && (*j)->getType() == 1 && pMath->isCircleToTriangleCollision((*j), pMat2, 1.0f, (*i), pMat1))
+				collision = true;
+			if ((*i)->getType() == 1 && (*j)->getType() == 1 && pMath->isCircleToCircleCollision((*i), pMat1, 1.0f, (*j), pMat2, 1.0f))
+				collision = true;
+		}
+	}
+	return collision;
+}
+
+SUITE(Benchmarks) {
+// Benchmark: the triangle and circle scenarios above, with many bounding areas per entity, checked
+// at many distances. Bounding lists walked pair by pair against the contiguous world cache
+TEST(BENCHMARK_COLLISIONLISTSAGAINSTCACHE) {
+	IND_Math *math = CIndieLib::instance()->_math;
+	CollisionParser *parser = CollisionParser::instance();
+
+	list <BOUNDING_COLLISION *> list1, list2;
+	for (int i = 0; i < 24; i++) {
+		parser->setBoundingTriangle(&list1, "body", i * 10, 0, i * 10 + 30, 0, i * 10 + 15, 30);
+		parser->setBoundingTriangle(&list2, "body", 0, i * 10, 30, i * 10, 15, i * 10 + 30);
+	}
+	for (int i = 0; i < 8; i++) {
+		parser->setBoundingCircle(&list1, "head", i * 30, 60, 12);
+		parser->setBoundingCircle(&list2, "head", 60, i * 30, 12);
+	}
+
+	IND_Matrix mat1, mat2;
+	math->matrix4DSetIdentity(mat1);
+	CollisionCache2d cache1, cache2;
+	cache1.build(&list1, mat1, 1.0f, math);
+
+	bool results [BENCHMARK_POSITIONS];
+	UnitTest::Timer timer;
+	timer.Start();
+	for (int i = 0; i < BENCHMARK_POSITIONS; i++) {
+		math->matrix4DSetTranslation(mat2, static_cast<float>(i % 400), static_cast<float>(i % 7) * 40.0f, 0.0f);
+		results[i] = isCollisionOfLists(math, &list1, mat1, &list2, mat2);
+	}
+	int listsMs = timer.GetTimeInMs();
+
+	int collisions = 0;
+	timer.Start();
+	for (int i = 0; i < BENCHMARK_POSITIONS; i++) {
+		math->matrix4DSetTranslation(mat2, static_cast<float>(i % 400), static_cast<float>(i % 7) * 40.0f, 0.0f);
+		cache2.build(&list2, mat2, 1.0f, math);
+		bool collision = cache1.isCollision(IND_COLLISION_GROUP_ANY, cache2, IND_COLLISION_GROUP_ANY, math);
+		CHECK_EQUAL(results[i], collision);
+		if (collision) collisions++;
+	}
+	int cacheMs = timer.GetTimeInMs();
+
+	printf("Collision of %d bounding areas at %d positions (%d collide): %d ms bounding lists, %d ms world cache\n",
+	       static_cast<int>(list1.size()), BENCHMARK_POSITIONS, collisions, listsMs, cacheMs);
+
+	parser->deleteBoundingAreas(&list1, "*");
+	parser->deleteBoundingAreas(&list2, "*");
+}
+}
@@ -0,0 +1,896 @@
+/*********************************** The zlib License ************************************
+ *
+ * Copyright (c) 2013 Indielib-crossplatform Development Team
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software
+ * in a product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ *
+ *****************************************************************************************/
+
+#include "dependencies/unittest++/src/UnitTest++.h"
+#include "CIndieLib.h"
+#include "IND_Entity2d.h"
+#include "IND_Surface.h"
+#include "IND_Image.h"
+#include "IND_Animation.h"
+#include "IND_Font.h"
+#include <stdio.h>
+#include <math.h>
+
+#define CHURN_ENTITIES 100000
+
+// Places entities with a circle bounding area on a square with room for all of them, and draws
+// them once, so their transforms are up to date
+static void spawnColliders(CIndieLib *iLib, IND_Surface *pSurface, IND_Entity2d **pEntities, int pNum, int pSide) {
+	unsigned int seed = 12345;
+	for (int i = 0; i < pNum; i++) {
+		pEntities[i] = IND_Entity2d::newEntity2d();
+		iLib->_entity2dManager->add(pEntities[i]);
+		pEntities[i]->setSurface(pSurface);
+		pEntities[i]->setBoundingCircle("body", 16, 16, 12);
+
+		seed = seed * 1103515245 + 12345;
+		float x = static_cast<float>((seed >> 8) % pSide);
+		seed = seed * 1103515245 + 12345;
+		float y = static_cast<float>((seed >> 8) % pSide);
+		pEntities[i]->setPosition(x, y, 0);
+	}
+
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+}
+
+static void countPair(IND_Entity2d *pEn1, IND_Entity2d *pEn2, void *pUserData) {
+	(*static_cast<int *>(pUserData))++;
+}
+
+struct entityFixture {
+    entityFixture() {
+        iLib = CIndieLib::instance();
+        iLib->init();
+        testEntity = IND_Entity2d::newEntity2d();
+    }
+    ~entityFixture() {
+        iLib->end();
+        
+    }
+    IND_Entity2d *testEntity;
+    CIndieLib* iLib;
+};
+
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_ADDTWICE_SECONDFAILS) {
+	CHECK(iLib->_entity2dManager->add(testEntity));
+	CHECK(!iLib->_entity2dManager->add(1, testEntity));
+}
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_REMOVETWICE_SECONDFAILS) {
+	CHECK(iLib->_entity2dManager->add(3, testEntity));
+	CHECK(iLib->_entity2dManager->remove(testEntity));
+	CHECK(!iLib->_entity2dManager->remove(testEntity));
+	testEntity->destroy();
+}
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_REMOVEARRAY_REMOVESALL) {
+	IND_Entity2d *entities [3] = {testEntity, IND_Entity2d::newEntity2d(), IND_Entity2d::newEntity2d()};
+	for (int i = 0; i < 3; i++) {
+		CHECK(iLib->_entity2dManager->add(entities[i]));
+	}
+
+	CHECK(iLib->_entity2dManager->remove(entities, 3));
+	for (int i = 0; i < 3; i++) {
+		CHECK(!iLib->_entity2dManager->remove(entities[i]));
+		entities[i]->destroy();
+	}
+}
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_REMOVEALL_EMPTIESLAYER) {
+	IND_Entity2d *other = IND_Entity2d::newEntity2d();
+	CHECK(iLib->_entity2dManager->add(2, testEntity));
+	CHECK(iLib->_entity2dManager->add(2, other));
+
+	CHECK(iLib->_entity2dManager->removeAll(2));
+	CHECK(!iLib->_entity2dManager->remove(testEntity));
+	CHECK(!iLib->_entity2dManager->remove(other));
+
+	// Removed entities can be added again
+	CHECK(iLib->_entity2dManager->add(2, testEntity));
+	other->destroy();
+}
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_QUERYCOLLISIONS_SAMEASPAIRWISE) {
+	IND_Surface *surface = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(surface, const_cast<char *>("rabbit.png"), IND_ALPHA, IND_32));
+
+	const int num = 300;
+	IND_Entity2d *entities [num];
+	spawnColliders(iLib, surface, entities, num, 600);
+
+	int pairwise = 0;
+	for (int i = 0; i < num; i++) {
+		for (int j = i + 1; j < num; j++) {
+			if (iLib->_entity2dManager->isCollision(entities[i], "body", entities[j], "body"))
+				pairwise++;
+		}
+	}
+
+	int called = 0;
+	CHECK(pairwise > 0);
+	CHECK_EQUAL(pairwise, iLib->_entity2dManager->queryCollisions(0, "body", "body", countPair, &called));
+	CHECK_EQUAL(pairwise, called);
+
+	// Moving entities updates the broadphase
+	for (int i = 0; i < num; i++) {
+		entities[i]->setPosition(static_cast<float>(i * 100), 0, 0);
+	}
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+	CHECK_EQUAL(0, iLib->_entity2dManager->queryCollisions(0, "body", "body", NULL, NULL));
+
+	// And so does removing them
+	entities[1]->setPosition(10, 0, 0);
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+	CHECK_EQUAL(1, iLib->_entity2dManager->queryCollisions(0, "body", "body", NULL, NULL));
+	CHECK(iLib->_entity2dManager->remove(entities[1]));
+	CHECK_EQUAL(0, iLib->_entity2dManager->queryCollisions(0, "body", "body", NULL, NULL));
+	entities[1]->destroy();
+}
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_QUERYPOINTANDRECT) {
+	IND_Surface *surface = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(surface, const_cast<char *>("rabbit.png"), IND_ALPHA, IND_32));
+
+	IND_Entity2d *entities [2];
+	spawnColliders(iLib, surface, entities, 2, 1);
+	entities[1]->setPosition(1000, 1000, 0);
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+
+	vector <IND_Entity2d *> found;
+	CHECK_EQUAL(1, iLib->_entity2dManager->queryPoint(0, 16, 16, found));
+	CHECK(found[0] == entities[0]);
+
+	// Inside the box of the circle, but not inside the circle
+	found.clear();
+	CHECK_EQUAL(0, iLib->_entity2dManager->queryPoint(0, 5, 5, found));
+
+	CHECK_EQUAL(2, iLib->_entity2dManager->queryRect(0, 0, 0, 1100, 1100, found));
+	found.clear();
+	CHECK_EQUAL(1, iLib->_entity2dManager->queryRect(0, 1100, 1100, 900, 900, found));
+	CHECK(found[0] == entities[1]);
+}
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_ISCOLLISION_FOLLOWSCHANGES) {
+	IND_Surface *surface = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(surface, const_cast<char *>("rabbit.png"), IND_ALPHA, IND_32));
+
+	IND_Entity2d *entities [2];
+	spawnColliders(iLib, surface, entities, 2, 1);
+	entities[1]->setBoundingRectangle("feet", 0, 0, 8, 8);
+	CHECK(iLib->_entity2dManager->isCollision(entities[0], "body", entities[1], "body"));
+	CHECK(iLib->_entity2dManager->isCollision(entities[0], "*", entities[1], "feet"));
+	CHECK(!iLib->_entity2dManager->isCollision(entities[0], "feet", entities[1], "*"));
+
+	// Moved away: boxes of the groups don't overlap
+	entities[1]->setPosition(-40, -40, 0);
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+	CHECK(!iLib->_entity2dManager->isCollision(entities[0], "*", entities[1], "*"));
+
+	// Bigger: the circle reaches the other one again
+	entities[1]->setScale(3, 3);
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+	CHECK(iLib->_entity2dManager->isCollision(entities[0], "body", entities[1], "body"));
+
+	// Bounding areas removed
+	entities[1]->deleteBoundingAreas("*");
+	CHECK(!iLib->_entity2dManager->isCollision(entities[0], "*", entities[1], "*"));
+}
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_COLLISIONGROUPS_SAMEASIDS) {
+	IND_Surface *surface = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(surface, const_cast<char *>("rabbit.png"), IND_ALPHA, IND_32));
+
+	CHECK_EQUAL(IND_COLLISION_GROUP_ANY, iLib->_entity2dManager->getCollisionGroup("*"));
+	CHECK_EQUAL(IND_COLLISION_GROUP_NONE, iLib->_entity2dManager->getCollisionGroup("never_used"));
+
+	IND_Entity2d *entities [2];
+	spawnColliders(iLib, surface, entities, 2, 1);
+	entities[1]->setBoundingRectangle("feet", 0, 0, 8, 8);
+
+	int body = iLib->_entity2dManager->getCollisionGroup("body");
+	int feet = iLib->_entity2dManager->getCollisionGroup("feet");
+	CHECK(body >= 0);
+	CHECK(feet >= 0);
+	CHECK(body != feet);
+
+	CHECK(iLib->_entity2dManager->isCollision(entities[0], body, entities[1], feet));
+	CHECK(!iLib->_entity2dManager->isCollision(entities[0], feet, entities[1], body));
+	CHECK(iLib->_entity2dManager->isCollision(entities[0], IND_COLLISION_GROUP_ANY, entities[1], IND_COLLISION_GROUP_ANY));
+	CHECK(!iLib->_entity2dManager->isCollision(entities[0], "never_used", entities[1], "*"));
+}
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_ISPIXELCOLLISION_ONLYSOLIDPIXELS) {
+	// 32x32 image, only the upper left 8x8 pixels visible (image rows start from the lower one)
+	IND_Image *image = IND_Image::newImage();
+	CHECK(iLib->_imageManager->add(image, 32, 32, IND_RGBA));
+	image->clear(0, 0, 0, 0);
+	for (int y = 0; y < 8; y++) {
+		for (int x = 0; x < 8; x++) {
+			image->putPixel(x, 31 - y, 255, 255, 255, 255);
+		}
+	}
+
+	iLib->_surfaceManager->setAlphaMasks(true, 128);
+	CHECK(iLib->_surfaceManager->isAlphaMasks());
+	IND_Surface *surface = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(surface, image, IND_ALPHA, IND_32));
+	CHECK(surface->isHaveAlphaMask());
+
+	IND_Entity2d *entities [2];
+	spawnColliders(iLib, surface, entities, 2, 1);
+	entities[0]->setPosition(100, 100, 0);
+	entities[0]->setBoundingRectangle("box", 0, 0, 32, 32);
+	entities[1]->setBoundingRectangle("box", 0, 0, 32, 32);
+
+	const int numCases = 5;
+	float posX [numCases] = {100, 104, 116, 76, 80};
+	float posY [numCases] = {100, 104, 100, 100, 100};
+	bool mirror [numCases] = {false, false, false, true, false};
+	float scale [numCases] = {1, 1, 1, 1, 1.5f};
+	bool pixels [numCases] = {true, true, false, true, false};
+
+	for (int i = 0; i < numCases; i++) {
+		entities[1]->setPosition(posX[i], posY[i], 0);
+		entities[1]->setMirrorX(mirror[i]);
+		entities[1]->setScale(scale[i], scale[i]);
+		iLib->_render->beginScene();
+		iLib->_entity2dManager->renderEntities2d();
+		iLib->_render->endScene();
+
+		// Bounding rectangles of the whole image always overlap
+		CHECK(iLib->_entity2dManager->isCollision(entities[0], "box", entities[1], "box"));
+		CHECK_EQUAL(pixels[i], iLib->_entity2dManager->isPixelCollision(entities[0], entities[1]));
+		CHECK_EQUAL(pixels[i], iLib->_entity2dManager->isPixelCollision(entities[1], entities[0]));
+	}
+
+	// No masks
+	iLib->_surfaceManager->setAlphaMasks(false, 128);
+	IND_Surface *noMask = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(noMask, image, IND_ALPHA, IND_32));
+	CHECK(!noMask->isHaveAlphaMask());
+	entities[1]->setSurface(noMask);
+	CHECK(!iLib->_entity2dManager->isPixelCollision(entities[0], entities[1]));
+
+	iLib->_imageManager->remove(image);
+}
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_OFFSCREENENTITIES_DISCARDEDBEFOREDRAWING) {
+	// Without batching, each drawn sprite is a rendered object
+	iLib->_render->setSpriteBatching(false);
+	IND_Surface *surface = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(surface, const_cast<char *>("rabbit.png"), IND_ALPHA, IND_32));
+
+	const int num = 20;
+	IND_Entity2d *entities [num];
+	spawnColliders(iLib, surface, entities, num, 100);
+
+	// Half of them far away, in all directions
+	for (int i = 0; i < num; i += 2) {
+		float away = (i % 4) ? 10000.0f : -10000.0f;
+		entities[i]->setPosition(away, (i % 8 < 4) ? away : 50.0f, 0);
+	}
+	// One of them moved out with a region bigger than the surface: still reaches the screen
+	entities[1]->setPosition(-150, 10, 0);
+	entities[1]->setRegion(0, 0, 200, 32);
+	entities[1]->toggleWrap(true);
+
+	iLib->_render->resetNumDiscardedObjects();
+	iLib->_render->resetNumrenderedObject();
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+
+	CHECK_EQUAL(num / 2, iLib->_render->getNumDiscardedObjectsInt());
+	CHECK(iLib->_render->getNumrenderedObjectsInt() >= num / 2);
+
+	// Boxes follow the transformations
+	for (int i = 0; i < num; i += 2) {
+		entities[i]->setPosition(10, 10, 0);
+	}
+	entities[3]->setScale(0.5f, 0.5f);
+	entities[3]->setPosition(-40, 0, 0);
+
+	iLib->_render->resetNumDiscardedObjects();
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+	CHECK_EQUAL(1, iLib->_render->getNumDiscardedObjectsInt());
+}
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_BATCHING_ONERENDEREDOBJECTPERBATCH) {
+	IND_Surface *surface = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(surface, const_cast<char *>("rabbit.png"), IND_ALPHA, IND_32));
+
+	const int num = 20;
+	IND_Entity2d *entities [num];
+	for (int i = 0; i < num; i++) {
+		entities[i] = IND_Entity2d::newEntity2d();
+		iLib->_entity2dManager->add(entities[i]);
+		entities[i]->setSurface(surface);
+		entities[i]->setPosition(static_cast<float>(i * 30), 100, 0);
+	}
+
+	// Same texture for all of them, sent to the graphic card at once
+	iLib->_render->resetNumrenderedObject();
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+	CHECK_EQUAL(1, iLib->_render->getNumrenderedObjectsInt());
+
+	iLib->_render->setSpriteBatching(false);
+	iLib->_render->resetNumrenderedObject();
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+	CHECK_EQUAL(num, iLib->_render->getNumrenderedObjectsInt());
+}
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_STATICLAYER_VISITSONLYVISIBLE) {
+	// Without batching, each drawn sprite is a rendered object
+	iLib->_render->setSpriteBatching(false);
+	IND_Surface *surface = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(surface, const_cast<char *>("rabbit.png"), IND_ALPHA, IND_32));
+
+	const int num = 400;
+	IND_Entity2d *entities [num];
+	spawnColliders(iLib, surface, entities, num, 100);
+	for (int i = 0; i < num; i++) {
+		entities[i]->setPosition(5000.0f + (i % 20) * 300.0f, 5000.0f + (i / 20) * 300.0f, 0);
+	}
+	entities[0]->setPosition(10, 10, 0);
+	entities[1]->setPosition(200, 100, 0);
+
+	// Dynamic layer: all of them visited
+	iLib->_render->resetNumrenderedObject();
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+	int dynamicRendered = iLib->_render->getNumrenderedObjectsInt();
+	CHECK_EQUAL(num, iLib->_entity2dManager->getNumVisitedEntities(0));
+
+	// Static layer: same entities drawn, visiting only the ones around the screen
+	iLib->_entity2dManager->setLayerStatic(0, true);
+	CHECK(iLib->_entity2dManager->isLayerStatic(0));
+	iLib->_render->resetNumrenderedObject();
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+	CHECK_EQUAL(dynamicRendered, iLib->_render->getNumrenderedObjectsInt());
+	CHECK_EQUAL(num, iLib->_entity2dManager->getNumEntities(0));
+	CHECK(iLib->_entity2dManager->getNumVisitedEntities(0) < num / 10);
+
+	// Moved entities are found in their new place
+	int visited = iLib->_entity2dManager->getNumVisitedEntities(0);
+	entities[num - 1]->setPosition(300, 300, 0);
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+	CHECK_EQUAL(visited + 1, iLib->_entity2dManager->getNumVisitedEntities(0));
+
+	iLib->_entity2dManager->setLayerStatic(0, false);
+	CHECK(!iLib->_entity2dManager->isLayerStatic(0));
+}
+
+// Renders some frames of entities moving on several layers, and keeps what was drawn and found
+static void renderMovingFrames(CIndieLib *iLib, IND_Entity2d **pEntities, int pNum, bool pPrepare, vector <int> &pResult) {
+	vector <IND_Entity2d *> found;
+
+	for (int frame = 0; frame < 5; frame++) {
+		for (int i = 0; i < pNum; i++) {
+			float x = static_cast<float>((i * 37 + frame * 53) % 1600) - 400.0f;
+			float y = static_cast<float>((i * 91 + frame * 29) % 1200) - 300.0f;
+			pEntities[i]->setPosition(x, y, (i + frame) % 7);
+			pEntities[i]->setAngleXYZ(0, 0, static_cast<float>((i + frame) % 360));
+			pEntities[i]->setScale(1.0f + (i % 3) * 0.5f, 1.0f);
+		}
+
+		if (pPrepare) {
+			iLib->_entity2dManager->prepareEntities2d();
+		}
+
+		iLib->_render->resetNumDiscardedObjects();
+		iLib->_render->resetNumrenderedObject();
+		iLib->_render->beginScene();
+		for (int layer = 0; layer < 3; layer++) {
+			iLib->_entity2dManager->renderEntities2d(layer);
+		}
+		iLib->_render->endScene();
+
+		pResult.push_back(iLib->_render->getNumDiscardedObjectsInt());
+		pResult.push_back(iLib->_render->getNumrenderedObjectsInt());
+		for (int layer = 0; layer < 3; layer++) {
+			pResult.push_back(iLib->_entity2dManager->queryRect(layer, 0, 0, 400, 300, found));
+			sort(found.begin(), found.end());
+			for (size_t i = 0; i < found.size(); i++) {
+				pResult.push_back(found[i]->getId());
+			}
+		}
+	}
+}
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_PREPAREENTITIES_SAMEASSERIAL) {
+	// Without batching, each drawn sprite is a rendered object
+	iLib->_render->setSpriteBatching(false);
+	IND_Surface *surface = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(surface, const_cast<char *>("rabbit.png"), IND_ALPHA, IND_32));
+
+	const int num = 3000;
+	IND_Entity2d *entities [num];
+	for (int i = 0; i < num; i++) {
+		entities[i] = IND_Entity2d::newEntity2d();
+		iLib->_entity2dManager->add(i % 3, entities[i]);
+		entities[i]->setSurface(surface);
+		entities[i]->setBoundingCircle("body", 16, 16, 12);
+	}
+	iLib->_entity2dManager->setLayerStatic(2, true);
+
+	vector <int> serial;
+	renderMovingFrames(iLib, entities, num, false, serial);
+
+	vector <int> prepared;
+	renderMovingFrames(iLib, entities, num, true, prepared);
+	CHECK(serial == prepared);
+
+	iLib->_entity2dManager->setNumThreads(4);
+	CHECK_EQUAL(4, iLib->_entity2dManager->getNumThreads());
+	vector <int> threaded;
+	renderMovingFrames(iLib, entities, num, true, threaded);
+	CHECK(serial == threaded);
+
+	iLib->_entity2dManager->setNumThreads(1);
+	CHECK_EQUAL(1, iLib->_entity2dManager->getNumThreads());
+}
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_ANIMATIONS_PLAYEDBYEACHENTITY) {
+	// 17 frames of 50 ms
+	IND_Animation *animation = IND_Animation::newAnimation();
+	CHECK(iLib->_animationManager->addToSurface(animation, "animations/ufo.xml", IND_ALPHA, IND_32));
+
+	IND_Entity2d *entities [3];
+	for (int i = 0; i < 3; i++) {
+		entities[i] = IND_Entity2d::newEntity2d();
+		iLib->_entity2dManager->add(entities[i]);
+		entities[i]->setAnimation(animation);
+		entities[i]->setPosition(100.0f * i, 100, 0);
+	}
+	entities[2]->setNumReplays(0);
+
+	// Clock moved by hand
+	iLib->_entity2dManager->advanceAnimations(0);
+	const unsigned long steps [] = {0, 120, 60, 60, 1720, 5000};
+	const int expected [][3] = {{0, 0, 0}, {2, 2, 2}, {3, 0, 3}, {4, 1, 4}, {5, 1, 16}, {3, 1, 16}};
+	for (int i = 0; i < 6; i++) {
+		iLib->_entity2dManager->advanceAnimations(steps[i]);
+		if (i == 2) {
+			// Starts again, without changing the others
+			entities[1]->setSequence(0);
+		}
+		if (i == 4) {
+			entities[1]->setShow(false);
+		}
+
+		iLib->_render->beginScene();
+		iLib->_entity2dManager->renderEntities2d();
+		iLib->_render->endScene();
+
+		for (int j = 0; j < 3; j++) {
+			CHECK_EQUAL(expected[i][j], entities[j]->getActualFrame());
+		}
+	}
+
+	// The animation itself is not played
+	CHECK_EQUAL(0u, animation->getActualFramePos(0));
+}
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_ANIMATIONS_CULLEDOFFSCREEN) {
+	// 17 frames of 50 ms
+	IND_Animation *animation = IND_Animation::newAnimation();
+	CHECK(iLib->_animationManager->addToSurface(animation, "animations/ufo.xml", IND_ALPHA, IND_32));
+	iLib->_entity2dManager->add(testEntity);
+	testEntity->setAnimation(animation);
+	testEntity->setPosition(-10000, 100, 0);
+
+	iLib->_entity2dManager->advanceAnimations(0);
+	for (int i = 0; i < 2; i++) {
+		iLib->_render->resetNumDiscardedObjects();
+		iLib->_render->resetNumrenderedObject();
+		iLib->_render->beginScene();
+		iLib->_entity2dManager->renderEntities2d();
+		iLib->_render->endScene();
+		CHECK_EQUAL(1, iLib->_render->getNumDiscardedObjectsInt());
+		CHECK_EQUAL(0, iLib->_render->getNumrenderedObjectsInt());
+		iLib->_entity2dManager->advanceAnimations(120);
+	}
+
+	// Frames went on while it was out of the screen
+	testEntity->setPosition(100, 100, 0);
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+	CHECK_EQUAL(4, testEntity->getActualFrame());
+}
+
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_TEXT_LAIDOUTWHENCHANGED) {
+	// Without batching, each drawn sprite is a rendered object
+	iLib->_render->setSpriteBatching(false);
+	IND_Font *font = IND_Font::newFont();
+	CHECK(iLib->_fontManager->addMudFont(font, "font_small.png", "font_small.xml", IND_ALPHA, IND_32));
+	iLib->_entity2dManager->add(testEntity);
+	testEntity->setFont(font);
+	testEntity->setText("Hello\nWorld");
+	testEntity->setAlign(IND_CENTER);
+	testEntity->setPosition(400, 100, 0);
+
+	// One quad for each letter
+	for (int i = 0; i < 2; i++) {
+		iLib->_render->resetNumrenderedObject();
+		iLib->_render->beginScene();
+		iLib->_entity2dManager->renderEntities2d();
+		iLib->_render->endScene();
+		CHECK_EQUAL(10, iLib->_render->getNumrenderedObjectsInt());
+	}
+
+	testEntity->setText("Hi");
+	iLib->_render->resetNumrenderedObject();
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+	CHECK_EQUAL(2, iLib->_render->getNumrenderedObjectsInt());
+
+	// Out of the screen as a whole
+	testEntity->setPosition(-10000, 100, 0);
+	iLib->_render->resetNumrenderedObject();
+	iLib->_render->beginScene();
+	iLib->_entity2dManager->renderEntities2d();
+	iLib->_render->endScene();
+	CHECK_EQUAL(0, iLib->_render->getNumrenderedObjectsInt());
+}
+
+SUITE(Benchmarks) {
+// Benchmark: spawning and despawning many entities, removed in scattered order
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_BENCHMARK_CHURN100K) {
+	IND_Entity2d **entities = new IND_Entity2d* [CHURN_ENTITIES];
+	entities[0] = testEntity;
+	for (int i = 1; i < CHURN_ENTITIES; i++) {
+		entities[i] = IND_Entity2d::newEntity2d();
+	}
+
+	UnitTest::Timer timer;
+	timer.Start();
+
+	for (int i = 0; i < CHURN_ENTITIES; i++) {
+		iLib->_entity2dManager->add(entities[i]);
+	}
+
+	// 7919 is prime, so this visits every entity once, far from the previous one
+	for (int i = 0; i < CHURN_ENTITIES; i++) {
+		CHECK(iLib->_entity2dManager->remove(entities[(i * 7919) % CHURN_ENTITIES]));
+	}
+
+	int churnMs = timer.GetTimeInMs();
+
+	// Same again, removing in bulk
+	timer.Start();
+	for (int i = 0; i < CHURN_ENTITIES; i++) {
+		iLib->_entity2dManager->add(entities[i]);
+	}
+	CHECK(iLib->_entity2dManager->remove(entities, CHURN_ENTITIES));
+	int bulkMs = timer.GetTimeInMs();
+
+	printf("Entity churn %d: %d ms one by one, %d ms removing an array\n", CHURN_ENTITIES, churnMs, bulkMs);
+
+	for (int i = 0; i < CHURN_ENTITIES; i++) {
+		entities[i]->destroy();
+	}
+	delete [] entities;
+}
+
+// Benchmark: finding colliding pairs among many entities, with the same density of entities
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_BENCHMARK_BROADPHASE) {
+	IND_Surface *surface = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(surface, const_cast<char *>("rabbit.png"), IND_ALPHA, IND_32));
+
+	const int sizes [] = {1000, 5000, 10000, 50000};
+	for (int s = 0; s < 4; s++) {
+		int num = sizes[s];
+		int side = static_cast<int>(sqrtf(static_cast<float>(num)) * 40.0f);
+		IND_Entity2d **entities = new IND_Entity2d* [num];
+		spawnColliders(iLib, surface, entities, num, side);
+
+		UnitTest::Timer timer;
+		timer.Start();
+		int pairs = iLib->_entity2dManager->queryCollisions(0, "body", "body", NULL, NULL);
+		int buildMs = timer.GetTimeInMs();
+
+		// A tenth of the entities move: only those are placed again
+		for (int i = 0; i < num; i += 10) {
+			entities[i]->setPosition(entities[i]->getPosX() + 20, entities[i]->getPosY(), 0);
+		}
+		iLib->_render->beginScene();
+		iLib->_entity2dManager->renderEntities2d();
+		iLib->_render->endScene();
+
+		timer.Start();
+		iLib->_entity2dManager->queryCollisions(0, "body", "body", NULL, NULL);
+		int updateMs = timer.GetTimeInMs();
+
+		printf("Broadphase %d entities: %d pairs, %d ms first query, %d ms after moving 10%%", num, pairs, buildMs, updateMs);
+
+		// Checking every pair, only for the smallest size
+		if (num <= 1000) {
+			timer.Start();
+			int pairwise = 0;
+			for (int i = 0; i < num; i++) {
+				for (int j = i + 1; j < num; j++) {
+					if (iLib->_entity2dManager->isCollision(entities[i], "body", entities[j], "body"))
+						pairwise++;
+				}
+			}
+			printf(", %d ms pairwise", timer.GetTimeInMs());
+		}
+		printf("\n");
+
+		CHECK(iLib->_entity2dManager->remove(entities, num));
+		for (int i = 0; i < num; i++) {
+			entities[i]->destroy();
+		}
+		delete [] entities;
+	}
+}
+
+// Benchmark: each entity checked against many others, as games usually do
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_BENCHMARK_NARROWPHASE) {
+	IND_Surface *surface = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(surface, const_cast<char *>("rabbit.png"), IND_ALPHA, IND_32));
+
+	const int num = 500;
+	IND_Entity2d *entities [num];
+	spawnColliders(iLib, surface, entities, num, 800);
+	for (int i = 0; i < num; i += 2) {
+		entities[i]->setBoundingRectangle("feet", 4, 20, 24, 12);
+	}
+
+	UnitTest::Timer timer;
+	timer.Start();
+	int collisions = 0;
+	for (int i = 0; i < num; i++) {
+		for (int j = 0; j < num; j++) {
+			if (i != j && iLib->_entity2dManager->isCollision(entities[i], "*", entities[j], "*"))
+				collisions++;
+		}
+	}
+
+	printf("Narrowphase %d x %d entities: %d collisions, %d ms\n", num, num, collisions, timer.GetTimeInMs());
+}
+
+// Benchmark: pixel collisions against the triangles of a bounding rectangle, same entities
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_BENCHMARK_PIXELCOLLISION) {
+	iLib->_surfaceManager->setAlphaMasks(true, 128);
+	IND_Surface *surface = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(surface, const_cast<char *>("rabbit.png"), IND_ALPHA, IND_32));
+
+	const int num = 500;
+	IND_Entity2d *entities [num];
+	spawnColliders(iLib, surface, entities, num, 400);
+	for (int i = 0; i < num; i++) {
+		entities[i]->setBoundingRectangle("box", 0, 0, surface->getWidth(), surface->getHeight());
+	}
+
+	UnitTest::Timer timer;
+	timer.Start();
+	int triangles = 0;
+	for (int i = 0; i < num; i++) {
+		for (int j = 0; j < num; j++) {
+			if (i != j && iLib->_entity2dManager->isCollision(entities[i], "box", entities[j], "box"))
+				triangles++;
+		}
+	}
+	int trianglesMs = timer.GetTimeInMs();
+
+	timer.Start();
+	int pixels = 0;
+	for (int i = 0; i < num; i++) {
+		for (int j = 0; j < num; j++) {
+			if (i != j && iLib->_entity2dManager->isPixelCollision(entities[i], entities[j]))
+				pixels++;
+		}
+	}
+	int pixelsMs = timer.GetTimeInMs();
+
+	// Visible pixels are inside the whole image
+	CHECK(pixels <= triangles);
+	printf("Collisions %d x %d entities: %d with triangles in %d ms, %d with pixels in %d ms\n",
+	       num, num, triangles, trianglesMs, pixels, pixelsMs);
+}
+
+// Benchmark: a big scrolling world, with only some entities on the screen
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_BENCHMARK_OFFSCREENCULLING) {
+	IND_Surface *surface = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(surface, const_cast<char *>("rabbit.png"), IND_ALPHA, IND_32));
+
+	const int num = 50000;
+	IND_Entity2d **entities = new IND_Entity2d *[num];
+	spawnColliders(iLib, surface, entities, num, 20000);
+
+	const int frames = 20;
+	UnitTest::Timer timer;
+	timer.Start();
+	for (int i = 0; i < frames; i++) {
+		iLib->_render->resetNumDiscardedObjects();
+		iLib->_render->beginScene();
+		iLib->_entity2dManager->renderEntities2d();
+		iLib->_render->endScene();
+	}
+
+	printf("Culling %d entities: %d discarded, %.2f ms per frame\n",
+	       num, iLib->_render->getNumDiscardedObjectsInt(), timer.GetTimeInMs() / static_cast<float>(frames));
+	delete [] entities;
+}
+
+// Benchmark: a big static world (tiles, scenery), dynamic layer against static layer
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_BENCHMARK_STATICLAYER) {
+	IND_Surface *surface = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(surface, const_cast<char *>("rabbit.png"), IND_ALPHA, IND_32));
+
+	const int num = 50000;
+	IND_Entity2d **entities = new IND_Entity2d *[num];
+	spawnColliders(iLib, surface, entities, num, 20000);
+
+	const int frames = 20;
+	int ms [2];
+	for (int pass = 0; pass < 2; pass++) {
+		iLib->_entity2dManager->setLayerStatic(0, pass == 1);
+		UnitTest::Timer timer;
+		timer.Start();
+		for (int i = 0; i < frames; i++) {
+			iLib->_render->beginScene();
+			iLib->_entity2dManager->renderEntities2d();
+			iLib->_render->endScene();
+		}
+		ms[pass] = timer.GetTimeInMs();
+	}
+
+	printf("Static layer, %d entities: %.2f ms per frame dynamic, %.2f ms per frame static (%d visited)\n",
+	       num, ms[0] / static_cast<float>(frames), ms[1] / static_cast<float>(frames),
+	       iLib->_entity2dManager->getNumVisitedEntities(0));
+	delete [] entities;
+}
+
+// Benchmark: frame preparation of many moving entities, by the calling thread and by all the processors
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_BENCHMARK_PREPAREENTITIES) {
+	IND_Surface *surface = IND_Surface::newSurface();
+	CHECK(iLib->_surfaceManager->add(surface, const_cast<char *>("rabbit.png"), IND_ALPHA, IND_32));
+
+	const int num = 50000;
+	IND_Entity2d **entities = new IND_Entity2d *[num];
+	spawnColliders(iLib, surface, entities, num, 4000);
+
+	const int frames = 20;
+	int ms [2];
+	for (int pass = 0; pass < 2; pass++) {
+		iLib->_entity2dManager->setNumThreads(pass ? 0 : 1);
+		UnitTest::Timer timer;
+		timer.Start();
+		for (int i = 0; i < frames; i++) {
+			for (int j = 0; j < num; j++) {
+				entities[j]->setAngleXYZ(0, 0, static_cast<float>(i + j % 360));
+			}
+			iLib->_entity2dManager->prepareEntities2d();
+			iLib->_render->beginScene();
+			iLib->_entity2dManager->renderEntities2d();
+			iLib->_render->endScene();
+		}
+		ms[pass] = timer.GetTimeInMs();
+	}
+
+	printf("Frame preparation, %d entities: %.2f ms per frame with 1 thread, %.2f ms per frame with %d threads\n",
+	       num, ms[0] / static_cast<float>(frames), ms[1] / static_cast<float>(frames),
+	       iLib->_entity2dManager->getNumThreads());
+	delete [] entities;
+}
+
+// Benchmark: lots of entities playing the same animation, each one at its own frame
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_BENCHMARK_SHAREDANIMATION) {
+	IND_Animation *animation = IND_Animation::newAnimation();
+	CHECK(iLib->_animationManager->addToSurface(animation, "animations/ufo.xml", IND_ALPHA, IND_32));
+
+	const int num = 10000;
+	for (int i = 0; i < num; i++) {
+		IND_Entity2d *entity = IND_Entity2d::newEntity2d();
+		iLib->_entity2dManager->add(entity);
+		entity->setAnimation(animation);
+		entity->setPosition(static_cast<float>(i % 100) * 8.0f, static_cast<float>(i / 100) * 6.0f, 0);
+	}
+
+	const int frames = 20;
+	iLib->_entity2dManager->advanceAnimations(0);
+	UnitTest::Timer timer;
+	timer.Start();
+	for (int i = 0; i < frames; i++) {
+		// Slow frames: several animation frames each
+		iLib->_entity2dManager->advanceAnimations(180);
+		iLib->_render->beginScene();
+		iLib->_entity2dManager->renderEntities2d();
+		iLib->_render->endScene();
+	}
+
+	printf("Shared animation, %d entities: %.2f ms per frame\n", num, timer.GetTimeInMs() / static_cast<float>(frames));
+}
+
+// Benchmark: a HUD of static text entities, drawn from the layout kept in each entity, and laid out
+// again every frame (as before, when each letter was drawn apart)
+TEST_FIXTURE(entityFixture,ENTITY2DMANAGER_BENCHMARK_STATICTEXT) {
+	IND_Font *font = IND_Font::newFont();
+	CHECK(iLib->_fontManager->addMudFont(font, "font_small.png", "font_small.xml", IND_ALPHA, IND_32));
+
+	const int num = 500;
+	const char *text = "Score 0123456789\nLives 3 Level 12\nThe quick brown fox";
+	IND_Entity2d *entities [num];
+	for (int i = 0; i < num; i++) {
+		entities[i] = IND_Entity2d::newEntity2d();
+		iLib->_entity2dManager->add(entities[i]);
+		entities[i]->setFont(font);
+		entities[i]->setText(text);
+		entities[i]->setAlign(IND_CENTER);
+		entities[i]->setPosition(static_cast<float>(i % 10) * 80.0f, static_cast<float>(i / 10) * 12.0f, 0);
+	}
+
+	const int frames = 20;
+	UnitTest::Timer timer;
+	timer.Start();
+	for (int i = 0; i < frames; i++) {
+		iLib->_render->beginScene();
+		iLib->_entity2dManager->renderEntities2d();
+		iLib->_render->endScene();
+	}
+	float cachedMs = timer.GetTimeInMs() / static_cast<float>(frames);
+
+	timer.Start();
+	for (int i = 0; i < frames; i++) {
+		for (int j = 0; j < num; j++) {
+			entities[j]->setText(text);
+		}
+		iLib->_render->beginScene();
+		iLib->_entity2dManager->renderEntities2d();
+		iLib->_render->endScene();
+	}
+	float layoutMs = timer.GetTimeInMs() / static_cast<float>(frames);
+
+	printf("Static text, %d entities: %.2f ms per frame with cached layout, %.2f ms laid out every frame\n", num, cachedMs, layoutMs);
+}
+}
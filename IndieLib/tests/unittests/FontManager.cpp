@@ -26,6 +26,8 @@
 #include "dependencies/unittest++/src/UnitTest++.h"
 #include "CIndieLib.h"
 #include "IND_Font.h"
+#include <stdio.h>
+#include <string>
 
 struct fontFixture {
     fontFixture() {
@@ -63,3 +65,43 @@ TEST_FIXTURE(fontFixture,FONTMANAGER_ADDEXISTING_REMOVEIT_NOFAIL) {
 TEST_FIXTURE(fontFixture,FONTMANAGER_REMOVENONEXISTING_FAILS) {
     CHECK(!iLib->_fontManager->remove(testFont));
 }
+
+TEST_FIXTURE(fontFixture,FONTMANAGER_ADDANGELCODE_REMOVEIT_NOFAIL) {
+	CHECK(iLib->_fontManager->addAngelcodeFont(testFont, "cooper.xml", IND_ALPHA, IND_32));
+    CHECK(iLib->_fontManager->remove(testFont));
+}
+
+SUITE(Benchmarks) {
+// Benchmark: drawing a long centered HUD text. Letters are found by character and all the line widths
+// are measured in one pass, so the cost grows with the number of characters only
+#define BENCHMARK_TEXT_LINES 200
+#define BENCHMARK_TEXT_FRAMES 20
+
+static void benchmarkText(CIndieLib *iLib, IND_Font *font, const char *name) {
+    std::string text;
+    for (int i = 0; i < BENCHMARK_TEXT_LINES; i++) {
+        text += "The quick brown fox jumps over the lazy dog 0123456789 !?\n";
+    }
+
+    UnitTest::Timer timer;
+    timer.Start();
+    for (int i = 0; i < BENCHMARK_TEXT_FRAMES; i++) {
+        iLib->_render->beginScene();
+        iLib->_render->blitText(font, const_cast<char *>(text.c_str()), 400, 0, 0, 20, 1.0f, 1.0f,
+                                255, 255, 255, 255, 0, 0, 0, 255, IND_FILTER_POINT, IND_SRCALPHA, IND_INVSRCALPHA, IND_CENTER);
+        iLib->_render->endScene();
+    }
+    int textMs = timer.GetTimeInMs();
+
+    printf("Text %s: %d ms for %d frames of %d chars\n", name, textMs, BENCHMARK_TEXT_FRAMES, static_cast<int>(text.size()));
+}
+
+TEST_FIXTURE(fontFixture,FONTMANAGER_BENCHMARK_CENTEREDTEXT) {
+	CHECK(iLib->_fontManager->addMudFont(testFont, "font_small.png", "font_small.xml", IND_ALPHA, IND_32));
+    benchmarkText(iLib, testFont, "MudFont");
+
+    IND_Font *angelFont = IND_Font::newFont();
+	CHECK(iLib->_fontManager->addAngelcodeFont(angelFont, "cooper.xml", IND_ALPHA, IND_32));
+    benchmarkText(iLib, angelFont, "AngelCode");
+}
+}
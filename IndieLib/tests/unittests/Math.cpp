@@ -24,6 +24,7 @@
  *****************************************************************************************/
 #include "dependencies/unittest++/src/UnitTest++.h"
 #include "CIndieLib.h"
+#include <stdio.h>
 
 
 /*
@@ -590,3 +591,267 @@ TEST_FIXTURE(INDMathTests,idendityMatrix) {
     CHECK_CLOSE(0.f, matrix._43, 0.01f);
     CHECK_CLOSE(1.f, matrix._44, 0.01f);
 }
+
+// Transform chain as built by the general path of IND_Render::setTransform2d()
+static void transform2dChain(IND_Math *math, IND_Matrix &result,
+                             float x, float y, float angle, float scaleX, float scaleY,
+                             float axisX, float axisY, bool mirrorX, bool mirrorY, float width, float height) {
+    IND_Matrix step;
+    math->matrix4DSetIdentity(result);
+    if (x != 0.0f || y != 0.0f) {
+        math->matrix4DSetTranslation(step, x, y, 0.0f);
+        math->matrix4DMultiplyInPlace(result, step);
+    }
+    if (scaleX != 1.0f || scaleY != 1.0f) {
+        math->matrix4DSetScale(step, scaleX, scaleY, 0.0f);
+        math->matrix4DMultiplyInPlace(result, step);
+    }
+    if (angle != 0.0f) {
+        math->matrix4DSetRotationAroundAxis(step, angle, IND_Vector3(0.0f, 0.0f, 1.0f));
+        math->matrix4DMultiplyInPlace(result, step);
+    }
+    if (axisX != 0.0f || axisY != 0.0f) {
+        math->matrix4DSetTranslation(step, axisX, axisY, 0.0f);
+        math->matrix4DMultiplyInPlace(result, step);
+    }
+    if (mirrorX) {
+        math->matrix4DSetTranslation(step, width, 0.0f, 0.0f);
+        math->matrix4DMultiplyInPlace(result, step);
+        math->matrix4DSetRotationAroundAxis(step, 180.0f, IND_Vector3(0.0f, 1.0f, 0.0f));
+        math->matrix4DMultiplyInPlace(result, step);
+    }
+    if (mirrorY) {
+        math->matrix4DSetTranslation(step, 0.0f, height, 0.0f);
+        math->matrix4DMultiplyInPlace(result, step);
+        math->matrix4DSetRotationAroundAxis(step, 180.0f, IND_Vector3(1.0f, 0.0f, 0.0f));
+        math->matrix4DMultiplyInPlace(result, step);
+    }
+}
+
+TEST_FIXTURE(INDMathTests,transform2dSameAsChain) {
+    const float angles [] = {0.0f, 30.0f, -90.0f, 217.5f};
+    for (int i = 0; i < 4; i++) {
+        for (int mirror = 0; mirror < 4; mirror++) {
+            IND_Matrix chain, closed;
+            bool mirrorX = (mirror & 1) != 0;
+            bool mirrorY = (mirror & 2) != 0;
+            transform2dChain(math, chain, 120.0f, -45.0f, angles[i], 1.5f, 0.75f, -32.0f, -16.0f, mirrorX, mirrorY, 64.0f, 48.0f);
+            math->matrix4DSetTransform2d(closed, 120.0f, -45.0f, angles[i], 1.5f, 0.75f, -32.0f, -16.0f, mirrorX, mirrorY, 64.0f, 48.0f);
+
+            //Z column is irrelevant for 2d vertices (z = 0)
+            CHECK_CLOSE(chain._11, closed._11, 0.001f);
+            CHECK_CLOSE(chain._12, closed._12, 0.001f);
+            CHECK_CLOSE(chain._14, closed._14, 0.001f);
+            CHECK_CLOSE(chain._21, closed._21, 0.001f);
+            CHECK_CLOSE(chain._22, closed._22, 0.001f);
+            CHECK_CLOSE(chain._24, closed._24, 0.001f);
+            CHECK_CLOSE(chain._31, closed._31, 0.001f);
+            CHECK_CLOSE(chain._32, closed._32, 0.001f);
+            CHECK_CLOSE(chain._34, closed._34, 0.001f);
+            CHECK_CLOSE(chain._41, closed._41, 0.001f);
+            CHECK_CLOSE(chain._42, closed._42, 0.001f);
+            CHECK_CLOSE(chain._44, closed._44, 0.001f);
+        }
+    }
+}
+
+TEST_FIXTURE(INDMathTests,transform2dNoScaleKeepsZ) {
+    IND_Matrix chain, closed;
+    transform2dChain(math, chain, 10.0f, 20.0f, 45.0f, 1.0f, 1.0f, 0.0f, 0.0f, true, false, 64.0f, 48.0f);
+    math->matrix4DSetTransform2d(closed, 10.0f, 20.0f, 45.0f, 1.0f, 1.0f, 0.0f, 0.0f, true, false, 64.0f, 48.0f);
+    CHECK_CLOSE(chain._33, closed._33, 0.001f);
+}
+
+// Shapes for the batch collision tests, placed with a fixed seed so both versions check the same ones
+struct BatchShapes {
+    float x[IND_MATH_BATCH_SIZE], y[IND_MATH_BATCH_SIZE];
+    int radius[IND_MATH_BATCH_SIZE];
+    float ax[IND_MATH_BATCH_SIZE], ay[IND_MATH_BATCH_SIZE];
+    float bx[IND_MATH_BATCH_SIZE], by[IND_MATH_BATCH_SIZE];
+    float cx[IND_MATH_BATCH_SIZE], cy[IND_MATH_BATCH_SIZE];
+    unsigned int seed;
+
+    BatchShapes() : seed(1) {}
+
+    float random(float range) {
+        seed = seed * 1103515245 + 12345;
+        return static_cast<float>((seed >> 8) % 20000) / 20000.0f * range - range / 2.0f;
+    }
+
+    void place() {
+        for (int i = 0; i < IND_MATH_BATCH_SIZE; i++) {
+            x[i] = random(200.0f);
+            y[i] = random(200.0f);
+            radius[i] = 5 + static_cast<int>(random(40.0f) + 20.0f);
+            ax[i] = random(200.0f);
+            ay[i] = random(200.0f);
+            bx[i] = ax[i] + random(100.0f);
+            by[i] = ay[i] + random(100.0f);
+            cx[i] = ax[i] + random(100.0f);
+            cy[i] = ay[i] + random(100.0f);
+        }
+
+        // Vertical and horizontal edges
+        bx[3] = ax[3];
+        by[5] = ay[5];
+    }
+};
+
+TEST_FIXTURE(INDMathTests,CircleToCircleCollisionBatchSameAsScalar) {
+    BatchShapes shapes;
+    for (int test = 0; test < 2000; test++) {
+        shapes.place();
+        IND_Vector2 center(shapes.random(200.0f), shapes.random(200.0f));
+        int radius = 5 + static_cast<int>(shapes.random(40.0f) + 20.0f);
+        int count = 1 + test % IND_MATH_BATCH_SIZE;
+
+        unsigned int hits = math->isCircleToCircleCollisionBatch(center, radius, shapes.x, shapes.y, shapes.radius, count);
+        for (int i = 0; i < count; i++) {
+            IND_Vector2 other(shapes.x[i], shapes.y[i]);
+            CHECK_EQUAL(math->isCircleToCircleCollision(center, radius, other, shapes.radius[i]), ((hits >> i) & 1) != 0);
+        }
+        if (count < IND_MATH_BATCH_SIZE)
+            CHECK_EQUAL(0u, hits >> count);
+    }
+}
+
+TEST_FIXTURE(INDMathTests,PointInsideTriangleBatchSameAsScalar) {
+    BatchShapes shapes;
+    for (int test = 0; test < 2000; test++) {
+        shapes.place();
+        IND_Vector2 point(shapes.random(200.0f), shapes.random(200.0f));
+        int count = 1 + test % IND_MATH_BATCH_SIZE;
+
+        unsigned int hits = math->isPointInsideTriangleBatch(point, shapes.ax, shapes.ay, shapes.bx, shapes.by, shapes.cx, shapes.cy, count);
+        for (int i = 0; i < count; i++) {
+            IND_Vector2 a(shapes.ax[i], shapes.ay[i]);
+            IND_Vector2 b(shapes.bx[i], shapes.by[i]);
+            IND_Vector2 c(shapes.cx[i], shapes.cy[i]);
+            CHECK_EQUAL(IND_Math::isPointInsideTriangle(point, a, b, c), ((hits >> i) & 1) != 0);
+        }
+    }
+}
+
+TEST_FIXTURE(INDMathTests,TriangleToTriangleCollisionBatchSameAsScalar) {
+    BatchShapes shapes;
+    for (int test = 0; test < 2000; test++) {
+        shapes.place();
+        IND_Vector2 a1(shapes.random(200.0f), shapes.random(200.0f));
+        IND_Vector2 b1(a1._x + shapes.random(100.0f), a1._y + shapes.random(100.0f));
+        IND_Vector2 c1(a1._x + shapes.random(100.0f), a1._y + shapes.random(100.0f));
+        int count = 1 + test % IND_MATH_BATCH_SIZE;
+
+        unsigned int hits = math->isTriangleToTriangleCollisionBatch(a1, b1, c1, shapes.ax, shapes.ay, shapes.bx, shapes.by, shapes.cx, shapes.cy, count);
+        for (int i = 0; i < count; i++) {
+            // The scalar version may move the vertices, so it gets copies
+            IND_Vector2 mA1(a1), mB1(b1), mC1(c1);
+            IND_Vector2 a2(shapes.ax[i], shapes.ay[i]);
+            IND_Vector2 b2(shapes.bx[i], shapes.by[i]);
+            IND_Vector2 c2(shapes.cx[i], shapes.cy[i]);
+            CHECK_EQUAL(math->isTriangleToTriangleCollision(mA1, mB1, mC1, a2, b2, c2), ((hits >> i) & 1) != 0);
+        }
+    }
+}
+
+SUITE(Benchmarks) {
+// Benchmark: transforms of 100k entities, with the general matrix chain and with the closed form
+TEST_FIXTURE(INDMathTests,transform2dBenchmark100k) {
+    const int numEntities = 100000;
+    IND_Matrix result;
+    float checksumChain (0.0f), checksumClosed (0.0f);
+
+    UnitTest::Timer timer;
+    timer.Start();
+    for (int i = 0; i < numEntities; i++) {
+        transform2dChain(math, result, static_cast<float>(i % 800), static_cast<float>(i % 600), static_cast<float>(i % 360),
+                         1.25f, 1.25f, -16.0f, -16.0f, (i & 1) != 0, false, 32.0f, 32.0f);
+        checksumChain += result._14;
+    }
+    int chainMs = timer.GetTimeInMs();
+
+    timer.Start();
+    for (int i = 0; i < numEntities; i++) {
+        math->matrix4DSetTransform2d(result, static_cast<float>(i % 800), static_cast<float>(i % 600), static_cast<float>(i % 360),
+                                     1.25f, 1.25f, -16.0f, -16.0f, (i & 1) != 0, false, 32.0f, 32.0f);
+        checksumClosed += result._14;
+    }
+    int closedMs = timer.GetTimeInMs();
+
+    printf("setTransform2d 100k entities: %d ms matrix chain, %d ms closed form\n", chainMs, closedMs);
+    CHECK_CLOSE(checksumChain / numEntities, checksumClosed / numEntities, 0.01f);
+}
+
+// Benchmark: a player against every bullet of a layer
+TEST_FIXTURE(INDMathTests,CircleToCircleCollisionBatchBenchmark) {
+    const int numBullets = 1 << 20;
+    float *x = new float [numBullets];
+    float *y = new float [numBullets];
+    int *radius = new int [numBullets];
+    for (int i = 0; i < numBullets; i++) {
+        x[i] = static_cast<float>((i * 7919) % 1024);
+        y[i] = static_cast<float>((i * 104729) % 768);
+        radius[i] = 4;
+    }
+    IND_Vector2 player(512.0f, 384.0f);
+
+    UnitTest::Timer timer;
+    timer.Start();
+    int hitsScalar = 0;
+    for (int i = 0; i < numBullets; i++) {
+        IND_Vector2 bullet(x[i], y[i]);
+        if (math->isCircleToCircleCollision(player, 16, bullet, radius[i]))
+            hitsScalar++;
+    }
+    int scalarMs = timer.GetTimeInMs();
+
+    timer.Start();
+    int hitsBatch = 0;
+    for (int i = 0; i < numBullets; i += IND_MATH_BATCH_SIZE) {
+        unsigned int hits = math->isCircleToCircleCollisionBatch(player, 16, x + i, y + i, radius + i, IND_MATH_BATCH_SIZE);
+        for (; hits; hits &= hits - 1)
+            hitsBatch++;
+    }
+    int batchMs = timer.GetTimeInMs();
+
+    printf("Circle against %d circles: %d ms one by one, %d ms in batches\n", numBullets, scalarMs, batchMs);
+    CHECK_EQUAL(hitsScalar, hitsBatch);
+
+    // Same bullets as triangles, against a point
+    float *bx = new float [numBullets];
+    float *cy = new float [numBullets];
+    for (int i = 0; i < numBullets; i++) {
+        bx[i] = x[i] + 20.0f;
+        cy[i] = y[i] + 20.0f;
+    }
+
+    timer.Start();
+    hitsScalar = 0;
+    for (int i = 0; i < numBullets; i++) {
+        IND_Vector2 a(x[i], y[i]);
+        IND_Vector2 b(bx[i], y[i]);
+        IND_Vector2 c(x[i], cy[i]);
+        if (IND_Math::isPointInsideTriangle(player, a, b, c))
+            hitsScalar++;
+    }
+    scalarMs = timer.GetTimeInMs();
+
+    timer.Start();
+    hitsBatch = 0;
+    for (int i = 0; i < numBullets; i += IND_MATH_BATCH_SIZE) {
+        unsigned int hits = math->isPointInsideTriangleBatch(player, x + i, y + i, bx + i, y + i, x + i, cy + i, IND_MATH_BATCH_SIZE);
+        for (; hits; hits &= hits - 1)
+            hitsBatch++;
+    }
+    batchMs = timer.GetTimeInMs();
+
+    printf("Point against %d triangles: %d ms one by one, %d ms in batches\n", numBullets, scalarMs, batchMs);
+    CHECK_EQUAL(hitsScalar, hitsBatch);
+
+    delete [] bx;
+    delete [] cy;
+
+    delete [] x;
+    delete [] y;
+    delete [] radius;
+}
+}
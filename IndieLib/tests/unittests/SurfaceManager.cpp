@@ -26,6 +26,11 @@
 #include "dependencies/unittest++/src/UnitTest++.h"
 #include "CIndieLib.h"
 #include "IND_Surface.h"
+#include "IND_Image.h"
+#include "ImageCutter.h"
+#include "dependencies/glew-1.9.0/include/GL/glew.h"
+#include <stdio.h>
+#include <vector>
 
 struct fixture {
     fixture() {
@@ -58,3 +63,101 @@ TEST_FIXTURE(fixture,SURFACEMANAGER_ADDEXISTING_REMOVEIT_NOFAIL) {
 TEST_FIXTURE(fixture,SURFACEMANAGER_REMOVENONEXISTING_FAILS) {
     CHECK(!iLib->_surfaceManager->remove(testSurf));
 }
+
+TEST_FIXTURE(fixture,SURFACEMANAGER_ATLASING_SMALLSURFACESSHAREPAGE) {
+    IND_Surface *otherSurf = IND_Surface::newSurface();
+    iLib->_surfaceManager->setAtlasing(true, 512);
+    CHECK(iLib->_surfaceManager->isAtlasing());
+
+    CHECK(iLib->_surfaceManager->add(testSurf,const_cast<char *>("rabbit.png"), IND_ALPHA, IND_32));
+    CHECK(iLib->_surfaceManager->add(otherSurf,const_cast<char *>("cursor.png"), IND_ALPHA, IND_32));
+    CHECK(testSurf->isAtlased());
+    CHECK(otherSurf->isAtlased());
+    CHECK_EQUAL(1, iLib->_surfaceManager->getNumAtlasPages());
+    CHECK(iLib->_surfaceManager->getAtlasPageOccupancy(0) > 0.0f);
+
+    CHECK(iLib->_surfaceManager->remove(testSurf));
+    CHECK_EQUAL(1, iLib->_surfaceManager->getNumAtlasPages());
+    CHECK(iLib->_surfaceManager->remove(otherSurf));
+    CHECK_EQUAL(0, iLib->_surfaceManager->getNumAtlasPages());
+}
+
+TEST_FIXTURE(fixture,SURFACEMANAGER_ATLASING_BIGSURFACENOTATLASED) {
+    iLib->_surfaceManager->setAtlasing(true, 64);
+    CHECK(iLib->_surfaceManager->add(testSurf,const_cast<char *>("gem_squared.png"), IND_ALPHA, IND_32));
+    CHECK(!testSurf->isAtlased());
+    CHECK_EQUAL(0, iLib->_surfaceManager->getNumAtlasPages());
+}
+
+TEST_FIXTURE(fixture,SURFACEMANAGER_NPOTIMAGE_ONEEXACTSIZETEXTURE) {
+    CHECK(iLib->_surfaceManager->add(testSurf,const_cast<char *>("star.png"), IND_ALPHA, IND_32));
+    if (iLib->_render->isNPOTTextureSupported()) {
+        CHECK_EQUAL(1, testSurf->getNumTextures());
+        CHECK_EQUAL(testSurf->getWidth(), testSurf->getWidthBlock());
+        CHECK_EQUAL(testSurf->getHeight(), testSurf->getHeightBlock());
+        CHECK_EQUAL(0, testSurf->getSpareX());
+        CHECK_EQUAL(0, testSurf->getSpareY());
+    }
+}
+
+TEST_FIXTURE(fixture,SURFACEMANAGER_UPDATE_CHANGEDAREA) {
+    IND_Image *image = IND_Image::newImage();
+    CHECK(iLib->_imageManager->add(image, 256, 256, IND_RGBA));
+    CHECK(iLib->_surfaceManager->add(testSurf, image, IND_ALPHA, IND_32));
+
+    image->putPixel(10, 20, 255, 0, 0, 255);
+    CHECK(iLib->_surfaceManager->update(testSurf, image, 10, 256 - 21, 1, 1));
+    CHECK_EQUAL(256, testSurf->getWidth());
+    CHECK_EQUAL(256, testSurf->getHeight());
+
+    CHECK(!iLib->_surfaceManager->update(NULL, image, 0, 0, 1, 1));
+
+    iLib->_imageManager->remove(image);
+}
+
+SUITE(Benchmarks) {
+// Benchmark: creating a surface from a 4096x4096 image. Blocks are read straight from the image now;
+// the previous path (ImageCutter::cutBlock and one glTexImage2D for every block) is timed apart to compare
+TEST_FIXTURE(fixture,SURFACEMANAGER_BENCHMARK_LOAD4096) {
+    IND_Image *bigImage = IND_Image::newImage();
+    CHECK(iLib->_imageManager->add(bigImage, 4096, 4096, IND_RGBA));
+
+    UnitTest::Timer timer;
+    timer.Start();
+    CHECK(iLib->_surfaceManager->add(testSurf, bigImage, IND_ALPHA, IND_32));
+    glFinish();
+    int uploadMs = timer.GetTimeInMs();
+
+    // Previous upload path, with the same blocks
+    ImageCutter cutter;
+    CHECK(cutter.init(iLib->_imageManager, iLib->_render->getMaxTextureSize(), iLib->_render->isNPOTTextureSupported()));
+    int bytespp = bigImage->getBytespp();
+    int widthBlock = testSurf->getWidthBlock();
+    int heightBlock = testSurf->getHeightBlock();
+    std::vector<GLuint> textures(testSurf->getNumBlocks());
+    glGenTextures(static_cast<GLsizei>(textures.size()), &textures[0]);
+    timer.Start();
+    for (int i = 0; i < testSurf->getBlocksY(); i++) {
+        for (int j = 0; j < testSurf->getBlocksX(); j++) {
+            int spareX = (j == testSurf->getBlocksX() - 1) ? testSurf->getSpareX() : 0;
+            int spareY = (i == testSurf->getBlocksY() - 1) ? testSurf->getSpareY() : 0;
+            unsigned char *src = bigImage->getPointer() + (i * heightBlock * bigImage->getWidth() + j * widthBlock) * bytespp;
+            unsigned char *block = 0;
+            cutter.cutBlock(src, bigImage->getWidth(), widthBlock, heightBlock, spareX, spareY, bytespp, &block);
+
+            glBindTexture(GL_TEXTURE_2D, textures[i * testSurf->getBlocksX() + j]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, widthBlock, heightBlock, 0, GL_RGBA, GL_UNSIGNED_BYTE, block);
+            delete [] block;
+        }
+    }
+    glFinish();
+    int previousMs = timer.GetTimeInMs();
+    glDeleteTextures(static_cast<GLsizei>(textures.size()), &textures[0]);
+    cutter.end();
+
+    printf("Surface 4096x4096: %d ms streamed upload, %d ms with the previous cut and upload (%d blocks)\n",
+           uploadMs, previousMs, testSurf->getNumBlocks());
+
+    iLib->_imageManager->remove(bigImage);
+}
+}
@@ -121,20 +121,33 @@ If you want to use a global time constraint, but have one test that is notorious
 */
 
 #include "dependencies/unittest++/src/UnitTest++.h"
+#include "dependencies/unittest++/src/TestReporterStdout.h"
 #include "WorkingPath.h"
 #include "IndiePlatforms.h"
 
 #if defined(PLATFORM_LINUX)
 #include <stdio.h>
 #endif
-
-
-int main() {
-	//Just run all tests
-    printf("PERFORMING UNIT TESTS...\n");
+#include <string.h>
+
+// The tests in the Benchmarks suite are slow and print timings, they only run when asked for
+struct NotBenchmark {
+	bool operator()(const UnitTest::Test *test) const {
+		return strcmp(test->m_details.suiteName, "Benchmarks") != 0;
+	}
+};
+
+int main(int argc, char **argv) {
+	//Run all tests but the benchmarks, or only the benchmarks with "unittest benchmarks"
+    bool benchmarks = argc > 1 && strcmp(argv[1], "benchmarks") == 0;
+    printf(benchmarks ? "PERFORMING BENCHMARKS...\n" : "PERFORMING UNIT TESTS...\n");
     const char* resourcesDir = WorkingPathSetup::unittestsResourcesDirectory();
     WorkingPathSetup::setWorkingPath(resourcesDir);
     
-	return UnitTest::RunAllTests();
+	UnitTest::TestReporterStdout reporter;
+	UnitTest::TestRunner runner(reporter);
+	if (benchmarks)
+		return runner.RunTestsIf(UnitTest::Test::GetTestList(), "Benchmarks", UnitTest::True(), 0);
+	return runner.RunTestsIf(UnitTest::Test::GetTestList(), NULL, NotBenchmark(), 0);
 }
 
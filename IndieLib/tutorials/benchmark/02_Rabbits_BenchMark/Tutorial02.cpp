@@ -85,9 +85,10 @@ Indielib_Main
 	
 	// ----- Main Loop -----
 
-	char mFpsString[128];
+	char mFpsString[256];
 	char mFpsValueString[15];
 	mFpsString [0] = 0;
+	int mSpritesPerSecond = 0;
 
 	while (!mI->_input->onKeyPress(IND_ESCAPE) && !mI->_input->quit())
 	{
@@ -100,7 +101,16 @@ Indielib_Main
 		strcpy(mFpsString, "Fps: ");
 		mI->_render->getFpsString(mFpsValueString);
 		strcat(mFpsString, mFpsValueString);
+		strcat(mFpsString, "\nSprites/s: ");
+		IND_Math::itoa(mSpritesPerSecond, mFpsValueString);
+		strcat(mFpsString, mFpsValueString);
+		strcat(mFpsString, "\nDraw calls: ");
+		mI->_render->getNumrenderedObjectsString(mFpsValueString);
+		strcat(mFpsString, mFpsValueString);
+		strcat(mFpsString, mI->_render->isInstancing() ? "\nInstancing: on" : "\nInstancing: off");
+		strcat(mFpsString, mI->_render->isSpriteBatching() ? "\nBatching: on" : "\nBatching: off");
 		strcat(mFpsString, "\nPress space to toggle full screen");
+		strcat(mFpsString, "\nPress I to toggle instancing, B to toggle batching");
 		mTextSmallWhite->setText(mFpsString);	
 
 		// ----- Game logic ----
@@ -108,6 +118,10 @@ Indielib_Main
 		// Toogle full screen when pressing "space"
 		if (mI->_input->onKeyPress(IND_SPACE)) mI->_render->toggleFullScreen();
 
+		// Compare the instanced path with the sprite batch and the per-sprite path
+		if (mI->_input->onKeyPress(IND_I)) mI->_render->setInstancing(!mI->_render->isInstancing());
+		if (mI->_input->onKeyPress(IND_B)) mI->_render->setSpriteBatching(!mI->_render->isSpriteBatching());
+
 		// Update rabbits position
 		for (int i = 0; i < MAX_OBJECTS; i++) mRabbits[i].update();	
 
@@ -115,8 +129,14 @@ Indielib_Main
 
 		mI->_render->beginScene();
 		mI->_render->clearViewPort(60, 60, 60);
+		mI->_render->resetNumrenderedObject();
+		mI->_render->resetNumDiscardedObjects();
 		mI->_entity2dManager->renderEntities2d();
 		mI->_render->endScene();
+
+		// Sprites drawn in this frame, times the frames per second. Rendered objects are draw calls
+		// when batching, so the sprites are the rabbits that were not discarded
+		mSpritesPerSecond = (MAX_OBJECTS - mI->_render->getNumDiscardedObjectsInt()) * mI->_render->getFpsInt();
 	}
 
 	// ----- Free -----